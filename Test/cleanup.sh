@@ -1,3 +1,4 @@
 #!/bin/sh -e
 
 rm -f *.tsv
+rm -f test-*-classes.txt
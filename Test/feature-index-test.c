@@ -0,0 +1,139 @@
+/***************************************************************************
+ *  Description:
+ *      Regression test for the implicit interval tree of feature_index_t.
+ *      Random features of widely varying lengths are indexed for many
+ *      chromosome sizes, including those that are not a power of 2, and
+ *      every query is checked against a brute-force scan.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+#define CHROM_SIZE      1000000
+#define QUERIES         200
+
+int     check_chrom(size_t n, uint64_t *state, size_t *mismatches);
+int64_t rand_range(uint64_t *state, int64_t limit);
+
+int     main(int argc, char *argv[])
+
+{
+    uint64_t    state = 1;
+    size_t      n, mismatches = 0;
+
+    if ( argc != 1 )
+    {
+	fprintf(stderr, "Usage: %s\n", argv[0]);
+	return EX_USAGE;
+    }
+    for (n = 1; n <= 600; ++n)
+	check_chrom(n, &state, &mismatches);
+    for (n = 1000; n <= 70000; n = n * 3 + 7)
+	check_chrom(n, &state, &mismatches);
+    if ( mismatches > 0 )
+    {
+	fprintf(stderr, "%s: %zu queries differ from brute force.\n",
+		argv[0], mismatches);
+	return EX_SOFTWARE;
+    }
+    printf("%s: All queries match brute force.\n", argv[0]);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Index n random features on one chromosome and compare QUERIES
+ *      random queries with a scan of every feature.  Most features are
+ *      short, with a few long enough to span many others, which is
+ *      where a wrong max_end hides overlaps.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     check_chrom(size_t n, uint64_t *state, size_t *mismatches)
+
+{
+    feature_index_t fi;
+    hit_list_t      hits = HIT_LIST_INIT;
+    size_t          chrom, f, q, h, expected;
+    int64_t         start, end, len;
+    bool            bad;
+
+    feature_index_init(&fi);
+    chrom = feature_index_add_chrom(&fi, "chr1", 0);
+    for (f = 0; f < n; ++f)
+    {
+	start = rand_range(state, CHROM_SIZE);
+	len = rand_range(state, 100) == 0 ? rand_range(state, CHROM_SIZE / 4) :
+	      rand_range(state, 2000);
+	feature_index_add(&fi, chrom, start, start + len + 1, "exon", '+');
+    }
+    feature_index_build(&fi);
+
+    for (q = 0; q < QUERIES; ++q)
+    {
+	start = rand_range(state, CHROM_SIZE);
+	end = start + rand_range(state, 5000) + 1;
+	feature_index_overlaps(&fi, chrom, start, end, &hits);
+
+	// Hits must be exactly the overlapping features, in index order
+	bad = false;
+	for (h = 1; h < hits.count; ++h)
+	    if ( hits.index[h] <= hits.index[h - 1] )
+		bad = true;
+	for (f = 0, h = 0, expected = 0; f < fi.count; ++f)
+	{
+	    if ( (fi.start[f] < end) && (start < fi.end[f]) )
+	    {
+		++expected;
+		while ( (h < hits.count) && (hits.index[h] < f) )
+		    ++h;
+		if ( (h == hits.count) || (hits.index[h] != f) )
+		    bad = true;
+	    }
+	}
+	if ( bad || (expected != hits.count) )
+	{
+	    fprintf(stderr, "n = %zu, [%" PRId64 ", %" PRId64 "): %zu hits, "
+		    "%zu expected\n", n, start, end, hits.count, expected);
+	    ++*mismatches;
+	}
+    }
+    hit_list_free(&hits);
+    feature_index_free(&fi);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return a pseudo-random integer in [0, limit) from a 64-bit
+ *      xorshift generator, so that results do not depend on the libc.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t rand_range(uint64_t *state, int64_t limit)
+
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (int64_t)(*state % (uint64_t)limit);
+}
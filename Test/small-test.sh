@@ -0,0 +1,152 @@
+#!/bin/sh -e
+
+##########################################################################
+#   Run each mode on the small data set in Small/ and compare the output
+#   with Small/Expected.  The in-memory classification is also compared
+#   with bedtools intersect if bedtools is installed.  Run by "make test".
+#
+#   Set UPDATE=yes to replace the expected output after a deliberate
+#   change in results, and review the diff before committing it.
+##########################################################################
+
+if [ $0 != ./small-test.sh ]; then
+    printf "Must be run as ./small-test.sh\n"
+    exit 1
+fi
+
+pc=$(pwd)/../peak-classifier
+fo=$(pwd)/../filter-overlaps
+expected=$(pwd)/Small/Expected
+work=$(mktemp -d ${TMPDIR:-/tmp}/small-test.XXXXXX)
+trap "rm -rf $work" EXIT
+
+# The augmented BEDs are cached next to the GFF, so work on a copy
+cp Small/*.* $work
+cd $work
+failed=0
+
+# check name output: compare output with Expected/name
+check()
+{
+    if [ "$UPDATE" = yes ]; then
+	cp $2 $expected/$1
+	printf "%-24s updated\n" $1
+    elif cmp -s $2 $expected/$1; then
+	printf "%-24s ok\n" $1
+    else
+	printf "%-24s FAILED\n" $1
+	diff -u $expected/$1 $2 | head -20
+	failed=1
+    fi
+}
+
+# run name output args...: run peak-classifier and check output
+run()
+{
+    name=$1
+    output=$2
+    shift 2
+    if ! $pc "$@" 2> $name.log; then
+	printf "%-24s FAILED\n" $name
+	cat $name.log
+	failed=1
+    else
+	check $name $output
+    fi
+}
+
+run enrichment.tsv enrichment.tsv \
+    --enrichment 50 --seed 1 --threads 2 --chrom-sizes chrom.sizes \
+    --exclude exclude.bed peaks.bed small.gff3 enrichment.tsv
+run class-coverage.tsv class-coverage.tsv \
+    --class-coverage --chrom-sizes chrom.sizes - small.gff3 class-coverage.tsv
+
+# Extra outputs are computed in memory, so a stand-in that discards the
+# peaks replaces bedtools intersect
+printf '#!/bin/sh\ncat > /dev/null\n' > no-bedtools
+chmod +x no-bedtools
+run composition.tsv composition.tsv --bedtools ./no-bedtools \
+    --composition composition.tsv peaks.bed small.gff3 overlaps.tsv
+run gene-rollup.tsv gene-rollup.tsv --bedtools ./no-bedtools \
+    --gene-rollup gene-rollup.tsv peaks.bed small.gff3 overlaps.tsv
+run gene-rollup-batch.tsv gene-rollup-batch.tsv \
+    --batch --gene-rollup gene-rollup-batch.tsv samples.txt small.gff3 \
+    overlaps.tsv
+run feature-counts.tsv feature-counts.tsv --bedtools ./no-bedtools \
+    --feature-counts feature-counts.tsv peaks.bed small.gff3 overlaps.tsv
+run consensus.tsv consensus.tsv \
+    --batch --consensus 2 samples.txt small.gff3 consensus.tsv
+run jaccard.tsv jaccard.tsv \
+    --batch --jaccard --threads 2 samples.txt jaccard.tsv
+run stitch.tsv stitch.tsv --stitch 5000 peaks.bed small.gff3 stitch.tsv
+run tiles.tsv tiles.tsv \
+    --tiles 5000:2500 --chrom-sizes chrom.sizes - small.gff3 tiles.tsv
+run great.tsv great.tsv --great --great-extension 50000 \
+    --chrom-sizes chrom.sizes peaks.bed small.gff3 great.tsv
+run motifs.tsv motifs.tsv --motifs motifs.jaspar --genome genome.fa.xz \
+    --threads 2 peaks.bed small.gff3 motifs.tsv
+run kmers.tsv kmers.tsv --kmers 3 --genome genome.fa.xz --threads 2 \
+    peaks.bed small.gff3 kmers.tsv
+run bigwig.tsv bigwig.tsv --bigwig signal.bw peaks.bed small.gff3 bigwig.tsv
+run bigwig-summary.tsv bigwig-summary.tsv --bigwig signal.bw \
+    --bigwig-summary peaks.bed small.gff3 bigwig-summary.tsv
+run liftover.tsv liftover.tsv --liftover shift.chain \
+    --great --great-extension 50000 --chrom-sizes chrom.sizes \
+    peaks-other-assembly.bed small.gff3 liftover.tsv
+run loops.tsv loops.tsv --loops --loop-genes loops.bedpe small.gff3 loops.tsv
+run interval-ops.tsv interval-ops.tsv --slop 100 --merge 500 \
+    --subtract exclude.bed --great --great-extension 50000 \
+    --chrom-sizes chrom.sizes peaks.bed small.gff3 interval-ops.tsv
+run isoforms.tsv isoforms.tsv --isoforms peaks.bed small.gff3 isoforms.tsv
+run atac-qc.json atac-qc.json \
+    --atac-qc alignments.sam.xz peaks.bed small.gff3 atac-qc.json
+run coverage.bedGraph coverage.bedGraph \
+    --bedgraph alignments.sam.xz coverage.bedGraph
+run coverage-cpm.bedGraph coverage-cpm.bedGraph \
+    --bedgraph alignments.sam.xz --cpm coverage-cpm.bedGraph
+run call-peaks.tsv call-peaks.tsv --call-peaks alignments.sam.xz \
+    --peak-pvalue 0.01 --isoforms called.narrowPeak small.gff3 call-peaks.tsv
+check called.narrowPeak called.narrowPeak
+run count-matrix.tsv count-matrix.tsv \
+    --count-matrix alignments.txt peaks.bed count-matrix.tsv
+run classify-reads.tsv classify-reads.tsv \
+    --classify-reads alignments.sam.xz - small.gff3 classify-reads.tsv
+run junctions.tsv junctions.tsv \
+    --junctions alignments.sam.xz - small.gff3 junctions.tsv
+run marked.sam marked.sam --mark-duplicates alignments.sam.xz marked.sam
+run filtered.sam filtered.sam --filter-alignments alignments.sam.xz \
+    --exclude-regions exclude.bed --min-mapq 10 filtered.sam
+
+if which bedtools > /dev/null 2>&1; then
+    # The highest priority class per peak from bedtools intersect must
+    # agree with the in-memory classification.  Enrichment omits classes
+    # with no observed or expected peaks, so compare only nonzero counts.
+    $pc peaks.bed small.gff3 overlaps.tsv 2> default.log
+    $pc --enrichment 1 --seed 1 --chrom-sizes chrom.sizes \
+	peaks.bed small.gff3 memory.tsv 2> memory.log
+    classes="five_prime_utr three_prime_utr intron exon upstream1000
+	     upstream10000 upstream100000"
+    # Feature names are class;type;name;id and filter-overlaps matches
+    # the whole name, so reduce them to the class first
+    awk 'BEGIN { FS = OFS = "\t"; } { sub(/;.*/, "", $6); print }' \
+	overlaps.tsv | $fo - filtered.tsv $classes | \
+	awk '$1 == "Overlaps" && $5 != 0 { print $3, $5 }' \
+	> bedtools-classes.txt
+    awk '$1 !~ /^#/ && $1 != "upstream-beyond" && $2 != 0 { print $1, $2 }' \
+	memory.tsv > memory-classes.txt
+    if cmp -s bedtools-classes.txt memory-classes.txt; then
+	printf "%-24s ok\n" "in-memory vs bedtools"
+    else
+	printf "%-24s FAILED\n" "in-memory vs bedtools"
+	diff bedtools-classes.txt memory-classes.txt || true
+	failed=1
+    fi
+else
+    printf "bedtools not found, skipping in-memory vs bedtools.\n"
+fi
+
+if [ $failed != 0 ]; then
+    printf "Some small tests failed.\n"
+    exit 1
+fi
+printf "All small tests passed.\n"
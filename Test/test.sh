@@ -59,3 +59,23 @@ printf "\nMidpoints only:\n\n"
     five_prime_utr three_prime_utr intron exon \
     upstream1000 upstream10000 upstream100000 upstream200000 upstream300000 \
     upstream400000 upstream500000 upstream600000 upstream700000 upstream800000 upstream-beyond
+
+printf "\nIn-memory vs bedtools highest priority class:\n\n"
+../peak-classifier --enrichment 1 --seed 1 test.bed.xz $gff \
+    test-enrichment.tsv
+awk 'BEGIN { FS = OFS = "\t"; } { sub(/;.*/, "", $6); print }' \
+    test-overlaps.tsv | ../filter-overlaps - test-class-filtered.tsv \
+    five_prime_utr three_prime_utr intron exon \
+    upstream1000 upstream10000 upstream100000 upstream200000 upstream300000 \
+    upstream400000 upstream500000 upstream600000 upstream700000 upstream800000 \
+    | awk '$1 == "Overlaps" && $5 != 0 { print $3, $5 }' \
+    > test-bedtools-classes.txt
+awk '$1 !~ /^#/ && $1 != "upstream-beyond" && $2 != 0 { print $1, $2 }' \
+    test-enrichment.tsv > test-memory-classes.txt
+if cmp -s test-bedtools-classes.txt test-memory-classes.txt; then
+    printf "Classes match.\n"
+else
+    printf "Classes differ:\n"
+    diff test-bedtools-classes.txt test-memory-classes.txt || true
+    exit 1
+fi
@@ -0,0 +1,417 @@
+/***************************************************************************
+ *  Description:
+ *      One-pass ATAC-seq quality control.  Alignments are streamed once
+ *      and each contributes to the fraction of insertions in peaks
+ *      (FRiP), the aggregate insertion profile around gene TSSs, and
+ *      the fragment length histogram, which are written as JSON.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+int     atac_tss_cmp(const atac_tss_t *t1, const atac_tss_t *t2)
+
+{
+    if ( t1->chrom != t2->chrom )
+	return t1->chrom < t2->chrom ? -1 : 1;
+    if ( t1->tss != t2->tss )
+	return t1->tss < t2->tss ? -1 : 1;
+    return t1->strand - t2->strand;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read and merge the peaks and build the TSS list from the genes
+ *      in fi, which must be loaded with track_genes.  Genes sharing a
+ *      TSS and strand are counted once so that the profile is not
+ *      weighted by gene model redundancy.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     atac_qc_load(atac_qc_t *qc, FILE *peak_stream, feature_index_t *fi)
+
+{
+    size_t  g, t, c;
+
+    memset(qc, 0, sizeof(*qc));
+    qc->peaks = (peak_set_t)PEAK_SET_INIT;
+    if ( peak_set_read(&qc->peaks, peak_stream, fi, false) != FEATURE_INDEX_OK )
+	return FEATURE_INDEX_BAD_DATA;
+    qc->peak_count = qc->peaks.count;
+    if ( interval_set_apply(INTERVAL_MERGE, &qc->peaks, NULL, fi, 0, 1)
+	    != EX_OK )
+	return FEATURE_INDEX_BAD_DATA;
+
+    qc->chrom_count = fi->chrom_count;
+    qc->peak_first = xt_malloc(qc->chrom_count + 1, sizeof(*qc->peak_first));
+    qc->tss_first = xt_malloc(qc->chrom_count + 1, sizeof(*qc->tss_first));
+    qc->tss = xt_malloc(fi->gene_count + 1, sizeof(*qc->tss));
+    if ( (qc->peak_first == NULL) || (qc->tss_first == NULL) ||
+	 (qc->tss == NULL) )
+    {
+	fputs("atac_qc_load(): Could not allocate index.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    interval_set_chrom_first(&qc->peaks, qc->chrom_count, qc->peak_first);
+
+    for (g = 0; g < fi->gene_count; ++g)
+    {
+	qc->tss[g].chrom = fi->genes[g].chrom;
+	qc->tss[g].strand = fi->genes[g].strand == '-' ? '-' : '+';
+	qc->tss[g].tss = qc->tss[g].strand == '-' ?
+			 fi->genes[g].end - 1 : fi->genes[g].start;
+    }
+    qsort(qc->tss, fi->gene_count, sizeof(*qc->tss),
+	  (int (*)(const void *, const void *))atac_tss_cmp);
+    for (g = t = 0; g < fi->gene_count; ++g)
+	if ( (t == 0) || (atac_tss_cmp(&qc->tss[g], &qc->tss[t - 1]) != 0) )
+	    qc->tss[t++] = qc->tss[g];
+    qc->tss_count = t;
+
+    memset(qc->tss_first, 0, (qc->chrom_count + 1) * sizeof(*qc->tss_first));
+    for (t = 0; t < qc->tss_count; ++t)
+	++qc->tss_first[qc->tss[t].chrom + 1];
+    for (c = 0; c < qc->chrom_count; ++c)
+	qc->tss_first[c + 1] += qc->tss_first[c];
+    return FEATURE_INDEX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute the number of reference bases covered by a CIGAR string,
+ *      from its M, D, N, =, and X operations.
+ *
+ *  Returns:
+ *      Reference length, 0 for "*"
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t cigar_ref_len(const char *cigar)
+
+{
+    int64_t len = 0, n;
+    char    *end;
+
+    if ( cigar == NULL )
+	return 0;
+    while ( isdigit((unsigned char)*cigar) )
+    {
+	n = strtoll(cigar, &end, 10);
+	switch(*end)
+	{
+	    case    'M':
+	    case    'D':
+	    case    'N':
+	    case    '=':
+	    case    'X':
+		len += n;
+		break;
+	    case    '\0':
+		return len;
+	}
+	cigar = end + 1;
+    }
+    return len;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Locate the Tn5 insertion of an alignment starting at 0-based
+ *      position start, shifted +4 on the plus strand and -5 on the minus
+ *      strand to the center of the 9 base duplication.
+ *
+ *  Returns:
+ *      0-based insertion position
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t atac_insertion(unsigned flag, int64_t start, const char *cigar)
+
+{
+    int64_t pos;
+
+    if ( flag & BL_SAM_FLAG_REVERSE )
+    {
+	pos = start + cigar_ref_len(cigar) - 1 - 5;
+	return pos < start ? start : pos;
+    }
+    return start + 4;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Count one insertion at 0-based position pos.  Peaks are merged,
+ *      so the only candidate is the last peak starting at or before pos.
+ *      Every TSS within ATAC_TSS_FLANK adds to the profile at the
+ *      strand-aware offset of the insertion.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    atac_qc_insertion(atac_qc_t *qc, size_t chrom, int64_t pos)
+
+{
+    size_t  low, high, mid;
+    int64_t offset;
+    bool    near = false;
+
+    ++qc->insertions;
+    if ( chrom >= qc->chrom_count )
+	return;
+
+    // First peak starting after pos
+    low = qc->peak_first[chrom];
+    high = qc->peak_first[chrom + 1];
+    while ( low < high )
+    {
+	mid = low + (high - low) / 2;
+	if ( qc->peaks.start[mid] <= pos )
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    if ( (low > qc->peak_first[chrom]) && (qc->peaks.end[low - 1] > pos) )
+	++qc->in_peaks;
+
+    // First TSS at or after pos - ATAC_TSS_FLANK
+    low = qc->tss_first[chrom];
+    high = qc->tss_first[chrom + 1];
+    while ( low < high )
+    {
+	mid = low + (high - low) / 2;
+	if ( qc->tss[mid].tss < pos - ATAC_TSS_FLANK )
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    for (; (low < qc->tss_first[chrom + 1]) &&
+	   (qc->tss[low].tss <= pos + ATAC_TSS_FLANK); ++low)
+    {
+	offset = qc->tss[low].strand == '-' ?
+		 qc->tss[low].tss - pos : pos - qc->tss[low].tss;
+	++qc->profile[offset + ATAC_TSS_FLANK];
+	near = true;
+    }
+    if ( near )
+	++qc->near_tss;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Stream SAM, BAM, or CRAM alignments, skipping unmapped, secondary,
+ *      supplementary, QC failed, duplicate, and low MAPQ alignments.
+ *      Each remaining alignment adds one insertion, and the first mate
+ *      of each proper pair (positive TLEN) adds one fragment.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, or another BL_READ_ status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     atac_qc_scan(atac_qc_t *qc, FILE *sam_stream, feature_index_t *fi,
+		     unsigned min_mapq)
+
+{
+    bl_sam_t    alignment;
+    unsigned    flag;
+    size_t      chrom = 0;
+    long        tlen;
+    int         status;
+
+    // BL_SAM_INIT omits the qual sizes and bl_sam_init() the cigar sizes
+    memset(&alignment, 0, sizeof(alignment));
+
+    while ( (status = bl_sam_read(&alignment, sam_stream,
+				  BL_SAM_FIELD_FLAG | BL_SAM_FIELD_RNAME |
+				  BL_SAM_FIELD_POS | BL_SAM_FIELD_MAPQ |
+				  BL_SAM_FIELD_CIGAR | BL_SAM_FIELD_TLEN))
+	    == BL_READ_OK )
+    {
+	++qc->alignments;
+	flag = BL_SAM_FLAG(&alignment);
+	if ( flag & BL_SAM_FLAG_UNMAP )
+	    ++qc->unmapped;
+	else if ( flag & (BL_SAM_FLAG_SECONDARY | BL_SAM_FLAG_SUPPLEMENTARY) )
+	    ++qc->secondary;
+	else if ( flag & BL_SAM_FLAG_QCFAIL )
+	    ++qc->qc_fail;
+	else if ( flag & BL_SAM_FLAG_DUP )
+	    ++qc->duplicate;
+	else if ( BL_SAM_MAPQ(&alignment) < min_mapq )
+	    ++qc->low_mapq;
+	else
+	{
+	    chrom = feature_index_find_chrom(fi, BL_SAM_RNAME(&alignment), chrom);
+	    atac_qc_insertion(qc, chrom, atac_insertion(flag,
+			      BL_SAM_POS(&alignment) - 1, BL_SAM_CIGAR(&alignment)));
+
+	    tlen = BL_SAM_TLEN(&alignment);
+	    if ( (flag & BL_SAM_FLAG_PAIRED) && (flag & BL_SAM_FLAG_PROPER_PAIR)
+		 && (tlen > 0) )
+	    {
+		++qc->fragments;
+		qc->fragment_sum += tlen;
+		if ( tlen > ATAC_MAX_FRAGMENT )
+		    ++qc->long_fragments;
+		else
+		    ++qc->fragment_hist[tlen];
+	    }
+	}
+    }
+    bl_sam_free(&alignment);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the QC report as JSON.  TSS enrichment is the mean profile
+ *      depth within ATAC_TSS_CENTER of the TSS over the mean depth of
+ *      the ATAC_TSS_EDGE bases at each end of the profile, or null if
+ *      there are no background insertions.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    atac_qc_write(atac_qc_t *qc, const char *alignments_filename,
+		      FILE *outfile)
+
+{
+    uint64_t    center = 0, edge = 0, nfr = 0, mono = 0, di = 0,
+		cumulative = 0;
+    int64_t     median = -1;
+    size_t      c, l;
+    double      peak_bases = 0.0;
+    const char  *p;
+
+    for (c = ATAC_TSS_FLANK - ATAC_TSS_CENTER;
+	 c <= ATAC_TSS_FLANK + ATAC_TSS_CENTER; ++c)
+	center += qc->profile[c];
+    for (c = 0; c < ATAC_TSS_EDGE; ++c)
+	edge += qc->profile[c] + qc->profile[2 * ATAC_TSS_FLANK - c];
+    for (c = 0; c < qc->peaks.count; ++c)
+	peak_bases += qc->peaks.end[c] - qc->peaks.start[c];
+
+    fputs("{\n  \"alignments_file\": \"", outfile);
+    for (p = alignments_filename; *p != '\0'; ++p)
+    {
+	if ( (*p == '"') || (*p == '\\') )
+	    putc('\\', outfile);
+	putc(*p, outfile);
+    }
+    fputs("\",\n", outfile);
+    fprintf(outfile, "  \"alignments\": {\n"
+	    "    \"total\": %" PRIu64 ",\n    \"unmapped\": %" PRIu64 ",\n"
+	    "    \"secondary\": %" PRIu64 ",\n    \"qc_fail\": %" PRIu64 ",\n"
+	    "    \"duplicate\": %" PRIu64 ",\n    \"low_mapq\": %" PRIu64 ",\n"
+	    "    \"used\": %" PRIu64 "\n  },\n",
+	    qc->alignments, qc->unmapped, qc->secondary, qc->qc_fail,
+	    qc->duplicate, qc->low_mapq, qc->insertions);
+
+    fprintf(outfile, "  \"frip\": {\n"
+	    "    \"peaks\": %zu,\n    \"merged_peaks\": %zu,\n"
+	    "    \"peak_bases\": %.0f,\n    \"insertions\": %" PRIu64 ",\n"
+	    "    \"insertions_in_peaks\": %" PRIu64 ",\n    \"fraction\": %.6f\n"
+	    "  },\n",
+	    qc->peak_count, qc->peaks.count, peak_bases, qc->insertions,
+	    qc->in_peaks, qc->insertions == 0 ? 0.0 :
+	    (double)qc->in_peaks / qc->insertions);
+
+    fprintf(outfile, "  \"tss\": {\n"
+	    "    \"tss_count\": %zu,\n    \"flank\": %d,\n"
+	    "    \"insertions_near_tss\": %" PRIu64 ",\n    \"enrichment\": ",
+	    qc->tss_count, ATAC_TSS_FLANK, qc->near_tss);
+    if ( edge == 0 )
+	fputs("null", outfile);
+    else
+	fprintf(outfile, "%.6f", ((double)center / (2 * ATAC_TSS_CENTER + 1)) /
+		((double)edge / (2 * ATAC_TSS_EDGE)));
+    fputs(",\n    \"profile\": [", outfile);
+    for (c = 0; c <= 2 * ATAC_TSS_FLANK; ++c)
+	fprintf(outfile, "%s%" PRIu64, c == 0 ? "" : c % 20 == 0 ? ",\n      " :
+		", ", qc->profile[c]);
+    fputs("]\n  },\n", outfile);
+
+    for (l = 0; l <= ATAC_MAX_FRAGMENT; ++l)
+    {
+	if ( l <= ATAC_NFR_MAX )
+	    nfr += qc->fragment_hist[l];
+	else if ( l <= ATAC_MONO_MAX )
+	    mono += qc->fragment_hist[l];
+	else if ( l <= ATAC_DI_MAX )
+	    di += qc->fragment_hist[l];
+	cumulative += qc->fragment_hist[l];
+	if ( (median < 0) && (qc->fragments > 0) &&
+	     (2 * cumulative >= qc->fragments) )
+	    median = l;
+    }
+    fprintf(outfile, "  \"fragments\": {\n"
+	    "    \"count\": %" PRIu64 ",\n    \"mean\": %.2f,\n",
+	    qc->fragments, qc->fragments == 0 ? 0.0 :
+	    qc->fragment_sum / qc->fragments);
+    if ( median < 0 )
+	fputs("    \"median\": null,\n", outfile);
+    else
+	fprintf(outfile, "    \"median\": %" PRId64 ",\n", median);
+    fprintf(outfile,
+	    "    \"nucleosome_free\": %.6f,\n    \"mononucleosome\": %.6f,\n"
+	    "    \"dinucleosome\": %.6f,\n    \"multinucleosome\": %.6f,\n"
+	    "    \"longer_than_histogram\": %" PRIu64 ",\n    \"histogram\": [",
+	    qc->fragments == 0 ? 0.0 : (double)nfr / qc->fragments,
+	    qc->fragments == 0 ? 0.0 : (double)mono / qc->fragments,
+	    qc->fragments == 0 ? 0.0 : (double)di / qc->fragments,
+	    qc->fragments == 0 ? 0.0 :
+	    (double)(qc->fragments - nfr - mono - di) / qc->fragments,
+	    qc->long_fragments);
+    for (l = 0; l <= ATAC_MAX_FRAGMENT; ++l)
+	fprintf(outfile, "%s%" PRIu64, l == 0 ? "" : l % 20 == 0 ? ",\n      " :
+		", ", qc->fragment_hist[l]);
+    fputs("]\n  }\n}\n", outfile);
+}
+
+
+void    atac_qc_free(atac_qc_t *qc)
+
+{
+    peak_set_free(&qc->peaks);
+    free(qc->peak_first);
+    free(qc->tss_first);
+    free(qc->tss);
+    qc->peak_first = qc->tss_first = NULL;
+    qc->tss = NULL;
+}
@@ -0,0 +1,704 @@
+/***************************************************************************
+ *  Description:
+ *      bigWig reader for summarizing signal over peaks without
+ *      bigWigAverageOverBed.  Only the index and the data blocks
+ *      overlapping each query are read, and the last block read is kept,
+ *      so sorted peaks walk the blocks in order.  Large queries use the
+ *      coarsest zoom level with enough records, reading full resolution
+ *      data only at the edges.  Files are assumed to be little-endian, as written
+ *      by the UCSC tools on all common platforms.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <zlib.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+#define BW_HEADER_SIZE          64
+#define BW_ZOOM_HEADER_SIZE     24
+#define BW_CHROM_TREE_HEADER_SIZE   32
+#define BW_RTREE_HEADER_SIZE    48
+#define BW_NODE_HEADER_SIZE     4
+#define BW_LEAF_ITEM_SIZE       32
+#define BW_BRANCH_ITEM_SIZE     24
+#define BW_SECTION_HEADER_SIZE  24
+#define BW_ZOOM_RECORD_SIZE     32
+
+/*
+ *  Little-endian field access.  memcpy() avoids unaligned access.
+ */
+
+static uint16_t bw_u16(const unsigned char *p)
+{
+    uint16_t    v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t bw_u32(const unsigned char *p)
+{
+    uint32_t    v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t bw_u64(const unsigned char *p)
+{
+    uint64_t    v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static float    bw_float(const unsigned char *p)
+{
+    float   v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read len bytes at offset.
+ *
+ *  Returns:
+ *      BIGWIG_OK or BIGWIG_BAD_DATA if the file is truncated
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bw_read_at(bigwig_t *bw, uint64_t offset, void *buf, size_t len)
+
+{
+    if ( (fseeko(bw->stream, offset, SEEK_SET) != 0) ||
+	 (fread(buf, 1, len, bw->stream) != len) )
+	return BIGWIG_BAD_DATA;
+    return BIGWIG_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Load the leaves of the chromosome B+ tree node at offset.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bw_read_chrom_node(bigwig_t *bw, uint64_t offset, uint32_t key_size,
+			   size_t *array_size)
+
+{
+    unsigned char   header[BW_NODE_HEADER_SIZE], *items, *item;
+    size_t          item_size = key_size + 8, c, count;
+    int             status = BIGWIG_OK;
+
+    if ( bw_read_at(bw, offset, header, BW_NODE_HEADER_SIZE) != BIGWIG_OK )
+	return BIGWIG_BAD_DATA;
+    count = bw_u16(header + 2);
+    if ( (items = xt_malloc(count, item_size)) == NULL )
+    {
+	fputs("bw_read_chrom_node(): Could not allocate node.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    if ( bw_read_at(bw, offset + BW_NODE_HEADER_SIZE, items,
+		    count * item_size) != BIGWIG_OK )
+    {
+	free(items);
+	return BIGWIG_BAD_DATA;
+    }
+    for (c = 0; (c < count) && (status == BIGWIG_OK); ++c)
+    {
+	item = items + c * item_size;
+	if ( header[0] )
+	{
+	    if ( bw->chrom_count == *array_size )
+	    {
+		*array_size = *array_size == 0 ? 64 : *array_size * 2;
+		if ( (bw->chroms = xt_realloc(bw->chroms, *array_size,
+					      sizeof(*bw->chroms))) == NULL )
+		{
+		    fputs("bw_read_chrom_node(): Could not allocate chroms.\n",
+			  stderr);
+		    exit(EX_UNAVAILABLE);
+		}
+	    }
+	    // Keys are NUL-padded, not NUL-terminated if full length
+	    bw->chroms[bw->chrom_count].name = strndup((char *)item, key_size);
+	    bw->chroms[bw->chrom_count].id = bw_u32(item + key_size);
+	    bw->chroms[bw->chrom_count].size = bw_u32(item + key_size + 4);
+	    ++bw->chrom_count;
+	}
+	else
+	    status = bw_read_chrom_node(bw, bw_u64(item + key_size), key_size,
+					array_size);
+    }
+    free(items);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append the leaves of the R-tree node at offset to blocks.  Leaves
+ *      are visited in order, so the array is sorted by position.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bw_read_rtree_node(bigwig_t *bw, uint64_t offset, bw_block_t **blocks,
+			   size_t *count, size_t *array_size)
+
+{
+    unsigned char   header[BW_NODE_HEADER_SIZE], *items, *item;
+    size_t          item_size, c, items_count;
+    bw_block_t      *block;
+    int             status = BIGWIG_OK;
+
+    if ( bw_read_at(bw, offset, header, BW_NODE_HEADER_SIZE) != BIGWIG_OK )
+	return BIGWIG_BAD_DATA;
+    item_size = header[0] ? BW_LEAF_ITEM_SIZE : BW_BRANCH_ITEM_SIZE;
+    items_count = bw_u16(header + 2);
+    if ( (items = xt_malloc(items_count, item_size)) == NULL )
+    {
+	fputs("bw_read_rtree_node(): Could not allocate node.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    if ( bw_read_at(bw, offset + BW_NODE_HEADER_SIZE, items,
+		    items_count * item_size) != BIGWIG_OK )
+    {
+	free(items);
+	return BIGWIG_BAD_DATA;
+    }
+    for (c = 0; (c < items_count) && (status == BIGWIG_OK); ++c)
+    {
+	item = items + c * item_size;
+	if ( header[0] )
+	{
+	    if ( *count == *array_size )
+	    {
+		*array_size = *array_size == 0 ? 1024 : *array_size * 2;
+		if ( (*blocks = xt_realloc(*blocks, *array_size,
+					   sizeof(**blocks))) == NULL )
+		{
+		    fputs("bw_read_rtree_node(): Could not allocate blocks.\n",
+			  stderr);
+		    exit(EX_UNAVAILABLE);
+		}
+	    }
+	    block = *blocks + (*count)++;
+	    block->start_chrom = bw_u32(item);
+	    block->start_base = bw_u32(item + 4);
+	    block->end_chrom = bw_u32(item + 8);
+	    block->end_base = bw_u32(item + 12);
+	    block->offset = bw_u64(item + 16);
+	    block->size = bw_u64(item + 24);
+	}
+	else
+	    status = bw_read_rtree_node(bw, bw_u64(item + 16), blocks, count,
+					array_size);
+    }
+    free(items);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Load all data block locations of the R-tree index at offset.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bw_read_rtree(bigwig_t *bw, uint64_t offset, bw_block_t **blocks,
+		      size_t *count)
+
+{
+    unsigned char   header[BW_RTREE_HEADER_SIZE];
+    size_t          array_size = 0;
+
+    *blocks = NULL;
+    *count = 0;
+    if ( (bw_read_at(bw, offset, header, BW_RTREE_HEADER_SIZE) != BIGWIG_OK) ||
+	 (bw_u32(header) != BIGWIG_RTREE_MAGIC) )
+	return BIGWIG_BAD_DATA;
+    return bw_read_rtree_node(bw, offset + BW_RTREE_HEADER_SIZE, blocks,
+			      count, &array_size);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Open a bigWig file and load its chromosome list and full
+ *      resolution index.
+ *
+ *  Returns:
+ *      BIGWIG_OK, BIGWIG_NOINPUT, or BIGWIG_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bigwig_open(bigwig_t *bw, const char *filename)
+
+{
+    unsigned char   header[BW_HEADER_SIZE], zoom_header[BW_ZOOM_HEADER_SIZE],
+		    tree_header[BW_CHROM_TREE_HEADER_SIZE];
+    uint64_t        chrom_tree_offset, index_offset;
+    size_t          c, array_size = 0;
+    int             status;
+
+    if ( (bw->stream = fopen(filename, "r")) == NULL )
+    {
+	fprintf(stderr, "bigwig_open(): Cannot open %s: %s\n",
+		filename, strerror(errno));
+	return BIGWIG_NOINPUT;
+    }
+    if ( (bw_read_at(bw, 0, header, BW_HEADER_SIZE) != BIGWIG_OK) ||
+	 (bw_u32(header) != BIGWIG_MAGIC) )
+    {
+	fprintf(stderr, "bigwig_open(): %s is not a little-endian bigWig file.\n",
+		filename);
+	return BIGWIG_BAD_DATA;
+    }
+    bw->zoom_count = bw_u16(header + 6);
+    chrom_tree_offset = bw_u64(header + 8);
+    index_offset = bw_u64(header + 24);
+    bw->uncompress_buf_size = bw_u32(header + 52);
+
+    if ( (bw->zooms = xt_malloc(bw->zoom_count + 1, sizeof(*bw->zooms))) == NULL )
+    {
+	fputs("bigwig_open(): Could not allocate zoom levels.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0; c < bw->zoom_count; ++c)
+    {
+	if ( bw_read_at(bw, BW_HEADER_SIZE + c * BW_ZOOM_HEADER_SIZE,
+			zoom_header, BW_ZOOM_HEADER_SIZE) != BIGWIG_OK )
+	{
+	    bw->zoom_count = c;
+	    return BIGWIG_BAD_DATA;
+	}
+	bw->zooms[c].reduction = bw_u32(zoom_header);
+	bw->zooms[c].index_offset = bw_u64(zoom_header + 16);
+	bw->zooms[c].block_count = 0;
+	bw->zooms[c].blocks = NULL;
+    }
+
+    if ( (bw_read_at(bw, chrom_tree_offset, tree_header,
+		     BW_CHROM_TREE_HEADER_SIZE) != BIGWIG_OK) ||
+	 (bw_u32(tree_header) != BIGWIG_CHROM_TREE_MAGIC) ||
+	 (bw_read_chrom_node(bw, chrom_tree_offset + BW_CHROM_TREE_HEADER_SIZE,
+			     bw_u32(tree_header + 8), &array_size) != BIGWIG_OK) )
+    {
+	fprintf(stderr, "bigwig_open(): Bad chromosome tree in %s.\n", filename);
+	return BIGWIG_BAD_DATA;
+    }
+    if ( (status = bw_read_rtree(bw, index_offset, &bw->blocks,
+				 &bw->block_count)) != BIGWIG_OK )
+	fprintf(stderr, "bigwig_open(): Bad index in %s.\n", filename);
+    return status;
+}
+
+
+void    bigwig_close(bigwig_t *bw)
+
+{
+    size_t  c;
+
+    if ( bw->stream != NULL )
+	fclose(bw->stream);
+    for (c = 0; c < bw->chrom_count; ++c)
+	free(bw->chroms[c].name);
+    for (c = 0; c < bw->zoom_count; ++c)
+	free(bw->zooms[c].blocks);
+    free(bw->chroms);
+    free(bw->zooms);
+    free(bw->blocks);
+    free(bw->full_cache.data);
+    free(bw->zoom_cache.data);
+    free(bw->raw);
+    *bw = (bigwig_t)BIGWIG_INIT;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the bigWig chromosome ID of chrom, trying hint first, or
+ *      -1 if it is not in the file.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t bigwig_chrom_id(bigwig_t *bw, const char *chrom, size_t *hint)
+
+{
+    size_t  c;
+
+    if ( (*hint < bw->chrom_count) &&
+	 (strcmp(bw->chroms[*hint].name, chrom) == 0) )
+	return bw->chroms[*hint].id;
+    for (c = 0; c < bw->chrom_count; ++c)
+    {
+	if ( strcmp(bw->chroms[c].name, chrom) == 0 )
+	{
+	    *hint = c;
+	    return bw->chroms[c].id;
+	}
+    }
+    return -1;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Load and decompress the data block at block->offset into cache,
+ *      unless it is the block already there.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bw_load_block(bigwig_t *bw, const bw_block_t *block, bw_cache_t *cache)
+
+{
+    uLongf  len;
+    size_t  size;
+
+    if ( block->offset == cache->offset )
+	return BIGWIG_OK;
+    size = bw->uncompress_buf_size == 0 ? block->size : bw->uncompress_buf_size;
+    if ( cache->size < size )
+    {
+	cache->size = size;
+	free(cache->data);
+	if ( (cache->data = xt_malloc(cache->size, 1)) == NULL )
+	{
+	    fputs("bw_load_block(): Could not allocate buffer.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    cache->offset = UINT64_MAX;
+
+    // Uncompressed files are read straight into the cache
+    if ( bw->uncompress_buf_size == 0 )
+    {
+	if ( bw_read_at(bw, block->offset, cache->data, block->size)
+		!= BIGWIG_OK )
+	    return BIGWIG_BAD_DATA;
+	cache->len = block->size;
+    }
+    else
+    {
+	if ( block->size > bw->raw_size )
+	{
+	    bw->raw_size = block->size;
+	    free(bw->raw);
+	    if ( (bw->raw = xt_malloc(bw->raw_size, 1)) == NULL )
+	    {
+		fputs("bw_load_block(): Could not allocate buffer.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	if ( bw_read_at(bw, block->offset, bw->raw, block->size) != BIGWIG_OK )
+	    return BIGWIG_BAD_DATA;
+	len = cache->size;
+	if ( uncompress(cache->data, &len, bw->raw, block->size) != Z_OK )
+	    return BIGWIG_BAD_DATA;
+	cache->len = len;
+    }
+    cache->offset = block->offset;
+    return BIGWIG_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the index of the first block ending after chrom:start.
+ *      Blocks are sorted and do not overlap, so ends are in order too.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  bw_first_block(const bw_block_t *blocks, size_t count, uint32_t chrom,
+		       uint32_t start)
+
+{
+    size_t  low = 0, high = count, mid;
+
+    while ( low < high )
+    {
+	mid = (low + high) / 2;
+	if ( (blocks[mid].end_chrom < chrom) ||
+	     ((blocks[mid].end_chrom == chrom) &&
+	      (blocks[mid].end_base <= start)) )
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    return low;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add a value covering [item_start, item_end) to stats, clipped to
+ *      [start, end).
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+static void bw_stats_add(bw_stats_t *stats, int64_t item_start,
+			 int64_t item_end, int64_t start, int64_t end,
+			 double value)
+
+{
+    int64_t overlap = XT_MIN(item_end, end) - XT_MAX(item_start, start);
+
+    if ( overlap <= 0 )
+	return;
+    if ( (stats->covered == 0) || (value > stats->max) )
+	stats->max = value;
+    stats->covered += overlap;
+    stats->sum += value * overlap;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add full resolution signal on chrom in [start, end) to stats.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bw_stats_full(bigwig_t *bw, uint32_t chrom, int64_t start,
+		      int64_t end, bw_stats_t *stats)
+
+{
+    const bw_block_t    *block;
+    const unsigned char *p, *section_end, *data_end;
+    size_t              b, item, item_count;
+    uint32_t            section_chrom, item_step, item_span;
+    int64_t             pos;
+    unsigned char       type;
+
+    for (b = bw_first_block(bw->blocks, bw->block_count, chrom, start);
+	 b < bw->block_count; ++b)
+    {
+	block = &bw->blocks[b];
+	if ( (block->start_chrom > chrom) ||
+	     ((block->start_chrom == chrom) && (block->start_base >= end)) )
+	    break;
+	if ( bw_load_block(bw, block, &bw->full_cache) != BIGWIG_OK )
+	    return BIGWIG_BAD_DATA;
+	data_end = bw->full_cache.data + bw->full_cache.len;
+	for (p = bw->full_cache.data; p + BW_SECTION_HEADER_SIZE <= data_end;
+	     p = section_end)
+	{
+	    section_chrom = bw_u32(p);
+	    pos = bw_u32(p + 4);
+	    item_step = bw_u32(p + 12);
+	    item_span = bw_u32(p + 16);
+	    type = p[20];
+	    item_count = bw_u16(p + 22);
+	    p += BW_SECTION_HEADER_SIZE;
+	    section_end = p + item_count * (type == 1 ? 12 : type == 2 ? 8 : 4);
+	    if ( section_end > data_end )
+		return BIGWIG_BAD_DATA;
+	    if ( section_chrom != chrom )
+		continue;
+	    for (item = 0; item < item_count; ++item)
+	    {
+		switch(type)
+		{
+		    case 1: // bedGraph
+			bw_stats_add(stats, bw_u32(p), bw_u32(p + 4), start,
+				     end, bw_float(p + 8));
+			p += 12;
+			break;
+		    case 2: // variableStep
+			bw_stats_add(stats, bw_u32(p), bw_u32(p) + item_span,
+				     start, end, bw_float(p + 4));
+			p += 8;
+			break;
+		    case 3: // fixedStep
+			bw_stats_add(stats, pos, pos + item_span, start, end,
+				     bw_float(p));
+			pos += item_step;
+			p += 4;
+			break;
+		    default:
+			return BIGWIG_BAD_DATA;
+		}
+	    }
+	}
+    }
+    return BIGWIG_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add the zoom records of zoom level z lying entirely within
+ *      chrom:[start, end) to stats, and return the span they cover in
+ *      inner_start and inner_end.  Zoom records do not overlap, so the
+ *      rest of the query is the two edges outside this span.
+ *
+ *  Returns:
+ *      BIGWIG_OK or BIGWIG_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bw_stats_zoom(bigwig_t *bw, bw_zoom_t *zoom, uint32_t chrom,
+		      int64_t start, int64_t end, bw_stats_t *stats,
+		      int64_t *inner_start, int64_t *inner_end)
+
+{
+    const bw_block_t    *block;
+    const unsigned char *p, *data_end;
+    size_t              b;
+    int64_t             rec_start, rec_end, valid;
+    double              max;
+
+    if ( (zoom->blocks == NULL) &&
+	 (bw_read_rtree(bw, zoom->index_offset, &zoom->blocks,
+			&zoom->block_count) != BIGWIG_OK) )
+	return BIGWIG_BAD_DATA;
+
+    *inner_start = end;
+    *inner_end = start;
+    for (b = bw_first_block(zoom->blocks, zoom->block_count, chrom, start);
+	 b < zoom->block_count; ++b)
+    {
+	block = &zoom->blocks[b];
+	if ( (block->start_chrom > chrom) ||
+	     ((block->start_chrom == chrom) && (block->start_base >= end)) )
+	    break;
+	if ( bw_load_block(bw, block, &bw->zoom_cache) != BIGWIG_OK )
+	    return BIGWIG_BAD_DATA;
+	data_end = bw->zoom_cache.data + bw->zoom_cache.len;
+	for (p = bw->zoom_cache.data; p + BW_ZOOM_RECORD_SIZE <= data_end;
+	     p += BW_ZOOM_RECORD_SIZE)
+	{
+	    rec_start = bw_u32(p + 4);
+	    rec_end = bw_u32(p + 8);
+	    valid = bw_u32(p + 12);
+	    if ( (bw_u32(p) != chrom) || (rec_start < start) ||
+		 (rec_end > end) || (valid == 0) )
+		continue;
+	    max = bw_float(p + 20);
+	    if ( (stats->covered == 0) || (max > stats->max) )
+		stats->max = max;
+	    stats->covered += valid;
+	    stats->sum += bw_float(p + 24);
+	    *inner_start = XT_MIN(*inner_start, rec_start);
+	    *inner_end = XT_MAX(*inner_end, rec_end);
+	}
+    }
+    return BIGWIG_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute covered bases, summed signal (value times bases) and
+ *      maximum over chrom:[start, end).  If use_zoom is true and a zoom
+ *      level has at least BIGWIG_ZOOM_MIN_RECORDS records across the
+ *      query, the coarsest such level is used for the interior.  Zoom
+ *      sums are single precision, so results may differ from full
+ *      resolution in the last digits.
+ *
+ *  Returns:
+ *      BIGWIG_OK or BIGWIG_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bigwig_stats(bigwig_t *bw, int64_t chrom_id, int64_t start,
+		     int64_t end, bool use_zoom, bw_stats_t *stats)
+
+{
+    bw_zoom_t   *zoom = NULL;
+    size_t      z;
+    int64_t     inner_start, inner_end;
+    int         status;
+
+    stats->covered = 0;
+    stats->sum = stats->max = 0.0;
+    if ( (chrom_id < 0) || (start >= end) )
+	return BIGWIG_OK;
+
+    if ( use_zoom )
+	for (z = 0; z < bw->zoom_count; ++z)
+	    if ( (bw->zooms[z].reduction > 0) &&
+		 ((end - start) / bw->zooms[z].reduction >=
+		  BIGWIG_ZOOM_MIN_RECORDS) &&
+		 ((zoom == NULL) || (bw->zooms[z].reduction > zoom->reduction)) )
+		zoom = &bw->zooms[z];
+    if ( zoom == NULL )
+	return bw_stats_full(bw, chrom_id, start, end, stats);
+
+    if ( (status = bw_stats_zoom(bw, zoom, chrom_id, start, end, stats,
+				 &inner_start, &inner_end)) != BIGWIG_OK )
+	return status;
+    if ( inner_start >= inner_end )
+	return bw_stats_full(bw, chrom_id, start, end, stats);
+    if ( (status = bw_stats_full(bw, chrom_id, start, inner_start, stats))
+	    != BIGWIG_OK )
+	return status;
+    return bw_stats_full(bw, chrom_id, inner_end, end, stats);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write size, covered bases, sum, mean over size (uncovered bases
+ *      count as 0), mean over covered bases, and maximum, as with
+ *      bigWigAverageOverBed.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    bw_stats_write(bw_stats_t *stats, int64_t size, FILE *outfile)
+
+{
+    fprintf(outfile, "\t%" PRId64 "\t%" PRId64 "\t%.6g\t%.6g\t%.6g\t%.6g\n",
+	    size, stats->covered, stats->sum,
+	    size == 0 ? 0.0 : stats->sum / size,
+	    stats->covered == 0 ? 0.0 : stats->sum / stats->covered,
+	    stats->max);
+}
@@ -0,0 +1,368 @@
+/***************************************************************************
+ *  Description:
+ *      Genome-wide base-pair coverage of each feature class, used as the
+ *      denominator for interpreting peak class fractions.  Coverage is
+ *      computed by a single boundary sweep over each chromosome's
+ *      features, both for any overlap (a base in an exon and an intron
+ *      counts toward both) and priority-resolved (it counts only toward
+ *      the higher priority class).  Bases covered by no feature count
+ *      toward upstream-beyond.  The same sweep, clipped to a single
+ *      peak, gives the base-pair composition of the peak.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Build the boundary events for count features, sorted by position.
+ *      Features are fi->start[first] through fi->start[first + count - 1]
+ *      if index is NULL, otherwise those listed in index[].  Each feature
+ *      contributes a +1 event at its start and a -1 event at its end.
+ *      events must have room for 2 * count entries.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     boundary_event_cmp(const boundary_event_t *e1, const boundary_event_t *e2)
+
+{
+    if ( e1->pos != e2->pos )
+	return e1->pos < e2->pos ? -1 : 1;
+    return e1->delta - e2->delta;
+}
+
+void    boundary_events(feature_index_t *fi, size_t first, size_t count,
+			const size_t *index, boundary_event_t *events)
+
+{
+    size_t  c, f;
+
+    for (c = 0; c < count; ++c)
+    {
+	f = index == NULL ? first + c : index[c];
+	events[2 * c].pos = fi->start[f];
+	events[2 * c].delta = 1;
+	events[2 * c].class_id = fi->class_id[f];
+	events[2 * c + 1].pos = fi->end[f];
+	events[2 * c + 1].delta = -1;
+	events[2 * c + 1].class_id = fi->class_id[f];
+    }
+    qsort(events, count * 2, sizeof(*events),
+	  (int (*)(const void *, const void *))boundary_event_cmp);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Credit len bases to the classes active in a sweep.  active_other
+ *      counts active features that are not in any class.  Slot
+ *      fi->class_count holds bases covered only by unclassified features,
+ *      or by nothing if there is no upstream-beyond class.  any_bp may
+ *      be NULL if only priority-resolved counts are needed.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    class_coverage_add(feature_index_t *fi, int64_t *any_bp,
+			   int64_t *priority_bp, int64_t len,
+			   class_mask_t active_mask, size_t active_other)
+
+{
+    unsigned        class_id, none = fi->class_count;
+    class_mask_t    mask;
+
+    if ( len <= 0 )
+	return;
+    if ( active_mask == 0 )
+    {
+	class_id = (active_other == 0) && (fi->beyond_class != FEATURE_CLASS_NONE) ?
+		    fi->beyond_class : none;
+	if ( any_bp != NULL )
+	    any_bp[class_id] += len;
+	priority_bp[class_id] += len;
+	return;
+    }
+    // Lowest set bit is the highest priority class
+    priority_bp[__builtin_ctzll(active_mask)] += len;
+    if ( any_bp != NULL )
+	for (mask = active_mask; mask != 0; mask &= mask - 1)
+	    any_bp[__builtin_ctzll(mask)] += len;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Walk n sorted boundary events, crediting each base of
+ *      [start, end) to the classes active over it.  Events outside
+ *      [start, end) still update the active set, so features beginning
+ *      before start are counted.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    boundary_sweep(feature_index_t *fi, boundary_event_t *events,
+		       size_t n, int64_t start, int64_t end,
+		       int64_t *any_bp, int64_t *priority_bp)
+
+{
+    size_t          e, active_other = 0;
+    int64_t         pos = start, next, active[FEATURE_CLASS_MAX];
+    class_mask_t    active_mask = 0;
+
+    memset(active, 0, sizeof(active));
+    for (e = 0; e < n; )
+    {
+	next = XT_MIN(XT_MAX(events[e].pos, start), end);
+	class_coverage_add(fi, any_bp, priority_bp, next - pos,
+			   active_mask, active_other);
+	pos = XT_MAX(pos, next);
+	// Apply all events at this position before the next segment
+	do
+	{
+	    if ( events[e].class_id == FEATURE_CLASS_NONE )
+		active_other += events[e].delta;
+	    else if ( (active[events[e].class_id] += events[e].delta) > 0 )
+		active_mask |= (class_mask_t)1 << events[e].class_id;
+	    else
+		active_mask &= ~((class_mask_t)1 << events[e].class_id);
+	    ++e;
+	}   while ( (e < n) && (events[e].pos == events[e - 1].pos) );
+    }
+    class_coverage_add(fi, any_bp, priority_bp, end - pos, 0, 0);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute class coverage over all chromosomes in the index.
+ *      Features extending beyond the ends of a chromosome, such as
+ *      upstream regions of genes near a telomere, are clipped.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    class_coverage_compute(feature_index_t *fi, class_coverage_t *cov)
+
+{
+    boundary_event_t    *events;
+    fi_chrom_t          *ch;
+    size_t              c;
+
+    memset(cov, 0, sizeof(*cov));
+    cov->class_count = fi->class_count;
+    for (c = 0; c < fi->chrom_count; ++c)
+    {
+	ch = &fi->chroms[c];
+	cov->genome_size += ch->size;
+	if ( (events = xt_malloc(ch->count * 2 + 1, sizeof(*events))) == NULL )
+	{
+	    fputs("class_coverage_compute(): Could not allocate events.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	boundary_events(fi, ch->first, ch->count, NULL, events);
+	boundary_sweep(fi, events, ch->count * 2, 0, ch->size,
+		       cov->any_bp, cov->priority_bp);
+	free(events);
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute the priority-resolved base-pair composition of the peak
+ *      [start, end) on chromosome chrom.  Only features passing the
+ *      overlap requirements in params are counted, and bases overlapping
+ *      none of them count toward upstream-beyond, so bp[] sums to the
+ *      peak length.  bp must have room for fi->class_count + 1 entries.
+ *      events is grown as needed and may be reused across calls.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    peak_composition(feature_index_t *fi, size_t chrom,
+			 int64_t start, int64_t end, overlap_params_t *params,
+			 hit_list_t *hits, boundary_event_t **events,
+			 size_t *events_size, int64_t *bp)
+
+{
+    memset(bp, 0, (fi->class_count + 1) * sizeof(*bp));
+    feature_index_classify(fi, chrom, start, end, params, hits, NULL);
+    if ( hits->count * 2 > *events_size )
+    {
+	*events_size = hits->count * 2;
+	if ( (*events = xt_realloc(*events, *events_size,
+				   sizeof(**events))) == NULL )
+	{
+	    fputs("peak_composition(): Could not allocate events.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    boundary_events(fi, 0, hits->count, hits->index, *events);
+    boundary_sweep(fi, *events, hits->count * 2, start, end, NULL, bp);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write class coverage as TSV.  The priority list and genome size
+ *      are recorded in header lines so a cached copy can be validated
+ *      by class_coverage_read().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    class_coverage_write(feature_index_t *fi, class_coverage_t *cov,
+			     const char *priority_list, FILE *stream)
+
+{
+    size_t  c;
+
+    fprintf(stream, "#Priority\t%s\n", priority_list);
+    fprintf(stream, "#Genome-size\t%" PRId64 "\n", cov->genome_size);
+    fprintf(stream, "#Class\tAny-bp\tAny-fraction\tPriority-bp\tPriority-fraction\n");
+    for (c = 0; c <= cov->class_count; ++c)
+	fprintf(stream, "%s\t%" PRId64 "\t%.6f\t%" PRId64 "\t%.6f\n",
+		feature_index_class_name(fi, c == cov->class_count ?
+					 FEATURE_CLASS_NONE : c),
+		cov->any_bp[c], class_coverage_fraction(cov, cov->any_bp[c]),
+		cov->priority_bp[c],
+		class_coverage_fraction(cov, cov->priority_bp[c]));
+}
+
+
+double  class_coverage_fraction(class_coverage_t *cov, int64_t bp)
+
+{
+    return cov->genome_size == 0 ? 0.0 : (double)bp / cov->genome_size;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read cached class coverage written by class_coverage_write().
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK if the cache exists and was computed with the
+ *      same priority list and genome size, FEATURE_INDEX_NOINPUT or
+ *      FEATURE_INDEX_BAD_DATA otherwise
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     class_coverage_read(feature_index_t *fi, class_coverage_t *cov,
+			    const char *priority_list, int64_t genome_size,
+			    const char *filename)
+
+{
+    FILE        *stream;
+    dsv_line_t  line = DSV_INIT;
+    size_t      c = 0;
+    int         status = FEATURE_INDEX_OK;
+
+    if ( (stream = fopen(filename, "r")) == NULL )
+	return FEATURE_INDEX_NOINPUT;
+    memset(cov, 0, sizeof(*cov));
+    cov->class_count = fi->class_count;
+    while ( (status == FEATURE_INDEX_OK) &&
+	    (dsv_line_read(&line, stream, "\t") != EOF) )
+    {
+	if ( DSV_LINE_NUM_FIELDS(&line) < 2 )
+	    status = FEATURE_INDEX_BAD_DATA;
+	else if ( strcmp(DSV_LINE_FIELDS_AE(&line, 0), "#Priority") == 0 )
+	{
+	    if ( strcmp(DSV_LINE_FIELDS_AE(&line, 1), priority_list) != 0 )
+		status = FEATURE_INDEX_BAD_DATA;
+	}
+	else if ( strcmp(DSV_LINE_FIELDS_AE(&line, 0), "#Genome-size") == 0 )
+	{
+	    cov->genome_size = strtoll(DSV_LINE_FIELDS_AE(&line, 1), NULL, 10);
+	    if ( cov->genome_size != genome_size )
+		status = FEATURE_INDEX_BAD_DATA;
+	}
+	else if ( *DSV_LINE_FIELDS_AE(&line, 0) != '#' )
+	{
+	    if ( (c > cov->class_count) || (DSV_LINE_NUM_FIELDS(&line) < 5) )
+		status = FEATURE_INDEX_BAD_DATA;
+	    else
+	    {
+		cov->any_bp[c] = strtoll(DSV_LINE_FIELDS_AE(&line, 1), NULL, 10);
+		cov->priority_bp[c] = strtoll(DSV_LINE_FIELDS_AE(&line, 3), NULL, 10);
+		++c;
+	    }
+	}
+	dsv_line_free(&line);
+    }
+    fclose(stream);
+    if ( c != cov->class_count + 1 )
+	status = FEATURE_INDEX_BAD_DATA;
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Get class coverage from the cache file if it is valid for this
+ *      index and priority list, otherwise compute it and (re)write the
+ *      cache.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     class_coverage_get(feature_index_t *fi, class_coverage_t *cov,
+			   const char *priority_list, const char *cache_filename)
+
+{
+    FILE    *stream;
+    int64_t genome_size = 0;
+    size_t  c;
+
+    for (c = 0; c < fi->chrom_count; ++c)
+	genome_size += fi->chroms[c].size;
+    if ( class_coverage_read(fi, cov, priority_list, genome_size,
+			     cache_filename) == FEATURE_INDEX_OK )
+    {
+	fprintf(stderr, "Using existing %s...\n", cache_filename);
+	return EX_OK;
+    }
+
+    fputs("Computing class coverage...\n", stderr);
+    class_coverage_compute(fi, cov);
+    if ( (stream = fopen(cache_filename, "w")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot write %s: %s\n",
+		cache_filename, strerror(errno));
+	return EX_CANTCREAT;
+    }
+    class_coverage_write(fi, cov, priority_list, stream);
+    fclose(stream);
+    return EX_OK;
+}
@@ -0,0 +1,543 @@
+/***************************************************************************
+ *  Description:
+ *      Consensus peaks from many sorted peak files by k-way streaming
+ *      merge.  Overlapping and book-ended peaks from all samples are
+ *      merged as with "cat | sort | bedtools merge", and each merged
+ *      peak carries the number of samples supporting it and a presence
+ *      bitset.  Only one peak per input is held in memory at a time,
+ *      after a first pass that records the order of chromosomes.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Look up a chromosome in a merge order, trying hint first.
+ *
+ *  Returns:
+ *      Index of chrom, or order->count if not present
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+size_t  chrom_order_find(chrom_order_t *order, const char *chrom, size_t hint)
+
+{
+    size_t  c;
+
+    if ( (hint < order->count) && (strcmp(order->names[hint], chrom) == 0) )
+	return hint;
+    for (c = 0; c < order->count; ++c)
+	if ( strcmp(order->names[c], chrom) == 0 )
+	    return c;
+    return order->count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Record that prev (if less than order->count) is followed by chrom
+ *      in input, adding chrom if it is new.
+ *
+ *  Returns:
+ *      Index of chrom, or order->count if input has already left chrom
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+size_t  chrom_order_add(chrom_order_t *order, const char *chrom, size_t prev,
+			size_t input)
+
+{
+    size_t  c;
+    bool    has_prev = prev < order->count;
+
+    if ( (c = chrom_order_find(order, chrom, prev + 1)) == order->count )
+    {
+	if ( order->count == order->array_size )
+	{
+	    order->array_size = order->array_size == 0 ? 64 :
+				order->array_size * 2;
+	    order->names = xt_realloc(order->names, order->array_size,
+				      sizeof(*order->names));
+	    order->last_input = xt_realloc(order->last_input,
+				order->array_size, sizeof(*order->last_input));
+	    if ( (order->names == NULL) || (order->last_input == NULL) )
+	    {
+		fputs("chrom_order_add(): Could not allocate names.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	if ( (order->names[c] = strdup(chrom)) == NULL )
+	{
+	    fputs("chrom_order_add(): Could not allocate name.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	++order->count;
+    }
+    else if ( order->last_input[c] == input )
+	return order->count;
+    order->last_input[c] = input;
+
+    if ( has_prev )
+    {
+	if ( order->edge_count == order->edge_array_size )
+	{
+	    order->edge_array_size = order->edge_array_size == 0 ? 64 :
+				     order->edge_array_size * 2;
+	    order->edge_from = xt_realloc(order->edge_from,
+			order->edge_array_size, sizeof(*order->edge_from));
+	    order->edge_to = xt_realloc(order->edge_to,
+			order->edge_array_size, sizeof(*order->edge_to));
+	    if ( (order->edge_from == NULL) || (order->edge_to == NULL) )
+	    {
+		fputs("chrom_order_add(): Could not allocate edges.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	order->edge_from[order->edge_count] = prev;
+	order->edge_to[order->edge_count++] = c;
+    }
+    return c;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sort the names of a merge order so that every recorded edge goes
+ *      from a lower index to a higher one, preferring the chromosome
+ *      seen first when there is a choice.  For peaks sorted with
+ *      "sort -n -k 1,1 -k 2,2n", "sort -k 1,1 -k 2,2n", or any other
+ *      order used consistently, this reproduces that order.
+ *
+ *  Returns:
+ *      EX_OK, or EX_DATAERR if inputs disagree on chromosome order
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+int     chrom_order_sort(chrom_order_t *order)
+
+{
+    size_t  *in_degree, *rank, c, e, placed, next;
+    char    **names;
+
+    in_degree = xt_malloc(order->count + 1, sizeof(*in_degree));
+    rank = xt_malloc(order->count + 1, sizeof(*rank));
+    names = xt_malloc(order->count + 1, sizeof(*names));
+    if ( (in_degree == NULL) || (rank == NULL) || (names == NULL) )
+    {
+	fputs("chrom_order_sort(): Could not allocate ranks.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0; c < order->count; ++c)
+    {
+	in_degree[c] = 0;
+	rank[c] = order->count;
+    }
+    for (e = 0; e < order->edge_count; ++e)
+	++in_degree[order->edge_to[e]];
+
+    for (placed = 0; placed < order->count; ++placed)
+    {
+	// First chromosome seen that follows none not yet placed
+	for (next = 0; (next < order->count) &&
+		       ((rank[next] != order->count) || (in_degree[next] != 0));
+	     ++next)
+	    ;
+	if ( next == order->count )
+	{
+	    fputs("peak-classifier: Chromosomes are not in the same order "
+		  "in all inputs.\n", stderr);
+	    free(in_degree);
+	    free(rank);
+	    free(names);
+	    return EX_DATAERR;
+	}
+	rank[next] = placed;
+	names[placed] = order->names[next];
+	for (e = 0; e < order->edge_count; ++e)
+	    if ( order->edge_from[e] == next )
+		--in_degree[order->edge_to[e]];
+    }
+
+    free(order->names);
+    order->names = names;
+    free(in_degree);
+    free(rank);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read the chromosome sequence of every input and sort the
+ *      chromosomes into one order consistent with all of them.  Each
+ *      input must have all peaks on a chromosome together.
+ *
+ *  Returns:
+ *      EX_OK, EX_NOINPUT, or EX_DATAERR
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+int     chrom_order_scan(chrom_order_t *order, sample_list_t *samples)
+
+{
+    FILE        *stream;
+    bl_bed_t    peak = BL_BED_INIT;
+    char        prev_chrom[BL_CHROM_MAX_CHARS + 1];
+    size_t      s, prev;
+    int         status = EX_OK;
+
+    for (s = 0; (s < samples->count) && (status == EX_OK); ++s)
+    {
+	if ( (stream = xt_fopen(samples->filenames[s], "r")) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		    samples->filenames[s], strerror(errno));
+	    return EX_NOINPUT;
+	}
+	bl_bed_skip_header(stream);
+	*prev_chrom = '\0';
+	prev = order->count;
+	while ( bl_bed_read(&peak, stream, BL_BED_FIELD_ALL) == BL_READ_OK )
+	{
+	    if ( strcmp(BL_BED_CHROM(&peak), prev_chrom) == 0 )
+		continue;
+	    prev = chrom_order_add(order, BL_BED_CHROM(&peak), prev, s);
+	    if ( prev == order->count )
+	    {
+		fprintf(stderr, "peak-classifier: %s is not sorted at %s %"
+			PRId64 ".\n", samples->filenames[s],
+			BL_BED_CHROM(&peak), BL_BED_CHROM_START(&peak));
+		status = EX_DATAERR;
+		break;
+	    }
+	    strlcpy(prev_chrom, BL_BED_CHROM(&peak), BL_CHROM_MAX_CHARS + 1);
+	}
+	xt_fclose(stream);
+    }
+    if ( status == EX_OK )
+	status = chrom_order_sort(order);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Free a merge order.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+void    chrom_order_free(chrom_order_t *order)
+
+{
+    size_t  c;
+
+    for (c = 0; c < order->count; ++c)
+	free(order->names[c]);
+    free(order->names);
+    free(order->last_input);
+    free(order->edge_from);
+    free(order->edge_to);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compare the current peaks of two merge inputs by chromosome rank,
+ *      then start.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ *  2026-10-19  agent       Use chrom_order_t ranks instead of strcmp()
+ ***************************************************************************/
+
+int     merge_input_cmp(merge_input_t *inputs, size_t i1, size_t i2)
+
+{
+    bl_bed_t    *p1 = &inputs[i1].peak, *p2 = &inputs[i2].peak;
+
+    if ( inputs[i1].chrom_rank != inputs[i2].chrom_rank )
+	return inputs[i1].chrom_rank < inputs[i2].chrom_rank ? -1 : 1;
+    if ( BL_BED_CHROM_START(p1) != BL_BED_CHROM_START(p2) )
+	return BL_BED_CHROM_START(p1) < BL_BED_CHROM_START(p2) ? -1 : 1;
+    return i1 < i2 ? -1 : i1 > i2;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Restore the heap property below heap[root].
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    merge_heap_down(merge_input_t *inputs, size_t *heap, size_t count,
+			size_t root)
+
+{
+    size_t  child, tmp;
+
+    while ( (child = 2 * root + 1) < count )
+    {
+	if ( (child + 1 < count) &&
+	     (merge_input_cmp(inputs, heap[child + 1], heap[child]) < 0) )
+	    ++child;
+	if ( merge_input_cmp(inputs, heap[child], heap[root]) >= 0 )
+	    break;
+	tmp = heap[root];
+	heap[root] = heap[child];
+	heap[child] = tmp;
+	root = child;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read the next peak of one input, checking that it is sorted
+ *      by start within each chromosome and that chromosomes follow
+ *      the merge order.
+ *
+ *  Returns:
+ *      BL_READ_OK, BL_READ_EOF, or an error status from bl_bed_read()
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ *  2026-10-19  agent       Accept any chromosome order used by all inputs
+ ***************************************************************************/
+
+int     merge_input_next(merge_input_t *input, chrom_order_t *order,
+			 const char *filename)
+
+{
+    size_t  prev_rank;
+    int64_t prev_start;
+    int     status;
+
+    prev_rank = input->chrom_rank;
+    prev_start = BL_BED_CHROM_START(&input->peak);
+    status = bl_bed_read(&input->peak, input->stream, BL_BED_FIELD_ALL);
+    if ( status != BL_READ_OK )
+    {
+	input->eof = true;
+	return status;
+    }
+    input->chrom_rank = chrom_order_find(order, BL_BED_CHROM(&input->peak),
+					 prev_rank);
+    if ( (prev_rank != order->count) &&
+	 ((input->chrom_rank < prev_rank) ||
+	  ((input->chrom_rank == prev_rank) &&
+	   (BL_BED_CHROM_START(&input->peak) < prev_start))) )
+    {
+	fprintf(stderr, "merge_input_next(): %s is not sorted at %s %" PRId64 ".\n",
+		filename, BL_BED_CHROM(&input->peak),
+		BL_BED_CHROM_START(&input->peak));
+	input->eof = true;
+	return BL_READ_MISMATCH;
+    }
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write one consensus peak if it has at least min_support samples,
+ *      followed by its class if fi is not NULL.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    consensus_peak_write(consensus_peak_t *cp, size_t samples,
+			     size_t min_support, size_t *serial,
+			     feature_index_t *fi, overlap_params_t *params,
+			     hit_list_t *hits, FILE *outfile)
+
+{
+    size_t  c, chrom;
+
+    if ( cp->support < min_support )
+	return;
+    fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\tconsensus%zu\t%zu\t",
+	    cp->chrom, cp->start, cp->end, ++*serial, cp->support);
+    for (c = 0; c < samples; ++c)
+	putc(cp->presence[c / 64] & ((uint64_t)1 << (c % 64)) ? '1' : '0',
+	     outfile);
+    if ( fi != NULL )
+    {
+	chrom = feature_index_find_chrom(fi, cp->chrom, 0);
+	fprintf(outfile, "\t%s", feature_index_class_name(fi,
+		feature_index_classify(fi, chrom, cp->start, cp->end, params,
+				       hits, NULL)));
+    }
+    putc('\n', outfile);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Merge the sorted peak files in samples and write consensus peaks
+ *      supported by at least min_support samples.  If fi is not NULL,
+ *      each consensus peak is classified against it.  A first pass
+ *      over the inputs finds the chromosome order they share, so any
+ *      consistent order is accepted.  Merging stops at the first input
+ *      found to be unsorted, leaving partial output for the caller to
+ *      discard.
+ *
+ *  Returns:
+ *      EX_OK, EX_NOINPUT, or EX_DATAERR
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ *  2026-10-19  agent       Find chromosome order with chrom_order_scan()
+ ***************************************************************************/
+
+int     consensus_merge(sample_list_t *samples, size_t min_support,
+			feature_index_t *fi, overlap_params_t *params,
+			FILE *outfile)
+
+{
+    merge_input_t       *inputs;
+    bl_bed_t            peak_init = BL_BED_INIT;
+    consensus_peak_t    cp;
+    hit_list_t          hits = HIT_LIST_INIT;
+    size_t              *heap, heap_count = 0, c, s, words, serial = 0;
+    bl_bed_t            *peak;
+    int                 status = EX_OK, read_status;
+    chrom_order_t       order = CHROM_ORDER_INIT;
+    bool                open = false;
+
+    if ( (status = chrom_order_scan(&order, samples)) != EX_OK )
+    {
+	chrom_order_free(&order);
+	return status;
+    }
+
+    words = (samples->count + 63) / 64;
+    inputs = xt_malloc(samples->count, sizeof(*inputs));
+    heap = xt_malloc(samples->count, sizeof(*heap));
+    cp.presence = xt_malloc(words, sizeof(*cp.presence));
+    if ( (inputs == NULL) || (heap == NULL) || (cp.presence == NULL) )
+    {
+	fputs("consensus_merge(): Could not allocate inputs.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+
+    for (s = 0; s < samples->count; ++s)
+    {
+	if ( (inputs[s].stream = xt_fopen(samples->filenames[s], "r")) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		    samples->filenames[s], strerror(errno));
+	    for (c = 0; c < s; ++c)
+		xt_fclose(inputs[c].stream);
+	    free(inputs);
+	    free(heap);
+	    free(cp.presence);
+	    chrom_order_free(&order);
+	    return EX_NOINPUT;
+	}
+	inputs[s].peak = peak_init;
+	inputs[s].chrom_rank = order.count;
+	inputs[s].eof = false;
+	bl_bed_skip_header(inputs[s].stream);
+	if ( merge_input_next(&inputs[s], &order,
+			      samples->filenames[s]) == BL_READ_OK )
+	    heap[heap_count++] = s;
+    }
+    for (c = heap_count / 2; c-- > 0; )
+	merge_heap_down(inputs, heap, heap_count, c);
+
+    fputs("#Chr\tStart\tEnd\tName\tSupport\tPresence", outfile);
+    if ( fi != NULL )
+	fputs("\tClass", outfile);
+    putc('\n', outfile);
+    while ( heap_count > 0 )
+    {
+	s = heap[0];
+	peak = &inputs[s].peak;
+	if ( open && (strcmp(BL_BED_CHROM(peak), cp.chrom) == 0) &&
+	     (BL_BED_CHROM_START(peak) <= cp.end) )
+	    cp.end = XT_MAX(cp.end, BL_BED_CHROM_END(peak));
+	else
+	{
+	    if ( open )
+		consensus_peak_write(&cp, samples->count, min_support, &serial,
+				     fi, params, &hits, outfile);
+	    strlcpy(cp.chrom, BL_BED_CHROM(peak), BL_CHROM_MAX_CHARS + 1);
+	    cp.start = BL_BED_CHROM_START(peak);
+	    cp.end = BL_BED_CHROM_END(peak);
+	    cp.support = 0;
+	    memset(cp.presence, 0, words * sizeof(*cp.presence));
+	    open = true;
+	}
+	if ( !(cp.presence[s / 64] & ((uint64_t)1 << (s % 64))) )
+	{
+	    cp.presence[s / 64] |= (uint64_t)1 << (s % 64);
+	    ++cp.support;
+	}
+
+	read_status = merge_input_next(&inputs[s], &order,
+				       samples->filenames[s]);
+	if ( read_status == BL_READ_OK )
+	    merge_heap_down(inputs, heap, heap_count, 0);
+	else if ( read_status != BL_READ_EOF )
+	{
+	    // Consensus peaks from here on would be wrong, so stop
+	    status = EX_DATAERR;
+	    break;
+	}
+	else
+	{
+	    heap[0] = heap[--heap_count];
+	    merge_heap_down(inputs, heap, heap_count, 0);
+	}
+    }
+    if ( open && (status == EX_OK) )
+	consensus_peak_write(&cp, samples->count, min_support, &serial,
+			     fi, params, &hits, outfile);
+    if ( status == EX_OK )
+	fprintf(stderr, "%zu consensus peaks with support >= %zu.\n",
+		serial, min_support);
+
+    for (s = 0; s < samples->count; ++s)
+	xt_fclose(inputs[s].stream);
+    hit_list_free(&hits);
+    free(inputs);
+    free(heap);
+    free(cp.presence);
+    chrom_order_free(&order);
+    return status;
+}
@@ -0,0 +1,226 @@
+/***************************************************************************
+ *  Description:
+ *      Peak x sample read count matrix.  Many coordinate-sorted alignment
+ *      files are streamed concurrently, one reader thread per file, and
+ *      each is swept against the sorted peak set with its own active
+ *      window, filling one column of a dense count matrix.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Count the alignments in one sorted SAM stream overlapping each
+ *      peak.  Peaks must be sorted by interval_set_sort().  Each read is
+ *      counted once for every peak overlapped by its CIGAR blocks, so
+ *      spliced reads are not counted in peaks within their introns.
+ *      Filtering is done by bl_sam_buff_alignment_ok(), which discards
+ *      unmapped alignments and those below the buffer's minimum MAPQ.
+ *
+ *      The window start moves past peaks ending before the current
+ *      read, which can never overlap a later one.  Peaks nested inside
+ *      a longer one may linger in the window until it ends, but are
+ *      rejected by the end test.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, BL_READ_BAD_DATA if alignments are not
+ *      sorted, or another bl_sam_read() status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     count_matrix_scan(count_sample_t *sample, FILE *sam_stream)
+
+{
+    bl_sam_t        alignment;
+    bl_sam_buff_t   sam_buff;
+    sam_blocks_t    blocks = SAM_BLOCKS_INIT;
+    peak_set_t      *peaks = sample->peaks;
+    char            *rname = NULL;
+    size_t          chrom = 0, first = 0, last = 0, p;
+    int64_t         start, end, previous_start = 0;
+    int             status;
+
+    // BL_SAM_INIT omits the qual sizes and bl_sam_init() the cigar sizes
+    memset(&alignment, 0, sizeof(alignment));
+
+    bl_sam_buff_init(&sam_buff, sample->min_mapq, 0);
+    while ( (status = bl_sam_read(&alignment, sam_stream,
+				  BL_SAM_FIELD_FLAG | BL_SAM_FIELD_RNAME |
+				  BL_SAM_FIELD_POS | BL_SAM_FIELD_MAPQ |
+				  BL_SAM_FIELD_CIGAR)) == BL_READ_OK )
+    {
+	++sample->alignments;
+	if ( ! bl_sam_buff_alignment_ok(&sam_buff, &alignment) )
+	    continue;
+	start = BL_SAM_POS(&alignment) - 1;
+	if ( (rname == NULL) || (strcmp(rname, BL_SAM_RNAME(&alignment)) != 0) )
+	{
+	    free(rname);
+	    rname = strdup(BL_SAM_RNAME(&alignment));
+	    chrom = feature_index_find_chrom(sample->chroms, rname, chrom);
+	    if ( chrom < sample->chroms->chrom_count )
+	    {
+		first = sample->chrom_first[chrom];
+		last = sample->chrom_first[chrom + 1];
+	    }
+	    else
+		first = last = 0;
+	}
+	else if ( start < previous_start )
+	{
+	    fprintf(stderr, "count_matrix_scan(): %s is not sorted: "
+		    "%s %" PRId64 "\n", sample->filename, rname, start + 1);
+	    status = BL_READ_BAD_DATA;
+	    break;
+	}
+	previous_start = start;
+	++sample->used;
+
+	sam_blocks_parse(&blocks, start, BL_SAM_CIGAR(&alignment));
+	if ( blocks.count == 0 )
+	    continue;
+	end = blocks.end[blocks.count - 1];
+	while ( (first < last) && (peaks->end[first] <= start) )
+	    ++first;
+	for (p = first; (p < last) && (peaks->start[p] < end); ++p)
+	    if ( (peaks->end[p] > start) &&
+		 (sam_blocks_overlap(&blocks, peaks->start[p], peaks->end[p]) > 0) )
+		++sample->counts[p];
+    }
+    sample->unmapped = sam_buff.unmapped_alignments;
+    sample->low_mapq = sam_buff.discarded_alignments;
+    free(sam_buff.alignments);
+    sam_blocks_free(&blocks);
+    free(rname);
+    bl_sam_free(&alignment);
+    return status;
+}
+
+
+void    *count_matrix_thread(void *arg)
+
+{
+    count_sample_t  *sample = arg;
+    FILE            *sam_stream, *header_stream;
+
+    if ( (sam_stream = bl_sam_fopen(sample->filename, "r", NULL)) == NULL )
+    {
+	fprintf(stderr, "count_matrix_thread(): Cannot open %s: %s\n",
+		sample->filename, strerror(errno));
+	sample->status = EX_NOINPUT;
+	return NULL;
+    }
+    if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	fclose(header_stream);
+    sample->status = count_matrix_scan(sample, sam_stream) == BL_READ_EOF ?
+		     EX_OK : EX_DATAERR;
+    bl_sam_fclose(sam_stream);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Count reads in each peak for every alignment file in samples.
+ *      Peaks must be sorted by interval_set_sort().  Each file is read
+ *      by its own thread into its own column, counts + s * peak count,
+ *      so that threads never share cache lines.  More than
+ *      PC_MAX_THREADS files are processed in waves.
+ *
+ *  Returns:
+ *      EX_OK on success, or the first failing sample's status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     count_matrix(sample_list_t *samples, feature_index_t *chroms,
+		     peak_set_t *peaks, size_t *chrom_first, unsigned min_mapq,
+		     uint64_t *counts, count_sample_t *stats)
+
+{
+    pthread_t   thread_ids[PC_MAX_THREADS];
+    size_t      first, s, t, wave;
+    int         status = EX_OK;
+
+    memset(counts, 0, samples->count * peaks->count * sizeof(*counts));
+    for (s = 0; s < samples->count; ++s)
+    {
+	memset(&stats[s], 0, sizeof(stats[s]));
+	stats[s].filename = samples->filenames[s];
+	stats[s].chroms = chroms;
+	stats[s].peaks = peaks;
+	stats[s].chrom_first = chrom_first;
+	stats[s].min_mapq = min_mapq;
+	stats[s].counts = counts + s * peaks->count;
+    }
+
+    for (first = 0; first < samples->count; first += PC_MAX_THREADS)
+    {
+	wave = XT_MIN(samples->count - first, PC_MAX_THREADS);
+	for (t = 0; t < wave; ++t)
+	    if ( pthread_create(&thread_ids[t], NULL, count_matrix_thread,
+				&stats[first + t]) != 0 )
+	    {
+		fputs("count_matrix(): pthread_create() failed.\n", stderr);
+		return EX_OSERR;
+	    }
+	for (t = 0; t < wave; ++t)
+	{
+	    pthread_join(thread_ids[t], NULL);
+	    if ( (status == EX_OK) && (stats[first + t].status != EX_OK) )
+		status = stats[first + t].status;
+	}
+    }
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the count matrix, one row per peak in sorted order and one
+ *      column per sample in list order.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    count_matrix_write(sample_list_t *samples, feature_index_t *chroms,
+			   peak_set_t *peaks, uint64_t *counts, FILE *outfile)
+
+{
+    size_t  p, s;
+
+    fputs("#Chrom\tStart\tEnd\tName", outfile);
+    for (s = 0; s < samples->count; ++s)
+	fprintf(outfile, "\t%s", samples->names[s]);
+    putc('\n', outfile);
+    for (p = 0; p < peaks->count; ++p)
+    {
+	fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\t%s",
+		chroms->chroms[peaks->chrom[p]].name, peaks->start[p],
+		peaks->end[p], peaks->name[p] != NULL ? peaks->name[p] : ".");
+	for (s = 0; s < samples->count; ++s)
+	    fprintf(outfile, "\t%" PRIu64, counts[s * peaks->count + p]);
+	putc('\n', outfile);
+    }
+}
@@ -0,0 +1,471 @@
+/***************************************************************************
+ *  Description:
+ *      Streaming bedGraph coverage from coordinate-sorted alignments.
+ *      Each alignment's M, =, and X blocks are added to a rolling
+ *      difference array, and depth runs are written as soon as no later
+ *      alignment can change them, so memory is bounded by the longest
+ *      alignment span rather than the chromosome length.  Indexed BAM
+ *      and CRAM files can be processed one chromosome per thread.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+void    coverage_init(coverage_t *cov, FILE *out)
+
+{
+    cov->chrom = NULL;
+    cov->size = COVERAGE_WINDOW_START;
+    cov->mask = cov->size - 1;
+    cov->diff = calloc(cov->size, sizeof(*cov->diff));
+    if ( cov->diff == NULL )
+    {
+	fputs("coverage_init(): Could not allocate window.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    cov->base = cov->depth = cov->run_start = cov->run_depth = 0;
+    cov->last_event = -1;
+    cov->emit = coverage_write_run;
+    cov->arg = out;
+}
+
+
+void    coverage_write_run(void *out, const char *chrom, int64_t start,
+			   int64_t end, int64_t depth)
+
+{
+    fprintf(out, "%s\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\n",
+	    chrom, start, end, depth);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Double the window until position end fits, moving pending
+ *      differences to their slots under the new mask.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    coverage_grow(coverage_t *cov, int64_t end)
+
+{
+    int32_t *diff;
+    size_t  size;
+    int64_t p;
+
+    for (size = cov->size; end - cov->base >= (int64_t)size; size *= 2)
+	;
+    if ( size == cov->size )
+	return;
+    if ( (diff = calloc(size, sizeof(*diff))) == NULL )
+    {
+	fputs("coverage_grow(): Could not allocate window.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (p = cov->base; p <= cov->last_event; ++p)
+	diff[p & (size - 1)] = cov->diff[p & cov->mask];
+    free(cov->diff);
+    cov->diff = diff;
+    cov->size = size;
+    cov->mask = size - 1;
+}
+
+
+void    coverage_add(coverage_t *cov, int64_t start, int64_t end)
+
+{
+    coverage_grow(cov, end);
+    ++cov->diff[start & cov->mask];
+    --cov->diff[end & cov->mask];
+    if ( end > cov->last_event )
+	cov->last_event = end;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Pass all runs ending before pos to cov->emit(), which writes
+ *      bedGraph by default.  pos must not be after the start of any
+ *      interval added later.  Past the last pending change
+ *      depth is 0, so the window jumps directly to pos.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    coverage_flush(coverage_t *cov, int64_t pos)
+
+{
+    int64_t p, stop;
+    size_t  slot;
+
+    stop = pos <= cov->last_event ? pos : cov->last_event + 1;
+    for (p = cov->base; p < stop; ++p)
+    {
+	slot = p & cov->mask;
+	if ( cov->diff[slot] == 0 )
+	    continue;
+	cov->depth += cov->diff[slot];
+	cov->diff[slot] = 0;
+	if ( cov->run_depth > 0 )
+	    cov->emit(cov->arg, cov->chrom, cov->run_start, p, cov->run_depth);
+	cov->run_start = p;
+	cov->run_depth = cov->depth;
+    }
+    if ( pos > cov->base )
+	cov->base = pos;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the remaining runs of the current chromosome and switch to
+ *      chrom, or to none if chrom is NULL.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    coverage_set_chrom(coverage_t *cov, const char *chrom)
+
+{
+    if ( cov->chrom != NULL )
+    {
+	coverage_flush(cov, cov->last_event + 1);
+	free(cov->chrom);
+    }
+    cov->chrom = chrom == NULL ? NULL : strdup(chrom);
+    cov->base = cov->depth = cov->run_start = cov->run_depth = 0;
+    cov->last_event = -1;
+}
+
+
+void    coverage_free(coverage_t *cov)
+
+{
+    coverage_set_chrom(cov, NULL);
+    free(cov->diff);
+    cov->diff = NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add the M, =, and X blocks of one alignment starting at 0-based
+ *      position start.  Deletions and skipped regions (D, N) are not
+ *      covered, as with bedtools genomecov -split.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    coverage_add_alignment(coverage_t *cov, int64_t start, const char *cigar)
+
+{
+    int64_t n;
+    char    *end;
+
+    while ( isdigit((unsigned char)*cigar) )
+    {
+	n = strtoll(cigar, &end, 10);
+	switch(*end)
+	{
+	    case    'M':
+	    case    '=':
+	    case    'X':
+		if ( n > 0 )
+		    coverage_add(cov, start, start + n);
+		start += n;
+		break;
+	    case    'D':
+	    case    'N':
+		start += n;
+		break;
+	    case    '\0':
+		return;
+	}
+	cigar = end + 1;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write bedGraph runs for a sorted alignment stream to out, skipping
+ *      unmapped, secondary, supplementary, QC failed, duplicate, and low
+ *      MAPQ alignments.  The number of alignments used is added to reads.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, or another BL_READ_ status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     coverage_scan(FILE *sam_stream, unsigned min_mapq, FILE *out,
+		      uint64_t *reads)
+
+{
+    bl_sam_t    alignment;
+    coverage_t  cov;
+    int64_t     start;
+    int         status;
+
+    // BL_SAM_INIT omits the qual sizes and bl_sam_init() the cigar sizes
+    memset(&alignment, 0, sizeof(alignment));
+
+    coverage_init(&cov, out);
+    while ( (status = bl_sam_read(&alignment, sam_stream,
+				  BL_SAM_FIELD_FLAG | BL_SAM_FIELD_RNAME |
+				  BL_SAM_FIELD_POS | BL_SAM_FIELD_MAPQ |
+				  BL_SAM_FIELD_CIGAR)) == BL_READ_OK )
+    {
+	if ( (BL_SAM_FLAG(&alignment) & (BL_SAM_FLAG_UNMAP |
+		BL_SAM_FLAG_SECONDARY | BL_SAM_FLAG_SUPPLEMENTARY |
+		BL_SAM_FLAG_QCFAIL | BL_SAM_FLAG_DUP)) ||
+	     (BL_SAM_MAPQ(&alignment) < min_mapq) )
+	    continue;
+	start = BL_SAM_POS(&alignment) - 1;
+	if ( (cov.chrom == NULL) ||
+	     (strcmp(cov.chrom, BL_SAM_RNAME(&alignment)) != 0) )
+	    coverage_set_chrom(&cov, BL_SAM_RNAME(&alignment));
+	else if ( start < cov.base )
+	{
+	    fprintf(stderr, "coverage_scan(): Alignments are not sorted: "
+		    "%s %" PRId64 "\n", cov.chrom, start + 1);
+	    status = BL_READ_BAD_DATA;
+	    break;
+	}
+	coverage_flush(&cov, start);
+	coverage_add_alignment(&cov, start, BL_SAM_CIGAR(&alignment));
+	++*reads;
+    }
+    coverage_free(&cov);
+    bl_sam_free(&alignment);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Copy runs written by coverage_scan() to out, scaling depths by
+ *      scale (counts per million) if cpm is true.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    coverage_write_runs(FILE *runs, bool cpm, double scale, FILE *out)
+
+{
+    char        chrom[BL_CHROM_MAX_CHARS + 1];
+    int64_t     start, end, depth;
+
+    rewind(runs);
+    while ( fscanf(runs, "%256s %" SCNd64 " %" SCNd64 " %" SCNd64, chrom,
+		   &start, &end, &depth) == 4 )
+    {
+	if ( cpm )
+	    fprintf(out, "%s\t%" PRId64 "\t%" PRId64 "\t%.6g\n",
+		    chrom, start, end, depth * scale);
+	else
+	    fprintf(out, "%s\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\n",
+		    chrom, start, end, depth);
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      List the reference sequences in the header of a BAM or CRAM file.
+ *
+ *  Returns:
+ *      Number of sequences, with the names in *chroms
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  coverage_chroms(const char *alignments_filename, char ***chroms)
+
+{
+    char    cmd[PEAK_CMD_MAX + 1],
+	    line[BL_SAM_RNAME_MAX_CHARS + 1],
+	    *name, *end;
+    FILE    *header;
+    size_t  count = 0, array_size = 64;
+
+    snprintf(cmd, PEAK_CMD_MAX, "samtools view -H %s", alignments_filename);
+    if ( (header = popen(cmd, "r")) == NULL )
+	return 0;
+    if ( (*chroms = xt_malloc(array_size, sizeof(**chroms))) == NULL )
+    {
+	fputs("coverage_chroms(): Could not allocate chroms.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    while ( fgets(line, BL_SAM_RNAME_MAX_CHARS, header) != NULL )
+    {
+	if ( (memcmp(line, "@SQ", 3) != 0) ||
+	     ((name = strstr(line, "\tSN:")) == NULL) )
+	    continue;
+	name += 4;
+	end = name + strcspn(name, "\t\n");
+	*end = '\0';
+	if ( count == array_size )
+	{
+	    array_size *= 2;
+	    *chroms = xt_realloc(*chroms, array_size, sizeof(**chroms));
+	    if ( *chroms == NULL )
+	    {
+		fputs("coverage_chroms(): Could not allocate chroms.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	(*chroms)[count++] = strdup(name);
+    }
+    pclose(header);
+    return count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the runs of each chromosome assigned to this thread to its
+ *      own temp file, reading it with an indexed samtools query.
+ *      Chromosomes are assigned round-robin as in jaccard_matrix().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    *coverage_thread(void *arg)
+
+{
+    coverage_thread_t   *ct = arg;
+    char                cmd[PEAK_CMD_MAX + 1];
+    FILE                *stream;
+    size_t              c;
+    int                 status;
+
+    for (c = ct->first_chrom; c < ct->chrom_count; c += ct->chrom_step)
+    {
+	snprintf(cmd, PEAK_CMD_MAX, "samtools view %s %s",
+		 ct->alignments_filename, ct->chroms[c]);
+	if ( ((stream = popen(cmd, "r")) == NULL) ||
+	     ((ct->runs[c] = tmpfile()) == NULL) )
+	{
+	    fprintf(stderr, "coverage_thread(): Cannot read %s.\n", ct->chroms[c]);
+	    ct->status = BL_READ_UNKNOWN_FORMAT;
+	    return NULL;
+	}
+	status = coverage_scan(stream, ct->min_mapq, ct->runs[c],
+			       &ct->reads[c]);
+	pclose(stream);
+	if ( status != BL_READ_EOF )
+	{
+	    ct->status = status;
+	    return NULL;
+	}
+    }
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write bedGraph coverage for one chromosome per thread, then
+ *      concatenate the chromosomes in header order.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, or another BL_READ_ status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     coverage_parallel(const char *alignments_filename, char **chroms,
+			  size_t chrom_count, unsigned min_mapq, bool cpm,
+			  unsigned threads, FILE *out)
+
+{
+    coverage_thread_t   thread_args[PC_MAX_THREADS];
+    pthread_t           thread_ids[PC_MAX_THREADS];
+    FILE                **runs;
+    uint64_t            *reads, total = 0;
+    size_t              c;
+    unsigned            t;
+    int                 status = BL_READ_EOF;
+
+    runs = calloc(chrom_count, sizeof(*runs));
+    reads = calloc(chrom_count, sizeof(*reads));
+    if ( (runs == NULL) || (reads == NULL) )
+    {
+	fputs("coverage_parallel(): Could not allocate chromosomes.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    if ( threads > chrom_count )
+	threads = chrom_count;
+    for (t = 0; t < threads; ++t)
+    {
+	thread_args[t].alignments_filename = alignments_filename;
+	thread_args[t].chroms = chroms;
+	thread_args[t].runs = runs;
+	thread_args[t].reads = reads;
+	thread_args[t].chrom_count = chrom_count;
+	thread_args[t].first_chrom = t;
+	thread_args[t].chrom_step = threads;
+	thread_args[t].min_mapq = min_mapq;
+	thread_args[t].status = BL_READ_EOF;
+	if ( pthread_create(&thread_ids[t], NULL, coverage_thread,
+			    &thread_args[t]) != 0 )
+	{
+	    fputs("coverage_parallel(): pthread_create() failed.\n", stderr);
+	    exit(EX_OSERR);
+	}
+    }
+    for (t = 0; t < threads; ++t)
+    {
+	pthread_join(thread_ids[t], NULL);
+	if ( thread_args[t].status != BL_READ_EOF )
+	    status = thread_args[t].status;
+    }
+
+    for (c = 0; c < chrom_count; ++c)
+	total += reads[c];
+    for (c = 0; c < chrom_count; ++c)
+    {
+	if ( runs[c] == NULL )
+	    continue;
+	if ( status == BL_READ_EOF )
+	    coverage_write_runs(runs[c], cpm, total == 0 ? 0.0 : 1.0e6 / total,
+				out);
+	fclose(runs[c]);
+    }
+    free(runs);
+    free(reads);
+    return status;
+}
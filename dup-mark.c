@@ -0,0 +1,800 @@
+/***************************************************************************
+ *  Description:
+ *      Streaming duplicate marking of coordinate-sorted alignments.
+ *      Single reads are grouped by chromosome, unclipped 5' position,
+ *      and strand, and pairs by those of both ends.  Records wait in an
+ *      input-order queue until no later read can join their group, then
+ *      are written with 0x400 set on all but the read or pair with the
+ *      highest sum of base qualities.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+void    dup_mark_init(dup_mark_t *dm, FILE *out)
+
+{
+    memset(dm, 0, sizeof(*dm));
+    feature_index_init(&dm->mate_chroms);
+    dm->out = out;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the 1-based unclipped 5' position of an alignment: the
+ *      start less leading clips for forward reads, or the end plus
+ *      trailing clips for reverse reads.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t dup_unclipped_5prime(unsigned flag, int64_t pos, const char *cigar)
+
+{
+    const char  *p;
+    char        *end;
+    int64_t     len, lead = 0, trail = 0;
+    bool        aligned = false;
+
+    for (p = cigar; isdigit((unsigned char)*p); p = end + 1)
+    {
+	len = strtoll(p, &end, 10);
+	if ( *end == '\0' )
+	    break;
+	if ( (*end == 'S') || (*end == 'H') )
+	{
+	    if ( aligned )
+		trail += len;
+	    else
+		lead += len;
+	}
+	else
+	    aligned = true;
+    }
+    if ( flag & BL_SAM_FLAG_REVERSE )
+	return pos + cigar_ref_len(cigar) - 1 + trail;
+    else
+	return pos - lead;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return a 64-bit FNV-1a hash of a read name.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+uint64_t    dup_qname_hash(const char *qname)
+
+{
+    uint64_t    hash = 0xcbf29ce484222325ULL;
+
+    for (; *qname != '\0'; ++qname)
+	hash = (hash ^ (unsigned char)*qname) * 0x100000001b3ULL;
+    return hash;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the table position of key, which is either its group or
+ *      the empty slot where it belongs.  Table size is a power of 2.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  dup_group_find(dup_mark_t *dm, dup_key_t *key)
+
+{
+    size_t      mask = dm->table_size - 1, pos;
+    dup_group_t *g;
+
+    pos = ((((uint64_t)key->pos5 * 0x9e3779b97f4a7c15ULL) ^
+	    (uint64_t)key->mate_pos ^ ((uint64_t)key->mate_chrom << 40) ^
+	    ((uint64_t)key->strand << 62) ^ ((uint64_t)key->mate_strand << 63))
+	   * 0x9e3779b97f4a7c15ULL) >> 32 & mask;
+    for (g = &dm->table[pos]; g->used; g = &dm->table[pos])
+    {
+	if ( (g->key.pos5 == key->pos5) && (g->key.mate_pos == key->mate_pos) &&
+	     (g->key.mate_chrom == key->mate_chrom) &&
+	     (g->key.strand == key->strand) &&
+	     (g->key.mate_strand == key->mate_strand) )
+	    break;
+	pos = (pos + 1) & mask;
+    }
+    return pos;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Rebuild the group table with only the groups that still have
+ *      records waiting to be written.  Closed groups are never looked
+ *      up again, so they are dropped here rather than deleted one at a
+ *      time.  The table is sized for 4 times the live groups.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    dup_group_rebuild(dup_mark_t *dm)
+
+{
+    dup_group_t *old_table = dm->table;
+    size_t      old_size = dm->table_size, live = 0, c;
+
+    for (c = 0; c < old_size; ++c)
+	if ( old_table[c].used && (old_table[c].pending > 0) )
+	    ++live;
+    for (dm->table_size = DUP_MARK_HASH_START_SIZE;
+	 dm->table_size < live * 4; dm->table_size *= 2)
+	;
+    dm->table = xt_malloc(dm->table_size, sizeof(*dm->table));
+    if ( dm->table == NULL )
+    {
+	fputs("dup_group_rebuild(): Could not allocate table.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    memset(dm->table, 0, dm->table_size * sizeof(*dm->table));
+    for (c = 0; c < old_size; ++c)
+	if ( old_table[c].used && (old_table[c].pending > 0) )
+	    dm->table[dup_group_find(dm, &old_table[c].key)] = old_table[c];
+    dm->used = live;
+    free(old_table);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the group for key, adding an empty one if it is new.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+dup_group_t *dup_group_get(dup_mark_t *dm, dup_key_t *key)
+
+{
+    dup_group_t *g;
+
+    // Keep the load factor at most 1/2, including closed groups
+    if ( (dm->used + 1) * 2 > dm->table_size )
+	dup_group_rebuild(dm);
+    g = &dm->table[dup_group_find(dm, key)];
+    if ( !g->used )
+    {
+	memset(g, 0, sizeof(*g));
+	g->used = true;
+	g->key = *key;
+	++dm->used;
+    }
+    return g;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Make the read or pair seq the best of group g if its score is
+ *      higher than any so far.  Ties go to the first scored.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+void    dup_group_score(dup_group_t *g, uint64_t seq, uint64_t score)
+
+{
+    if ( !g->scored || (score > g->best_score) )
+    {
+	g->best_seq = seq;
+	g->best_score = score;
+	g->scored = true;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return a free record at the tail of the queue, doubling the ring
+ *      if it is full.  Slots keep their line buffers for reuse.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+dup_entry_t *dup_queue_tail(dup_mark_t *dm)
+
+{
+    dup_entry_t *old_queue = dm->queue;
+    size_t      old_size = dm->queue_size, c;
+
+    if ( dm->count == dm->queue_size )
+    {
+	dm->queue_size = old_size == 0 ? DUP_MARK_QUEUE_START_SIZE :
+			 old_size * 2;
+	dm->queue = xt_malloc(dm->queue_size, sizeof(*dm->queue));
+	if ( dm->queue == NULL )
+	{
+	    fputs("dup_queue_tail(): Could not allocate queue.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	memset(dm->queue, 0, dm->queue_size * sizeof(*dm->queue));
+	for (c = 0; c < old_size; ++c)
+	    dm->queue[c] = old_queue[(dm->head + c) % old_size];
+	dm->head = 0;
+	free(old_queue);
+    }
+    return &dm->queue[(dm->head + dm->count) % dm->queue_size];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the queued record with sequence number seq, or NULL if it
+ *      has been written.  Sequence numbers are consecutive from the head.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+dup_entry_t *dup_queue_entry(dup_mark_t *dm, uint64_t seq)
+
+{
+    uint64_t    head_seq;
+
+    if ( dm->count == 0 )
+	return NULL;
+    head_seq = dm->queue[dm->head].seq;
+    if ( (seq < head_seq) || (seq - head_seq >= dm->count) )
+	return NULL;
+    return &dm->queue[(dm->head + (seq - head_seq)) % dm->queue_size];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the position in the mate table of the first mate named
+ *      qname that is still waiting, or the empty slot where it belongs.
+ *      Slots of mates already found are skipped until the next rebuild.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+size_t  dup_mate_find(dup_mark_t *dm, const char *qname)
+
+{
+    size_t      mask = dm->mates_size - 1, pos;
+    dup_entry_t *e;
+
+    pos = dup_qname_hash(qname) >> 32 & mask;
+    for (; dm->mates[pos] != 0; pos = (pos + 1) & mask)
+    {
+	e = dup_queue_entry(dm, dm->mates[pos] - 1);
+	if ( (e != NULL) && e->open &&
+	     (strcmp(SAM_RECORD_FIELD(&e->rec, SAM_RECORD_QNAME), qname) == 0) )
+	    break;
+    }
+    return pos;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Rebuild the mate table with only the first mates still waiting,
+ *      sized for 4 times as many.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+void    dup_mate_rebuild(dup_mark_t *dm)
+
+{
+    uint64_t    *old_mates = dm->mates;
+    size_t      old_size = dm->mates_size, live = 0, c;
+    dup_entry_t *e;
+
+    for (c = 0; c < old_size; ++c)
+	if ( (old_mates[c] != 0) &&
+	     ((e = dup_queue_entry(dm, old_mates[c] - 1)) != NULL) && e->open )
+	    old_mates[live++] = old_mates[c];
+    for (dm->mates_size = DUP_MARK_HASH_START_SIZE;
+	 dm->mates_size < live * 4; dm->mates_size *= 2)
+	;
+    if ( (dm->mates = calloc(dm->mates_size, sizeof(*dm->mates))) == NULL )
+    {
+	fputs("dup_mate_rebuild(): Could not allocate table.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0; c < live; ++c)
+    {
+	e = dup_queue_entry(dm, old_mates[c] - 1);
+	dm->mates[dup_mate_find(dm, SAM_RECORD_FIELD(&e->rec,
+			SAM_RECORD_QNAME))] = old_mates[c];
+    }
+    dm->mates_used = live;
+    free(old_mates);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Stop first mate waiting and score its pair, which is worth
+ *      score, in its group.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+void    dup_mate_close(dup_mark_t *dm, dup_entry_t *first, uint64_t score)
+
+{
+    dup_group_t *g;
+
+    first->open = false;
+    g = &dm->table[dup_group_find(dm, &first->key)];
+    --g->open;
+    dup_group_score(g, first->pair_seq, score);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Give up on the mates of waiting first mates whose mate position
+ *      is before pos, which cannot arrive in sorted input.  Such pairs
+ *      are scored by the first mate alone.  This happens when a mate
+ *      has been filtered out or failed QC.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+void    dup_mark_orphans(dup_mark_t *dm, int64_t pos)
+
+{
+    dup_entry_t *e;
+    size_t      c;
+
+    for (c = 0; c < dm->mates_size; ++c)
+	if ( (dm->mates[c] != 0) &&
+	     ((e = dup_queue_entry(dm, dm->mates[c] - 1)) != NULL) &&
+	     e->open && (e->rec.pnext < pos) )
+	    dup_mate_close(dm, e, e->score);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write records from the head of the queue whose groups cannot
+ *      change, i.e. whose 5' position is at most limit and which have
+ *      no pairs waiting for a mate.  The best read or pair of each
+ *      group is written without 0x400 and the others with it, so both
+ *      mates of a pair are always flagged alike.  A limit of INT64_MAX
+ *      ends the chromosome, writing everything.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    dup_mark_flush(dup_mark_t *dm, int64_t limit)
+
+{
+    dup_entry_t *e;
+    dup_group_t *g;
+
+    if ( limit == INT64_MAX )
+	dup_mark_orphans(dm, INT64_MAX);
+    while ( dm->count > 0 )
+    {
+	e = &dm->queue[dm->head];
+	if ( e->keyed )
+	{
+	    if ( e->open )
+		break;
+	    g = &dm->table[dup_group_find(dm, &e->key)];
+	    if ( (g->key.pos5 > limit) || (g->open > 0) )
+		break;
+	    if ( g->best_seq == e->pair_seq )
+		e->rec.flag &= ~BL_SAM_FLAG_DUP;
+	    else
+	    {
+		e->rec.flag |= BL_SAM_FLAG_DUP;
+		++dm->duplicates;
+	    }
+	    --g->pending;
+	}
+	sam_record_write(&e->rec, dm->out);
+	dm->head = (dm->head + 1) % dm->queue_size;
+	--dm->count;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Key a pair by its two unclipped 5' ends, lower end first so that
+ *      both mates produce the same key.  The mate's end comes from its
+ *      CIGAR in the MC tag if present, or else is approximated by PNEXT.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+void    dup_pair_key(dup_key_t *key, sam_record_t *rec)
+
+{
+    const char  *mate_cigar;
+    int64_t     pos5;
+    char        strand;
+
+    key->mate_strand = (rec->flag & BL_SAM_FLAG_MREVERSE) != 0;
+    if ( ((mate_cigar = sam_record_tag(rec, "MC")) != NULL) &&
+	 isdigit((unsigned char)*mate_cigar) )
+	key->mate_pos = dup_unclipped_5prime(key->mate_strand ?
+				BL_SAM_FLAG_REVERSE : 0, rec->pnext, mate_cigar);
+    else
+	key->mate_pos = rec->pnext;
+    if ( (key->mate_chrom == 0) &&
+	 ((key->mate_pos < key->pos5) ||
+	  ((key->mate_pos == key->pos5) && (key->mate_strand < key->strand))) )
+    {
+	pos5 = key->pos5;
+	key->pos5 = key->mate_pos;
+	key->mate_pos = pos5;
+	strand = key->strand;
+	key->strand = key->mate_strand;
+	key->mate_strand = strand;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add the record just read at the queue tail to its group.
+ *      Unmapped, secondary, supplementary, and QC failed records pass
+ *      through unmarked.
+ *
+ *      Pairs with both mates mapped within DUP_MARK_MAX_INSERT on this
+ *      chromosome are scored together: the first mate waits, unscored,
+ *      until its mate arrives and the pair's score is the sum of both.
+ *      Mates further apart are grouped by their own end and are never
+ *      seen together, especially by separate threads, so the survivor
+ *      of each group is chosen by a hash of QNAME, which both ends
+ *      compute alike.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    dup_mark_add(dup_mark_t *dm, dup_entry_t *e)
+
+{
+    sam_record_t    *rec = &e->rec;
+    dup_entry_t     *first;
+    dup_group_t     *g;
+    const char      *rnext, *qname, *q;
+    uint64_t        score = 0;
+    size_t          slot;
+    bool            near;
+
+    e->seq = e->pair_seq = dm->next_seq++;
+    e->open = false;
+    e->keyed = !(rec->flag & (BL_SAM_FLAG_UNMAP | BL_SAM_FLAG_SECONDARY |
+			      BL_SAM_FLAG_SUPPLEMENTARY | BL_SAM_FLAG_QCFAIL));
+    ++dm->count;
+    qname = SAM_RECORD_FIELD(rec, SAM_RECORD_QNAME);
+    rnext = SAM_RECORD_FIELD(rec, SAM_RECORD_RNEXT);
+    near = (rec->flag & BL_SAM_FLAG_PAIRED) &&
+	   !(rec->flag & (BL_SAM_FLAG_MUNMAP | BL_SAM_FLAG_SECONDARY |
+			  BL_SAM_FLAG_SUPPLEMENTARY)) &&
+	   ((strcmp(rnext, "=") == 0) ||
+	    (strcmp(rnext, SAM_RECORD_FIELD(rec, SAM_RECORD_RNAME)) == 0)) &&
+	   (llabs(rec->pnext - rec->pos) <= DUP_MARK_MAX_INSERT);
+
+    // A waiting first mate is completed even by a mate passed through
+    first = NULL;
+    if ( near )
+    {
+	slot = dup_mate_find(dm, qname);
+	if ( dm->mates[slot] != 0 )
+	    first = dup_queue_entry(dm, dm->mates[slot] - 1);
+    }
+    if ( !e->keyed )
+    {
+	if ( first != NULL )
+	    dup_mate_close(dm, first, first->score);
+	return;
+    }
+
+    for (q = SAM_RECORD_FIELD(rec, SAM_RECORD_QUAL); *q != '\0'; ++q)
+	score += *q - 33;
+    if ( strcmp(SAM_RECORD_FIELD(rec, SAM_RECORD_QUAL), "*") == 0 )
+	score = 0;
+    ++dm->keyed;
+
+    if ( first != NULL )
+    {
+	e->key = first->key;
+	e->pair_seq = first->seq;
+	dup_mate_close(dm, first, first->score + score);
+	++dm->table[dup_group_find(dm, &e->key)].pending;
+	return;
+    }
+
+    memset(&e->key, 0, sizeof(e->key));
+    e->key.pos5 = dup_unclipped_5prime(rec->flag, rec->pos,
+				       SAM_RECORD_FIELD(rec, SAM_RECORD_CIGAR));
+    e->key.strand = (rec->flag & BL_SAM_FLAG_REVERSE) != 0;
+    if ( near )
+	e->key.mate_chrom = 0;
+    else if ( (rec->flag & BL_SAM_FLAG_PAIRED) &&
+	      !(rec->flag & BL_SAM_FLAG_MUNMAP) )
+    {
+	// Distant mates on this chromosome are numbered like other chroms
+	e->key.mate_chrom = feature_index_add_chrom(&dm->mate_chroms,
+			strcmp(rnext, "=") == 0 ?
+			SAM_RECORD_FIELD(rec, SAM_RECORD_RNAME) : rnext, 0) + 1;
+	score = dup_qname_hash(qname);
+    }
+    else
+	e->key.mate_chrom = -1;
+    if ( e->key.mate_chrom != -1 )
+	dup_pair_key(&e->key, rec);
+
+    g = dup_group_get(dm, &e->key);
+    ++g->pending;
+    if ( near && (rec->pnext >= rec->pos) )
+    {
+	// Wait for the mate, which is later in sorted input
+	e->open = true;
+	e->score = score;
+	++g->open;
+	if ( (dm->mates_used + 1) * 2 > dm->mates_size )
+	    dup_mate_rebuild(dm);
+	dm->mates[dup_mate_find(dm, qname)] = e->seq + 1;
+	++dm->mates_used;
+    }
+    else
+	// Unpaired, distant, or a mate that never arrived
+	dup_group_score(g, e->seq, score);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Mark duplicates in a sorted SAM stream positioned after the
+ *      header, writing every record to dm->out in input order.  Records
+ *      are held until the sweep is DUP_MARK_WINDOW bases past their
+ *      group's 5' position and every pair in the group has both mates,
+ *      which bounds memory by the read depth over the window or insert
+ *      size rather than the chromosome.  Forward reads with more than
+ *      DUP_MARK_WINDOW leading clipped bases may miss a group.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, BL_READ_BAD_DATA if the input is not
+ *      sorted, or another read status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     dup_mark_scan(dup_mark_t *dm, FILE *sam_stream)
+
+{
+    dup_entry_t *e;
+    int         status;
+
+    while ( (status = sam_record_read(&(e = dup_queue_tail(dm))->rec,
+				      sam_stream)) == BL_READ_OK )
+    {
+	++dm->records;
+	if ( (dm->chrom == NULL) ||
+	     (strcmp(dm->chrom, SAM_RECORD_FIELD(&e->rec, SAM_RECORD_RNAME))
+	      != 0) )
+	{
+	    // Nothing carries over to a new chromosome
+	    dup_mark_flush(dm, INT64_MAX);
+	    free(dm->chrom);
+	    dm->chrom = strdup(SAM_RECORD_FIELD(&e->rec, SAM_RECORD_RNAME));
+	    dup_group_rebuild(dm);
+	    dup_mate_rebuild(dm);
+	}
+	else if ( e->rec.pos < dm->last_pos )
+	{
+	    fprintf(stderr, "dup_mark_scan(): Alignments are not sorted: "
+		    "%s %" PRId64 "\n", dm->chrom, e->rec.pos);
+	    status = BL_READ_BAD_DATA;
+	    break;
+	}
+	dm->last_pos = e->rec.pos;
+	// Flushing advances the head but leaves e at the tail
+	dup_mark_flush(dm, e->rec.pos - DUP_MARK_WINDOW - 1);
+	dup_mark_add(dm, e);
+	if ( dm->count == dm->queue_size )
+	{
+	    // Before growing the queue, release pairs missing a mate
+	    dup_mark_orphans(dm, dm->last_pos);
+	    dup_mark_flush(dm, dm->last_pos - DUP_MARK_WINDOW - 1);
+	}
+    }
+    if ( status == BL_READ_EOF )
+	dup_mark_flush(dm, INT64_MAX);
+    return status;
+}
+
+
+void    dup_mark_free(dup_mark_t *dm)
+
+{
+    size_t  c;
+
+    for (c = 0; c < dm->queue_size; ++c)
+	sam_record_free(&dm->queue[c].rec);
+    free(dm->queue);
+    free(dm->table);
+    free(dm->mates);
+    free(dm->chrom);
+    feature_index_free(&dm->mate_chroms);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Mark duplicates in each chromosome assigned to this thread,
+ *      writing it to its own temp file from an indexed samtools query.
+ *      Chromosomes are assigned round-robin as in jaccard_matrix().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    *dup_mark_thread(void *arg)
+
+{
+    dup_mark_thread_t   *dt = arg;
+    dup_mark_t          dm;
+    char                cmd[PEAK_CMD_MAX + 1];
+    FILE                *stream;
+    size_t              c;
+    int                 status;
+
+    for (c = dt->first_chrom; c < dt->chrom_count; c += dt->chrom_step)
+    {
+	snprintf(cmd, PEAK_CMD_MAX, "samtools view %s '%s'",
+		 dt->alignments_filename, dt->chroms[c]);
+	if ( ((stream = popen(cmd, "r")) == NULL) ||
+	     ((dt->outputs[c] = tmpfile()) == NULL) )
+	{
+	    fprintf(stderr, "dup_mark_thread(): Cannot read %s.\n", dt->chroms[c]);
+	    dt->status = BL_READ_UNKNOWN_FORMAT;
+	    return NULL;
+	}
+	dup_mark_init(&dm, dt->outputs[c]);
+	status = dup_mark_scan(&dm, stream);
+	pclose(stream);
+	dt->records += dm.records;
+	dt->keyed += dm.keyed;
+	dt->duplicates += dm.duplicates;
+	dup_mark_free(&dm);
+	if ( status != BL_READ_EOF )
+	{
+	    dt->status = status;
+	    return NULL;
+	}
+    }
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Mark duplicates one chromosome per thread, then write the header
+ *      and the chromosomes in header order, followed by unplaced reads
+ *      (samtools region "*").  chroms must include "*" last.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, or another BL_READ_ status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     dup_mark_parallel(const char *alignments_filename, char **chroms,
+			  size_t chrom_count, unsigned threads, FILE *out,
+			  dup_mark_t *totals)
+
+{
+    dup_mark_thread_t   thread_args[PC_MAX_THREADS];
+    pthread_t           thread_ids[PC_MAX_THREADS];
+    FILE                **outputs;
+    size_t              c;
+    unsigned            t;
+    int                 status = BL_READ_EOF;
+
+    if ( (outputs = calloc(chrom_count, sizeof(*outputs))) == NULL )
+    {
+	fputs("dup_mark_parallel(): Could not allocate chromosomes.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    if ( threads > chrom_count )
+	threads = chrom_count;
+    for (t = 0; t < threads; ++t)
+    {
+	memset(&thread_args[t], 0, sizeof(thread_args[t]));
+	thread_args[t].alignments_filename = alignments_filename;
+	thread_args[t].chroms = chroms;
+	thread_args[t].outputs = outputs;
+	thread_args[t].chrom_count = chrom_count;
+	thread_args[t].first_chrom = t;
+	thread_args[t].chrom_step = threads;
+	thread_args[t].status = BL_READ_EOF;
+	if ( pthread_create(&thread_ids[t], NULL, dup_mark_thread,
+			    &thread_args[t]) != 0 )
+	{
+	    fputs("dup_mark_parallel(): pthread_create() failed.\n", stderr);
+	    exit(EX_OSERR);
+	}
+    }
+    for (t = 0; t < threads; ++t)
+    {
+	pthread_join(thread_ids[t], NULL);
+	if ( thread_args[t].status != BL_READ_EOF )
+	    status = thread_args[t].status;
+	totals->records += thread_args[t].records;
+	totals->keyed += thread_args[t].keyed;
+	totals->duplicates += thread_args[t].duplicates;
+    }
+
+    if ( (status == BL_READ_EOF) &&
+	 (sam_header_copy(alignments_filename, out) != EX_OK) )
+	status = BL_READ_UNKNOWN_FORMAT;
+    for (c = 0; c < chrom_count; ++c)
+    {
+	if ( outputs[c] == NULL )
+	    continue;
+	if ( status == BL_READ_EOF )
+	    sam_tmpfile_append(outputs[c], out);
+	else
+	    fclose(outputs[c]);
+    }
+    free(outputs);
+    return status;
+}
@@ -0,0 +1,291 @@
+/***************************************************************************
+ *  Description:
+ *      Permutation test for enrichment of peaks in each feature class.
+ *      Each permutation places every peak at a random position on its
+ *      own chromosome, preserving its width and avoiding optional
+ *      excluded regions, and classifies it against the resident feature
+ *      index.  Permutations are never written to disk.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+typedef struct
+{
+    feature_index_t *fi;
+    feature_index_t *exclude;
+    size_t          *exclude_chrom; // exclude chromosome of each fi chromosome
+    peak_set_t      *peaks;
+    overlap_params_t *params;
+    uint64_t        seed;
+    size_t          first_perm,
+		    last_perm;
+    size_t          counts_per_perm;
+    int64_t         *counts;    // [perm][class], class_count + 1 per perm
+    size_t          failed;     // Placements skipped within exclusions
+}   enrich_thread_t;
+
+/***************************************************************************
+ *  Description:
+ *      splitmix64 generator.  xt_shuffle() and random() share global
+ *      state, so each permutation carries its own generator instead.
+ *      This also makes results independent of the number of threads.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+uint64_t    pc_random(uint64_t *state)
+
+{
+    uint64_t    z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return a random start position for a peak of the given width on
+ *      chromosome chrom, avoiding excluded regions on exclude_chrom.
+ *      Peaks on chromosomes of unknown size stay where they are.
+ *
+ *  Returns:
+ *      The new start, or -1 if every one of ENRICH_MAX_TRIES positions
+ *      overlapped an excluded region
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t random_placement(feature_index_t *fi, feature_index_t *exclude,
+			 size_t chrom, size_t exclude_chrom, int64_t start,
+			 int64_t width, uint64_t *rng, hit_list_t *hits)
+
+{
+    int64_t     size = fi->chroms[chrom].size,
+		new_start;
+    int         tries;
+
+    if ( size <= width )
+	return start;
+    for (tries = 0; tries < ENRICH_MAX_TRIES; ++tries)
+    {
+	new_start = pc_random(rng) % (uint64_t)(size - width + 1);
+	if ( (exclude == NULL) ||
+	     (feature_index_overlaps(exclude, exclude_chrom, new_start,
+				     new_start + width, hits) == 0) )
+	    return new_start;
+    }
+    return -1;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Thread body: run permutations first_perm through last_perm - 1.
+ *      Peaks that cannot be placed outside excluded regions are left out
+ *      of their permutation rather than counted inside an exclusion.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    *enrich_thread(void *arg)
+
+{
+    enrich_thread_t *et = arg;
+    peak_set_t      *peaks = et->peaks;
+    hit_list_t      hits = HIT_LIST_INIT;
+    size_t          perm, c;
+    int64_t         *counts, width, start;
+    uint64_t        rng;
+    unsigned        class_id;
+
+    for (perm = et->first_perm; perm < et->last_perm; ++perm)
+    {
+	counts = et->counts + perm * et->counts_per_perm;
+	rng = et->seed ^ (perm * 0xd1b54a32d192ed03ULL);
+	for (c = 0; c < peaks->count; ++c)
+	{
+	    width = peaks->end[c] - peaks->start[c];
+	    start = random_placement(et->fi, et->exclude, peaks->chrom[c],
+				     et->exclude_chrom == NULL ? 0 :
+					et->exclude_chrom[peaks->chrom[c]],
+				     peaks->start[c], width, &rng, &hits);
+	    if ( start < 0 )
+	    {
+		++et->failed;
+		continue;
+	    }
+	    class_id = feature_index_classify(et->fi, peaks->chrom[c],
+				start, start + width, et->params, &hits, NULL);
+	    if ( class_id == FEATURE_CLASS_NONE )
+		++counts[et->fi->class_count];
+	    else
+		++counts[class_id];
+	}
+    }
+    hit_list_free(&hits);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify the observed peaks, run permutations across threads,
+ *      and report observed/expected ratios and empirical one-sided
+ *      p-values for each class.  The p-values include the observed
+ *      set as one permutation, (1 + hits) / (1 + permutations), so they
+ *      are never 0.  If cov is not NULL, the fraction of the genome in
+ *      each class is reported as well.  A warning reports how many random
+ *      placements were skipped because they could not avoid exclude.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     enrichment_test(feature_index_t *fi, feature_index_t *exclude,
+			peak_set_t *peaks, class_coverage_t *cov,
+			overlap_params_t *params,
+			size_t permutations, unsigned threads, uint64_t seed,
+			FILE *outfile)
+
+{
+    enrich_thread_t thread_args[PC_MAX_THREADS];
+    pthread_t       thread_ids[PC_MAX_THREADS];
+    hit_list_t      hits = HIT_LIST_INIT;
+    size_t          per_class = fi->class_count + 1,
+		    c, perm, perms_per_thread, failed = 0,
+		    *exclude_chrom = NULL;
+    int64_t         *observed, *counts, greater, less;
+    double          expected;
+    unsigned        t, class_id;
+
+    observed = xt_malloc(per_class, sizeof(*observed));
+    counts = xt_malloc(permutations * per_class, sizeof(*counts));
+    if ( (observed == NULL) || (counts == NULL) )
+    {
+	fputs("enrichment_test(): Could not allocate counts.\n", stderr);
+	return EX_UNAVAILABLE;
+    }
+    memset(observed, 0, per_class * sizeof(*observed));
+    memset(counts, 0, permutations * per_class * sizeof(*counts));
+
+    // Chromosome numbers differ between the indexes, so map them once
+    if ( exclude != NULL )
+    {
+	if ( (exclude_chrom = xt_malloc(fi->chrom_count + 1,
+					sizeof(*exclude_chrom))) == NULL )
+	{
+	    fputs("enrichment_test(): Could not allocate chromosomes.\n", stderr);
+	    free(observed);
+	    free(counts);
+	    return EX_UNAVAILABLE;
+	}
+	for (c = 0; c < fi->chrom_count; ++c)
+	    exclude_chrom[c] = feature_index_find_chrom(exclude,
+					fi->chroms[c].name, c);
+    }
+
+    for (c = 0; c < peaks->count; ++c)
+    {
+	class_id = feature_index_classify(fi, peaks->chrom[c], peaks->start[c],
+					  peaks->end[c], params, &hits, NULL);
+	++observed[class_id == FEATURE_CLASS_NONE ? fi->class_count : class_id];
+    }
+    hit_list_free(&hits);
+
+    if ( threads > permutations )
+	threads = permutations == 0 ? 1 : permutations;
+    perms_per_thread = (permutations + threads - 1) / threads;
+    fprintf(stderr, "Running %zu permutations on %u threads...\n",
+	    permutations, threads);
+    for (t = 0; t < threads; ++t)
+    {
+	thread_args[t].fi = fi;
+	thread_args[t].exclude = exclude;
+	thread_args[t].exclude_chrom = exclude_chrom;
+	thread_args[t].peaks = peaks;
+	thread_args[t].params = params;
+	thread_args[t].seed = seed;
+	thread_args[t].first_perm = XT_MIN(t * perms_per_thread, permutations);
+	thread_args[t].last_perm = XT_MIN((t + 1) * perms_per_thread, permutations);
+	thread_args[t].counts_per_perm = per_class;
+	thread_args[t].counts = counts;
+	thread_args[t].failed = 0;
+	if ( pthread_create(&thread_ids[t], NULL, enrich_thread,
+			    &thread_args[t]) != 0 )
+	{
+	    fputs("enrichment_test(): pthread_create() failed.\n", stderr);
+	    // Threads already started use the counts
+	    while ( t-- > 0 )
+		pthread_join(thread_ids[t], NULL);
+	    free(exclude_chrom);
+	    free(observed);
+	    free(counts);
+	    return EX_OSERR;
+	}
+    }
+    for (t = 0; t < threads; ++t)
+    {
+	pthread_join(thread_ids[t], NULL);
+	failed += thread_args[t].failed;
+    }
+    if ( failed > 0 )
+	fprintf(stderr, "peak-classifier: Warning: %zu of %zu random placements "
+		"overlapped excluded regions\nin all %d tries and were skipped.\n",
+		failed, peaks->count * permutations, ENRICH_MAX_TRIES);
+
+    fprintf(outfile, "#Class\tObserved\tExpected\tObs/Exp\tP-enriched\tP-depleted%s\n",
+	    cov == NULL ? "" : "\tGenome-fraction");
+    for (c = 0; c < per_class; ++c)
+    {
+	expected = 0.0;
+	greater = less = 0;
+	for (perm = 0; perm < permutations; ++perm)
+	{
+	    expected += counts[perm * per_class + c];
+	    if ( counts[perm * per_class + c] >= observed[c] )
+		++greater;
+	    if ( counts[perm * per_class + c] <= observed[c] )
+		++less;
+	}
+	if ( permutations > 0 )
+	    expected /= permutations;
+	if ( (observed[c] == 0) && (expected == 0.0) )
+	    continue;
+	fprintf(outfile, "%s\t%" PRId64 "\t%.2f\t%.4f\t%.4g\t%.4g",
+		feature_index_class_name(fi, c == fi->class_count ?
+					 FEATURE_CLASS_NONE : c),
+		observed[c], expected,
+		expected > 0.0 ? observed[c] / expected : 0.0,
+		(1.0 + greater) / (1.0 + permutations),
+		(1.0 + less) / (1.0 + permutations));
+	if ( cov != NULL )
+	    fprintf(outfile, "\t%.6f",
+		    class_coverage_fraction(cov, cov->priority_bp[c]));
+	putc('\n', outfile);
+    }
+    free(exclude_chrom);
+    free(observed);
+    free(counts);
+    return EX_OK;
+}
@@ -0,0 +1,1016 @@
+/***************************************************************************
+ *  Description:
+ *      In-memory index of the augmented feature BED, so that peaks can be
+ *      classified without piping through bedtools intersect.  Features
+ *      are stored in parallel arrays sorted by chromosome and start, with
+ *      an implicit augmented interval tree (max_end) per chromosome.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Initialize an empty feature index.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    feature_index_init(feature_index_t *fi)
+
+{
+    feature_index_t init = FEATURE_INDEX_INIT;
+
+    *fi = init;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Set the feature classes from a comma-separated priority list, e.g.
+ *      "five_prime_utr,three_prime_utr,intron,exon,upstream1000".
+ *      Must be called before feature_index_load() so that each feature
+ *      can be assigned a class as it is read.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK or FEATURE_INDEX_BAD_DATA if the list is too long
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     feature_index_set_classes(feature_index_t *fi, const char *priority_list)
+
+{
+    char    *list, *p, *class;
+
+    if ( (list = strdup(priority_list)) == NULL )
+	return FEATURE_INDEX_BAD_DATA;
+    fi->class_count = 0;
+    fi->beyond_class = FEATURE_CLASS_NONE;
+    for (p = list; (class = strsep(&p, ",")) != NULL; )
+    {
+	if ( *class == '\0' )
+	    continue;
+	if ( fi->class_count == FEATURE_CLASS_MAX )
+	{
+	    fprintf(stderr, "feature_index_set_classes(): More than %d classes.\n",
+		    FEATURE_CLASS_MAX);
+	    free(list);
+	    return FEATURE_INDEX_BAD_DATA;
+	}
+	if ( strcasecmp(class, FEATURE_CLASS_BEYOND) == 0 )
+	    fi->beyond_class = fi->class_count;
+	fi->class_names[fi->class_count++] = strdup(class);
+    }
+    free(list);
+    return FEATURE_INDEX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Build the default priority list matching the features generated
+ *      by gff_augment(): UTRs, intron, exon, each upstream region from
+ *      nearest to farthest, and finally upstream-beyond.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    default_priority_list(char *list, size_t list_size,
+			      const char *upstream_boundaries)
+
+{
+    bl_pos_list_t   pos_list = BL_POS_LIST_INIT;
+    size_t          c, len;
+
+    bl_pos_list_from_csv(&pos_list, upstream_boundaries, MAX_UPSTREAM_BOUNDARIES);
+    bl_pos_list_sort(&pos_list, BL_POS_LIST_ASCENDING);
+    len = snprintf(list, list_size, "five_prime_utr,three_prime_utr,intron,exon");
+    for (c = 0; (c < BL_POS_LIST_COUNT(&pos_list)) && (len < list_size); ++c)
+	len += snprintf(list + len, list_size - len, ",upstream%" PRId64,
+			BL_POS_LIST_POSITIONS_AE(&pos_list, c));
+    if ( len < list_size )
+	snprintf(list + len, list_size - len, "," FEATURE_CLASS_BEYOND);
+    bl_pos_list_free(&pos_list);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the class ID for a feature name of the form
+ *      "type;Name;ID", or FEATURE_CLASS_NONE if type is not one of
+ *      the prioritized classes.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+unsigned char   feature_index_class_id(feature_index_t *fi, const char *name)
+
+{
+    size_t      c, len;
+    const char  *semicolon;
+
+    if ( (semicolon = strchr(name, ';')) == NULL )
+	len = strlen(name);
+    else
+	len = semicolon - name;
+    for (c = 0; c < fi->class_count; ++c)
+	if ( (strncasecmp(name, fi->class_names[c], len) == 0) &&
+	     (fi->class_names[c][len] == '\0') )
+	    return c;
+    return FEATURE_CLASS_NONE;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the name of a class ID, including FEATURE_CLASS_NONE.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+const char  *feature_index_class_name(feature_index_t *fi, unsigned class_id)
+
+{
+    if ( class_id < fi->class_count )
+	return fi->class_names[class_id];
+    return FEATURE_CLASS_NONE_NAME;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Look up a chromosome by name.  Peaks and features are sorted by
+ *      chromosome, so the previous match is checked first.
+ *
+ *  Returns:
+ *      Index into fi->chroms, or fi->chrom_count if not found
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  feature_index_find_chrom(feature_index_t *fi, const char *chrom,
+				 size_t hint)
+
+{
+    size_t  c;
+
+    if ( (hint < fi->chrom_count) && (strcmp(fi->chroms[hint].name, chrom) == 0) )
+	return hint;
+    for (c = 0; c < fi->chrom_count; ++c)
+	if ( strcmp(fi->chroms[c].name, chrom) == 0 )
+	    return c;
+    return fi->chrom_count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Look up a chromosome, adding an empty entry if it is not present.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  feature_index_add_chrom(feature_index_t *fi, const char *chrom,
+				size_t hint)
+
+{
+    size_t      c;
+    fi_chrom_t  *new_chrom;
+
+    if ( (c = feature_index_find_chrom(fi, chrom, hint)) < fi->chrom_count )
+	return c;
+
+    if ( fi->chrom_count == fi->chrom_array_size )
+    {
+	fi->chrom_array_size = fi->chrom_array_size == 0 ? 64 :
+			       fi->chrom_array_size * 2;
+	fi->chroms = xt_realloc(fi->chroms, fi->chrom_array_size,
+				sizeof(*fi->chroms));
+	if ( fi->chroms == NULL )
+	{
+	    fputs("feature_index_add_chrom(): Could not allocate chroms.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    new_chrom = &fi->chroms[fi->chrom_count];
+    new_chrom->name = strdup(chrom);
+    new_chrom->first = fi->count;
+    new_chrom->count = 0;
+    new_chrom->size = 0;
+    new_chrom->root_level = -1;
+    return fi->chrom_count++;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append a feature to the index.  Features must be added one
+ *      chromosome at a time.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    feature_index_add(feature_index_t *fi, size_t chrom, int64_t start,
+			  int64_t end, const char *name, char strand)
+
+{
+    fi_chrom_t  *ch = &fi->chroms[chrom];
+
+    if ( fi->count == fi->array_size )
+    {
+	fi->array_size = fi->array_size == 0 ? FEATURE_INDEX_START_SIZE :
+			 fi->array_size * 2;
+	fi->start = xt_realloc(fi->start, fi->array_size, sizeof(*fi->start));
+	fi->end = xt_realloc(fi->end, fi->array_size, sizeof(*fi->end));
+	fi->max_end = xt_realloc(fi->max_end, fi->array_size, sizeof(*fi->max_end));
+	fi->class_id = xt_realloc(fi->class_id, fi->array_size, sizeof(*fi->class_id));
+	fi->strand = xt_realloc(fi->strand, fi->array_size, sizeof(*fi->strand));
+	fi->name = xt_realloc(fi->name, fi->array_size, sizeof(*fi->name));
+	fi->gene = xt_realloc(fi->gene, fi->array_size, sizeof(*fi->gene));
+	if ( (fi->start == NULL) || (fi->end == NULL) || (fi->max_end == NULL) ||
+	     (fi->class_id == NULL) || (fi->strand == NULL) || (fi->name == NULL) ||
+	     (fi->gene == NULL) )
+	{
+	    fputs("feature_index_add(): Could not allocate features.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    if ( ch->count == 0 )
+	ch->first = fi->count;
+    fi->start[fi->count] = start;
+    fi->end[fi->count] = end;
+    fi->class_id[fi->count] = feature_index_class_id(fi, name);
+    fi->strand[fi->count] = strand;
+    fi->name[fi->count] = strdup(name);
+    fi->gene[fi->count] = FEATURE_GENE_NONE;
+    ++fi->count;
+    ++ch->count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add a gene record for the feature just added, whose name is
+ *      "type;Name;ID" as written by gff_augment().
+ *
+ *  Returns:
+ *      Index of the new gene in fi->genes
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  feature_index_add_gene(feature_index_t *fi, size_t chrom)
+
+{
+    fi_gene_t   *gene;
+    size_t      f = fi->count - 1;
+    char        *name, *id;
+
+    if ( fi->gene_count == fi->gene_array_size )
+    {
+	fi->gene_array_size = fi->gene_array_size == 0 ? 1024 :
+			      fi->gene_array_size * 2;
+	fi->genes = xt_realloc(fi->genes, fi->gene_array_size,
+			       sizeof(*fi->genes));
+	if ( fi->genes == NULL )
+	{
+	    fputs("feature_index_add_gene(): Could not allocate genes.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    gene = &fi->genes[fi->gene_count];
+    if ( (name = strchr(fi->name[f], ';')) == NULL )
+	name = fi->name[f];
+    else
+	++name;
+    if ( (id = strchr(name, ';')) == NULL )
+	id = "";
+    else
+	++id;
+    gene->name = strdup(name);
+    gene->id = strdup(id);
+    if ( (id = strchr(gene->name, ';')) != NULL )
+	*id = '\0';
+    gene->chrom = chrom;
+    gene->start = fi->start[f];
+    gene->end = fi->end[f];
+    gene->strand = fi->strand[f];
+    fi->gene[f] = fi->gene_count;
+    return fi->gene_count++;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Load a BED file into the index.  Lines for each chromosome must be
+ *      contiguous, as in the augmented+sorted BED, but need not be sorted
+ *      by position.  Call feature_index_build() afterward.
+ *
+ *      If track_genes is true, the file must be the unsorted augmented
+ *      BED, where each gene is followed by its subfeatures and upstream
+ *      regions, ending with a "###" line.  Each of these features is
+ *      then linked to its gene through fi->gene[].
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     feature_index_load(feature_index_t *fi, const char *bed_filename,
+			   bool track_genes)
+
+{
+    FILE        *bed_stream;
+    bl_bed_t    bed_feature = BL_BED_INIT;
+    size_t      chrom = 0,
+		gene = FEATURE_GENE_NONE,
+		type_len;
+    int         status, ch;
+    char        *name, save;
+    bool        is_gene;
+
+    if ( (bed_stream = xt_fopen(bed_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "feature_index_load(): Cannot open %s: %s\n",
+		bed_filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    bl_bed_skip_header(bed_stream);
+    while ( true )
+    {
+	// "###" ends a gene block in the augmented BED
+	while ( (ch = getc(bed_stream)) == '#' )
+	{
+	    gene = FEATURE_GENE_NONE;
+	    tsv_skip_rest_of_line(bed_stream);
+	}
+	ungetc(ch, bed_stream);
+	if ( (status = bl_bed_read(&bed_feature, bed_stream, BL_BED_FIELD_ALL))
+		!= BL_READ_OK )
+	    break;
+	chrom = feature_index_add_chrom(fi, BL_BED_CHROM(&bed_feature), chrom);
+	if ( (fi->chroms[chrom].count != 0) &&
+	     (fi->chroms[chrom].first + fi->chroms[chrom].count != fi->count) )
+	{
+	    fprintf(stderr, "feature_index_load(): %s: chromosome %s is not contiguous.\n",
+		    bed_filename, BL_BED_CHROM(&bed_feature));
+	    xt_fclose(bed_stream);
+	    return FEATURE_INDEX_BAD_DATA;
+	}
+	feature_index_add(fi, chrom, BL_BED_CHROM_START(&bed_feature),
+			  BL_BED_CHROM_END(&bed_feature),
+			  BL_BED_FIELDS(&bed_feature) > 3 ?
+			    BL_BED_NAME(&bed_feature) : "",
+			  BL_BED_FIELDS(&bed_feature) > 5 ?
+			    BL_BED_STRAND(&bed_feature) : '.');
+	if ( track_genes )
+	{
+	    // Same test for a gene as gff_augment(), applied to the type
+	    name = fi->name[fi->count - 1];
+	    type_len = strcspn(name, ";");
+	    save = name[type_len];
+	    name[type_len] = '\0';
+	    is_gene = (strstr(name, "gene") != NULL);
+	    name[type_len] = save;
+	    if ( (gene == FEATURE_GENE_NONE) && is_gene )
+		gene = feature_index_add_gene(fi, chrom);
+	    else
+		fi->gene[fi->count - 1] = gene;
+	}
+    }
+    xt_fclose(bed_stream);
+    return status == BL_READ_EOF ? FEATURE_INDEX_OK : FEATURE_INDEX_BAD_DATA;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read chromosome sizes from a .fai or chrom.sizes file.  Both have
+ *      the name in column 1 and the length in column 2.  Sizes override
+ *      the feature extents used by default.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     feature_index_load_sizes(feature_index_t *fi, const char *sizes_filename)
+
+{
+    FILE        *sizes_stream;
+    char        chrom[BL_CHROM_MAX_CHARS + 1],
+		size_str[BL_POSITION_MAX_DIGITS + 1],
+		*end;
+    size_t      len, c = 0;
+    int         delim;
+
+    if ( (sizes_stream = xt_fopen(sizes_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "feature_index_load_sizes(): Cannot open %s: %s\n",
+		sizes_filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    while ( tsv_read_field(sizes_stream, chrom, BL_CHROM_MAX_CHARS, &len) != EOF )
+    {
+	if ( *chrom == '#' )
+	{
+	    tsv_skip_rest_of_line(sizes_stream);
+	    continue;
+	}
+	delim = tsv_read_field(sizes_stream, size_str, BL_POSITION_MAX_DIGITS, &len);
+	if ( delim == EOF )
+	    break;
+	if ( delim != '\n' )
+	    tsv_skip_rest_of_line(sizes_stream);
+	c = feature_index_add_chrom(fi, chrom, c);
+	fi->chroms[c].size = strtoll(size_str, &end, 10);
+	if ( *end != '\0' )
+	{
+	    fprintf(stderr, "feature_index_load_sizes(): Invalid size for %s: %s\n",
+		    chrom, size_str);
+	    xt_fclose(sizes_stream);
+	    return FEATURE_INDEX_BAD_DATA;
+	}
+    }
+    xt_fclose(sizes_stream);
+    return FEATURE_INDEX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sort the features of each chromosome by start and compute
+ *      max_end for the implicit interval tree.  Chromosomes with no
+ *      size from feature_index_load_sizes() get the largest feature end.
+ *      In the implicit tree, node i is at the level given by the number
+ *      of trailing 1 bits in i, and max_end[i] is the largest end in its
+ *      subtree.  When n is not a power of 2, right children beyond the
+ *      last node take the max_end of the last node at their level, as
+ *      in cgranges.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    feature_index_build(feature_index_t *fi)
+
+{
+    size_t      c, n, i, last_i, x, step;
+    int64_t     *end, *max_end, last, el, er, e;
+    fi_chrom_t  *ch;
+    int         k;
+
+    for (c = 0; c < fi->chrom_count; ++c)
+    {
+	ch = &fi->chroms[c];
+	if ( (n = ch->count) == 0 )
+	    continue;
+	feature_index_sort_chrom(fi, ch);
+	if ( ch->size == 0 )
+	    for (i = ch->first; i < ch->first + n; ++i)
+		ch->size = XT_MAX(ch->size, fi->end[i]);
+	end = fi->end + ch->first;
+	max_end = fi->max_end + ch->first;
+
+	for (i = 0, last_i = 0, last = 0; i < n; i += 2)
+	{
+	    last_i = i;
+	    last = max_end[i] = end[i];
+	}
+	for (k = 1; ((size_t)1 << k) <= n; ++k)
+	{
+	    x = (size_t)1 << (k - 1);
+	    step = x << 2;
+	    for (i = (x << 1) - 1; i < n; i += step)
+	    {
+		el = max_end[i - x];
+		er = i + x < n ? max_end[i + x] : last;
+		e = end[i];
+		e = XT_MAX(e, el);
+		e = XT_MAX(e, er);
+		max_end[i] = e;
+	    }
+	    // Parent of the last node at level k - 1
+	    last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+	    if ( (last_i < n) && (max_end[last_i] > last) )
+		last = max_end[last_i];
+	}
+	ch->root_level = k - 1;
+    }
+}
+
+
+// qsort() has no argument for context, so feature_cmp() uses this
+static feature_index_t  *Sort_fi;
+
+int     feature_cmp(const size_t *i1, const size_t *i2)
+
+{
+    int64_t s1 = Sort_fi->start[*i1], s2 = Sort_fi->start[*i2];
+
+    if ( s1 != s2 )
+	return s1 < s2 ? -1 : 1;
+    s1 = Sort_fi->end[*i1], s2 = Sort_fi->end[*i2];
+    if ( s1 != s2 )
+	return s1 < s2 ? -1 : 1;
+    return *i1 < *i2 ? -1 : *i1 > *i2;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sort one chromosome's features by start, then end.  The parallel
+ *      arrays are permuted through a temporary index array.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    feature_index_sort_chrom(feature_index_t *fi, fi_chrom_t *ch)
+
+{
+    size_t          *order, c, n = ch->count;
+    int64_t         *tmp64;
+    unsigned char   *tmp_class;
+    char            *tmp_strand, **tmp_name;
+    size_t          *tmp_gene;
+    bool            sorted = true;
+
+    for (c = ch->first + 1; c < ch->first + n; ++c)
+	if ( fi->start[c] < fi->start[c - 1] )
+	{
+	    sorted = false;
+	    break;
+	}
+    if ( sorted )
+	return;
+
+    order = xt_malloc(n, sizeof(*order));
+    tmp64 = xt_malloc(n, sizeof(*tmp64));
+    tmp_class = xt_malloc(n, sizeof(*tmp_class));
+    tmp_strand = xt_malloc(n, sizeof(*tmp_strand));
+    tmp_name = xt_malloc(n, sizeof(*tmp_name));
+    tmp_gene = xt_malloc(n, sizeof(*tmp_gene));
+    if ( (order == NULL) || (tmp64 == NULL) || (tmp_class == NULL) ||
+	 (tmp_strand == NULL) || (tmp_name == NULL) || (tmp_gene == NULL) )
+    {
+	fputs("feature_index_sort_chrom(): Could not allocate temp arrays.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0; c < n; ++c)
+	order[c] = ch->first + c;
+    Sort_fi = fi;
+    qsort(order, n, sizeof(*order),
+	  (int (*)(const void *, const void *))feature_cmp);
+
+    for (c = 0; c < n; ++c)
+	tmp64[c] = fi->start[order[c]];
+    memcpy(fi->start + ch->first, tmp64, n * sizeof(*tmp64));
+    for (c = 0; c < n; ++c)
+	tmp64[c] = fi->end[order[c]];
+    memcpy(fi->end + ch->first, tmp64, n * sizeof(*tmp64));
+    for (c = 0; c < n; ++c)
+    {
+	tmp_class[c] = fi->class_id[order[c]];
+	tmp_strand[c] = fi->strand[order[c]];
+	tmp_name[c] = fi->name[order[c]];
+	tmp_gene[c] = fi->gene[order[c]];
+    }
+    memcpy(fi->class_id + ch->first, tmp_class, n * sizeof(*tmp_class));
+    memcpy(fi->strand + ch->first, tmp_strand, n * sizeof(*tmp_strand));
+    memcpy(fi->name + ch->first, tmp_name, n * sizeof(*tmp_name));
+    memcpy(fi->gene + ch->first, tmp_gene, n * sizeof(*tmp_gene));
+
+    free(order);
+    free(tmp64);
+    free(tmp_class);
+    free(tmp_strand);
+    free(tmp_name);
+    free(tmp_gene);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append a feature index to a hit list, expanding as needed.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    hit_list_add(hit_list_t *hits, size_t index)
+
+{
+    if ( hits->count == hits->array_size )
+    {
+	hits->array_size = hits->array_size == 0 ? 64 : hits->array_size * 2;
+	hits->index = xt_realloc(hits->index, hits->array_size,
+				 sizeof(*hits->index));
+	if ( hits->index == NULL )
+	{
+	    fputs("hit_list_add(): Could not allocate hits.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    hits->index[hits->count++] = index;
+}
+
+
+void    hit_list_free(hit_list_t *hits)
+
+{
+    free(hits->index);
+    hits->index = NULL;
+    hits->count = hits->array_size = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Find all features on chromosome chrom overlapping the half-open
+ *      interval [start, end).  Indexes of overlapping features are
+ *      placed in hits in ascending order of feature start.  The index
+ *      is not modified, so concurrent queries from multiple threads
+ *      are safe as long as each has its own hit list.
+ *
+ *  Returns:
+ *      The number of overlapping features
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  feature_index_overlaps(feature_index_t *fi, size_t chrom,
+			       int64_t start, int64_t end, hit_list_t *hits)
+
+{
+    struct
+    {
+	size_t  x;
+	int     k, w;
+    }   stack[64], z;
+    size_t      i, i0, i1, y, n, first;
+    int64_t     *fstart, *fend, *max_end;
+    int         t = 0;
+    fi_chrom_t  *ch;
+
+    hits->count = 0;
+    if ( chrom >= fi->chrom_count )
+	return 0;
+    ch = &fi->chroms[chrom];
+    if ( (n = ch->count) == 0 )
+	return 0;
+    first = ch->first;
+    fstart = fi->start + first;
+    fend = fi->end + first;
+    max_end = fi->max_end + first;
+
+    stack[t].x = ((size_t)1 << ch->root_level) - 1;
+    stack[t].k = ch->root_level;
+    stack[t++].w = 0;
+    while ( t > 0 )
+    {
+	z = stack[--t];
+	if ( z.k <= 3 )
+	{
+	    // Small subtree: scan every node in order
+	    i0 = z.x >> z.k << z.k;
+	    i1 = i0 + ((size_t)1 << (z.k + 1)) - 1;
+	    if ( i1 >= n )
+		i1 = n;
+	    for (i = i0; (i < i1) && (fstart[i] < end); ++i)
+		if ( start < fend[i] )
+		    hit_list_add(hits, first + i);
+	}
+	else if ( z.w == 0 )
+	{
+	    // Revisit this node after its left child
+	    y = z.x - ((size_t)1 << (z.k - 1));
+	    stack[t].x = z.x;
+	    stack[t].k = z.k;
+	    stack[t++].w = 1;
+	    if ( (y >= n) || (max_end[y] > start) )
+	    {
+		stack[t].x = y;
+		stack[t].k = z.k - 1;
+		stack[t++].w = 0;
+	    }
+	}
+	else if ( (z.x < n) && (fstart[z.x] < end) )
+	{
+	    if ( start < fend[z.x] )
+		hit_list_add(hits, first + z.x);
+	    stack[t].x = z.x + ((size_t)1 << (z.k - 1));
+	    stack[t].k = z.k - 1;
+	    stack[t++].w = 0;
+	}
+    }
+    return hits->count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Determine whether an overlap of overlap_len bases satisfies the
+ *      minimum overlap requirements, with the same meaning as
+ *      bedtools intersect -f, -F, and -e.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+bool    overlap_ok(overlap_params_t *params, int64_t peak_len,
+		   int64_t feature_len, int64_t overlap_len)
+
+{
+    bool    peak_ok, gff_ok;
+
+    if ( overlap_len <= 0 )
+	return false;
+    peak_ok = overlap_len >= params->min_peak_overlap * peak_len;
+    gff_ok = overlap_len >= params->min_gff_overlap * feature_len;
+    return params->either ? peak_ok || gff_ok : peak_ok && gff_ok;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify the interval [start, end) on chromosome chrom.
+ *      Overlapping features that fail the overlap requirements are
+ *      removed from hits.  If classes is not NULL, it receives the set
+ *      of all classes overlapped.
+ *
+ *  Returns:
+ *      The priority-resolved class ID: the highest priority class
+ *      overlapped, the upstream-beyond class if nothing is overlapped,
+ *      or FEATURE_CLASS_NONE if only unprioritized features overlap.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+unsigned    feature_index_classify(feature_index_t *fi, size_t chrom,
+				   int64_t start, int64_t end,
+				   overlap_params_t *params, hit_list_t *hits,
+				   class_mask_t *classes)
+
+{
+    feature_index_overlaps(fi, chrom, start, end, hits);
+    return feature_index_resolve(fi, start, end, params, hits, classes);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify the interval [start, end) given the features in hits
+ *      that overlap it, from feature_index_overlaps() or a sweep.
+ *      Returns as feature_index_classify().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+unsigned    feature_index_resolve(feature_index_t *fi, int64_t start,
+				  int64_t end, overlap_params_t *params,
+				  hit_list_t *hits, class_mask_t *classes)
+
+{
+    size_t          c, kept, f;
+    unsigned        best = FEATURE_CLASS_NONE;
+    class_mask_t    mask = 0;
+    int64_t         overlap_len;
+
+    for (c = kept = 0; c < hits->count; ++c)
+    {
+	f = hits->index[c];
+	overlap_len = XT_MIN(end, fi->end[f]) - XT_MAX(start, fi->start[f]);
+	if ( overlap_ok(params, end - start, fi->end[f] - fi->start[f],
+			overlap_len) )
+	{
+	    hits->index[kept++] = f;
+	    if ( fi->class_id[f] != FEATURE_CLASS_NONE )
+	    {
+		mask |= (class_mask_t)1 << fi->class_id[f];
+		if ( fi->class_id[f] < best )
+		    best = fi->class_id[f];
+	    }
+	}
+    }
+    hits->count = kept;
+    if ( kept == 0 )
+	best = fi->beyond_class;
+    if ( classes != NULL )
+	*classes = mask;
+    return best;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Free all memory used by a feature index.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    feature_index_free(feature_index_t *fi)
+
+{
+    size_t  c;
+
+    for (c = 0; c < fi->count; ++c)
+	free(fi->name[c]);
+    for (c = 0; c < fi->chrom_count; ++c)
+	free(fi->chroms[c].name);
+    for (c = 0; c < fi->class_count; ++c)
+	free(fi->class_names[c]);
+    for (c = 0; c < fi->gene_count; ++c)
+    {
+	free(fi->genes[c].id);
+	free(fi->genes[c].name);
+    }
+    free(fi->start);
+    free(fi->end);
+    free(fi->max_end);
+    free(fi->class_id);
+    free(fi->strand);
+    free(fi->name);
+    free(fi->gene);
+    free(fi->chroms);
+    free(fi->genes);
+    feature_index_init(fi);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read all peaks from a BED stream into memory, adding any
+ *      chromosomes not present in the feature index.  If midpoints_only
+ *      is true, each peak is reduced to its midpoint, as with
+ *      --midpoints.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     peak_set_read(peak_set_t *peaks, FILE *peak_stream,
+		      feature_index_t *fi, bool midpoints_only)
+
+{
+    bl_bed_t    bed_feature = BL_BED_INIT;
+    size_t      chrom = 0;
+    int64_t     start, end;
+    int         status;
+
+    bl_bed_skip_header(peak_stream);
+    while ( (status = peak_read(&bed_feature, peak_stream, midpoints_only,
+				&start, &end)) == BL_READ_OK )
+    {
+	chrom = feature_index_add_chrom(fi, BL_BED_CHROM(&bed_feature), chrom);
+	peak_set_add(peaks, chrom, start, end,
+		     BL_BED_FIELDS(&bed_feature) > 3 ?
+			BL_BED_NAME(&bed_feature) : NULL);
+    }
+    return status == BL_READ_EOF ? FEATURE_INDEX_OK : FEATURE_INDEX_BAD_DATA;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read one peak from a BED stream, returning its interval in start
+ *      and end, reduced to the midpoint if midpoints_only is true.
+ *
+ *  Returns:
+ *      The status from bl_bed_read()
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     peak_read(bl_bed_t *bed_feature, FILE *peak_stream,
+		  bool midpoints_only, int64_t *start, int64_t *end)
+
+{
+    int     status;
+
+    if ( (status = bl_bed_read(bed_feature, peak_stream, BL_BED_FIELD_ALL))
+	    == BL_READ_OK )
+    {
+	*start = BL_BED_CHROM_START(bed_feature);
+	*end = BL_BED_CHROM_END(bed_feature);
+	if ( midpoints_only )
+	{
+	    *start = (*start + *end) / 2;
+	    *end = *start + 1;
+	}
+    }
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append a peak to a peak set.  name may be NULL.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    peak_set_add(peak_set_t *peaks, size_t chrom, int64_t start,
+		     int64_t end, const char *name)
+
+{
+    if ( peaks->count == peaks->array_size )
+    {
+	peaks->array_size = peaks->array_size == 0 ? PEAK_SET_START_SIZE :
+			    peaks->array_size * 2;
+	peaks->chrom = xt_realloc(peaks->chrom, peaks->array_size,
+				  sizeof(*peaks->chrom));
+	peaks->start = xt_realloc(peaks->start, peaks->array_size,
+				  sizeof(*peaks->start));
+	peaks->end = xt_realloc(peaks->end, peaks->array_size,
+				sizeof(*peaks->end));
+	peaks->name = xt_realloc(peaks->name, peaks->array_size,
+				 sizeof(*peaks->name));
+	if ( (peaks->chrom == NULL) || (peaks->start == NULL) ||
+	     (peaks->end == NULL) || (peaks->name == NULL) )
+	{
+	    fputs("peak_set_add(): Could not allocate peaks.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    peaks->chrom[peaks->count] = chrom;
+    peaks->start[peaks->count] = start;
+    peaks->end[peaks->count] = end;
+    peaks->name[peaks->count] = name == NULL ? NULL : strdup(name);
+    ++peaks->count;
+}
+
+
+void    peak_set_free(peak_set_t *peaks)
+
+{
+    size_t  c;
+
+    for (c = 0; c < peaks->count; ++c)
+	free(peaks->name[c]);
+    free(peaks->chrom);
+    free(peaks->start);
+    free(peaks->end);
+    free(peaks->name);
+    peaks->count = peaks->array_size = 0;
+    peaks->chrom = NULL;
+    peaks->start = peaks->end = NULL;
+    peaks->name = NULL;
+}
@@ -0,0 +1,215 @@
+/***************************************************************************
+ *  Description:
+ *      GREAT-style assignment of peaks to genes through basal plus
+ *      extension regulatory domains.  Domains are computed from the gene
+ *      TSSs in the augmented BED in one sorted sweep per chromosome and
+ *      cached as a BED file next to the other annotation files, so
+ *      later runs only load them into a feature index and query.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+int     great_gene_cmp(const great_gene_t *g1, const great_gene_t *g2)
+
+{
+    if ( g1->chrom != g2->chrom )
+	return g1->chrom < g2->chrom ? -1 : 1;
+    return g1->tss < g2->tss ? -1 : g1->tss > g2->tss;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute the regulatory domain of every gene in fi, which must be
+ *      loaded with track_genes, and write them as BED.  The name of
+ *      each domain is "Name;ID;TSS" so that assignments can report the
+ *      distance to the TSS.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    great_domains_write(feature_index_t *fi, int64_t max_extension,
+			    FILE *outfile)
+
+{
+    great_gene_t    *genes, *g;
+    size_t          c;
+    int64_t         start, end;
+
+    if ( (genes = xt_malloc(fi->gene_count + 1, sizeof(*genes))) == NULL )
+    {
+	fputs("great_domains_write(): Could not allocate genes.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0; c < fi->gene_count; ++c)
+    {
+	g = &genes[c];
+	g->gene = &fi->genes[c];
+	g->chrom = g->gene->chrom;
+	if ( g->gene->strand == '-' )
+	{
+	    g->tss = g->gene->end - 1;
+	    g->basal_start = g->tss - GREAT_BASAL_DOWNSTREAM;
+	    g->basal_end = g->tss + GREAT_BASAL_UPSTREAM + 1;
+	}
+	else
+	{
+	    g->tss = g->gene->start;
+	    g->basal_start = g->tss - GREAT_BASAL_UPSTREAM;
+	    g->basal_end = g->tss + GREAT_BASAL_DOWNSTREAM + 1;
+	}
+	g->basal_start = XT_MAX(g->basal_start, 0);
+    }
+    qsort(genes, fi->gene_count, sizeof(*genes),
+	  (int (*)(const void *, const void *))great_gene_cmp);
+
+    fprintf(outfile, "#GREAT\t%d\t%d\t%" PRId64 "\n",
+	    GREAT_BASAL_UPSTREAM, GREAT_BASAL_DOWNSTREAM, max_extension);
+    for (c = 0; c < fi->gene_count; ++c)
+    {
+	g = &genes[c];
+	start = XT_MAX(g->tss - max_extension, 0);
+	if ( (c > 0) && (genes[c - 1].chrom == g->chrom) )
+	    start = XT_MAX(start, genes[c - 1].basal_end);
+	start = XT_MIN(start, g->basal_start);
+	end = g->tss + max_extension + 1;
+	if ( (c + 1 < fi->gene_count) && (genes[c + 1].chrom == g->chrom) )
+	    end = XT_MIN(end, genes[c + 1].basal_start);
+	end = XT_MAX(end, g->basal_end);
+	fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\t%s;%s;%" PRId64 "\t0\t%c\n",
+		fi->chroms[g->chrom].name, start, end, g->gene->name,
+		g->gene->id, g->tss, g->gene->strand);
+    }
+    free(genes);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Check whether a cached domain file was computed with the current
+ *      parameters.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+bool    great_cache_ok(const char *cache_filename, int64_t max_extension)
+
+{
+    FILE    *stream;
+    char    header[128], expected[128];
+    bool    ok;
+
+    if ( (stream = fopen(cache_filename, "r")) == NULL )
+	return false;
+    snprintf(expected, sizeof(expected), "#GREAT\t%d\t%d\t%" PRId64 "\n",
+	     GREAT_BASAL_UPSTREAM, GREAT_BASAL_DOWNSTREAM, max_extension);
+    ok = (fgets(header, sizeof(header), stream) != NULL) &&
+	 (strcmp(header, expected) == 0);
+    fclose(stream);
+    return ok;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Load the regulatory domains into domains, computing and caching
+ *      them from the genes in the augmented BED if necessary.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     great_domains_get(feature_index_t *domains,
+			  const char *augmented_filename,
+			  const char *cache_filename, int64_t max_extension)
+
+{
+    feature_index_t fi;
+    FILE            *stream;
+    int             status;
+
+    if ( great_cache_ok(cache_filename, max_extension) )
+	fprintf(stderr, "Using existing %s...\n", cache_filename);
+    else
+    {
+	fprintf(stderr, "Computing regulatory domains...\n");
+	if ( (status = load_feature_index(&fi, augmented_filename, "",
+					  NULL, true)) != EX_OK )
+	    return status;
+	if ( (stream = fopen(cache_filename, "w")) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot write %s: %s\n",
+		    cache_filename, strerror(errno));
+	    feature_index_free(&fi);
+	    return EX_CANTCREAT;
+	}
+	great_domains_write(&fi, max_extension, stream);
+	fclose(stream);
+	feature_index_free(&fi);
+    }
+
+    feature_index_init(domains);
+    if ( feature_index_load(domains, cache_filename, false) != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    feature_index_build(domains);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the genes whose domains contain the peak [start, end) as
+ *      a comma-separated list of Name(distance), where distance is from
+ *      the TSS to the peak midpoint, positive downstream.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    great_assign(feature_index_t *domains, size_t chrom, int64_t start,
+		     int64_t end, overlap_params_t *params, hit_list_t *hits,
+		     FILE *outfile)
+
+{
+    size_t  c, f, name_len;
+    char    *tss_str;
+    int64_t tss, distance;
+
+    feature_index_overlaps(domains, chrom, start, end, hits);
+    feature_index_resolve(domains, start, end, params, hits, NULL);
+    if ( hits->count == 0 )
+    {
+	fputs("\t.", outfile);
+	return;
+    }
+    for (c = 0; c < hits->count; ++c)
+    {
+	f = hits->index[c];
+	name_len = strcspn(domains->name[f], ";");
+	tss_str = strrchr(domains->name[f], ';');
+	tss = tss_str == NULL ? 0 : strtoll(tss_str + 1, NULL, 10);
+	distance = (start + end) / 2 - tss;
+	if ( domains->strand[f] == '-' )
+	    distance = -distance;
+	fprintf(outfile, "%c%.*s(%+" PRId64 ")", c == 0 ? '\t' : ',',
+		(int)name_len, domains->name[f], distance);
+    }
+}
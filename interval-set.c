@@ -0,0 +1,575 @@
+/***************************************************************************
+ *  Description:
+ *      Interval set algebra on peak sets: merge, intersect, subtract,
+ *      complement, slop, and flank, as with the bedtools commands of the
+ *      same names.  Sets are kept in the columnar peak_set_t layout and
+ *      sorted by chromosome and start, so each operation is one linear
+ *      sweep per chromosome, and chromosomes are swept in parallel.
+ *      Peaks can be preprocessed this way before any mode instead of
+ *      running bedtools and writing intermediate files.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+int     interval_key_cmp(const interval_key_t *k1, const interval_key_t *k2)
+
+{
+    if ( k1->start != k2->start )
+	return k1->start < k2->start ? -1 : 1;
+    if ( k1->end != k2->end )
+	return k1->end < k2->end ? -1 : 1;
+    return k1->index < k2->index ? -1 : k1->index > k2->index;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute the first interval of each chromosome in a set sorted by
+ *      chromosome.  chrom_first must have chrom_count + 1 entries, and
+ *      the intervals of chrom c are [chrom_first[c], chrom_first[c + 1]).
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    interval_set_chrom_first(peak_set_t *set, size_t chrom_count,
+				 size_t *chrom_first)
+
+{
+    size_t  c, p;
+
+    memset(chrom_first, 0, (chrom_count + 1) * sizeof(*chrom_first));
+    for (p = 0; p < set->count; ++p)
+	++chrom_first[set->chrom[p] + 1];
+    for (c = 0; c < chrom_count; ++c)
+	chrom_first[c + 1] += chrom_first[c];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sort a set by chromosome index, start, and end, and compute
+ *      chrom_first as interval_set_chrom_first().  Intervals are bucketed
+ *      by chromosome, so only each chromosome's keys need a comparison
+ *      sort.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    interval_set_sort(peak_set_t *set, size_t chrom_count,
+			  size_t *chrom_first)
+
+{
+    interval_key_t  *keys, *key;
+    size_t          *next, c, p, n = set->count;
+    char            **tmp_name;
+
+    interval_set_chrom_first(set, chrom_count, chrom_first);
+    keys = xt_malloc(n + 1, sizeof(*keys));
+    next = xt_malloc(chrom_count + 1, sizeof(*next));
+    tmp_name = xt_malloc(n + 1, sizeof(*tmp_name));
+    if ( (keys == NULL) || (next == NULL) || (tmp_name == NULL) )
+    {
+	fputs("interval_set_sort(): Could not allocate keys.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    memcpy(next, chrom_first, chrom_count * sizeof(*next));
+    for (p = 0; p < n; ++p)
+    {
+	key = &keys[next[set->chrom[p]]++];
+	key->start = set->start[p];
+	key->end = set->end[p];
+	key->index = p;
+    }
+    for (c = 0; c < chrom_count; ++c)
+	qsort(keys + chrom_first[c], chrom_first[c + 1] - chrom_first[c],
+	      sizeof(*keys), (int (*)(const void *, const void *))interval_key_cmp);
+
+    for (c = 0; c < chrom_count; ++c)
+	for (p = chrom_first[c]; p < chrom_first[c + 1]; ++p)
+	{
+	    set->chrom[p] = c;
+	    set->start[p] = keys[p].start;
+	    set->end[p] = keys[p].end;
+	    tmp_name[p] = set->name[keys[p].index];
+	}
+    memcpy(set->name, tmp_name, n * sizeof(*tmp_name));
+    free(keys);
+    free(next);
+    free(tmp_name);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append sets[0 .. count - 1] to an empty result in order, moving
+ *      rather than copying names, and free the sets.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    interval_set_concat(peak_set_t *sets, size_t count, peak_set_t *result)
+
+{
+    size_t  s, total = 0, n;
+
+    for (s = 0; s < count; ++s)
+	total += sets[s].count;
+    result->array_size = total + 1;
+    result->chrom = xt_malloc(result->array_size, sizeof(*result->chrom));
+    result->start = xt_malloc(result->array_size, sizeof(*result->start));
+    result->end = xt_malloc(result->array_size, sizeof(*result->end));
+    result->name = xt_malloc(result->array_size, sizeof(*result->name));
+    if ( (result->chrom == NULL) || (result->start == NULL) ||
+	 (result->end == NULL) || (result->name == NULL) )
+    {
+	fputs("interval_set_concat(): Could not allocate intervals.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (s = 0, result->count = 0; s < count; ++s)
+    {
+	n = sets[s].count;
+	memcpy(result->chrom + result->count, sets[s].chrom, n * sizeof(size_t));
+	memcpy(result->start + result->count, sets[s].start, n * sizeof(int64_t));
+	memcpy(result->end + result->count, sets[s].end, n * sizeof(int64_t));
+	memcpy(result->name + result->count, sets[s].name, n * sizeof(char *));
+	result->count += n;
+	free(sets[s].chrom);
+	free(sets[s].start);
+	free(sets[s].end);
+	free(sets[s].name);
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Apply one operation to the intervals of chromosome c, appending
+ *      the results to it->out[c].  Intersect and subtract keep the names
+ *      of it->a, and require the intervals of it->b to be disjoint.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    interval_sweep_chrom(interval_thread_t *it, size_t c)
+
+{
+    peak_set_t  *a = it->a, *b = it->b, *out = &it->out[c];
+    size_t      p, q, j, k, last = it->a_first[c + 1], b_last;
+    int64_t     start, end, pos, size;
+
+    switch(it->op)
+    {
+	case INTERVAL_MERGE:
+	    for (p = it->a_first[c]; p < last; p = q)
+	    {
+		start = a->start[p];
+		end = a->end[p];
+		for (q = p + 1; (q < last) &&
+				(a->start[q] <= end + it->distance); ++q)
+		    end = XT_MAX(end, a->end[q]);
+		peak_set_add(out, c, start, end, NULL);
+	    }
+	    break;
+
+	case INTERVAL_INTERSECT:
+	case INTERVAL_SUBTRACT:
+	    // j is the first b interval ending after the a start, which
+	    // only moves forward since a is sorted by start
+	    j = it->b_first[c];
+	    b_last = it->b_first[c + 1];
+	    for (p = it->a_first[c]; p < last; ++p)
+	    {
+		while ( (j < b_last) && (b->end[j] <= a->start[p]) )
+		    ++j;
+		pos = a->start[p];
+		for (k = j; (k < b_last) && (b->start[k] < a->end[p]); ++k)
+		{
+		    if ( it->op == INTERVAL_INTERSECT )
+			peak_set_add(out, c, XT_MAX(a->start[p], b->start[k]),
+				     XT_MIN(a->end[p], b->end[k]), a->name[p]);
+		    else if ( b->start[k] > pos )
+			peak_set_add(out, c, pos, b->start[k], a->name[p]);
+		    pos = XT_MAX(pos, b->end[k]);
+		}
+		if ( (it->op == INTERVAL_SUBTRACT) && (pos < a->end[p]) )
+		    peak_set_add(out, c, pos, a->end[p], a->name[p]);
+	    }
+	    break;
+
+	case INTERVAL_COMPLEMENT:
+	    size = it->chroms->chroms[c].size;
+	    for (p = it->a_first[c], pos = 0; p < last; ++p)
+	    {
+		if ( (a->start[p] > pos) && (pos < size) )
+		    peak_set_add(out, c, pos, XT_MIN(a->start[p], size), NULL);
+		pos = XT_MAX(pos, a->end[p]);
+	    }
+	    if ( pos < size )
+		peak_set_add(out, c, pos, size, NULL);
+	    break;
+    }
+}
+
+
+void    *interval_thread(void *arg)
+
+{
+    interval_thread_t   *it = arg;
+    size_t              c;
+
+    for (c = it->first_chrom; c < it->chrom_count; c += it->chrom_step)
+	interval_sweep_chrom(it, c);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Replace a with the result of op applied to a and, for intersect
+ *      and subtract, b.  a and b must use chromosome indexes from chroms,
+ *      whose sizes are used by complement.  distance is the maximum gap
+ *      between merged intervals, 0 to merge only overlapping and
+ *      book-ended intervals.  b is merged first, so it may overlap
+ *      itself.  The result is sorted.
+ *
+ *  Returns:
+ *      EX_OK or EX_OSERR
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     interval_set_apply(int op, peak_set_t *a, peak_set_t *b,
+			   feature_index_t *chroms, int64_t distance,
+			   unsigned threads)
+
+{
+    interval_thread_t   thread_args[PC_MAX_THREADS];
+    pthread_t           thread_ids[PC_MAX_THREADS];
+    size_t              chrom_count = chroms->chrom_count, *a_first,
+			*b_first = NULL, c;
+    peak_set_t          *out;
+    unsigned            t;
+
+    a_first = xt_malloc(chrom_count + 1, sizeof(*a_first));
+    out = xt_malloc(chrom_count + 1, sizeof(*out));
+    if ( (a_first == NULL) || (out == NULL) )
+    {
+	fputs("interval_set_apply(): Could not allocate chromosomes.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    interval_set_sort(a, chrom_count, a_first);
+    if ( b != NULL )
+    {
+	if ( interval_set_apply(INTERVAL_MERGE, b, NULL, chroms, 0, threads)
+		!= EX_OK )
+	    return EX_OSERR;
+	if ( (b_first = xt_malloc(chrom_count + 1, sizeof(*b_first))) == NULL )
+	{
+	    fputs("interval_set_apply(): Could not allocate chromosomes.\n",
+		  stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	interval_set_chrom_first(b, chrom_count, b_first);
+    }
+    for (c = 0; c < chrom_count; ++c)
+	out[c] = (peak_set_t)PEAK_SET_INIT;
+
+    if ( threads > chrom_count )
+	threads = chrom_count == 0 ? 1 : chrom_count;
+    for (t = 0; t < threads; ++t)
+    {
+	thread_args[t].op = op;
+	thread_args[t].a = a;
+	thread_args[t].b = b;
+	thread_args[t].out = out;
+	thread_args[t].a_first = a_first;
+	thread_args[t].b_first = b_first;
+	thread_args[t].chrom_count = chrom_count;
+	thread_args[t].first_chrom = t;
+	thread_args[t].chrom_step = threads;
+	thread_args[t].chroms = chroms;
+	thread_args[t].distance = distance;
+	if ( pthread_create(&thread_ids[t], NULL, interval_thread,
+			    &thread_args[t]) != 0 )
+	{
+	    fputs("interval_set_apply(): pthread_create() failed.\n", stderr);
+	    return EX_OSERR;
+	}
+    }
+    for (t = 0; t < threads; ++t)
+	pthread_join(thread_ids[t], NULL);
+
+    peak_set_free(a);
+    interval_set_concat(out, chrom_count, a);
+    free(out);
+    free(a_first);
+    free(b_first);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Extend every interval by bases on both sides, within the
+ *      chromosome if its size is known.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    interval_set_slop(peak_set_t *set, feature_index_t *chroms,
+			  int64_t bases)
+
+{
+    size_t  p;
+    int64_t size;
+
+    for (p = 0; p < set->count; ++p)
+    {
+	size = chroms->chroms[set->chrom[p]].size;
+	set->start[p] = XT_MAX(set->start[p] - bases, 0);
+	set->end[p] += bases;
+	if ( size > 0 )
+	    set->end[p] = XT_MIN(set->end[p], size);
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Replace every interval with its flanks of up to bases on each
+ *      side, within the chromosome if its size is known.  Both flanks
+ *      keep the interval's name.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    interval_set_flank(peak_set_t *set, feature_index_t *chroms,
+			   int64_t bases)
+
+{
+    peak_set_t  flanks = PEAK_SET_INIT;
+    size_t      p, c;
+    int64_t     start, end, size;
+
+    for (p = 0; p < set->count; ++p)
+    {
+	c = set->chrom[p];
+	size = chroms->chroms[c].size;
+	start = XT_MAX(set->start[p] - bases, 0);
+	if ( start < set->start[p] )
+	    peak_set_add(&flanks, c, start, set->start[p], set->name[p]);
+	end = set->end[p] + bases;
+	if ( size > 0 )
+	    end = XT_MIN(end, size);
+	if ( end > set->end[p] )
+	    peak_set_add(&flanks, c, set->end[p], end, set->name[p]);
+    }
+    peak_set_free(set);
+    *set = flanks;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read the regions in a BED file into set, adding chromosomes to
+ *      chroms.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     interval_set_load(peak_set_t *set, const char *filename,
+			  feature_index_t *chroms)
+
+{
+    FILE    *stream;
+    int     status;
+
+    if ( (stream = xt_fopen(filename, "r")) == NULL )
+    {
+	fprintf(stderr, "interval_set_load(): Cannot open %s: %s\n",
+		filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    status = peak_set_read(set, stream, chroms, false);
+    xt_fclose(stream);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Apply a binary operation with the regions in filename to set.
+ *
+ *  Returns:
+ *      EX_OK, EX_NOINPUT, EX_DATAERR, or EX_OSERR
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     interval_set_apply_file(int op, peak_set_t *set, const char *filename,
+				feature_index_t *chroms, unsigned threads)
+
+{
+    peak_set_t  regions = PEAK_SET_INIT;
+    int         status;
+
+    if ( (status = interval_set_load(&regions, filename, chroms))
+	    != FEATURE_INDEX_OK )
+	return status == FEATURE_INDEX_NOINPUT ? EX_NOINPUT : EX_DATAERR;
+    status = interval_set_apply(op, set, &regions, chroms, 0, threads);
+    peak_set_free(&regions);
+    return status;
+}
+
+
+bool    interval_ops_active(interval_ops_t *ops)
+
+{
+    return (ops->slop > 0) || (ops->flank > 0) || (ops->merge_distance >= 0) ||
+	   (ops->intersect_filename != NULL) ||
+	   (ops->subtract_filename != NULL) || ops->complement;
+}
+
+
+void    *interval_pipe_thread(void *arg)
+
+{
+    interval_pipe_t *ip = arg;
+    peak_set_t      *set = &ip->set;
+    size_t          p;
+
+    for (p = 0; p < set->count; ++p)
+    {
+	fprintf(ip->out, "%s\t%" PRId64 "\t%" PRId64,
+		ip->chroms.chroms[set->chrom[p]].name, set->start[p], set->end[p]);
+	if ( set->name[p] != NULL )
+	    fprintf(ip->out, "\t%s", set->name[p]);
+	putc('\n', ip->out);
+    }
+    fclose(ip->out);
+    peak_set_free(set);
+    feature_index_free(&ip->chroms);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read all peaks from peak_stream, apply the operations in ops, and
+ *      return a stream of the resulting peaks written by a thread, as
+ *      liftover_pipe() does.  peak_stream is closed.  Only the name is
+ *      kept from BED fields beyond the third, and merged or complement
+ *      intervals have no name.
+ *
+ *  Returns:
+ *      The preprocessed peak stream, or NULL on failure
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+FILE    *interval_preprocess(FILE *peak_stream, interval_ops_t *ops)
+
+{
+    static interval_pipe_t  ip;
+    pthread_t   thread_id;
+    int         fds[2];
+    FILE        *processed_stream;
+
+    ip.set = (peak_set_t)PEAK_SET_INIT;
+    feature_index_init(&ip.chroms);
+    if ( (ops->chrom_sizes != NULL) &&
+	 (feature_index_load_sizes(&ip.chroms, ops->chrom_sizes)
+	    != FEATURE_INDEX_OK) )
+	return NULL;
+    if ( peak_set_read(&ip.set, peak_stream, &ip.chroms, false)
+	    != FEATURE_INDEX_OK )
+	return NULL;
+    xt_fclose(peak_stream);
+
+    fprintf(stderr, "Preprocessing %zu peaks...\n", ip.set.count);
+    if ( ops->slop > 0 )
+	interval_set_slop(&ip.set, &ip.chroms, ops->slop);
+    if ( ops->flank > 0 )
+	interval_set_flank(&ip.set, &ip.chroms, ops->flank);
+    if ( (ops->merge_distance >= 0) &&
+	 (interval_set_apply(INTERVAL_MERGE, &ip.set, NULL, &ip.chroms,
+			     ops->merge_distance, ops->threads) != EX_OK) )
+	return NULL;
+    if ( (ops->intersect_filename != NULL) &&
+	 (interval_set_apply_file(INTERVAL_INTERSECT, &ip.set,
+			ops->intersect_filename, &ip.chroms, ops->threads)
+	    != EX_OK) )
+	return NULL;
+    if ( (ops->subtract_filename != NULL) &&
+	 (interval_set_apply_file(INTERVAL_SUBTRACT, &ip.set,
+			ops->subtract_filename, &ip.chroms, ops->threads)
+	    != EX_OK) )
+	return NULL;
+    if ( ops->complement &&
+	 (interval_set_apply(INTERVAL_COMPLEMENT, &ip.set, NULL, &ip.chroms,
+			     0, ops->threads) != EX_OK) )
+	return NULL;
+    fprintf(stderr, "%zu intervals after preprocessing.\n", ip.set.count);
+
+    if ( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 )
+    {
+	fprintf(stderr, "interval_preprocess(): socketpair() failed: %s\n",
+		strerror(errno));
+	return NULL;
+    }
+    // A popen() child such as bedtools holding the write end would block EOF
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    if ( ((ip.out = fdopen(fds[1], "w")) == NULL) ||
+	 ((processed_stream = fdopen(fds[0], "r")) == NULL) )
+    {
+	fputs("interval_preprocess(): fdopen() failed.\n", stderr);
+	return NULL;
+    }
+    if ( pthread_create(&thread_id, NULL, interval_pipe_thread, &ip) != 0 )
+    {
+	fputs("interval_preprocess(): pthread_create() failed.\n", stderr);
+	return NULL;
+    }
+    pthread_detach(thread_id);
+    return processed_stream;
+}
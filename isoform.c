@@ -0,0 +1,550 @@
+/***************************************************************************
+ *  Description:
+ *      Isoform-resolved classification.  Rather than reporting one
+ *      overlap per transcript feature and grouping them afterward, each
+ *      gene is cut into segments at all of its transcripts' subfeature
+ *      boundaries, and each segment records which transcripts are in
+ *      each class there as one bitset per class.  A peak query ORs the
+ *      bitsets of the segments it touches, giving the class of every
+ *      transcript from a single interval tree lookup.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdbool.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Return true if a GFF feature type starts a new transcript within a
+ *      gene, such as mRNA or lnc_RNA.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+bool    gff_is_transcript(const char *type)
+
+{
+    return (strstr(type, "RNA") != NULL) ||
+	   (strstr(type, "transcript") != NULL) ||
+	   (strstr(type, "gene_segment") != NULL) ||
+	   (strstr(type, "_overlapping_ncrna") != NULL);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Set up an empty isoform index.  The transcript-level classes are
+ *      the classes in priority_list other than upstream regions.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     isoform_index_init(isoform_index_t *iso, const char *priority_list)
+
+{
+    size_t  c;
+
+    memset(iso, 0, sizeof(*iso));
+    feature_index_init(&iso->segments);
+    if ( feature_index_set_classes(&iso->segments, priority_list)
+	    != FEATURE_INDEX_OK )
+	return FEATURE_INDEX_BAD_DATA;
+    for (c = 0; c < iso->segments.class_count; ++c)
+    {
+	if ( strncasecmp(iso->segments.class_names[c], "upstream", 8) == 0 )
+	    continue;
+	if ( iso->class_count == ISOFORM_MAX_CLASSES )
+	{
+	    fprintf(stderr, "isoform_index_init(): More than %d transcript classes.\n",
+		    ISOFORM_MAX_CLASSES);
+	    return FEATURE_INDEX_BAD_DATA;
+	}
+	iso->class_id[iso->class_count++] = c;
+    }
+    return FEATURE_INDEX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the bitset slot of the class of a feature named
+ *      "type;Name;ID", or ISOFORM_MAX_CLASSES if it is not a
+ *      transcript-level class.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+unsigned    isoform_slot(isoform_index_t *iso, const char *name)
+
+{
+    unsigned        slot;
+    unsigned char   class_id = feature_index_class_id(&iso->segments, name);
+
+    for (slot = 0; slot < iso->class_count; ++slot)
+	if ( iso->class_id[slot] == class_id )
+	    return slot;
+    return ISOFORM_MAX_CLASSES;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add a gene from a feature named "type;Name;ID", or a transcript
+ *      of the last gene added.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    isoform_add_gene(isoform_index_t *iso, const char *feature_name)
+
+{
+    isoform_gene_t  *gene;
+    const char      *name, *id;
+
+    if ( iso->gene_count == iso->gene_array_size )
+    {
+	iso->gene_array_size = iso->gene_array_size == 0 ? 1024 :
+			       iso->gene_array_size * 2;
+	if ( (iso->genes = xt_realloc(iso->genes, iso->gene_array_size,
+				      sizeof(*iso->genes))) == NULL )
+	{
+	    fputs("isoform_add_gene(): Could not allocate genes.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    gene = &iso->genes[iso->gene_count++];
+    name = (name = strchr(feature_name, ';')) == NULL ? feature_name : name + 1;
+    id = (id = strchr(name, ';')) == NULL ? "" : id + 1;
+    gene->name = strndup(name, strcspn(name, ";"));
+    gene->id = strdup(id);
+    gene->first_tx = iso->tx_count;
+    gene->tx_count = 0;
+    gene->words = 0;
+}
+
+
+void    isoform_add_tx(isoform_index_t *iso, const char *name, size_t len)
+
+{
+    if ( iso->tx_count == iso->tx_array_size )
+    {
+	iso->tx_array_size = iso->tx_array_size == 0 ? 4096 :
+			     iso->tx_array_size * 2;
+	if ( (iso->tx_names = xt_realloc(iso->tx_names, iso->tx_array_size,
+					 sizeof(*iso->tx_names))) == NULL )
+	{
+	    fputs("isoform_add_tx(): Could not allocate transcripts.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    iso->tx_names[iso->tx_count++] = strndup(name, len);
+    ++iso->genes[iso->gene_count - 1].tx_count;
+}
+
+
+void    isoform_feature_add(isoform_feature_list_t *list, int64_t start,
+			    int64_t end, size_t tx, unsigned slot)
+
+{
+    isoform_feature_t   *f;
+
+    if ( list->count == list->array_size )
+    {
+	list->array_size = list->array_size == 0 ? 256 : list->array_size * 2;
+	if ( (list->features = xt_realloc(list->features, list->array_size,
+					  sizeof(*list->features))) == NULL )
+	{
+	    fputs("isoform_feature_add(): Could not allocate features.\n",
+		  stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    f = &list->features[list->count++];
+    f->start = start;
+    f->end = end;
+    f->tx = tx;
+    f->slot = slot;
+}
+
+
+int     position_cmp(const int64_t *p1, const int64_t *p2)
+
+{
+    return *p1 < *p2 ? -1 : *p1 > *p2;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the index of pos in the sorted, unique bounds[0 .. n - 1].
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  isoform_bound_index(const int64_t *bounds, size_t n, int64_t pos)
+
+{
+    size_t  lo = 0, hi = n, mid;
+
+    while ( lo < hi )
+    {
+	mid = (lo + hi) / 2;
+	if ( bounds[mid] < pos )
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Cut the last gene added into segments at every boundary of the
+ *      features in list, and add each segment in at least one transcript
+ *      to the index with its bitsets.  list is emptied.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    isoform_segment_gene(isoform_index_t *iso, size_t chrom, char strand,
+			     isoform_feature_list_t *list)
+
+{
+    isoform_gene_t      *gene = &iso->genes[iso->gene_count - 1];
+    isoform_feature_t   *f;
+    isoform_segment_t   *seg;
+    int64_t             *bounds;
+    uint64_t            *seg_bits, *b;
+    size_t              words, per_seg, nb, c, k, lo, hi, w;
+
+    gene->words = words = (gene->tx_count + ISOFORM_WORD_BITS - 1) /
+			  ISOFORM_WORD_BITS;
+    per_seg = iso->class_count * words;
+    if ( list->count == 0 )
+	return;
+
+    bounds = xt_malloc(list->count * 2, sizeof(*bounds));
+    if ( bounds == NULL )
+    {
+	fputs("isoform_segment_gene(): Could not allocate bounds.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0; c < list->count; ++c)
+    {
+	bounds[c * 2] = list->features[c].start;
+	bounds[c * 2 + 1] = list->features[c].end;
+    }
+    qsort(bounds, list->count * 2, sizeof(*bounds),
+	  (int (*)(const void *, const void *))position_cmp);
+    for (c = 1, nb = 1; c < list->count * 2; ++c)
+	if ( bounds[c] != bounds[nb - 1] )
+	    bounds[nb++] = bounds[c];
+
+    seg_bits = xt_malloc(nb * per_seg, sizeof(*seg_bits));
+    if ( seg_bits == NULL )
+    {
+	fputs("isoform_segment_gene(): Could not allocate bitsets.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    memset(seg_bits, 0, nb * per_seg * sizeof(*seg_bits));
+    for (c = 0; c < list->count; ++c)
+    {
+	f = &list->features[c];
+	lo = isoform_bound_index(bounds, nb, f->start);
+	hi = isoform_bound_index(bounds, nb, f->end);
+	for (k = lo; k < hi; ++k)
+	    seg_bits[k * per_seg + f->slot * words + f->tx / ISOFORM_WORD_BITS]
+		|= (uint64_t)1 << (f->tx % ISOFORM_WORD_BITS);
+    }
+
+    for (k = 0; k + 1 < nb; ++k)
+    {
+	b = seg_bits + k * per_seg;
+	for (w = 0; (w < per_seg) && (b[w] == 0); ++w)
+	    ;
+	if ( w == per_seg )
+	    continue;   // Between transcripts
+	if ( iso->segment_count == iso->segment_array_size )
+	{
+	    iso->segment_array_size = iso->segment_array_size == 0 ? 65536 :
+				      iso->segment_array_size * 2;
+	    iso->segs = xt_realloc(iso->segs, iso->segment_array_size,
+				   sizeof(*iso->segs));
+	}
+	while ( iso->bit_count + per_seg > iso->bit_array_size )
+	{
+	    iso->bit_array_size = iso->bit_array_size == 0 ? 65536 :
+				  iso->bit_array_size * 2;
+	    iso->bits = xt_realloc(iso->bits, iso->bit_array_size,
+				   sizeof(*iso->bits));
+	}
+	if ( (iso->segs == NULL) || (iso->bits == NULL) )
+	{
+	    fputs("isoform_segment_gene(): Could not allocate segments.\n",
+		  stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	seg = &iso->segs[iso->segment_count];
+	seg->gene = iso->gene_count - 1;
+	seg->bits = iso->bit_count;
+	memcpy(iso->bits + iso->bit_count, b, per_seg * sizeof(*b));
+	iso->bit_count += per_seg;
+	feature_index_add(&iso->segments, chrom, bounds[k], bounds[k + 1],
+			  "", strand);
+	iso->segments.gene[iso->segments.count - 1] = iso->segment_count++;
+    }
+    free(bounds);
+    free(seg_bits);
+    list->count = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Build an isoform index from the unsorted augmented BED, where each
+ *      gene is followed by its transcripts, each followed by its
+ *      subfeatures, and the block ends with a "###" line.  Subfeatures
+ *      of a gene with no transcript records are assigned to the gene
+ *      itself as a single transcript.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     isoform_index_load(isoform_index_t *iso, const char *augmented_filename,
+			   const char *priority_list)
+
+{
+    FILE                    *bed_stream;
+    bl_bed_t                bed_feature = BL_BED_INIT;
+    isoform_feature_list_t  features = ISOFORM_FEATURE_LIST_INIT;
+    isoform_gene_t          *gene = NULL;
+    fi_chrom_t              *ch;
+    size_t                  chrom = 0;
+    char                    *name, *tx_name,
+			    type[BL_BED_NAME_MAX_CHARS + 1],
+			    strand = '.';
+    unsigned                slot;
+    int                     status, ch_in;
+
+    if ( isoform_index_init(iso, priority_list) != FEATURE_INDEX_OK )
+	return FEATURE_INDEX_BAD_DATA;
+    if ( (bed_stream = xt_fopen(augmented_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "isoform_index_load(): Cannot open %s: %s\n",
+		augmented_filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    fputs("Segmenting transcripts...\n", stderr);
+    bl_bed_skip_header(bed_stream);
+    while ( true )
+    {
+	// "###" ends a gene block
+	while ( (ch_in = getc(bed_stream)) == '#' )
+	{
+	    if ( gene != NULL )
+		isoform_segment_gene(iso, chrom, strand, &features);
+	    gene = NULL;
+	    tsv_skip_rest_of_line(bed_stream);
+	}
+	ungetc(ch_in, bed_stream);
+	if ( (status = bl_bed_read(&bed_feature, bed_stream, BL_BED_FIELD_ALL))
+		!= BL_READ_OK )
+	    break;
+	name = BL_BED_FIELDS(&bed_feature) > 3 ? BL_BED_NAME(&bed_feature) : "";
+	snprintf(type, sizeof(type), "%.*s", (int)strcspn(name, ";"), name);
+	if ( gene == NULL )
+	{
+	    // Same test for a gene as gff_augment()
+	    if ( strstr(type, "gene") == NULL )
+		continue;
+	    chrom = feature_index_add_chrom(&iso->segments,
+					    BL_BED_CHROM(&bed_feature), chrom);
+	    ch = &iso->segments.chroms[chrom];
+	    if ( (ch->count != 0) &&
+		 (ch->first + ch->count != iso->segments.count) )
+	    {
+		fprintf(stderr, "isoform_index_load(): %s: chromosome %s is not contiguous.\n",
+			augmented_filename, BL_BED_CHROM(&bed_feature));
+		xt_fclose(bed_stream);
+		return FEATURE_INDEX_BAD_DATA;
+	    }
+	    isoform_add_gene(iso, name);
+	    gene = &iso->genes[iso->gene_count - 1];
+	    strand = BL_BED_FIELDS(&bed_feature) > 5 ?
+		     BL_BED_STRAND(&bed_feature) : '.';
+	}
+	else if ( gff_is_transcript(type) )
+	{
+	    tx_name = name[strlen(type)] == ';' ? name + strlen(type) + 1 : name;
+	    isoform_add_tx(iso, tx_name, strcspn(tx_name, ";"));
+	}
+	else if ( (slot = isoform_slot(iso, name)) < ISOFORM_MAX_CLASSES )
+	{
+	    if ( gene->tx_count == 0 )
+		isoform_add_tx(iso, gene->name, strlen(gene->name));
+	    isoform_feature_add(&features, BL_BED_CHROM_START(&bed_feature),
+				BL_BED_CHROM_END(&bed_feature),
+				gene->tx_count - 1, slot);
+	}
+    }
+    if ( gene != NULL )
+	isoform_segment_gene(iso, chrom, strand, &features);
+    xt_fclose(bed_stream);
+    free(features.features);
+    if ( status != BL_READ_EOF )
+	return FEATURE_INDEX_BAD_DATA;
+    fprintf(stderr, "%zu genes, %zu transcripts, %zu segments.\n",
+	    iso->gene_count, iso->tx_count, iso->segment_count);
+    feature_index_build(&iso->segments);
+    return FEATURE_INDEX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the transcripts overlapping chrom:[start, end) as a column
+ *      of comma-separated "transcript:class" entries, each with the
+ *      transcript's highest priority class there, or "." if none.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    isoform_assign(isoform_index_t *iso, size_t chrom, int64_t start,
+		       int64_t end, hit_list_t *hits, isoform_query_t *q,
+		       FILE *outfile)
+
+{
+    isoform_segment_t   *seg;
+    isoform_gene_t      *gene;
+    uint64_t            *acc, bit;
+    size_t              h, t, w, per_gene, tx;
+    unsigned            slot;
+    bool                written = false;
+
+    q->count = q->bit_count = 0;
+    feature_index_overlaps(&iso->segments, chrom, start, end, hits);
+    for (h = 0; h < hits->count; ++h)
+    {
+	seg = &iso->segs[iso->segments.gene[hits->index[h]]];
+	per_gene = iso->class_count * iso->genes[seg->gene].words;
+	for (t = 0; (t < q->count) && (q->gene[t] != seg->gene); ++t)
+	    ;
+	if ( t == q->count )
+	{
+	    if ( q->count == q->array_size )
+	    {
+		q->array_size = q->array_size == 0 ? 16 : q->array_size * 2;
+		q->gene = xt_realloc(q->gene, q->array_size, sizeof(*q->gene));
+		q->offset = xt_realloc(q->offset, q->array_size,
+				       sizeof(*q->offset));
+	    }
+	    while ( q->bit_count + per_gene > q->bit_array_size )
+	    {
+		q->bit_array_size = q->bit_array_size == 0 ? 256 :
+				    q->bit_array_size * 2;
+		q->bits = xt_realloc(q->bits, q->bit_array_size,
+				     sizeof(*q->bits));
+	    }
+	    if ( (q->gene == NULL) || (q->offset == NULL) || (q->bits == NULL) )
+	    {
+		fputs("isoform_assign(): Could not allocate bitsets.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	    q->gene[t] = seg->gene;
+	    q->offset[t] = q->bit_count;
+	    memset(q->bits + q->bit_count, 0, per_gene * sizeof(*q->bits));
+	    q->bit_count += per_gene;
+	    ++q->count;
+	}
+	acc = q->bits + q->offset[t];
+	for (w = 0; w < per_gene; ++w)
+	    acc[w] |= iso->bits[seg->bits + w];
+    }
+
+    // Slots are in priority order, so the first set is the class
+    for (t = 0; t < q->count; ++t)
+    {
+	gene = &iso->genes[q->gene[t]];
+	acc = q->bits + q->offset[t];
+	for (tx = 0; tx < gene->tx_count; ++tx)
+	{
+	    w = tx / ISOFORM_WORD_BITS;
+	    bit = (uint64_t)1 << (tx % ISOFORM_WORD_BITS);
+	    for (slot = 0; slot < iso->class_count; ++slot)
+		if ( acc[slot * gene->words + w] & bit )
+		{
+		    fprintf(outfile, "%c%s:%s", written ? ',' : '\t',
+			    iso->tx_names[gene->first_tx + tx],
+			    feature_index_class_name(&iso->segments,
+						     iso->class_id[slot]));
+		    written = true;
+		    break;
+		}
+	}
+    }
+    if ( !written )
+	fputs("\t.", outfile);
+}
+
+
+void    isoform_query_free(isoform_query_t *q)
+
+{
+    free(q->gene);
+    free(q->offset);
+    free(q->bits);
+}
+
+
+void    isoform_index_free(isoform_index_t *iso)
+
+{
+    size_t  c;
+
+    for (c = 0; c < iso->gene_count; ++c)
+    {
+	free(iso->genes[c].name);
+	free(iso->genes[c].id);
+    }
+    for (c = 0; c < iso->tx_count; ++c)
+	free(iso->tx_names[c]);
+    free(iso->genes);
+    free(iso->tx_names);
+    free(iso->segs);
+    free(iso->bits);
+    feature_index_free(&iso->segments);
+}
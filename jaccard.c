@@ -0,0 +1,250 @@
+/***************************************************************************
+ *  Description:
+ *      Pairwise Jaccard similarity of many peak sets in one sweep.
+ *      Start and end events from all samples are swept together per
+ *      chromosome, and the length of each segment between events is
+ *      credited to every pair of samples active over it.  The diagonal
+ *      is the merged length of each sample, so
+ *      Jaccard(i, j) = I(i, j) / (I(i, i) + I(j, j) - I(i, j)),
+ *      as with bedtools jaccard, without N^2 separate runs.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+int     sample_event_cmp(const sample_event_t *e1, const sample_event_t *e2)
+
+{
+    if ( e1->pos != e2->pos )
+	return e1->pos < e2->pos ? -1 : 1;
+    return e1->delta - e2->delta;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Thread body: sort and sweep chromosomes first_chrom,
+ *      first_chrom + chrom_step, ...
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    *jaccard_thread(void *arg)
+
+{
+    jaccard_thread_t    *jt = arg;
+    sample_event_t      *events;
+    size_t              c, e, n, a, b, active_count, *active, *active_pos;
+    unsigned            *depth, sample;
+    int64_t             pos, len, *row;
+
+    depth = xt_malloc(jt->samples, sizeof(*depth));
+    active = xt_malloc(jt->samples, sizeof(*active));
+    active_pos = xt_malloc(jt->samples, sizeof(*active_pos));
+    if ( (depth == NULL) || (active == NULL) || (active_pos == NULL) )
+    {
+	fputs("jaccard_thread(): Could not allocate active set.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = jt->first_chrom; c < jt->chrom_count; c += jt->chrom_step)
+    {
+	events = jt->events + jt->chrom_first[c];
+	n = jt->chrom_first[c + 1] - jt->chrom_first[c];
+	qsort(events, n, sizeof(*events),
+	      (int (*)(const void *, const void *))sample_event_cmp);
+	memset(depth, 0, jt->samples * sizeof(*depth));
+	active_count = 0;
+	pos = 0;
+	for (e = 0; e < n; ++e)
+	{
+	    if ( (len = events[e].pos - pos) > 0 )
+	    {
+		// Active samples overlap each other over this segment
+		for (a = 0; a < active_count; ++a)
+		{
+		    row = jt->intersect + active[a] * jt->samples;
+		    for (b = 0; b < active_count; ++b)
+			row[active[b]] += len;
+		}
+	    }
+	    pos = events[e].pos;
+	    sample = events[e].sample;
+	    // Overlapping peaks within a sample are merged by depth
+	    if ( events[e].delta > 0 )
+	    {
+		if ( depth[sample]++ == 0 )
+		{
+		    active_pos[sample] = active_count;
+		    active[active_count++] = sample;
+		}
+	    }
+	    else if ( --depth[sample] == 0 )
+	    {
+		a = active_pos[sample];
+		active[a] = active[--active_count];
+		active_pos[active[a]] = a;
+	    }
+	}
+    }
+    free(depth);
+    free(active);
+    free(active_pos);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute the intersection length of every pair of samples.
+ *      Peak sets must share the chromosome numbering of fi, as
+ *      produced by peak_set_read() with the same fi.  intersect must
+ *      have room for samples x samples values.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     jaccard_matrix(feature_index_t *fi, peak_set_t *sets, size_t samples,
+		       unsigned threads, int64_t *intersect)
+
+{
+    jaccard_thread_t    thread_args[PC_MAX_THREADS];
+    pthread_t           thread_ids[PC_MAX_THREADS];
+    sample_event_t      *events;
+    size_t              *chrom_first, *next, total = 0, s, p, c,
+			matrix_size = samples * samples;
+    unsigned            t;
+
+    for (s = 0; s < samples; ++s)
+	total += sets[s].count * 2;
+    events = xt_malloc(total + 1, sizeof(*events));
+    chrom_first = xt_malloc(fi->chrom_count + 1, sizeof(*chrom_first));
+    next = xt_malloc(fi->chrom_count + 1, sizeof(*next));
+    if ( (events == NULL) || (chrom_first == NULL) || (next == NULL) )
+    {
+	fputs("jaccard_matrix(): Could not allocate events.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+
+    // Bucket events by chromosome so each thread gets whole chromosomes
+    memset(chrom_first, 0, (fi->chrom_count + 1) * sizeof(*chrom_first));
+    for (s = 0; s < samples; ++s)
+	for (p = 0; p < sets[s].count; ++p)
+	    chrom_first[sets[s].chrom[p] + 1] += 2;
+    for (c = 0; c < fi->chrom_count; ++c)
+	chrom_first[c + 1] += chrom_first[c];
+    memcpy(next, chrom_first, fi->chrom_count * sizeof(*next));
+    for (s = 0; s < samples; ++s)
+	for (p = 0; p < sets[s].count; ++p)
+	{
+	    c = sets[s].chrom[p];
+	    events[next[c]].pos = sets[s].start[p];
+	    events[next[c]].delta = 1;
+	    events[next[c]++].sample = s;
+	    events[next[c]].pos = sets[s].end[p];
+	    events[next[c]].delta = -1;
+	    events[next[c]++].sample = s;
+	}
+    free(next);
+
+    if ( threads > fi->chrom_count )
+	threads = fi->chrom_count == 0 ? 1 : fi->chrom_count;
+    for (t = 0; t < threads; ++t)
+    {
+	thread_args[t].samples = samples;
+	thread_args[t].chrom_count = fi->chrom_count;
+	thread_args[t].first_chrom = t;
+	thread_args[t].chrom_step = threads;
+	thread_args[t].chrom_first = chrom_first;
+	thread_args[t].events = events;
+	thread_args[t].intersect = xt_malloc(matrix_size,
+					     sizeof(*thread_args[t].intersect));
+	if ( thread_args[t].intersect == NULL )
+	{
+	    fputs("jaccard_matrix(): Could not allocate matrix.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	memset(thread_args[t].intersect, 0,
+	       matrix_size * sizeof(*thread_args[t].intersect));
+	if ( pthread_create(&thread_ids[t], NULL, jaccard_thread,
+			    &thread_args[t]) != 0 )
+	{
+	    fputs("jaccard_matrix(): pthread_create() failed.\n", stderr);
+	    return EX_OSERR;
+	}
+    }
+    memset(intersect, 0, matrix_size * sizeof(*intersect));
+    for (t = 0; t < threads; ++t)
+    {
+	pthread_join(thread_ids[t], NULL);
+	for (p = 0; p < matrix_size; ++p)
+	    intersect[p] += thread_args[t].intersect[p];
+	free(thread_args[t].intersect);
+    }
+    free(events);
+    free(chrom_first);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the Jaccard matrix followed by the intersection length
+ *      matrix.  The first row of each is headed by the matrix name.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    jaccard_write(sample_list_t *samples, int64_t *intersect,
+		      FILE *outfile)
+
+{
+    size_t  i, j, n = samples->count;
+    int64_t union_bp;
+
+    fputs("#Jaccard", outfile);
+    for (j = 0; j < n; ++j)
+	fprintf(outfile, "\t%s", samples->names[j]);
+    putc('\n', outfile);
+    for (i = 0; i < n; ++i)
+    {
+	fputs(samples->names[i], outfile);
+	for (j = 0; j < n; ++j)
+	{
+	    union_bp = intersect[i * n + i] + intersect[j * n + j] -
+		       intersect[i * n + j];
+	    fprintf(outfile, "\t%.6f", union_bp == 0 ? 0.0 :
+		    (double)intersect[i * n + j] / union_bp);
+	}
+	putc('\n', outfile);
+    }
+
+    fputs("#Intersection-bp", outfile);
+    for (j = 0; j < n; ++j)
+	fprintf(outfile, "\t%s", samples->names[j]);
+    putc('\n', outfile);
+    for (i = 0; i < n; ++i)
+    {
+	fputs(samples->names[i], outfile);
+	for (j = 0; j < n; ++j)
+	    fprintf(outfile, "\t%" PRId64, intersect[i * n + j]);
+	putc('\n', outfile);
+    }
+}
@@ -0,0 +1,446 @@
+/***************************************************************************
+ *  Description:
+ *      Streaming splice junction counts.  Junctions are the gaps between
+ *      the CIGAR blocks of each alignment, keyed by donor, acceptor, and
+ *      strand, counted in one hash table per chromosome, and annotated as
+ *      known or novel by exact lookup in a table of the introns derived
+ *      by gff_augment().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+void    junction_set_init(junction_set_t *set)
+
+{
+    feature_index_init(&set->chroms);
+    set->shards = NULL;
+    set->shard_array_size = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the shard for chrom, adding it if new.  hint is the shard
+ *      index last used, which is usually the right one for sorted input.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+junction_shard_t    *junction_shard(junction_set_t *set, const char *chrom,
+				    size_t *hint)
+
+{
+    size_t  old_size = set->shard_array_size;
+
+    *hint = feature_index_add_chrom(&set->chroms, chrom, *hint);
+    if ( *hint >= set->shard_array_size )
+    {
+	set->shard_array_size = set->shard_array_size == 0 ? 64 :
+				set->shard_array_size * 2;
+	set->shards = xt_realloc(set->shards, set->shard_array_size,
+				 sizeof(*set->shards));
+	if ( set->shards == NULL )
+	{
+	    fputs("junction_shard(): Could not allocate shards.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	memset(set->shards + old_size, 0,
+	       (set->shard_array_size - old_size) * sizeof(*set->shards));
+    }
+    return &set->shards[*hint];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the table position of the junction start,end,strand in
+ *      shard, which is either the junction or the empty slot where it
+ *      belongs.  Table size is a power of 2.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  junction_find(junction_shard_t *shard, int64_t start, int64_t end,
+		      char strand)
+
+{
+    size_t      mask = shard->table_size - 1, pos;
+    junction_t  *j;
+
+    pos = (((uint64_t)start * 0x9e3779b97f4a7c15ULL) ^ (uint64_t)end ^
+	   (uint64_t)strand << 56) * 0x9e3779b97f4a7c15ULL >> 32 & mask;
+    for (j = &shard->table[pos]; j->count != 0; j = &shard->table[pos])
+    {
+	if ( (j->start == start) && (j->end == end) && (j->strand == strand) )
+	    break;
+	pos = (pos + 1) & mask;
+    }
+    return pos;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Double the shard table, reinserting all junctions.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    junction_grow(junction_shard_t *shard)
+
+{
+    junction_t  *old_table = shard->table;
+    size_t      old_size = shard->table_size, c;
+
+    shard->table_size = old_size == 0 ? JUNCTION_HASH_START_SIZE :
+			old_size * 2;
+    shard->table = xt_malloc(shard->table_size, sizeof(*shard->table));
+    if ( shard->table == NULL )
+    {
+	fputs("junction_grow(): Could not allocate table.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    memset(shard->table, 0, shard->table_size * sizeof(*shard->table));
+    for (c = 0; c < old_size; ++c)
+	if ( old_table[c].count != 0 )
+	    shard->table[junction_find(shard, old_table[c].start,
+				       old_table[c].end, old_table[c].strand)] =
+		old_table[c];
+    free(old_table);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add count to the junction start,end,strand in shard.  name is
+ *      kept from the first addition.
+ *
+ *  Returns:
+ *      The junction
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+junction_t  *junction_add(junction_shard_t *shard, int64_t start, int64_t end,
+			  char strand, const char *name, uint64_t count)
+
+{
+    junction_t  *j;
+    size_t      pos;
+
+    // Keep the load factor at most 1/2
+    if ( (shard->used + 1) * 2 > shard->table_size )
+	junction_grow(shard);
+    pos = junction_find(shard, start, end, strand);
+    j = &shard->table[pos];
+    if ( j->count == 0 )
+    {
+	j->start = start;
+	j->end = end;
+	j->strand = strand;
+	j->name = name == NULL ? NULL : strdup(name);
+	++shard->used;
+    }
+    j->count += count;
+    return j;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the junction start,end,strand on chrom, or NULL if not
+ *      present.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+junction_t  *junction_lookup(junction_set_t *set, const char *chrom,
+			     size_t *hint, int64_t start, int64_t end,
+			     char strand)
+
+{
+    junction_shard_t    *shard;
+    size_t              pos;
+
+    *hint = feature_index_find_chrom(&set->chroms, chrom, *hint);
+    if ( *hint == set->chroms.chrom_count )
+	return NULL;
+    shard = &set->shards[*hint];
+    if ( shard->used == 0 )
+	return NULL;
+    pos = junction_find(shard, start, end, strand);
+    return shard->table[pos].count == 0 ? NULL : &shard->table[pos];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Load the introns from a sorted augmented BED, named for the
+ *      transcript part of the BED name.  Introns shared by several
+ *      transcripts on the same strand are stored once, with the first
+ *      name.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     junction_introns_load(junction_set_t *introns, const char *bed_filename)
+
+{
+    FILE        *bed_stream;
+    bl_bed_t    bed_feature = BL_BED_INIT;
+    char        *name, *p;
+    size_t      chrom = 0;
+    int         status;
+
+    if ( (bed_stream = xt_fopen(bed_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "junction_introns_load(): Cannot open %s: %s\n",
+		bed_filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    bl_bed_skip_header(bed_stream);
+    while ( (status = bl_bed_read(&bed_feature, bed_stream, BL_BED_FIELD_ALL))
+	    == BL_READ_OK )
+    {
+	if ( (BL_BED_FIELDS(&bed_feature) < 4) ||
+	     (strncmp(name = BL_BED_NAME(&bed_feature), "intron;", 7) != 0) )
+	    continue;
+	name += 7;
+	if ( (p = strchr(name, ';')) != NULL )
+	    *p = '\0';
+	junction_add(junction_shard(introns, BL_BED_CHROM(&bed_feature), &chrom),
+		     BL_BED_CHROM_START(&bed_feature),
+		     BL_BED_CHROM_END(&bed_feature),
+		     BL_BED_FIELDS(&bed_feature) > 5 ?
+			BL_BED_STRAND(&bed_feature) : '.', name, 1);
+    }
+    xt_fclose(bed_stream);
+    return status == BL_READ_EOF ? FEATURE_INDEX_OK : FEATURE_INDEX_BAD_DATA;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the transcript strand of a spliced alignment from its XS
+ *      tag (HISAT2, STAR, TopHat) or ts tag (minimap2), or '.' if it has
+ *      neither.  ts is relative to the read, so it is flipped for
+ *      reverse strand alignments.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+char    junction_strand(sam_record_t *rec)
+
+{
+    const char  *value;
+
+    if ( ((value = sam_record_tag(rec, "XS")) != NULL) &&
+	 ((*value == '+') || (*value == '-')) )
+	return *value;
+    if ( ((value = sam_record_tag(rec, "ts")) != NULL) &&
+	 ((*value == '+') || (*value == '-')) )
+    {
+	if ( rec->flag & BL_SAM_FLAG_REVERSE )
+	    return *value == '+' ? '-' : '+';
+	return *value;
+    }
+    return '.';
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Count the junctions of every alignment in a SAM stream.  Each gap
+ *      between consecutive CIGAR blocks is one junction, from the first
+ *      skipped base to one past the last, on the strand given by
+ *      junction_strand().  Unmapped, secondary, supplementary, QC
+ *      failed, and duplicate alignments and those below min_mapq are
+ *      skipped.  Input need not be sorted.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, or another sam_record_read() status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     junction_scan(junction_set_t *junctions, FILE *sam_stream,
+		      unsigned min_mapq, uint64_t *spliced_reads)
+
+{
+    // bl_sam_read() discards the tags that give the strand
+    sam_record_t        rec = SAM_RECORD_INIT;
+    sam_blocks_t        blocks = SAM_BLOCKS_INIT;
+    junction_shard_t    *shard = NULL;
+    char                *rname = NULL, strand;
+    size_t              chrom = 0, b;
+    int                 status;
+
+    while ( (status = sam_record_read(&rec, sam_stream)) == BL_READ_OK )
+    {
+	if ( (rec.flag & (BL_SAM_FLAG_UNMAP | BL_SAM_FLAG_SECONDARY |
+			  BL_SAM_FLAG_SUPPLEMENTARY | BL_SAM_FLAG_QCFAIL |
+			  BL_SAM_FLAG_DUP)) ||
+	     (rec.mapq < min_mapq) ||
+	     (strchr(SAM_RECORD_FIELD(&rec, SAM_RECORD_CIGAR), 'N') == NULL) )
+	    continue;
+	sam_blocks_parse(&blocks, rec.pos - 1,
+			 SAM_RECORD_FIELD(&rec, SAM_RECORD_CIGAR));
+	if ( blocks.count < 2 )
+	    continue;
+	if ( (rname == NULL) ||
+	     (strcmp(rname, SAM_RECORD_FIELD(&rec, SAM_RECORD_RNAME)) != 0) )
+	{
+	    free(rname);
+	    rname = strdup(SAM_RECORD_FIELD(&rec, SAM_RECORD_RNAME));
+	    shard = junction_shard(junctions, rname, &chrom);
+	}
+	strand = junction_strand(&rec);
+	for (b = 1; b < blocks.count; ++b)
+	    junction_add(shard, blocks.end[b - 1], blocks.start[b], strand,
+			 NULL, 1);
+	++*spliced_reads;
+    }
+    free(rname);
+    sam_blocks_free(&blocks);
+    sam_record_free(&rec);
+    return status;
+}
+
+
+int     junction_cmp(const junction_t *j1, const junction_t *j2)
+
+{
+    if ( j1->start != j2->start )
+	return j1->start < j2->start ? -1 : 1;
+    if ( j1->end != j2->end )
+	return j1->end < j2->end ? -1 : 1;
+    return j1->strand - j2->strand;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write junctions sorted by position and strand within each
+ *      chromosome, in order of first appearance, with the name of the
+ *      matching annotated intron, or "novel".  A stranded junction
+ *      matches an intron on the same strand or an unstranded one.  An
+ *      unstranded junction matches an intron on either strand, but is
+ *      still written with strand '.' so that it is not confused with
+ *      the separately counted stranded junction.  known and novel
+ *      receive the number of distinct junctions of each kind.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    junction_write(junction_set_t *junctions, junction_set_t *introns,
+		       FILE *outfile, size_t *known, size_t *novel)
+
+{
+    junction_shard_t    *shard;
+    junction_t          *sorted = NULL, *intron;
+    size_t              c, s, n, array_size = 0, intron_chrom = 0;
+    const char          *chrom;
+
+    *known = *novel = 0;
+    fputs("#Chr\tJ-start\tJ-end\tStrand\tReads\tStatus\tIntron\n", outfile);
+    for (c = 0; c < junctions->chroms.chrom_count; ++c)
+    {
+	shard = &junctions->shards[c];
+	chrom = junctions->chroms.chroms[c].name;
+	if ( shard->used > array_size )
+	{
+	    array_size = shard->used;
+	    if ( (sorted = xt_realloc(sorted, array_size, sizeof(*sorted)))
+		    == NULL )
+	    {
+		fputs("junction_write(): Could not allocate junctions.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	for (s = n = 0; s < shard->table_size; ++s)
+	    if ( shard->table[s].count != 0 )
+		sorted[n++] = shard->table[s];
+	qsort(sorted, n, sizeof(*sorted),
+	      (int (*)(const void *, const void *))junction_cmp);
+	for (s = 0; s < n; ++s)
+	{
+	    if ( sorted[s].strand == '.' )
+	    {
+		if ( (intron = junction_lookup(introns, chrom, &intron_chrom,
+			sorted[s].start, sorted[s].end, '+')) == NULL )
+		    intron = junction_lookup(introns, chrom, &intron_chrom,
+			sorted[s].start, sorted[s].end, '-');
+	    }
+	    else
+		intron = junction_lookup(introns, chrom, &intron_chrom,
+					 sorted[s].start, sorted[s].end,
+					 sorted[s].strand);
+	    if ( intron == NULL )
+		intron = junction_lookup(introns, chrom, &intron_chrom,
+					 sorted[s].start, sorted[s].end, '.');
+	    fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\t%c\t%" PRIu64
+		    "\t%s\t%s\n", chrom, sorted[s].start, sorted[s].end,
+		    sorted[s].strand, sorted[s].count,
+		    intron == NULL ? "novel" : "known",
+		    intron == NULL ? "." : intron->name);
+	    if ( intron == NULL )
+		++*novel;
+	    else
+		++*known;
+	}
+    }
+    free(sorted);
+}
+
+
+void    junction_set_free(junction_set_t *set)
+
+{
+    size_t  c, s;
+
+    for (c = 0; c < set->chroms.chrom_count; ++c)
+    {
+	for (s = 0; s < set->shards[c].table_size; ++s)
+	    if ( set->shards[c].table[s].count != 0 )
+		free(set->shards[c].table[s].name);
+	free(set->shards[c].table);
+    }
+    free(set->shards);
+    set->shards = NULL;
+    set->shard_array_size = 0;
+    feature_index_free(&set->chroms);
+}
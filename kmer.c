@@ -0,0 +1,521 @@
+/***************************************************************************
+ *  Description:
+ *      Canonical k-mer frequencies of peak sequences by peak class,
+ *      compared against all peaks.  K-mers are packed 2 bits per base
+ *      and updated with a rolling shift on both strands, so each base
+ *      costs a few integer operations regardless of k.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Initialize counts for k-mers of length k in slots slots.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_counts_init(kmer_counts_t *kc, unsigned k, size_t slots)
+
+{
+    size_t  size;
+
+    kc->k = k;
+    kc->slots = slots;
+    kc->dense = k <= KMER_DENSE_MAX_K;
+    kc->used = 0;
+    if ( kc->dense )
+    {
+	kc->table_size = (size_t)1 << (2 * k);
+	size = slots * kc->table_size;
+	kc->keys = NULL;
+    }
+    else
+    {
+	kc->table_size = size = KMER_HASH_START_SIZE;
+	if ( (kc->keys = xt_malloc(size, sizeof(*kc->keys))) == NULL )
+	{
+	    fputs("kmer_counts_init(): Could not allocate keys.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	memset(kc->keys, 0xff, size * sizeof(*kc->keys));
+    }
+    kc->counts = xt_malloc(size, sizeof(*kc->counts));
+    kc->totals = xt_malloc(slots, sizeof(*kc->totals));
+    if ( (kc->counts == NULL) || (kc->totals == NULL) )
+    {
+	fputs("kmer_counts_init(): Could not allocate counts.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    memset(kc->counts, 0, size * sizeof(*kc->counts));
+    memset(kc->totals, 0, slots * sizeof(*kc->totals));
+}
+
+
+void    kmer_counts_free(kmer_counts_t *kc)
+
+{
+    free(kc->counts);
+    free(kc->keys);
+    free(kc->totals);
+    kc->counts = kc->totals = NULL;
+    kc->keys = NULL;
+    kc->table_size = kc->used = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the hash table position of key, which is either the key or
+ *      the empty slot where it belongs.  Table size is a power of 2.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  kmer_hash_find(kmer_counts_t *kc, uint64_t key)
+
+{
+    size_t  mask = kc->table_size - 1,
+	    pos = (key * 0x9e3779b97f4a7c15ULL) >> 32 & mask;
+
+    while ( (kc->keys[pos] != key) && (kc->keys[pos] != KMER_HASH_EMPTY) )
+	pos = (pos + 1) & mask;
+    return pos;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Double the hash table, reinserting all keys.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_hash_grow(kmer_counts_t *kc)
+
+{
+    uint64_t    *old_keys = kc->keys;
+    int64_t     *old_counts = kc->counts;
+    size_t      old_size = kc->table_size, c, pos;
+
+    kc->table_size *= 2;
+    kc->keys = xt_malloc(kc->table_size, sizeof(*kc->keys));
+    kc->counts = xt_malloc(kc->table_size, sizeof(*kc->counts));
+    if ( (kc->keys == NULL) || (kc->counts == NULL) )
+    {
+	fputs("kmer_hash_grow(): Could not allocate table.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    memset(kc->keys, 0xff, kc->table_size * sizeof(*kc->keys));
+    for (c = 0; c < old_size; ++c)
+    {
+	if ( old_keys[c] != KMER_HASH_EMPTY )
+	{
+	    pos = kmer_hash_find(kc, old_keys[c]);
+	    kc->keys[pos] = old_keys[c];
+	    kc->counts[pos] = old_counts[c];
+	}
+    }
+    free(old_keys);
+    free(old_counts);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add count to k-mer kmer in slot.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_counts_add(kmer_counts_t *kc, size_t slot, uint64_t kmer,
+			int64_t count)
+
+{
+    uint64_t    key;
+    size_t      pos;
+
+    kc->totals[slot] += count;
+    if ( kc->dense )
+    {
+	kc->counts[slot * kc->table_size + kmer] += count;
+	return;
+    }
+    key = kmer << KMER_SLOT_BITS | slot;
+    pos = kmer_hash_find(kc, key);
+    if ( kc->keys[pos] == KMER_HASH_EMPTY )
+    {
+	// Keep the load factor at most 1/2
+	if ( (kc->used + 1) * 2 > kc->table_size )
+	{
+	    kmer_hash_grow(kc);
+	    pos = kmer_hash_find(kc, key);
+	}
+	kc->keys[pos] = key;
+	kc->counts[pos] = 0;
+	++kc->used;
+    }
+    kc->counts[pos] += count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the count of kmer in slot.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t kmer_counts_get(kmer_counts_t *kc, size_t slot, uint64_t kmer)
+
+{
+    size_t  pos;
+
+    if ( kc->dense )
+	return kc->counts[slot * kc->table_size + kmer];
+    pos = kmer_hash_find(kc, kmer << KMER_SLOT_BITS | slot);
+    return kc->keys[pos] == KMER_HASH_EMPTY ? 0 : kc->counts[pos];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add all counts in src to dest.  Dense arrays are summed directly.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_counts_merge(kmer_counts_t *dest, kmer_counts_t *src)
+
+{
+    size_t  c, size;
+
+    if ( dest->dense )
+    {
+	size = dest->slots * dest->table_size;
+	for (c = 0; c < size; ++c)
+	    dest->counts[c] += src->counts[c];
+	for (c = 0; c < dest->slots; ++c)
+	    dest->totals[c] += src->totals[c];
+	return;
+    }
+    for (c = 0; c < src->table_size; ++c)
+	if ( src->keys[c] != KMER_HASH_EMPTY )
+	    kmer_counts_add(dest, src->keys[c] & ((1 << KMER_SLOT_BITS) - 1),
+			    src->keys[c] >> KMER_SLOT_BITS, src->counts[c]);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Count the canonical k-mers of len encoded bases into slot and the
+ *      background slot.  K-mers containing N are skipped.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_count_seq(kmer_counts_t *kc, size_t slot, const uint8_t *codes,
+		       size_t len)
+
+{
+    uint64_t    mask = ((uint64_t)1 << (2 * kc->k)) - 1,
+		fwd = 0, rev = 0;
+    unsigned    shift = 2 * (kc->k - 1), run = 0;
+    size_t      c, background = kc->slots - 1;
+
+    for (c = 0; c < len; ++c)
+    {
+	if ( codes[c] == BASE_OTHER )
+	{
+	    run = 0;
+	    continue;
+	}
+	fwd = ((fwd << 2) | codes[c]) & mask;
+	rev = (rev >> 2) | ((uint64_t)(3 - codes[c]) << shift);
+	if ( ++run >= kc->k )
+	{
+	    kmer_counts_add(kc, slot, XT_MIN(fwd, rev), 1);
+	    kmer_counts_add(kc, background, XT_MIN(fwd, rev), 1);
+	}
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Thread body: classify every peak_step'th peak of a chromosome and
+ *      count its k-mers under its class.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    *kmer_thread(void *arg)
+
+{
+    kmer_thread_t   *kt = arg;
+    hit_list_t      hits = HIT_LIST_INIT;
+    size_t          c, peak;
+    int64_t         start, end;
+    unsigned        class_id;
+
+    for (c = kt->first_peak; c < kt->peak_count; c += kt->peak_step)
+    {
+	peak = kt->peak_indexes[c];
+	start = kt->peaks->start[peak];
+	end = XT_MIN(kt->peaks->end[peak], kt->len);
+	class_id = feature_index_classify(kt->fi, kt->chrom, start,
+				kt->peaks->end[peak], kt->params, &hits, NULL);
+	if ( start < end )
+	    kmer_count_seq(&kt->counts, class_id == FEATURE_CLASS_NONE ?
+			   kt->fi->class_count : class_id,
+			   kt->codes + start, end - start);
+    }
+    hit_list_free(&hits);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      peak_seq_sweep() callback: count the peaks of one chromosome
+ *      across threads.  Each thread keeps its own counts, so there is no
+ *      locking.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     kmer_count_chrom(void *arg, size_t chrom, const uint8_t *codes,
+			 int64_t len, const size_t *peak_indexes,
+			 size_t peak_count)
+
+{
+    kmer_scan_t     *scan = arg;
+    kmer_thread_t   *kt;
+    pthread_t       thread_ids[PC_MAX_THREADS];
+    unsigned        t;
+
+    for (t = 0; t < scan->threads; ++t)
+    {
+	kt = &scan->thread_args[t];
+	kt->chrom = chrom;
+	kt->codes = codes;
+	kt->len = len;
+	kt->peak_indexes = peak_indexes;
+	kt->peak_count = peak_count;
+	if ( pthread_create(&thread_ids[t], NULL, kmer_thread, kt) != 0 )
+	{
+	    fputs("kmer_count_chrom(): pthread_create() failed.\n", stderr);
+	    return EX_OSERR;
+	}
+    }
+    for (t = 0; t < scan->threads; ++t)
+	pthread_join(thread_ids[t], NULL);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Decode a packed k-mer into a string.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_decode(uint64_t kmer, unsigned k, char *str)
+
+{
+    unsigned    c;
+
+    for (c = 0; c < k; ++c)
+	str[c] = "ACGT"[(kmer >> 2 * (k - 1 - c)) & 3];
+    str[k] = '\0';
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write one k-mer of one class with its frequency in all peaks and
+ *      log2 enrichment over all peaks.  Counts get a pseudocount of 0.5
+ *      for the ratio so k-mers absent from the background are finite.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_write_row(kmer_counts_t *kc, feature_index_t *fi, size_t slot,
+		       uint64_t kmer, int64_t count, FILE *outfile)
+
+{
+    size_t  background = kc->slots - 1;
+    int64_t bg_count = kmer_counts_get(kc, background, kmer);
+    char    str[KMER_MAX_K + 1];
+
+    kmer_decode(kmer, kc->k, str);
+    fprintf(outfile, "%s\t%s\t%" PRId64 "\t%.6g\t%.6g\t%.4f\n",
+	    feature_index_class_name(fi, slot == fi->class_count ?
+				     FEATURE_CLASS_NONE : slot),
+	    str, count, (double)count / kc->totals[slot],
+	    (double)bg_count / kc->totals[background],
+	    log2(((count + 0.5) / kc->totals[slot]) /
+		 ((bg_count + 0.5) / kc->totals[background])));
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Order hash keys by slot, then k-mer.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     kmer_key_cmp(const uint64_t *key1, const uint64_t *key2)
+
+{
+    uint64_t    slot_mask = (1 << KMER_SLOT_BITS) - 1,
+		k1 = (*key1 & slot_mask) << 56 | *key1 >> KMER_SLOT_BITS,
+		k2 = (*key2 & slot_mask) << 56 | *key2 >> KMER_SLOT_BITS;
+
+    return k1 < k2 ? -1 : k1 > k2 ? 1 : 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the table of canonical k-mers found in each class, ordered
+ *      by class, then k-mer.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    kmer_write(kmer_counts_t *kc, feature_index_t *fi, FILE *outfile)
+
+{
+    size_t      slot, background = kc->slots - 1, c, n;
+    uint64_t    kmer, *keys, slot_mask = (1 << KMER_SLOT_BITS) - 1;
+    int64_t     count;
+
+    fputs("#Class\tK-mer\tCount\tFrequency\tBackground-frequency\tLog2-enrichment\n",
+	  outfile);
+    if ( kc->dense )
+    {
+	for (slot = 0; slot < background; ++slot)
+	{
+	    for (kmer = 0; kmer < kc->table_size; ++kmer)
+	    {
+		// Only canonical k-mers have counts
+		if ( (count = kc->counts[slot * kc->table_size + kmer]) != 0 )
+		    kmer_write_row(kc, fi, slot, kmer, count, outfile);
+	    }
+	}
+	return;
+    }
+
+    if ( (keys = xt_malloc(kc->used, sizeof(*keys))) == NULL )
+    {
+	fputs("kmer_write(): Could not allocate keys.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0, n = 0; c < kc->table_size; ++c)
+	if ( (kc->keys[c] != KMER_HASH_EMPTY) &&
+	     ((kc->keys[c] & slot_mask) != background) )
+	    keys[n++] = kc->keys[c];
+    qsort(keys, n, sizeof(*keys),
+	  (int (*)(const void *, const void *))kmer_key_cmp);
+    for (c = 0; c < n; ++c)
+    {
+	slot = keys[c] & slot_mask;
+	kmer = keys[c] >> KMER_SLOT_BITS;
+	kmer_write_row(kc, fi, slot, kmer, kmer_counts_get(kc, slot, kmer),
+		       outfile);
+    }
+    free(keys);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Count canonical k-mers in all peaks by class, reading sequences
+ *      from the genome FASTA one chromosome at a time, and write the
+ *      enrichment table.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     kmer_scan(unsigned k, const char *genome_filename, feature_index_t *fi,
+		  peak_set_t *peaks, overlap_params_t *params,
+		  unsigned threads, FILE *outfile)
+
+{
+    kmer_scan_t     scan;
+    kmer_thread_t   thread_args[PC_MAX_THREADS];
+    unsigned        t;
+    int             status;
+
+    scan.fi = fi;
+    scan.peaks = peaks;
+    scan.params = params;
+    scan.threads = threads;
+    scan.thread_args = thread_args;
+    for (t = 0; t < threads; ++t)
+    {
+	thread_args[t].fi = fi;
+	thread_args[t].peaks = peaks;
+	thread_args[t].params = params;
+	thread_args[t].first_peak = t;
+	thread_args[t].peak_step = threads;
+	// Classes, unclassified, and background
+	kmer_counts_init(&thread_args[t].counts, k, fi->class_count + 2);
+    }
+
+    status = peak_seq_sweep(genome_filename, fi, peaks, kmer_count_chrom,
+			    &scan);
+    for (t = 1; t < threads; ++t)
+    {
+	kmer_counts_merge(&thread_args[0].counts, &thread_args[t].counts);
+	kmer_counts_free(&thread_args[t].counts);
+    }
+    if ( status == EX_OK )
+	kmer_write(&thread_args[0].counts, fi, outfile);
+    kmer_counts_free(&thread_args[0].counts);
+    return status;
+}
@@ -0,0 +1,316 @@
+/***************************************************************************
+ *  Description:
+ *      Liftover of peaks between assemblies using a UCSC chain file, as
+ *      peaks are read.  The aligned blocks of all chains are held in a
+ *      feature index on the old assembly, so each peak is mapped with
+ *      one interval tree query.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Load the aligned blocks of every chain in a chain file into
+ *      chains, indexed by position on the old (target) assembly.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     liftover_load(feature_index_t *chains, const char *chain_filename)
+
+{
+    FILE    *stream;
+    char    line[LIFTOVER_LINE_MAX + 1],
+	    t_name[BL_CHROM_MAX_CHARS + 1],
+	    q_name[BL_CHROM_MAX_CHARS + 1],
+	    name[BL_CHROM_MAX_CHARS + 64],
+	    t_strand, q_strand;
+    size_t  chrom = 0, id, blocks = 0;
+    int64_t t_size, t_start, t_end, q_size, q_start, q_end,
+	    size, dt, dq, t_pos = 0, q_pos = 0, origin;
+    double  score;
+    bool    in_chain = false;
+    int     fields;
+
+    feature_index_init(chains);
+    if ( (stream = xt_fopen(chain_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "liftover_load(): Cannot open %s: %s\n",
+		chain_filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    fprintf(stderr, "Loading %s...\n", chain_filename);
+    while ( fgets(line, LIFTOVER_LINE_MAX, stream) != NULL )
+    {
+	if ( memcmp(line, "chain", 5) == 0 )
+	{
+	    if ( sscanf(line, "chain %lf %256s %" SCNd64 " %c %" SCNd64 " %" SCNd64
+			" %256s %" SCNd64 " %c %" SCNd64 " %" SCNd64 " %zu",
+			&score, t_name, &t_size, &t_strand, &t_start, &t_end,
+			q_name, &q_size, &q_strand, &q_start, &q_end, &id) != 12 )
+	    {
+		fprintf(stderr, "liftover_load(): Bad chain header: %s", line);
+		xt_fclose(stream);
+		return FEATURE_INDEX_BAD_DATA;
+	    }
+	    chrom = feature_index_add_chrom(chains, t_name, chrom);
+	    t_pos = t_start;
+	    q_pos = q_start;
+	    in_chain = true;
+	}
+	else if ( in_chain && ((fields = sscanf(line, "%" SCNd64 " %" SCNd64
+				" %" SCNd64, &size, &dt, &dq)) >= 1) )
+	{
+	    // q_pos is on the - strand for - chains
+	    origin = q_strand == '-' ? q_size - q_pos : q_pos;
+	    snprintf(name, sizeof(name), "%zu\t%s\t%" PRId64, id, q_name, origin);
+	    feature_index_add(chains, chrom, t_pos, t_pos + size, name, q_strand);
+	    ++blocks;
+	    if ( fields == 3 )
+	    {
+		t_pos += size + dt;
+		q_pos += size + dq;
+	    }
+	    else
+		in_chain = false;
+	}
+    }
+    xt_fclose(stream);
+    fprintf(stderr, "Indexing %zu aligned blocks...\n", blocks);
+    feature_index_build(chains);
+    return FEATURE_INDEX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Map chrom:[start, end) through every chain it overlaps.  Each
+ *      chain aligning at least min_match of the region gives one lifted
+ *      interval, from the first to the last aligned base, in lifted.
+ *
+ *  Returns:
+ *      The number of lifted intervals
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  liftover_region(feature_index_t *chains, const char *chrom,
+			int64_t start, int64_t end, double min_match,
+			hit_list_t *hits, liftover_hit_t **lifted,
+			size_t *lifted_size)
+
+{
+    size_t          chrom_index, h, c, count = 0, lifted_count;
+    size_t          feature, id;
+    int64_t         a, b, origin, fstart, new_start, new_end;
+    char            *p;
+    liftover_hit_t  *lh;
+
+    if ( ((chrom_index = feature_index_find_chrom(chains, chrom, 0))
+	    == chains->chrom_count) || (end <= start) ||
+	 (feature_index_overlaps(chains, chrom_index, start, end, hits) == 0) )
+	return 0;
+
+    // Accumulate aligned bases and lifted extent per chain
+    for (h = 0; h < hits->count; ++h)
+    {
+	feature = hits->index[h];
+	fstart = chains->start[feature];
+	a = XT_MAX(start, fstart);
+	b = XT_MIN(end, chains->end[feature]);
+	id = strtoul(chains->name[feature], &p, 10);
+	origin = strtoll(p + 1 + strcspn(p + 1, "\t"), NULL, 10);
+	if ( chains->strand[feature] == '-' )
+	{
+	    new_start = origin - (b - fstart);
+	    new_end = origin - (a - fstart);
+	}
+	else
+	{
+	    new_start = origin + (a - fstart);
+	    new_end = origin + (b - fstart);
+	}
+	for (c = 0; (c < count) && ((*lifted)[c].id != id); ++c)
+	    ;
+	if ( c == count )
+	{
+	    if ( count == *lifted_size )
+	    {
+		*lifted_size = *lifted_size == 0 ? 16 : *lifted_size * 2;
+		if ( (*lifted = xt_realloc(*lifted, *lifted_size,
+					   sizeof(**lifted))) == NULL )
+		{
+		    fputs("liftover_region(): Could not allocate chains.\n",
+			  stderr);
+		    exit(EX_UNAVAILABLE);
+		}
+	    }
+	    lh = &(*lifted)[count++];
+	    lh->id = id;
+	    ++p;
+	    memcpy(lh->chrom, p, XT_MIN(strcspn(p, "\t"), BL_CHROM_MAX_CHARS));
+	    lh->chrom[XT_MIN(strcspn(p, "\t"), BL_CHROM_MAX_CHARS)] = '\0';
+	    lh->strand = chains->strand[feature];
+	    lh->matched = 0;
+	    lh->start = new_start;
+	    lh->end = new_end;
+	}
+	lh = &(*lifted)[c];
+	lh->matched += b - a;
+	lh->start = XT_MIN(lh->start, new_start);
+	lh->end = XT_MAX(lh->end, new_end);
+    }
+
+    // Keep chains meeting min_match
+    for (c = 0, lifted_count = 0; c < count; ++c)
+	if ( (*lifted)[c].matched >= min_match * (end - start) )
+	    (*lifted)[lifted_count++] = (*lifted)[c];
+    return lifted_count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Lift every peak in a BED stream, writing one line per lifted
+ *      interval with the name and score of the peak.  The strand is
+ *      reversed for peaks lifted through - strand chains.  Peaks that
+ *      no chain aligns well enough are dropped.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    liftover_stream(feature_index_t *chains, FILE *in, FILE *out,
+			double min_match)
+
+{
+    bl_bed_t        bed_feature = BL_BED_INIT;
+    hit_list_t      hits = HIT_LIST_INIT;
+    liftover_hit_t  *lifted = NULL;
+    size_t          lifted_size = 0, count, c,
+		    peaks = 0, dropped = 0, split = 0;
+    char            strand;
+
+    bl_bed_skip_header(in);
+    while ( bl_bed_read(&bed_feature, in, BL_BED_FIELD_ALL) == BL_READ_OK )
+    {
+	++peaks;
+	count = liftover_region(chains, BL_BED_CHROM(&bed_feature),
+			BL_BED_CHROM_START(&bed_feature),
+			BL_BED_CHROM_END(&bed_feature), min_match, &hits,
+			&lifted, &lifted_size);
+	if ( count == 0 )
+	    ++dropped;
+	else if ( count > 1 )
+	    ++split;
+	for (c = 0; c < count; ++c)
+	{
+	    fprintf(out, "%s\t%" PRId64 "\t%" PRId64, lifted[c].chrom,
+		    lifted[c].start, lifted[c].end);
+	    if ( BL_BED_FIELDS(&bed_feature) > 3 )
+		fprintf(out, "\t%s", BL_BED_NAME(&bed_feature));
+	    if ( BL_BED_FIELDS(&bed_feature) > 4 )
+		fprintf(out, "\t%u", BL_BED_SCORE(&bed_feature));
+	    if ( BL_BED_FIELDS(&bed_feature) > 5 )
+	    {
+		strand = BL_BED_STRAND(&bed_feature);
+		if ( lifted[c].strand == '-' )
+		    strand = strand == '+' ? '-' : strand == '-' ? '+' : strand;
+		fprintf(out, "\t%c", strand);
+	    }
+	    putc('\n', out);
+	}
+    }
+    fprintf(stderr, "Lifted %zu peaks, dropped %zu, split %zu across chains.\n",
+	    peaks - dropped, dropped, split);
+    free(lifted);
+    hit_list_free(&hits);
+}
+
+
+void    *liftover_thread(void *arg)
+
+{
+    liftover_thread_t   *lt = arg;
+
+    liftover_stream(lt->chains, lt->in, lt->out, lt->min_match);
+    xt_fclose(lt->in);
+    fclose(lt->out);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return a stream of the peaks in peak_stream lifted through chains,
+ *      fed by a thread, so any mode can read lifted peaks without a
+ *      temporary file.  A socket pair is used rather than a pipe, since
+ *      xt_fclose() would pclose() a pipe.
+ *
+ *  Returns:
+ *      The lifted peak stream, or NULL on failure
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+FILE    *liftover_pipe(feature_index_t *chains, FILE *peak_stream,
+		       double min_match)
+
+{
+    static liftover_thread_t    lt;
+    pthread_t   thread_id;
+    int         fds[2];
+    FILE        *lifted_stream;
+
+    if ( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 )
+    {
+	fprintf(stderr, "liftover_pipe(): socketpair() failed: %s\n",
+		strerror(errno));
+	return NULL;
+    }
+    // A popen() child such as bedtools holding the write end would block EOF
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    lt.chains = chains;
+    lt.in = peak_stream;
+    lt.min_match = min_match;
+    if ( ((lt.out = fdopen(fds[1], "w")) == NULL) ||
+	 ((lifted_stream = fdopen(fds[0], "r")) == NULL) )
+    {
+	fputs("liftover_pipe(): fdopen() failed.\n", stderr);
+	return NULL;
+    }
+    if ( pthread_create(&thread_id, NULL, liftover_thread, &lt) != 0 )
+    {
+	fputs("liftover_pipe(): pthread_create() failed.\n", stderr);
+	return NULL;
+    }
+    pthread_detach(thread_id);
+    return lifted_stream;
+}
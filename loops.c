@@ -0,0 +1,290 @@
+/***************************************************************************
+ *  Description:
+ *      Classification of both anchors of BEDPE chromatin loops in one
+ *      pass.  Anchors are read into a single peak set, sorted by
+ *      position so that interval tree queries and the nearest gene sweep
+ *      move forward through each chromosome, and results are scattered
+ *      back by anchor index so loops are written in input order.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Read BEDPE loops, adding any chromosomes not present in the
+ *      feature index.  Only the two anchors and the name are used.
+ *      Loops with an unpaired anchor ("." with -1 coordinates) are
+ *      counted in skipped.  If midpoints_only is true, each anchor is
+ *      reduced to its midpoint, as with --midpoints.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     loop_set_read(loop_set_t *loops, FILE *stream, feature_index_t *fi,
+		      bool midpoints_only, size_t *skipped)
+
+{
+    char    line[LOOP_LINE_MAX + 1],
+	    chrom1[BL_CHROM_MAX_CHARS + 1],
+	    chrom2[BL_CHROM_MAX_CHARS + 1],
+	    name[LOOP_LINE_MAX + 1];
+    int64_t start1, end1, start2, end2;
+    size_t  chrom = 0, line_num = 0;
+    int     fields, ch;
+
+    *skipped = 0;
+    while ( fgets(line, LOOP_LINE_MAX, stream) != NULL )
+    {
+	++line_num;
+	// Only the leading fields are needed from overlong lines
+	if ( strchr(line, '\n') == NULL )
+	    while ( ((ch = getc(stream)) != EOF) && (ch != '\n') )
+		;
+	if ( (*line == '#') || (*line == '\n') ||
+	     (memcmp(line, "track", 5) == 0) ||
+	     (memcmp(line, "browser", 7) == 0) )
+	    continue;
+	fields = sscanf(line, "%256s %" SCNd64 " %" SCNd64 " %256s %" SCNd64
+			" %" SCNd64 " %s", chrom1, &start1, &end1,
+			chrom2, &start2, &end2, name);
+	if ( fields < 6 )
+	{
+	    fprintf(stderr, "loop_set_read(): Line %zu: Expected BEDPE.\n",
+		    line_num);
+	    return FEATURE_INDEX_BAD_DATA;
+	}
+	if ( (start1 < 0) || (start2 < 0) )
+	{
+	    ++*skipped;
+	    continue;
+	}
+	if ( midpoints_only )
+	{
+	    start1 = (start1 + end1) / 2;
+	    end1 = start1 + 1;
+	    start2 = (start2 + end2) / 2;
+	    end2 = start2 + 1;
+	}
+	chrom = feature_index_add_chrom(fi, chrom1, chrom);
+	peak_set_add(&loops->anchors, chrom, start1, end1,
+		     fields > 6 ? name : NULL);
+	chrom = feature_index_add_chrom(fi, chrom2, chrom);
+	peak_set_add(&loops->anchors, chrom, start2, end2, NULL);
+    }
+    return FEATURE_INDEX_OK;
+}
+
+
+// qsort() has no argument for context, so loop_anchor_cmp() uses this
+static peak_set_t   *Sort_anchors;
+
+int     loop_anchor_cmp(const size_t *a1, const size_t *a2)
+
+{
+    size_t  c1 = Sort_anchors->chrom[*a1], c2 = Sort_anchors->chrom[*a2];
+    int64_t s1 = Sort_anchors->start[*a1], s2 = Sort_anchors->start[*a2];
+
+    if ( c1 != c2 )
+	return c1 < c2 ? -1 : 1;
+    if ( s1 != s2 )
+	return s1 < s2 ? -1 : 1;
+    return *a1 < *a2 ? -1 : *a1 > *a2;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify every anchor in position order, storing each class at
+ *      the anchor's input index.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    loop_classify(loop_set_t *loops, feature_index_t *fi,
+		      overlap_params_t *params)
+
+{
+    peak_set_t  *anchors = &loops->anchors;
+    hit_list_t  hits = HIT_LIST_INIT;
+    size_t      c, a;
+
+    loops->order = xt_malloc(anchors->count + 1, sizeof(*loops->order));
+    loops->class_id = xt_malloc(anchors->count + 1, sizeof(*loops->class_id));
+    if ( (loops->order == NULL) || (loops->class_id == NULL) )
+    {
+	fputs("loop_classify(): Could not allocate anchors.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (c = 0; c < anchors->count; ++c)
+	loops->order[c] = c;
+    Sort_anchors = anchors;
+    qsort(loops->order, anchors->count, sizeof(*loops->order),
+	  (int (*)(const void *, const void *))loop_anchor_cmp);
+
+    for (c = 0; c < anchors->count; ++c)
+    {
+	a = loops->order[c];
+	loops->class_id[a] = feature_index_classify(fi, anchors->chrom[a],
+				anchors->start[a], anchors->end[a], params,
+				&hits, NULL);
+    }
+    hit_list_free(&hits);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Find the gene TSS nearest the midpoint of every anchor, in one
+ *      sweep of the sorted anchors over the sorted TSSs.  fi must be
+ *      loaded with track_genes and loop_classify() must have sorted the
+ *      anchors.  The distance is positive downstream of the TSS, as
+ *      with --great.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    loop_nearest_genes(loop_set_t *loops, feature_index_t *fi)
+
+{
+    peak_set_t      *anchors = &loops->anchors;
+    great_gene_t    *genes, *best;
+    size_t          c, a, g, k, n = fi->gene_count, chrom;
+    int64_t         mid;
+
+    genes = xt_malloc(n + 1, sizeof(*genes));
+    loops->gene = xt_malloc(anchors->count + 1, sizeof(*loops->gene));
+    loops->distance = xt_malloc(anchors->count + 1, sizeof(*loops->distance));
+    if ( (genes == NULL) || (loops->gene == NULL) || (loops->distance == NULL) )
+    {
+	fputs("loop_nearest_genes(): Could not allocate genes.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    for (g = 0; g < n; ++g)
+    {
+	genes[g].gene = &fi->genes[g];
+	genes[g].chrom = fi->genes[g].chrom;
+	genes[g].tss = fi->genes[g].strand == '-' ?
+		       fi->genes[g].end - 1 : fi->genes[g].start;
+	genes[g].basal_start = genes[g].basal_end = genes[g].tss;
+    }
+    qsort(genes, n, sizeof(*genes),
+	  (int (*)(const void *, const void *))great_gene_cmp);
+
+    // g is the first TSS at or after the anchor start, which only moves
+    // forward since anchors are sorted by start
+    for (c = g = 0; c < anchors->count; ++c)
+    {
+	a = loops->order[c];
+	chrom = anchors->chrom[a];
+	mid = (anchors->start[a] + anchors->end[a]) / 2;
+	while ( (g < n) && ((genes[g].chrom < chrom) ||
+		((genes[g].chrom == chrom) &&
+		 (genes[g].tss < anchors->start[a]))) )
+	    ++g;
+	for (k = g; (k < n) && (genes[k].chrom == chrom) &&
+		    (genes[k].tss <= mid); ++k)
+	    ;
+
+	// Nearest is the last TSS <= mid or the first beyond it
+	best = NULL;
+	if ( (k > 0) && (genes[k - 1].chrom == chrom) )
+	    best = &genes[k - 1];
+	if ( (k < n) && (genes[k].chrom == chrom) &&
+	     ((best == NULL) || (genes[k].tss - mid < mid - best->tss)) )
+	    best = &genes[k];
+	if ( best == NULL )
+	    loops->gene[a] = NULL;
+	else
+	{
+	    loops->gene[a] = best->gene;
+	    loops->distance[a] = best->gene->strand == '-' ?
+				 best->tss - mid : mid - best->tss;
+	}
+    }
+    free(genes);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write each loop in input order with the class of both anchors,
+ *      and their nearest genes if loop_nearest_genes() was run.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    loop_write(loop_set_t *loops, feature_index_t *fi, FILE *outfile)
+
+{
+    peak_set_t  *anchors = &loops->anchors;
+    size_t      l, a, side;
+
+    fputs("#Chr1\tA1-start\tA1-end\tChr2\tA2-start\tA2-end\tName\t"
+	  "Class1\tClass2", outfile);
+    if ( loops->gene != NULL )
+	fputs("\tGene1\tGene2", outfile);
+    putc('\n', outfile);
+    for (l = 0; l < anchors->count; l += 2)
+    {
+	for (side = 0; side < 2; ++side)
+	{
+	    a = l + side;
+	    fprintf(outfile, "%s%s\t%" PRId64 "\t%" PRId64, side == 0 ? "" : "\t",
+		    fi->chroms[anchors->chrom[a]].name,
+		    anchors->start[a], anchors->end[a]);
+	}
+	fprintf(outfile, "\t%s\t%s\t%s",
+		anchors->name[l] == NULL ? "." : anchors->name[l],
+		feature_index_class_name(fi, loops->class_id[l]),
+		feature_index_class_name(fi, loops->class_id[l + 1]));
+	if ( loops->gene != NULL )
+	{
+	    for (a = l; a < l + 2; ++a)
+	    {
+		if ( loops->gene[a] == NULL )
+		    fputs("\t.", outfile);
+		else
+		    fprintf(outfile, "\t%s(%+" PRId64 ")",
+			    loops->gene[a]->name, loops->distance[a]);
+	    }
+	}
+	putc('\n', outfile);
+    }
+}
+
+
+void    loop_set_free(loop_set_t *loops)
+
+{
+    peak_set_free(&loops->anchors);
+    free(loops->order);
+    free(loops->class_id);
+    free(loops->gene);
+    free(loops->distance);
+    loops->order = NULL;
+    loops->class_id = NULL;
+    loops->gene = NULL;
+    loops->distance = NULL;
+}
@@ -0,0 +1,572 @@
+/***************************************************************************
+ *  Description:
+ *      Position weight matrix scanning of peak sequences.  Motifs are
+ *      read from MEME or JASPAR files and converted to integer log-odds
+ *      against a uniform background.  Both strands of each peak are
+ *      scored by summing one matrix column at a time over all windows,
+ *      a simple loop that compilers vectorize.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+#define MOTIF_LINE_MAX  65536
+
+/***************************************************************************
+ *  Description:
+ *      Add a motif from a frequency or count matrix, freq[b][j] for base
+ *      b (ACGT) at position j.  Columns are normalized, so counts and
+ *      probabilities are both accepted.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK or FEATURE_INDEX_BAD_DATA for an empty column
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     motif_add(motif_set_t *set, const char *id, const char *name,
+		  size_t width, double freq[4][MOTIF_MAX_WIDTH])
+
+{
+    motif_t *motif;
+    size_t  j, b;
+    double  total, p;
+    int32_t *col, *rc_col, min, max;
+
+    if ( set->count == set->array_size )
+    {
+	set->array_size = set->array_size == 0 ? 64 : set->array_size * 2;
+	if ( (set->motifs = xt_realloc(set->motifs, set->array_size,
+				       sizeof(*set->motifs))) == NULL )
+	{
+	    fputs("motif_add(): Could not allocate motifs.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    motif = &set->motifs[set->count];
+    motif->score = xt_malloc(width * BASE_CODES, sizeof(*motif->score));
+    motif->rc_score = xt_malloc(width * BASE_CODES, sizeof(*motif->rc_score));
+    if ( (motif->score == NULL) || (motif->rc_score == NULL) )
+    {
+	fputs("motif_add(): Could not allocate matrix.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+
+    motif->min_score = motif->max_score = 0;
+    for (j = 0; j < width; ++j)
+    {
+	for (b = 0, total = 0.0; b < 4; ++b)
+	    total += freq[b][j];
+	if ( total <= 0.0 )
+	{
+	    fprintf(stderr, "motif_add(): Empty column %zu in %s.\n", j + 1, id);
+	    free(motif->score);
+	    free(motif->rc_score);
+	    return FEATURE_INDEX_BAD_DATA;
+	}
+	col = motif->score + j * BASE_CODES;
+	min = INT32_MAX;
+	max = INT32_MIN;
+	for (b = 0; b < 4; ++b)
+	{
+	    p = (freq[b][j] / total + MOTIF_PSEUDOCOUNT) /
+		(1.0 + 4 * MOTIF_PSEUDOCOUNT);
+	    col[b] = lround(MOTIF_SCALE * log2(p / 0.25));
+	    min = XT_MIN(min, col[b]);
+	    max = XT_MAX(max, col[b]);
+	}
+	col[BASE_OTHER] = min;
+	motif->min_score += min;
+	motif->max_score += max;
+    }
+
+    // Minus strand: column j of the reverse complement is the
+    // complement of column width - 1 - j
+    for (j = 0; j < width; ++j)
+    {
+	col = motif->score + (width - 1 - j) * BASE_CODES;
+	rc_col = motif->rc_score + j * BASE_CODES;
+	for (b = 0; b < 4; ++b)
+	    rc_col[b] = col[3 - b];
+	rc_col[BASE_OTHER] = col[BASE_OTHER];
+    }
+
+    motif->id = strdup(id);
+    motif->name = strdup(name);
+    motif->width = width;
+    ++set->count;
+    return FEATURE_INDEX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Parse up to MOTIF_MAX_WIDTH numbers from a JASPAR matrix row such
+ *      as "A  [ 3 0 12 ]" or "3 0 12".  The row's leading base letter
+ *      is returned in base, or '\0' if there is none.
+ *
+ *  Returns:
+ *      The number of values parsed
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+size_t  motif_parse_row(char *line, double *values, char *base)
+
+{
+    char    *p = line, *end;
+    size_t  count = 0;
+
+    while ( isspace(*p) )
+	++p;
+    *base = '\0';
+    if ( isalpha(*p) )
+	*base = toupper(*p++);
+    while ( (*p != '\0') && (*p != ']') )
+    {
+	if ( isspace(*p) || (*p == '[') )
+	{
+	    ++p;
+	    continue;
+	}
+	if ( count == MOTIF_MAX_WIDTH )
+	    return MOTIF_MAX_WIDTH + 1;
+	values[count] = strtod(p, &end);
+	if ( end == p )
+	    return 0;
+	++count;
+	p = end;
+    }
+    return count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Split a header line into id and name at the first whitespace.
+ *      name is the id if there is no second word.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    motif_split_header(char *line, char **id, char **name)
+
+{
+    char    *p;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    while ( isspace(*line) )
+	++line;
+    *id = line;
+    p = line + strcspn(line, " \t");
+    if ( *p == '\0' )
+    {
+	*name = *id;
+	return;
+    }
+    *p++ = '\0';
+    while ( isspace(*p) )
+	++p;
+    *name = *p == '\0' ? *id : p;
+    p[strcspn(p, " \t")] = '\0';
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read motifs from a MEME text file ("MOTIF id name" followed by a
+ *      letter-probability matrix) or a JASPAR file (">id name" followed
+ *      by A, C, G and T count rows).  Other lines are ignored.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     motif_set_read(motif_set_t *set, const char *filename)
+
+{
+    FILE    *stream;
+    static char line[MOTIF_LINE_MAX + 1];
+    char    header[MOTIF_LINE_MAX + 1], *id = NULL, *name = NULL, *p, base;
+    double  freq[4][MOTIF_MAX_WIDTH], values[MOTIF_MAX_WIDTH + 1];
+    size_t  width, count, row, b;
+    int     status = FEATURE_INDEX_OK;
+    static const char   bases[] = "ACGT";
+
+    if ( (stream = xt_fopen(filename, "r")) == NULL )
+    {
+	fprintf(stderr, "motif_set_read(): Cannot open %s: %s\n",
+		filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    while ( (status == FEATURE_INDEX_OK) &&
+	    (fgets(line, MOTIF_LINE_MAX, stream) != NULL) )
+    {
+	if ( *line == '>' )
+	{
+	    // JASPAR: four rows follow, in ACGT order if not labeled
+	    strlcpy(header, line + 1, MOTIF_LINE_MAX);
+	    motif_split_header(header, &id, &name);
+	    for (row = 0, width = 0; (row < 4) && (status == FEATURE_INDEX_OK);
+		 ++row)
+	    {
+		if ( fgets(line, MOTIF_LINE_MAX, stream) == NULL )
+		    status = FEATURE_INDEX_BAD_DATA;
+		else
+		{
+		    count = motif_parse_row(line, values, &base);
+		    if ( base == '\0' )
+			b = row;
+		    else if ( (p = strchr(bases, base)) != NULL )
+			b = p - bases;
+		    else
+			b = 4;
+		    if ( (count == 0) || (count > MOTIF_MAX_WIDTH) ||
+			 ((width != 0) && (count != width)) || (b == 4) )
+			status = FEATURE_INDEX_BAD_DATA;
+		    else
+		    {
+			width = count;
+			memcpy(freq[b], values, width * sizeof(*values));
+		    }
+		}
+	    }
+	    if ( status == FEATURE_INDEX_OK )
+		status = motif_add(set, id, name, width, freq);
+	}
+	else if ( memcmp(line, "MOTIF", 5) == 0 )
+	{
+	    strlcpy(header, line + 5, MOTIF_LINE_MAX);
+	    motif_split_header(header, &id, &name);
+	}
+	else if ( (p = strstr(line, "letter-probability matrix")) != NULL )
+	{
+	    // MEME: w= rows of four probabilities
+	    if ( (id == NULL) || ((p = strstr(p, "w=")) == NULL) ||
+		 ((width = strtoul(p + 2, NULL, 10)) == 0) ||
+		 (width > MOTIF_MAX_WIDTH) )
+		status = FEATURE_INDEX_BAD_DATA;
+	    for (row = 0; (row < width) && (status == FEATURE_INDEX_OK); )
+	    {
+		if ( fgets(line, MOTIF_LINE_MAX, stream) == NULL )
+		    status = FEATURE_INDEX_BAD_DATA;
+		else if ( strspn(line, " \t\r\n") == strlen(line) )
+		    continue;
+		else if ( (motif_parse_row(line, values, &base) != 4) ||
+			  (base != '\0') )
+		    status = FEATURE_INDEX_BAD_DATA;
+		else
+		{
+		    for (b = 0; b < 4; ++b)
+			freq[b][row] = values[b];
+		    ++row;
+		}
+	    }
+	    if ( status == FEATURE_INDEX_OK )
+		status = motif_add(set, id, name, width, freq);
+	    id = NULL;
+	}
+    }
+    xt_fclose(stream);
+    if ( status != FEATURE_INDEX_OK )
+	fprintf(stderr, "motif_set_read(): Bad matrix in %s near %s.\n",
+		filename, id == NULL ? "start" : id);
+    else if ( set->count == 0 )
+    {
+	fprintf(stderr, "motif_set_read(): No motifs in %s.\n", filename);
+	status = FEATURE_INDEX_BAD_DATA;
+    }
+    return status;
+}
+
+
+void    motif_set_free(motif_set_t *set)
+
+{
+    size_t  c;
+
+    for (c = 0; c < set->count; ++c)
+    {
+	free(set->motifs[c].id);
+	free(set->motifs[c].name);
+	free(set->motifs[c].score);
+	free(set->motifs[c].rc_score);
+    }
+    free(set->motifs);
+    set->count = set->array_size = 0;
+    set->motifs = NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Score all windows of one strand.  acc[i] receives the score of
+ *      the motif at codes[i].  Each pass adds one matrix column to every
+ *      window, so the inner loop is a table lookup and add with no
+ *      dependencies between iterations.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    motif_score_windows(const int32_t *restrict score, size_t width,
+			    const uint8_t *restrict codes, size_t windows,
+			    int32_t *restrict acc)
+
+{
+    const int32_t   *col;
+    const uint8_t   *seq;
+    size_t          i, j;
+
+    memset(acc, 0, windows * sizeof(*acc));
+    for (j = 0; j < width; ++j)
+    {
+	col = score + j * BASE_CODES;
+	seq = codes + j;
+	for (i = 0; i < windows; ++i)
+	    acc[i] += col[seq[i]];
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Find the best hit of a motif on either strand of len bases.
+ *      The plus strand wins ties, then the leftmost window.
+ *
+ *  Returns:
+ *      true if the sequence is at least as long as the motif
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+bool    motif_best_hit(const motif_t *motif, const uint8_t *codes, size_t len,
+		       int32_t *acc, motif_hit_t *hit)
+
+{
+    size_t  windows, i;
+    int     strand;
+
+    if ( len < motif->width )
+	return false;
+    windows = len - motif->width + 1;
+    hit->score = INT32_MIN;
+    for (strand = 0; strand < 2; ++strand)
+    {
+	motif_score_windows(strand == 0 ? motif->score : motif->rc_score,
+			    motif->width, codes, windows, acc);
+	for (i = 0; i < windows; ++i)
+	{
+	    if ( acc[i] > hit->score )
+	    {
+		hit->score = acc[i];
+		hit->offset = i;
+		hit->strand = strand == 0 ? '+' : '-';
+	    }
+	}
+    }
+    return true;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Thread body: classify and scan every peak_step'th peak of a chunk.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    *motif_thread(void *arg)
+
+{
+    motif_thread_t  *mt = arg;
+    hit_list_t      hits = HIT_LIST_INIT;
+    motif_hit_t     *result;
+    int32_t         *acc = NULL;
+    size_t          c, m, peak, acc_size = 0;
+    int64_t         start, end;
+
+    for (c = mt->first_peak; c < mt->peak_count; c += mt->peak_step)
+    {
+	peak = mt->peak_indexes[c];
+	start = mt->peaks->start[peak];
+	end = XT_MIN(mt->peaks->end[peak], mt->len);
+	mt->class_ids[c] = feature_index_classify(mt->fi, mt->chrom, start,
+				mt->peaks->end[peak], mt->params, &hits, NULL);
+	if ( (size_t)(end - start) > acc_size )
+	{
+	    acc_size = end - start;
+	    free(acc);
+	    if ( (acc = xt_malloc(acc_size, sizeof(*acc))) == NULL )
+	    {
+		fputs("motif_thread(): Could not allocate scores.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	for (m = 0; m < mt->motifs->count; ++m)
+	{
+	    result = &mt->results[c * mt->motifs->count + m];
+	    if ( (start >= end) ||
+		 !motif_best_hit(&mt->motifs->motifs[m], mt->codes + start,
+				 end - start, acc, result) )
+		result->strand = '\0';
+	}
+    }
+    free(acc);
+    hit_list_free(&hits);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      peak_seq_sweep() callback: scan the peaks of one chromosome in
+ *      chunks across threads and write the best hit of each motif in
+ *      each peak, if its relative score is at least the threshold.
+ *      Output is in input order regardless of the number of threads.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     motif_scan_chrom(void *arg, size_t chrom, const uint8_t *codes,
+			 int64_t len, const size_t *peak_indexes,
+			 size_t peak_count)
+
+{
+    motif_scan_t    *scan = arg;
+    motif_thread_t  thread_args[PC_MAX_THREADS];
+    pthread_t       thread_ids[PC_MAX_THREADS];
+    motif_hit_t     *results, *hit;
+    motif_t         *motif;
+    unsigned char   class_ids[MOTIF_CHUNK_PEAKS];
+    size_t          first, chunk, c, m, peak;
+    double          rel_score;
+    unsigned        t;
+
+    results = xt_malloc(MOTIF_CHUNK_PEAKS * scan->motifs->count,
+			sizeof(*results));
+    if ( results == NULL )
+    {
+	fputs("motif_scan_chrom(): Could not allocate results.\n", stderr);
+	return EX_UNAVAILABLE;
+    }
+    for (first = 0; first < peak_count; first += chunk)
+    {
+	chunk = XT_MIN(peak_count - first, MOTIF_CHUNK_PEAKS);
+	for (t = 0; t < scan->threads; ++t)
+	{
+	    thread_args[t].motifs = scan->motifs;
+	    thread_args[t].fi = scan->fi;
+	    thread_args[t].peaks = scan->peaks;
+	    thread_args[t].params = scan->params;
+	    thread_args[t].chrom = chrom;
+	    thread_args[t].codes = codes;
+	    thread_args[t].len = len;
+	    thread_args[t].peak_indexes = peak_indexes + first;
+	    thread_args[t].peak_count = chunk;
+	    thread_args[t].first_peak = t;
+	    thread_args[t].peak_step = scan->threads;
+	    thread_args[t].results = results;
+	    thread_args[t].class_ids = class_ids;
+	    if ( pthread_create(&thread_ids[t], NULL, motif_thread,
+				&thread_args[t]) != 0 )
+	    {
+		fputs("motif_scan_chrom(): pthread_create() failed.\n", stderr);
+		free(results);
+		return EX_OSERR;
+	    }
+	}
+	for (t = 0; t < scan->threads; ++t)
+	    pthread_join(thread_ids[t], NULL);
+
+	for (c = 0; c < chunk; ++c)
+	{
+	    peak = peak_indexes[first + c];
+	    for (m = 0; m < scan->motifs->count; ++m)
+	    {
+		hit = &results[c * scan->motifs->count + m];
+		motif = &scan->motifs->motifs[m];
+		if ( hit->strand == '\0' )
+		    continue;
+		rel_score = (double)(hit->score - motif->min_score) /
+			    (motif->max_score - motif->min_score);
+		if ( rel_score < scan->threshold )
+		    continue;
+		fprintf(scan->outfile,
+			"%s\t%" PRId64 "\t%" PRId64 "\t%s\t%s\t%s\t%s\t%.2f\t%.4f\t%d\t%c\n",
+			scan->fi->chroms[chrom].name, scan->peaks->start[peak],
+			scan->peaks->end[peak],
+			scan->peaks->name[peak] == NULL ? "." :
+			    scan->peaks->name[peak],
+			feature_index_class_name(scan->fi, class_ids[c]),
+			motif->id, motif->name,
+			(double)hit->score / MOTIF_SCALE, rel_score,
+			hit->offset, hit->strand);
+	    }
+	}
+    }
+    free(results);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Scan all peaks for all motifs, reading sequences from the genome
+ *      FASTA one chromosome at a time.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     motif_scan(motif_set_t *motifs, const char *genome_filename,
+		   feature_index_t *fi, peak_set_t *peaks,
+		   overlap_params_t *params, double threshold,
+		   unsigned threads, FILE *outfile)
+
+{
+    motif_scan_t    scan;
+
+    scan.motifs = motifs;
+    scan.fi = fi;
+    scan.peaks = peaks;
+    scan.params = params;
+    scan.threshold = threshold;
+    scan.threads = threads;
+    scan.outfile = outfile;
+    fputs("#Chr\tP-start\tP-end\tP-name\tClass\tMotif-ID\tMotif-name\t"
+	  "Score\tRel-score\tOffset\tStrand\n", outfile);
+    return peak_seq_sweep(genome_filename, fi, peaks, motif_scan_chrom, &scan);
+}
@@ -0,0 +1,564 @@
+/***************************************************************************
+ *  Description:
+ *      Lightweight built-in peak calling from sorted alignments.  The
+ *      fragment or cut-site pileup is built by the rolling coverage
+ *      engine, runs of equal depth are tested against a local Poisson
+ *      background, and the resulting peaks are written as narrowPeak
+ *      and fed to classification through a stream, as with --liftover.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+// One peak caller per run, joined by peak_call_finish()
+static peak_call_t  Peak_call;
+static pthread_t    Peak_call_thread_id;
+static bool         Peak_call_started = false;
+
+/***************************************************************************
+ *  Description:
+ *      Compute -log10 P(X >= k) for X Poisson with mean lambda, summing
+ *      the upper tail relative to its first term to avoid underflow.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+double  peak_call_log10p(int64_t k, double lambda)
+
+{
+    double  log_first, term = 1.0, sum = 1.0;
+    int64_t i;
+
+    if ( k <= 0 )
+	return 0.0;
+    if ( lambda < 1.0e-300 )
+	lambda = 1.0e-300;
+    log_first = -lambda + k * log(lambda) - lgamma(k + 1.0);
+    for (i = k + 1; ; ++i)
+    {
+	term *= lambda / i;
+	sum += term;
+	if ( (i > lambda) && (term < sum * 1.0e-12) )
+	    break;
+    }
+    return fmax(0.0, -(log_first + log(sum)) / M_LN10);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      coverage_t emit function: buffer one pileup run with the pileup
+ *      area before it, for local lambda lookups.  Runs are buffered for
+ *      one chromosome at a time, so chrom is only needed for errors.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    peak_call_run(void *arg, const char *chrom, int64_t start,
+		      int64_t end, int64_t depth)
+
+{
+    peak_call_t *pc = arg;
+    peak_run_t  *run;
+
+    if ( pc->run_count == pc->run_array_size )
+    {
+	pc->run_array_size = pc->run_array_size == 0 ? 4096 :
+			     pc->run_array_size * 2;
+	pc->runs = xt_realloc(pc->runs, pc->run_array_size, sizeof(*pc->runs));
+	if ( pc->runs == NULL )
+	{
+	    fprintf(stderr, "peak_call_run(): Could not allocate runs for %s.\n",
+		    chrom);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    run = &pc->runs[pc->run_count++];
+    run->start = start;
+    run->end = end;
+    run->depth = depth;
+    run->area = pc->area;
+    pc->area += (double)depth * (end - start);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the pileup area before position x.  *run is the first run
+ *      ending after the previous x, which must not decrease.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+double  peak_call_area(peak_call_t *pc, int64_t x, size_t *run)
+
+{
+    peak_run_t  *r;
+
+    while ( (*run < pc->run_count) && (pc->runs[*run].end <= x) )
+	++*run;
+    if ( *run == pc->run_count )
+	return pc->area;
+    r = &pc->runs[*run];
+    return x > r->start ? r->area + (double)r->depth * (x - r->start) : r->area;
+}
+
+
+void    peak_call_close_region(peak_call_t *pc)
+
+{
+    if ( !pc->region_open )
+	return;
+    pc->region_open = false;
+    if ( pc->region.end - pc->region.start < PEAK_CALL_MIN_LENGTH )
+	return;
+    if ( pc->peak_count == pc->peak_array_size )
+    {
+	pc->peak_array_size = pc->peak_array_size == 0 ? 1024 :
+			      pc->peak_array_size * 2;
+	pc->peaks = xt_realloc(pc->peaks, pc->peak_array_size,
+			       sizeof(*pc->peaks));
+	if ( pc->peaks == NULL )
+	{
+	    fputs("peak_call_close_region(): Could not allocate peaks.\n",
+		  stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    pc->region.chrom = strdup(pc->cov.chrom);
+    pc->peaks[pc->peak_count++] = pc->region;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Test each buffered run whose local window ends at or before
+ *      horizon, where the pileup is final, joining significant runs
+ *      within PEAK_CALL_MAX_GAP into candidate peaks.  Runs before the
+ *      window of the next run to test are then discarded.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    peak_call_test(peak_call_t *pc, int64_t horizon)
+
+{
+    peak_run_t  *r;
+    int64_t     mid, low, high;
+    double      lambda;
+    size_t      drop;
+
+    for (; pc->next_run < pc->run_count; ++pc->next_run)
+    {
+	r = &pc->runs[pc->next_run];
+	mid = (r->start + r->end) / 2;
+	if ( mid + PEAK_CALL_LOCAL > horizon )
+	    break;
+	low = mid > PEAK_CALL_LOCAL ? mid - PEAK_CALL_LOCAL : 0;
+	high = mid + PEAK_CALL_LOCAL;
+	lambda = (peak_call_area(pc, high, &pc->high_run) -
+		  peak_call_area(pc, low, &pc->low_run)) / (high - low);
+	if ( peak_call_log10p(r->depth, lambda) < pc->min_log10p )
+	    continue;
+	if ( pc->region_open &&
+	     (r->start - pc->region.end > PEAK_CALL_MAX_GAP) )
+	    peak_call_close_region(pc);
+	if ( !pc->region_open )
+	{
+	    pc->region_open = true;
+	    pc->region.start = r->start;
+	    pc->region.depth = 0;
+	}
+	pc->region.end = r->end;
+	if ( r->depth > pc->region.depth )
+	{
+	    pc->region.depth = r->depth;
+	    pc->region.summit = mid;
+	    pc->region.lambda = lambda;
+	}
+    }
+
+    // Keep memory bounded by the local window
+    drop = pc->low_run < pc->next_run ? pc->low_run : pc->next_run;
+    if ( (drop > 4096) && (drop * 2 > pc->run_count) )
+    {
+	memmove(pc->runs, pc->runs + drop,
+		(pc->run_count - drop) * sizeof(*pc->runs));
+	pc->run_count -= drop;
+	pc->next_run -= drop;
+	pc->low_run -= drop;
+	pc->high_run -= drop;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Finish the current chromosome: write its remaining pileup, test
+ *      all remaining runs, and reset the run buffer.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    peak_call_chrom_end(peak_call_t *pc)
+
+{
+    if ( pc->cov.chrom == NULL )
+	return;
+    coverage_flush(&pc->cov, pc->cov.last_event + 1);
+    peak_call_test(pc, INT64_MAX);
+    peak_call_close_region(pc);
+    if ( pc->run_count > 0 )
+	pc->extent_sum += pc->runs[pc->run_count - 1].end;
+    pc->total_area += pc->area;
+    pc->area = 0.0;
+    pc->run_count = pc->next_run = pc->low_run = pc->high_run = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Stream sorted alignments into the pileup, skipping unmapped,
+ *      secondary, supplementary, QC failed, duplicate, and low MAPQ
+ *      alignments.  Proper pairs contribute their whole fragment once,
+ *      from the mate with positive TLEN, and single-end reads are
+ *      extended to PEAK_CALL_FRAGMENT.  With cut_sites, each read
+ *      instead contributes PEAK_CALL_CUT_EXTEND bases either side of
+ *      its Tn5 insertion.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, or another BL_READ_ status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     peak_call_scan(peak_call_t *pc, FILE *sam_stream)
+
+{
+    bl_sam_t    alignment;
+    unsigned    flag;
+    int64_t     pos, start, end, insertion, last_pos = 0;
+    int         status;
+
+    // BL_SAM_INIT omits the qual sizes and bl_sam_init() the cigar sizes
+    memset(&alignment, 0, sizeof(alignment));
+
+    while ( (status = bl_sam_read(&alignment, sam_stream,
+				  BL_SAM_FIELD_FLAG | BL_SAM_FIELD_RNAME |
+				  BL_SAM_FIELD_POS | BL_SAM_FIELD_MAPQ |
+				  BL_SAM_FIELD_CIGAR | BL_SAM_FIELD_TLEN))
+	    == BL_READ_OK )
+    {
+	flag = BL_SAM_FLAG(&alignment);
+	if ( (flag & (BL_SAM_FLAG_UNMAP | BL_SAM_FLAG_SECONDARY |
+		      BL_SAM_FLAG_SUPPLEMENTARY | BL_SAM_FLAG_QCFAIL |
+		      BL_SAM_FLAG_DUP)) ||
+	     (BL_SAM_MAPQ(&alignment) < pc->min_mapq) )
+	    continue;
+
+	pos = BL_SAM_POS(&alignment) - 1;
+	if ( (pc->cov.chrom == NULL) ||
+	     (strcmp(pc->cov.chrom, BL_SAM_RNAME(&alignment)) != 0) )
+	{
+	    peak_call_chrom_end(pc);
+	    coverage_set_chrom(&pc->cov, BL_SAM_RNAME(&alignment));
+	}
+	else if ( pos < last_pos )
+	{
+	    fprintf(stderr, "peak_call_scan(): Alignments are not sorted: "
+		    "%s %" PRId64 "\n", pc->cov.chrom, pos + 1);
+	    status = BL_READ_BAD_DATA;
+	    break;
+	}
+	last_pos = pos;
+
+	if ( pc->cut_sites )
+	{
+	    insertion = atac_insertion(flag, pos, BL_SAM_CIGAR(&alignment));
+	    start = insertion - PEAK_CALL_CUT_EXTEND;
+	    end = insertion + PEAK_CALL_CUT_EXTEND;
+	}
+	else if ( flag & BL_SAM_FLAG_PAIRED )
+	{
+	    if ( !(flag & BL_SAM_FLAG_PROPER_PAIR) ||
+		 (BL_SAM_TLEN(&alignment) <= 0) )
+		continue;
+	    start = pos;
+	    end = pos + BL_SAM_TLEN(&alignment);
+	}
+	else if ( flag & BL_SAM_FLAG_REVERSE )
+	{
+	    end = pos + cigar_ref_len(BL_SAM_CIGAR(&alignment));
+	    start = end - PEAK_CALL_FRAGMENT;
+	}
+	else
+	{
+	    start = pos;
+	    end = pos + PEAK_CALL_FRAGMENT;
+	}
+
+	// No interval starts more than PEAK_CALL_FRAGMENT before pos
+	if ( pos > PEAK_CALL_FRAGMENT )
+	{
+	    coverage_flush(&pc->cov, pos - PEAK_CALL_FRAGMENT);
+	    // The current run is not emitted until its depth changes
+	    peak_call_test(pc, pc->cov.run_depth > 0 ? pc->cov.run_start :
+			   pc->cov.base);
+	}
+	if ( start < pc->cov.base )
+	    start = pc->cov.base;
+	if ( end > start )
+	    coverage_add(&pc->cov, start, end);
+    }
+    peak_call_chrom_end(pc);
+    bl_sam_free(&alignment);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Test each candidate peak's summit again with lambda at least the
+ *      genome-wide mean depth, and write those that pass as narrowPeak
+ *      if requested and as BED for classification.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    peak_call_write(peak_call_t *pc)
+
+{
+    called_peak_t   *peak;
+    int64_t         size;
+    double          lambda_bg, lambda, log10p;
+    size_t          c, written = 0;
+    int             score;
+
+    size = pc->genome_size > 0 ? pc->genome_size : pc->extent_sum;
+    lambda_bg = size > 0 ? pc->total_area / size : 0.0;
+    for (c = 0; c < pc->peak_count; ++c)
+    {
+	peak = &pc->peaks[c];
+	lambda = fmax(peak->lambda, lambda_bg);
+	log10p = peak_call_log10p(peak->depth, lambda);
+	if ( log10p >= pc->min_log10p )
+	{
+	    ++written;
+	    score = log10p >= 100.0 ? 1000 : (int)(log10p * 10.0);
+	    if ( pc->narrow_peak != NULL )
+		fprintf(pc->narrow_peak, "%s\t%" PRId64 "\t%" PRId64
+			"\tpeak%zu\t%d\t.\t%.5f\t%.5f\t-1\t%" PRId64 "\n",
+			peak->chrom, peak->start, peak->end, written, score,
+			peak->depth / lambda, log10p,
+			peak->summit - peak->start);
+	    fprintf(pc->out, "%s\t%" PRId64 "\t%" PRId64 "\tpeak%zu\t%d\n",
+		    peak->chrom, peak->start, peak->end, written, score);
+	}
+	free(peak->chrom);
+    }
+    fprintf(stderr, "Called %zu peaks, genome-wide lambda %.4f.\n",
+	    written, lambda_bg);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sum the @SQ LN fields of a SAM header for the genome-wide lambda.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t peak_call_genome_size(FILE *header_stream)
+
+{
+    char    line[BL_SAM_RNAME_MAX_CHARS + 1], *len;
+    int64_t size = 0;
+
+    while ( fgets(line, BL_SAM_RNAME_MAX_CHARS, header_stream) != NULL )
+	if ( (memcmp(line, "@SQ", 3) == 0) &&
+	     ((len = strstr(line, "\tLN:")) != NULL) )
+	    size += strtoll(len + 4, NULL, 10);
+    return size;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Thread body of peak_call_pipe(): call peaks and write them to
+ *      pc->out.  pc->status is set before pc->out is closed, and a
+ *      narrowPeak file is removed if calling fails.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ *  2026-10-19  agent       Report failure in pc->status
+ ***************************************************************************/
+
+void    *peak_call_thread(void *arg)
+
+{
+    peak_call_t *pc = arg;
+    FILE        *sam_stream, *header_stream;
+
+    if ( (sam_stream = bl_sam_fopen(pc->alignments_filename, "r", NULL))
+	    == NULL )
+    {
+	fprintf(stderr, "peak_call_thread(): Cannot open %s.\n",
+		pc->alignments_filename);
+	pc->status = EX_NOINPUT;
+    }
+    else
+    {
+	if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	{
+	    pc->genome_size = peak_call_genome_size(header_stream);
+	    fclose(header_stream);
+	}
+	if ( peak_call_scan(pc, sam_stream) == BL_READ_EOF )
+	{
+	    peak_call_write(pc);
+	    pc->status = EX_OK;
+	}
+	else
+	    pc->status = EX_DATAERR;
+	bl_sam_fclose(sam_stream);
+    }
+    coverage_free(&pc->cov);
+    free(pc->runs);
+    free(pc->peaks);
+    if ( pc->narrow_peak != NULL )
+    {
+	xt_fclose(pc->narrow_peak);
+	if ( pc->status != EX_OK )
+	    unlink(pc->narrow_peak_filename);
+    }
+    fclose(pc->out);
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return a stream of peaks called from sorted alignments by a
+ *      thread, so any mode can classify them without a temporary file,
+ *      as with liftover_pipe().  Peaks are also written as narrowPeak to
+ *      narrow_peak_filename unless it is NULL.  After reading the
+ *      stream to EOF, call peak_call_finish() to learn whether calling
+ *      succeeded.
+ *
+ *  Returns:
+ *      The called peak stream, or NULL on failure
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ *  2026-10-19  agent       Keep the thread joinable for peak_call_finish()
+ ***************************************************************************/
+
+FILE    *peak_call_pipe(const char *alignments_filename,
+			const char *narrow_peak_filename, bool cut_sites,
+			unsigned min_mapq, double pvalue)
+
+{
+    peak_call_t *pc = &Peak_call;
+    int         fds[2];
+    FILE        *called_stream;
+
+    memset(pc, 0, sizeof(*pc));
+    if ( (narrow_peak_filename != NULL) &&
+	 ((pc->narrow_peak = xt_fopen(narrow_peak_filename, "w")) == NULL) )
+    {
+	fprintf(stderr, "peak_call_pipe(): Cannot open %s: %s\n",
+		narrow_peak_filename, strerror(errno));
+	return NULL;
+    }
+    if ( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 )
+    {
+	fprintf(stderr, "peak_call_pipe(): socketpair() failed: %s\n",
+		strerror(errno));
+	return NULL;
+    }
+    // A popen() child such as bedtools holding the write end would block EOF
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    pc->alignments_filename = alignments_filename;
+    pc->narrow_peak_filename = narrow_peak_filename;
+    pc->cut_sites = cut_sites;
+    pc->min_mapq = min_mapq;
+    pc->min_log10p = -log10(pvalue);
+    coverage_init(&pc->cov, NULL);
+    pc->cov.emit = peak_call_run;
+    pc->cov.arg = pc;
+    if ( ((pc->out = fdopen(fds[1], "w")) == NULL) ||
+	 ((called_stream = fdopen(fds[0], "r")) == NULL) )
+    {
+	fputs("peak_call_pipe(): fdopen() failed.\n", stderr);
+	return NULL;
+    }
+    if ( pthread_create(&Peak_call_thread_id, NULL, peak_call_thread, pc)
+	    != 0 )
+    {
+	fputs("peak_call_pipe(): pthread_create() failed.\n", stderr);
+	return NULL;
+    }
+    Peak_call_started = true;
+    return called_stream;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Wait for the thread started by peak_call_pipe() to finish, after
+ *      the caller is done reading the called peak stream.
+ *
+ *  Returns:
+ *      EX_OK if no peaks were called or calling succeeded, else
+ *      EX_NOINPUT or EX_DATAERR
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+int     peak_call_finish(void)
+
+{
+    if ( !Peak_call_started )
+	return EX_OK;
+    pthread_join(Peak_call_thread_id, NULL);
+    Peak_call_started = false;
+    return Peak_call.status;
+}
@@ -15,6 +15,7 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <limits.h>
+#include <inttypes.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <assert.h>
@@ -44,11 +45,68 @@ int     main(int argc,char *argv[])
 	    *gff_stem,
 	    augmented_filename[PATH_MAX + 1],
 	    sorted_filename[PATH_MAX + 1],
+	    coverage_filename[PATH_MAX + 1],
+	    great_filename[PATH_MAX + 1],
 	    *sort;
 	char *bedtools = "bedtools"; // location to bedtools binairy (used for intersect)
-    bool    midpoints_only = false;
+    char    *priority_list = NULL,
+	    *chrom_sizes = NULL,
+	    *exclude_filename = NULL,
+	    *peaks_filename,
+	    *stitch_exclude = STITCH_DEFAULT_EXCLUDE,
+	    *motif_filename = NULL,
+	    *genome_filename = NULL,
+	    *bigwig_filename = NULL,
+	    *liftover_filename = NULL,
+	    *atac_qc_filename = NULL,
+	    *bedgraph_filename = NULL,
+	    *call_peaks_filename = NULL,
+	    *count_matrix_filename = NULL,
+	    *classify_reads_filename = NULL,
+	    *junctions_filename = NULL,
+	    *mark_duplicates_filename = NULL,
+	    *filter_alignments_filename = NULL,
+	    *regions_filename = NULL,
+	    *composition_filename = NULL,
+	    *gene_rollup_filename = NULL,
+	    *feature_counts_filename = NULL,
+	    default_priorities[PEAK_CMD_MAX + 1];
+    bool    midpoints_only = false,
+	    include_regions = false,
+	    class_coverage = false,
+	    jaccard = false,
+	    great = false,
+	    bigwig_exact = false,
+	    bigwig_summary = false,
+	    loops = false,
+	    loop_genes = false,
+	    isoforms = false,
+	    cpm = false,
+	    cut_sites = false,
+	    extra_outputs,
+	    alignments_only,
+	    annotation,
+	    batch = false;
+    overlap_params_t    params = OVERLAP_PARAMS_INIT;
+    peak_extras_t       extras;
+    feature_index_t     chains;
+    interval_ops_t      interval_ops = INTERVAL_OPS_INIT;
     bl_bed_t   bed_feature;
     struct stat     file_info;
+    size_t  permutations = 0,
+	    min_support = 0,
+	    mode_count;
+    long    stitch_distance = -1,
+	    tile_size = 0,
+	    tile_step = 0,
+	    great_extension = GREAT_MAX_EXTENSION;
+    double  motif_threshold = MOTIF_DEFAULT_THRESHOLD,
+	    min_match = LIFTOVER_DEFAULT_MIN_MATCH,
+	    peak_pvalue = PEAK_CALL_DEFAULT_PVALUE;
+    unsigned    threads = 1,
+		kmer_size = 0,
+		min_mapq = 0;
+    uint64_t    seed = 1;
     
     if ( argc < 4 )
 	usage(argv);
@@ -86,138 +144,2084 @@ int     main(int argc,char *argv[])
 	{
 	    bedtools = argv[++c];
 	}
+	else if ( strcmp(argv[c], "--priority") == 0 )
+	    priority_list = argv[++c];
+	else if ( strcmp(argv[c], "--chrom-sizes") == 0 )
+	    chrom_sizes = argv[++c];
+	else if ( strcmp(argv[c], "--exclude") == 0 )
+	    exclude_filename = argv[++c];
+	else if ( strcmp(argv[c], "--class-coverage") == 0 )
+	    class_coverage = true;
+	else if ( strcmp(argv[c], "--composition") == 0 )
+	{
+	    composition_filename = argv[++c];
+	    assert(xt_valid_extension(composition_filename, ".tsv"));
+	}
+	else if ( strcmp(argv[c], "--gene-rollup") == 0 )
+	{
+	    gene_rollup_filename = argv[++c];
+	    assert(xt_valid_extension(gene_rollup_filename, ".tsv"));
+	}
+	else if ( strcmp(argv[c], "--feature-counts") == 0 )
+	{
+	    feature_counts_filename = argv[++c];
+	    assert(xt_valid_extension(feature_counts_filename, ".tsv"));
+	}
+	else if ( strcmp(argv[c], "--batch") == 0 )
+	    batch = true;
+	else if ( strcmp(argv[c], "--jaccard") == 0 )
+	    jaccard = true;
+	else if ( strcmp(argv[c], "--stitch") == 0 )
+	{
+	    stitch_distance = strtol(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (stitch_distance < 0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--stitch-exclude") == 0 )
+	    stitch_exclude = argv[++c];
+	else if ( strcmp(argv[c], "--great") == 0 )
+	    great = true;
+	else if ( strcmp(argv[c], "--great-extension") == 0 )
+	{
+	    great_extension = strtol(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (great_extension < 0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--motifs") == 0 )
+	    motif_filename = argv[++c];
+	else if ( strcmp(argv[c], "--genome") == 0 )
+	    genome_filename = argv[++c];
+	else if ( strcmp(argv[c], "--motif-threshold") == 0 )
+	{
+	    motif_threshold = strtod(argv[++c], &end);
+	    if ( (*end != '\0') || (motif_threshold < 0.0) ||
+		 (motif_threshold > 1.0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--slop") == 0 )
+	{
+	    interval_ops.slop = strtoll(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (interval_ops.slop < 1) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--flank") == 0 )
+	{
+	    interval_ops.flank = strtoll(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (interval_ops.flank < 1) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--merge") == 0 )
+	{
+	    interval_ops.merge_distance = strtoll(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (interval_ops.merge_distance < 0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--intersect") == 0 )
+	    interval_ops.intersect_filename = argv[++c];
+	else if ( strcmp(argv[c], "--subtract") == 0 )
+	    interval_ops.subtract_filename = argv[++c];
+	else if ( strcmp(argv[c], "--complement") == 0 )
+	    interval_ops.complement = true;
+	else if ( strcmp(argv[c], "--atac-qc") == 0 )
+	    atac_qc_filename = argv[++c];
+	else if ( strcmp(argv[c], "--bedgraph") == 0 )
+	    bedgraph_filename = argv[++c];
+	else if ( strcmp(argv[c], "--cpm") == 0 )
+	    cpm = true;
+	else if ( strcmp(argv[c], "--call-peaks") == 0 )
+	    call_peaks_filename = argv[++c];
+	else if ( strcmp(argv[c], "--count-matrix") == 0 )
+	    count_matrix_filename = argv[++c];
+	else if ( strcmp(argv[c], "--classify-reads") == 0 )
+	    classify_reads_filename = argv[++c];
+	else if ( strcmp(argv[c], "--junctions") == 0 )
+	    junctions_filename = argv[++c];
+	else if ( strcmp(argv[c], "--mark-duplicates") == 0 )
+	    mark_duplicates_filename = argv[++c];
+	else if ( strcmp(argv[c], "--filter-alignments") == 0 )
+	    filter_alignments_filename = argv[++c];
+	else if ( strcmp(argv[c], "--exclude-regions") == 0 )
+	{
+	    regions_filename = argv[++c];
+	    include_regions = false;
+	}
+	else if ( strcmp(argv[c], "--include-regions") == 0 )
+	{
+	    regions_filename = argv[++c];
+	    include_regions = true;
+	}
+	else if ( strcmp(argv[c], "--cut-sites") == 0 )
+	    cut_sites = true;
+	else if ( strcmp(argv[c], "--peak-pvalue") == 0 )
+	{
+	    peak_pvalue = strtod(argv[++c], &end);
+	    if ( (*end != '\0') || (peak_pvalue <= 0.0) || (peak_pvalue >= 1.0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--min-mapq") == 0 )
+	{
+	    min_mapq = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (min_mapq > 255) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--isoforms") == 0 )
+	    isoforms = true;
+	else if ( strcmp(argv[c], "--loops") == 0 )
+	    loops = true;
+	else if ( strcmp(argv[c], "--loop-genes") == 0 )
+	    loop_genes = true;
+	else if ( strcmp(argv[c], "--liftover") == 0 )
+	    liftover_filename = argv[++c];
+	else if ( strcmp(argv[c], "--min-match") == 0 )
+	{
+	    min_match = strtod(argv[++c], &end);
+	    if ( (*end != '\0') || (min_match <= 0.0) || (min_match > 1.0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--bigwig") == 0 )
+	    bigwig_filename = argv[++c];
+	else if ( strcmp(argv[c], "--bigwig-exact") == 0 )
+	    bigwig_exact = true;
+	else if ( strcmp(argv[c], "--bigwig-summary") == 0 )
+	    bigwig_summary = true;
+	else if ( strcmp(argv[c], "--kmers") == 0 )
+	{
+	    kmer_size = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (kmer_size < 1) || (kmer_size > KMER_MAX_K) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--tiles") == 0 )
+	{
+	    tile_size = tile_step = strtol(argv[++c], &end, 10);
+	    if ( *end == ':' )
+		tile_step = strtol(end + 1, &end, 10);
+	    if ( (*end != '\0') || (tile_size < 1) || (tile_step < 1) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--consensus") == 0 )
+	{
+	    min_support = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (min_support == 0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--enrichment") == 0 )
+	{
+	    permutations = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (permutations == 0) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--threads") == 0 )
+	{
+	    threads = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (threads < 1) || (threads > PC_MAX_THREADS) )
+		usage(argv);
+	}
+	else if ( strcmp(argv[c], "--seed") == 0 )
+	{
+	    seed = strtoull(argv[++c], &end, 10);
+	    if ( *end != '\0' )
+		usage(argv);
+	}
+	else
+	    usage(argv);
+    }
+
+    /*
+     *  Alignment-only modes read neither peaks nor annotation, and
+     *  --jaccard and --count-matrix read only peaks, so the unused
+     *  positional arguments may be omitted.  The output is always last.
+     */
+    alignments_only = (bedgraph_filename != NULL) ||
+		      (mark_duplicates_filename != NULL) ||
+		      (filter_alignments_filename != NULL);
+    annotation = !alignments_only && !jaccard &&
+		 (count_matrix_filename == NULL);
+    if ( annotation ? (c + 3 != argc) :
+	 alignments_only ? (c + 1 != argc) && (c + 3 != argc) :
+	 (c + 2 != argc) && (c + 3 != argc) )
+	usage(argv);
+    if ( (alignments_only || jaccard) && ((call_peaks_filename != NULL) ||
+			 (liftover_filename != NULL) ||
+			 interval_ops_active(&interval_ops)) )
+    {
+	fputs("peak-classifier: --call-peaks, --liftover, and preprocessing are not\n"
+	      "used with --bedgraph, --mark-duplicates, --filter-alignments, or\n"
+	      "--jaccard.\n", stderr);
+	usage(argv);
+    }
+    if ( (batch && (gene_rollup_filename == NULL) && (min_support == 0) &&
+	  !jaccard) ||
+	 (!batch && ((min_support > 0) || jaccard)) )
+    {
+	fputs("peak-classifier: --batch is required for --consensus and --jaccard\n"
+	      "and only supported with them and --gene-rollup.\n", stderr);
+	usage(argv);
+    }
+
+    // Each mode replaces the default classification, so only one may run
+    extra_outputs = (composition_filename != NULL) ||
+		    (gene_rollup_filename != NULL) ||
+		    (feature_counts_filename != NULL);
+    mode_count = class_coverage + jaccard + (min_support > 0) +
+		 (batch && (gene_rollup_filename != NULL)) +
+		 (permutations > 0) + (stitch_distance >= 0) + (tile_size > 0) +
+		 great + (motif_filename != NULL) + (kmer_size > 0) +
+		 (bigwig_filename != NULL) + loops + isoforms +
+		 (atac_qc_filename != NULL) + (bedgraph_filename != NULL) +
+		 (count_matrix_filename != NULL) +
+		 (classify_reads_filename != NULL) +
+		 (junctions_filename != NULL) +
+		 (mark_duplicates_filename != NULL) +
+		 (filter_alignments_filename != NULL);
+    if ( mode_count > 1 )
+    {
+	fputs("peak-classifier: Only one mode may be given.\n", stderr);
+	usage(argv);
+    }
+    if ( (mode_count == 1) && !batch && extra_outputs )
+    {
+	fputs("peak-classifier: --composition, --gene-rollup, and --feature-counts\n"
+	      "are only collected with the default classification.\n", stderr);
+	usage(argv);
+    }
+    if ( batch && ((composition_filename != NULL) ||
+		   (feature_counts_filename != NULL)) )
+    {
+	fputs("peak-classifier: --composition and --feature-counts are not supported\n"
+	      "with --batch.\n", stderr);
+	usage(argv);
+    }
+
+    if ( (genome_filename == NULL) != ((motif_filename == NULL) &&
+					 (kmer_size == 0)) )
+    {
+	fputs("peak-classifier: --genome is required for and only used with\n"
+	      "--motifs and --kmers.\n", stderr);
+	usage(argv);
+    }
+
+    if ( interval_ops_active(&interval_ops) && (batch || loops) )
+    {
+	fputs("peak-classifier: Preprocessing is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( interval_ops.complement && (chrom_sizes == NULL) )
+    {
+	fputs("peak-classifier: --complement requires --chrom-sizes.\n", stderr);
+	usage(argv);
+    }
+
+    if ( loop_genes && !loops )
+    {
+	fputs("peak-classifier: --loop-genes is only used with --loops.\n", stderr);
+	usage(argv);
+    }
+    if ( loops && (batch || (liftover_filename != NULL)) )
+    {
+	fputs("peak-classifier: --loops is not supported with --batch or --liftover.\n",
+	      stderr);
+	usage(argv);
+    }
+
+    if ( (min_mapq > 0) && (atac_qc_filename == NULL) &&
+	 (bedgraph_filename == NULL) && (call_peaks_filename == NULL) &&
+	 (count_matrix_filename == NULL) && (classify_reads_filename == NULL) &&
+	 (junctions_filename == NULL) && (filter_alignments_filename == NULL) )
+    {
+	fputs("peak-classifier: --min-mapq is only used with --atac-qc, --bedgraph,\n"
+	      "--call-peaks, --count-matrix, --classify-reads, --junctions, and\n"
+	      "--filter-alignments.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( (cut_sites || (peak_pvalue != PEAK_CALL_DEFAULT_PVALUE)) &&
+	 (call_peaks_filename == NULL) )
+    {
+	fputs("peak-classifier: --cut-sites and --peak-pvalue are only used with\n"
+	      "--call-peaks.\n", stderr);
+	usage(argv);
+    }
+    if ( (call_peaks_filename != NULL) && (batch || loops) )
+    {
+	fputs("peak-classifier: --call-peaks is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( cpm && (bedgraph_filename == NULL) )
+    {
+	fputs("peak-classifier: --cpm is only used with --bedgraph.\n", stderr);
+	usage(argv);
+    }
+    if ( (atac_qc_filename != NULL) && (batch || loops) )
+    {
+	fputs("peak-classifier: --atac-qc is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( (count_matrix_filename != NULL) && (batch || loops) )
+    {
+	fputs("peak-classifier: --count-matrix is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( (classify_reads_filename != NULL) && (batch || loops) )
+    {
+	fputs("peak-classifier: --classify-reads is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( (junctions_filename != NULL) && (batch || loops) )
+    {
+	fputs("peak-classifier: --junctions is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( (mark_duplicates_filename != NULL) && (batch || loops) )
+    {
+	fputs("peak-classifier: --mark-duplicates is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( (filter_alignments_filename != NULL) && (batch || loops) )
+    {
+	fputs("peak-classifier: --filter-alignments is not supported with --batch or --loops.\n",
+	      stderr);
+	usage(argv);
+    }
+    if ( (filter_alignments_filename == NULL) != (regions_filename == NULL) )
+    {
+	fputs("peak-classifier: --filter-alignments requires --exclude-regions or\n"
+	      "--include-regions, which are only used with it.\n", stderr);
+	usage(argv);
+    }
+
+    if ( strcmp(argv[argc - 1], "-") == 0 )
+    {
+	overlaps_filename = "";
+	redirect_overwrite = "";
+	redirect_append = "";
+    }
+    else
+    {
+	overlaps_filename = argv[argc - 1];
+	assert(xt_valid_extension(overlaps_filename,
+				  atac_qc_filename != NULL ? ".json" :
+				  (mark_duplicates_filename != NULL) ||
+				  (filter_alignments_filename != NULL) ? ".sam" :
+				  bedgraph_filename != NULL ? ".bedGraph" : ".tsv"));
+	redirect_overwrite = " > ";
+	redirect_append = " >> ";
+    }
+
+    // No annotation is needed, so skip augmenting and sorting the GFF
+    if ( jaccard )
+	return jaccard_mode(argv[c], threads, overlaps_filename);
+    if ( mark_duplicates_filename != NULL )
+	return mark_duplicates_mode(mark_duplicates_filename, threads,
+				    overlaps_filename);
+    if ( filter_alignments_filename != NULL )
+	return filter_alignments_mode(filter_alignments_filename,
+				      regions_filename, include_regions,
+				      min_mapq, threads, overlaps_filename);
+    if ( bedgraph_filename != NULL )
+	return bedgraph_mode(bedgraph_filename, min_mapq, cpm, threads,
+			     overlaps_filename);
+
+    // With --batch, the peaks argument lists peak files to open later
+    peaks_filename = argv[c];
+    if ( batch )
+	peak_stream = NULL;
+    else if ( call_peaks_filename != NULL )
+    {
+	// The peaks argument receives the called peaks
+	if ( strcmp(argv[c], "-") != 0 )
+	    assert(xt_valid_extension(argv[c], ".narrowPeak"));
+	if ( (peak_stream = peak_call_pipe(call_peaks_filename,
+			strcmp(argv[c], "-") == 0 ? NULL : argv[c], cut_sites,
+			min_mapq, peak_pvalue)) == NULL )
+	    exit(EX_CANTCREAT);
+    }
+    else if ( strcmp(argv[c], "-") == 0 )
+	peak_stream = stdin;
+    else
+    {
+	assert(xt_valid_extension(argv[c], loops ? ".bedpe" : ".bed"));
+	if ( (peak_stream = xt_fopen(argv[c], "r")) == NULL )
+	{
+	    fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[c],
+		    strerror(errno));
+	    exit(EX_NOINPUT);
+	}
+    }
+    
+    // Lift peaks as they are read, for every mode
+    if ( liftover_filename != NULL )
+    {
+	if ( batch )
+	{
+	    fputs("peak-classifier: --liftover is not supported with --batch.\n",
+		  stderr);
+	    usage(argv);
+	}
+	if ( liftover_load(&chains, liftover_filename) != FEATURE_INDEX_OK )
+	    exit(EX_DATAERR);
+	if ( (peak_stream = liftover_pipe(&chains, peak_stream, min_match))
+		== NULL )
+	    exit(EX_OSERR);
+    }
+    
+    // In-memory interval algebra on peaks, after any liftover
+    if ( interval_ops_active(&interval_ops) )
+    {
+	interval_ops.chrom_sizes = chrom_sizes;
+	interval_ops.threads = threads;
+	if ( (peak_stream = interval_preprocess(peak_stream, &interval_ops))
+		== NULL )
+	    exit(EX_DATAERR);
+    }
+    
+    // Reads are counted in the peaks as given, so no annotation is needed
+    if ( count_matrix_filename != NULL )
+    {
+	status = count_matrix_mode(peak_stream, count_matrix_filename,
+				   min_mapq, overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( strcmp(argv[++c], "-") == 0 )
+    {
+	gff_stream = stdin;
+	gff_stem = "unknown-stdin-gff";
+    }
+    else
+    {
+	assert(xt_valid_extension(argv[c], ".gff3"));
+	if ( (gff_stream = xt_fopen(argv[c], "r")) == NULL )
+	{
+	    fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[c],
+		    strerror(errno));
+	    exit(EX_NOINPUT);
+	}
+	gff_stem = argv[c];
+    }
+    
+    // Already verified .gff3[.*z] extension above
+    *strstr(gff_stem, ".gff3") = '\0';
+    snprintf(augmented_filename, PATH_MAX, "%s-augmented.bed", gff_stem);
+    if ( stat(augmented_filename, &file_info) == 0 )
+	fprintf(stderr, "Using existing %s...\n", augmented_filename);
+    else if ( gff_augment(gff_stream, upstream_boundaries, augmented_filename) != EX_OK )
+    {
+	fprintf(stderr, "gff_augment() failed.  Removing %s...\n",
+		augmented_filename);
+	unlink(augmented_filename);
+	exit(EX_DATAERR);
+    }
+    
+    snprintf(sorted_filename, PATH_MAX, "%s-augmented+sorted.bed", gff_stem);
+    if ( stat(sorted_filename, &file_info) == 0 )
+	fprintf(stderr, "Using existing %s...\n", sorted_filename);
+    else
+    {
+	// LC_ALL=C makes sort assume 1 byte/char, which improves speed
+	// gsort is faster than other implementations, so use it if
+	// available
+	if ( system("which gsort") == 0 )
+	    sort = "gsort";
+	else
+	    sort = "sort";
+	snprintf(cmd, PEAK_CMD_MAX, "env LC_ALL=C grep -v '^#' %s | "
+		"%s -n -k 1 -k 2 -k 3 > %s\n",
+		augmented_filename, sort, sorted_filename);
+	fputs("Sorting...\n", stderr);
+	if ( (status = system(cmd)) != 0 )
+	{
+	    fprintf(stderr, "Sort failed.  Removing %s...\n", sorted_filename);
+	    unlink(sorted_filename);
+	    exit(EX_DATAERR);
+	}
+    }
+    
+    if ( priority_list == NULL )
+    {
+	default_priority_list(default_priorities, PEAK_CMD_MAX, upstream_boundaries);
+	priority_list = default_priorities;
+    }
+
+    params.min_peak_overlap = min_peak_overlap;
+    params.min_gff_overlap = min_gff_overlap;
+    params.either = (*min_overlap_flags != '\0');
+    
+    snprintf(coverage_filename, PATH_MAX, "%s-class-coverage.tsv", gff_stem);
+    if ( class_coverage )
+    {
+	status = class_coverage_mode(sorted_filename, priority_list,
+				     chrom_sizes, coverage_filename,
+				     overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( min_support > 0 )
+	return consensus_mode(peaks_filename, sorted_filename, priority_list,
+			      &params, min_support, overlaps_filename);
+    
+    if ( batch )
+	return gene_rollup_mode(peaks_filename, augmented_filename,
+				priority_list, &params, midpoints_only,
+				gene_rollup_filename);
+    
+    if ( classify_reads_filename != NULL )
+    {
+	status = classify_reads_mode(classify_reads_filename, sorted_filename,
+				     priority_list, &params, min_mapq,
+				     overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( junctions_filename != NULL )
+    {
+	status = junctions_mode(junctions_filename, sorted_filename, min_mapq,
+				overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( atac_qc_filename != NULL )
+    {
+	status = atac_qc_mode(peak_stream, augmented_filename, priority_list,
+			      atac_qc_filename, min_mapq, overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( isoforms )
+    {
+	status = isoform_mode(peak_stream, sorted_filename, augmented_filename,
+			      priority_list, &params, midpoints_only,
+			      overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( loops )
+    {
+	status = loops_mode(peak_stream, sorted_filename, augmented_filename,
+			    priority_list, &params, midpoints_only, loop_genes,
+			    overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( motif_filename != NULL )
+    {
+	status = motif_mode(peak_stream, sorted_filename, priority_list,
+			    &params, midpoints_only, motif_filename,
+			    genome_filename, motif_threshold, threads,
+			    overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( bigwig_filename != NULL )
+    {
+	status = bigwig_mode(peak_stream, sorted_filename, priority_list,
+			     &params, midpoints_only, bigwig_filename,
+			     !bigwig_exact, bigwig_summary, overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( kmer_size > 0 )
+    {
+	status = kmer_mode(peak_stream, sorted_filename, priority_list,
+			   &params, midpoints_only, kmer_size, genome_filename,
+			   threads, overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( great )
+    {
+	snprintf(great_filename, PATH_MAX, "%s-great-domains.bed", gff_stem);
+	status = great_mode(peak_stream, sorted_filename, augmented_filename,
+			    great_filename, priority_list, &params,
+			    midpoints_only, great_extension, overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( tile_size > 0 )
+    {
+	status = tiles_mode(sorted_filename, priority_list, chrom_sizes,
+			    &params, tile_size, tile_step, overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( stitch_distance >= 0 )
+    {
+	status = stitch_mode(peak_stream, sorted_filename, priority_list,
+			     &params, stitch_distance, stitch_exclude,
+			     overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+    
+    if ( permutations > 0 )
+    {
+	status = enrichment_mode(peak_stream, sorted_filename, priority_list,
+				 chrom_sizes, coverage_filename,
+				 exclude_filename, &params, midpoints_only,
+				 permutations, threads, seed, overlaps_filename);
+	return close_peaks(peak_stream, status, overlaps_filename);
+    }
+
+    // Extra outputs are collected from the same pass over the peaks
+    if ( extra_outputs &&
+	 ((status = peak_extras_open(&extras, composition_filename,
+				     gene_rollup_filename,
+				     feature_counts_filename, sorted_filename,
+				     augmented_filename, priority_list,
+				     &params)) != EX_OK) )
+	return status;
+
+    fputs("Finding intersects...\n", stderr);
+    snprintf(cmd, PEAK_CMD_MAX,
+	    "printf '#Chr\tP-start\tP-end\tF-start\tF-end\tF-name\tStrand\tOverlap\n'%s%s",
+	    redirect_overwrite, overlaps_filename);
+    if ( (status = system(cmd)) == 0 )
+    {
+	/*
+	 *  Peaks not overlapping anything else are labeled
+	 *  upstream-beyond.  The entire peak length must overlap the
+	 *  beyond region since none of it overlaps anything else.
+	 */
+	 
+	// Insert "set -x; " for debugging
+	snprintf(cmd, PEAK_CMD_MAX,
+		 "%s intersect -a - -b %s -f %g -F %g %s -wao"
+		 "| awk 'BEGIN { OFS=IFS; } { if ( $8 == -1 ) "
+		    "$9 = \"upstream-beyond\"; $12 = $3 - $2; "
+		    "printf(\"%%s\\t%%d\\t%%d\\t%%d\\t%%d\\t"
+		    "%%s\\t%%s\\t%%s\\n\", "
+		    "$1, $2, $3, $7, $8, $9, $11, $12); }' %s%s\n",
+		bedtools, sorted_filename, min_peak_overlap, min_gff_overlap,
+		min_overlap_flags, redirect_append, overlaps_filename);
+
+	if ( (intersect_pipe = popen(cmd, "w")) == NULL )
+	{
+	    fprintf(stderr, "%s: Cannot pipe data to bedtools intersect.\n",
+		    argv[0]);
+	    return EX_CANTCREAT;
+	}
+	while ( bl_bed_read(&bed_feature, peak_stream, BL_BED_FIELD_ALL) != EOF )
+	{
+	    if ( midpoints_only )
+	    {
+		// Replace peak start/end with midpoint coordinates
+		bl_bed_set_chrom_start(&bed_feature,
+		    (BL_BED_CHROM_START(&bed_feature) + BL_BED_CHROM_END(&bed_feature))
+		    / 2);
+		bl_bed_set_chrom_end(&bed_feature, BL_BED_CHROM_START(&bed_feature) + 1);
+	    }
+	    bl_bed_write(&bed_feature, intersect_pipe, BL_BED_FIELD_ALL);
+	    if ( extra_outputs )
+		peak_extras_add(&extras, BL_BED_CHROM(&bed_feature),
+				BL_BED_CHROM_START(&bed_feature),
+				BL_BED_CHROM_END(&bed_feature),
+				BL_BED_FIELDS(&bed_feature) > 3 ?
+				BL_BED_NAME(&bed_feature) : ".");
+	}
+	pclose(intersect_pipe);
+    }
+    if ( extra_outputs && (peak_extras_close(&extras) != EX_OK) &&
+	 (status == 0) )
+	status = EX_CANTCREAT;
+    return close_peaks(peak_stream, status, overlaps_filename);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Close the peak stream of a mode that returned status.  If peaks
+ *      were called with --call-peaks, wait for the caller and remove
+ *      output_filename (unless it is "" for stdout) if calling failed,
+ *      since the mode saw only the peaks called before the failure.
+ *
+ *  Returns:
+ *      status, or the peak caller's status if status is EX_OK
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+int     close_peaks(FILE *peak_stream, int status, const char *output_filename)
+
+{
+    int     call_status;
+
+    if ( peak_stream != NULL )
+	xt_fclose(peak_stream);
+    if ( ((call_status = peak_call_finish()) != EX_OK) && (status == EX_OK) )
+    {
+	if ( *output_filename != '\0' )
+	{
+	    fprintf(stderr, "Peak calling failed.  Removing %s...\n",
+		    output_filename);
+	    unlink(output_filename);
+	}
+	status = call_status;
+    }
+    return status;
+}
+
+/***************************************************************************
+ *  Description:
+ *      Load the augmented+sorted feature BED into memory, with classes
+ *      from the priority list and optional chromosome sizes.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     load_feature_index(feature_index_t *fi, const char *sorted_filename,
+			   const char *priority_list, const char *chrom_sizes,
+			   bool track_genes)
+
+{
+    feature_index_init(fi);
+    if ( feature_index_set_classes(fi, priority_list) != FEATURE_INDEX_OK )
+	return EX_USAGE;
+    if ( (chrom_sizes != NULL) &&
+	 (feature_index_load_sizes(fi, chrom_sizes) != FEATURE_INDEX_OK) )
+	return EX_NOINPUT;
+    fputs("Loading feature index...\n", stderr);
+    if ( feature_index_load(fi, sorted_filename, track_genes)
+	    != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    feature_index_build(fi);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Open the output file for in-memory modes.  An empty name, used
+ *      for "-" on the command line, means standard output.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+FILE    *open_output(const char *filename)
+
+{
+    FILE    *outfile;
+
+    if ( *filename == '\0' )
+	return stdout;
+    if ( (outfile = xt_fopen(filename, "w")) == NULL )
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		filename, strerror(errno));
+    return outfile;
+}
+
+
+void    close_output(FILE *outfile)
+
+{
+    if ( outfile == stdout )
+	fflush(stdout);
+    else
+	xt_fclose(outfile);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --enrichment: Permutation test of peak class enrichment against
+ *      the resident feature index.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     enrichment_mode(FILE *peak_stream, const char *sorted_filename,
+			const char *priority_list, const char *chrom_sizes,
+			const char *coverage_filename,
+			const char *exclude_filename, overlap_params_t *params,
+			bool midpoints_only, size_t permutations,
+			unsigned threads, uint64_t seed,
+			const char *output_filename)
+
+{
+    feature_index_t fi, exclude;
+    peak_set_t      peaks = PEAK_SET_INIT;
+    class_coverage_t    cov;
+    FILE            *outfile;
+    int             status;
+
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      chrom_sizes, false)) != EX_OK )
+	return status;
+    if ( chrom_sizes == NULL )
+	fputs("peak-classifier: Warning: No --chrom-sizes, using feature extents.\n",
+	      stderr);
+    // Before reading peaks, which may add chromosomes
+    if ( (status = class_coverage_get(&fi, &cov, priority_list,
+				      coverage_filename)) != EX_OK )
+	return status;
+
+    feature_index_init(&exclude);
+    if ( exclude_filename != NULL )
+    {
+	if ( feature_index_load(&exclude, exclude_filename, false)
+		!= FEATURE_INDEX_OK )
+	    return EX_NOINPUT;
+	feature_index_build(&exclude);
+    }
+
+    if ( peak_set_read(&peaks, peak_stream, &fi, midpoints_only)
+	    != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+    status = enrichment_test(&fi, exclude_filename == NULL ? NULL : &exclude,
+			     &peaks, &cov, params, permutations, threads, seed,
+			     outfile);
+    close_output(outfile);
+    peak_set_free(&peaks);
+    feature_index_free(&exclude);
+    feature_index_free(&fi);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --class-coverage: Write the base pairs of the genome covered by
+ *      each class, computing and caching them if necessary.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     class_coverage_mode(const char *sorted_filename,
+			    const char *priority_list, const char *chrom_sizes,
+			    const char *coverage_filename,
+			    const char *output_filename)
+
+{
+    feature_index_t     fi;
+    class_coverage_t    cov;
+    FILE                *outfile;
+    int                 status;
+
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      chrom_sizes, false)) != EX_OK )
+	return status;
+    if ( chrom_sizes == NULL )
+	fputs("peak-classifier: Warning: No --chrom-sizes, using feature extents.\n",
+	      stderr);
+    if ( (status = class_coverage_get(&fi, &cov, priority_list,
+				      coverage_filename)) == EX_OK )
+    {
+	if ( (outfile = open_output(output_filename)) == NULL )
+	    status = EX_CANTCREAT;
+	else
+	{
+	    class_coverage_write(&fi, &cov, priority_list, outfile);
+	    close_output(outfile);
+	}
+    }
+    feature_index_free(&fi);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --jaccard: Write pairwise Jaccard and intersection length matrices
+ *      for the peak files listed in batch_filename.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     jaccard_mode(const char *batch_filename, unsigned threads,
+		     const char *output_filename)
+
+{
+    feature_index_t     chroms;
+    sample_list_t       samples = SAMPLE_LIST_INIT;
+    peak_set_t          *sets;
+    int64_t             *intersect;
+    size_t              s;
+    FILE                *peak_stream, *outfile;
+    int                 status = EX_OK;
+
+    if ( sample_list_read(&samples, batch_filename) != FEATURE_INDEX_OK )
+	return EX_NOINPUT;
+    sets = xt_malloc(samples.count, sizeof(*sets));
+    intersect = xt_malloc(samples.count * samples.count, sizeof(*intersect));
+    if ( (sets == NULL) || (intersect == NULL) )
+    {
+	fputs("jaccard_mode(): Could not allocate samples.\n", stderr);
+	return EX_UNAVAILABLE;
+    }
+
+    // Only used to number chromosomes consistently across samples
+    feature_index_init(&chroms);
+    for (s = 0; s < samples.count; ++s)
+    {
+	peak_set_t  init = PEAK_SET_INIT;
+
+	sets[s] = init;
+	if ( status != EX_OK )
+	    continue;
+	fprintf(stderr, "Reading %s...\n", samples.filenames[s]);
+	if ( (peak_stream = xt_fopen(samples.filenames[s], "r")) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		    samples.filenames[s], strerror(errno));
+	    status = EX_NOINPUT;
+	}
+	else
+	{
+	    if ( peak_set_read(&sets[s], peak_stream, &chroms, false)
+		    != FEATURE_INDEX_OK )
+		status = EX_DATAERR;
+	    xt_fclose(peak_stream);
+	}
+    }
+
+    if ( status == EX_OK )
+    {
+	fprintf(stderr, "Sweeping %zu samples on %u threads...\n",
+		samples.count, threads);
+	status = jaccard_matrix(&chroms, sets, samples.count, threads,
+				intersect);
+    }
+    if ( status == EX_OK )
+    {
+	if ( (outfile = open_output(output_filename)) == NULL )
+	    status = EX_CANTCREAT;
+	else
+	{
+	    jaccard_write(&samples, intersect, outfile);
+	    close_output(outfile);
+	}
+    }
+
+    for (s = 0; s < samples.count; ++s)
+	peak_set_free(&sets[s]);
+    free(sets);
+    free(intersect);
+    feature_index_free(&chroms);
+    sample_list_free(&samples);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --consensus: Merge the sorted peak files listed in batch_filename
+ *      and write the consensus peaks with at least min_support samples,
+ *      classified against the resident feature index.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     consensus_mode(const char *batch_filename, const char *sorted_filename,
+		       const char *priority_list, overlap_params_t *params,
+		       size_t min_support, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    sample_list_t       samples = SAMPLE_LIST_INIT;
+    FILE                *outfile;
+    int                 status;
+
+    if ( sample_list_read(&samples, batch_filename) != FEATURE_INDEX_OK )
+	return EX_NOINPUT;
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( (outfile = open_output(output_filename)) == NULL )
+	status = EX_CANTCREAT;
+    else
+    {
+	fprintf(stderr, "Merging %zu samples...\n", samples.count);
+	status = consensus_merge(&samples, min_support, &fi, params, outfile);
+	close_output(outfile);
+	if ( (status != EX_OK) && (*output_filename != '\0') )
+	{
+	    fprintf(stderr, "Merge failed.  Removing %s...\n", output_filename);
+	    unlink(output_filename);
+	}
+    }
+    sample_list_free(&samples);
+    feature_index_free(&fi);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --motifs: Scan the sequence of each peak for each motif and write
+ *      the best hit on either strand along with the peak class.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     motif_mode(FILE *peak_stream, const char *sorted_filename,
+		   const char *priority_list, overlap_params_t *params,
+		   bool midpoints_only, const char *motif_filename,
+		   const char *genome_filename, double threshold,
+		   unsigned threads, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    peak_set_t          peaks = PEAK_SET_INIT;
+    motif_set_t         motifs = MOTIF_SET_INIT;
+    FILE                *outfile;
+    int                 status;
+
+    if ( motif_set_read(&motifs, motif_filename) != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( peak_set_read(&peaks, peak_stream, &fi, midpoints_only)
+	    != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    if ( (outfile = open_output(output_filename)) == NULL )
+	status = EX_CANTCREAT;
+    else
+    {
+	fprintf(stderr, "Scanning %zu peaks for %zu motifs on %u threads...\n",
+		peaks.count, motifs.count, threads);
+	status = motif_scan(&motifs, genome_filename, &fi, &peaks, params,
+			    threshold, threads, outfile);
+	close_output(outfile);
+    }
+    motif_set_free(&motifs);
+    peak_set_free(&peaks);
+    feature_index_free(&fi);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --bigwig: Write bigWig signal statistics for each peak with its
+ *      class, or totals per class if summary is true.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bigwig_mode(FILE *peak_stream, const char *sorted_filename,
+		    const char *priority_list, overlap_params_t *params,
+		    bool midpoints_only, const char *bigwig_filename,
+		    bool use_zoom, bool summary, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    bigwig_t            bw = BIGWIG_INIT;
+    bl_bed_t            bed_feature = BL_BED_INIT;
+    hit_list_t          hits = HIT_LIST_INIT;
+    bw_stats_t          stats, class_stats[FEATURE_CLASS_MAX + 1];
+    int64_t             start, end, chrom_id,
+			class_peaks[FEATURE_CLASS_MAX + 1],
+			class_size[FEATURE_CLASS_MAX + 1];
+    size_t              chrom = 0, bw_chrom = 0, slot;
+    unsigned            class_id;
+    FILE                *outfile;
+    int                 status;
+
+    if ( bigwig_open(&bw, bigwig_filename) != BIGWIG_OK )
+    {
+	bigwig_close(&bw);
+	return EX_DATAERR;
+    }
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+
+    memset(class_stats, 0, sizeof(class_stats));
+    memset(class_peaks, 0, sizeof(class_peaks));
+    memset(class_size, 0, sizeof(class_size));
+    if ( !summary )
+	fputs("#Chr\tP-start\tP-end\tP-name\tClass\tSize\tCovered\tSum\t"
+	      "Mean0\tMean\tMax\n", outfile);
+    bl_bed_skip_header(peak_stream);
+    while ( (status = peak_read(&bed_feature, peak_stream, midpoints_only,
+				&start, &end)) == BL_READ_OK )
+    {
+	chrom = feature_index_find_chrom(&fi, BL_BED_CHROM(&bed_feature), chrom);
+	chrom_id = bigwig_chrom_id(&bw, BL_BED_CHROM(&bed_feature), &bw_chrom);
+	class_id = feature_index_classify(&fi, chrom, start, end, params,
+					  &hits, NULL);
+	if ( bigwig_stats(&bw, chrom_id, start, end, use_zoom, &stats)
+		!= BIGWIG_OK )
+	{
+	    fprintf(stderr, "peak-classifier: Bad data block in %s.\n",
+		    bigwig_filename);
+	    break;
+	}
+	if ( summary )
+	{
+	    slot = class_id == FEATURE_CLASS_NONE ? fi.class_count : class_id;
+	    if ( (class_stats[slot].covered == 0) ||
+		 (stats.max > class_stats[slot].max) )
+		class_stats[slot].max = stats.max;
+	    class_stats[slot].covered += stats.covered;
+	    class_stats[slot].sum += stats.sum;
+	    class_size[slot] += end - start;
+	    ++class_peaks[slot];
+	}
+	else
+	{
+	    fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\t%s\t%s",
+		    BL_BED_CHROM(&bed_feature), start, end,
+		    BL_BED_FIELDS(&bed_feature) > 3 ?
+			BL_BED_NAME(&bed_feature) : ".",
+		    feature_index_class_name(&fi, class_id));
+	    bw_stats_write(&stats, end - start, outfile);
+	}
+    }
+
+    if ( summary )
+    {
+	fputs("#Class\tPeaks\tSize\tCovered\tSum\tMean0\tMean\tMax\n", outfile);
+	for (slot = 0; slot <= fi.class_count; ++slot)
+	{
+	    if ( class_peaks[slot] == 0 )
+		continue;
+	    fprintf(outfile, "%s\t%" PRId64,
+		    feature_index_class_name(&fi, slot == fi.class_count ?
+					     FEATURE_CLASS_NONE : slot),
+		    class_peaks[slot]);
+	    bw_stats_write(&class_stats[slot], class_size[slot], outfile);
+	}
+    }
+    close_output(outfile);
+    hit_list_free(&hits);
+    bigwig_close(&bw);
+    feature_index_free(&fi);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --kmers: Count canonical k-mers in peak sequences by peak class
+ *      and write their enrichment over all peaks.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     kmer_mode(FILE *peak_stream, const char *sorted_filename,
+		  const char *priority_list, overlap_params_t *params,
+		  bool midpoints_only, unsigned k, const char *genome_filename,
+		  unsigned threads, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    peak_set_t          peaks = PEAK_SET_INIT;
+    FILE                *outfile;
+    int                 status;
+
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( peak_set_read(&peaks, peak_stream, &fi, midpoints_only)
+	    != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    if ( (outfile = open_output(output_filename)) == NULL )
+	status = EX_CANTCREAT;
+    else
+    {
+	fprintf(stderr, "Counting %u-mers in %zu peaks on %u threads...\n",
+		k, peaks.count, threads);
+	status = kmer_scan(k, genome_filename, &fi, &peaks, params, threads,
+			   outfile);
+	close_output(outfile);
+    }
+    peak_set_free(&peaks);
+    feature_index_free(&fi);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --loops: Classify both anchors of each BEDPE loop in one pass and
+ *      write the loops with their anchor classes, and with the nearest
+ *      gene to each anchor if nearest_genes is true.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     loops_mode(FILE *loop_stream, const char *sorted_filename,
+		   const char *augmented_filename, const char *priority_list,
+		   overlap_params_t *params, bool midpoints_only,
+		   bool nearest_genes, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    loop_set_t          loops = LOOP_SET_INIT;
+    size_t              skipped;
+    FILE                *outfile;
+    int                 status;
+
+    // Gene records are only in the augmented BED
+    if ( (status = load_feature_index(&fi, nearest_genes ?
+				      augmented_filename : sorted_filename,
+				      priority_list, NULL, nearest_genes))
+	    != EX_OK )
+	return status;
+    if ( loop_set_read(&loops, loop_stream, &fi, midpoints_only, &skipped)
+	    != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    if ( skipped > 0 )
+	fprintf(stderr, "Skipped %zu loops with unpaired anchors.\n", skipped);
+    if ( (outfile = open_output(output_filename)) == NULL )
+	status = EX_CANTCREAT;
+    else
+    {
+	fprintf(stderr, "Classifying %zu anchors...\n", loops.anchors.count);
+	loop_classify(&loops, &fi, params);
+	if ( nearest_genes )
+	    loop_nearest_genes(&loops, &fi);
+	loop_write(&loops, &fi, outfile);
+	close_output(outfile);
+    }
+    loop_set_free(&loops);
+    feature_index_free(&fi);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --isoforms: Write each peak with its class and the class of each
+ *      transcript it overlaps, from the per-segment transcript bitsets.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     isoform_mode(FILE *peak_stream, const char *sorted_filename,
+		     const char *augmented_filename, const char *priority_list,
+		     overlap_params_t *params, bool midpoints_only,
+		     const char *output_filename)
+
+{
+    feature_index_t     fi;
+    isoform_index_t     iso;
+    isoform_query_t     query = ISOFORM_QUERY_INIT;
+    bl_bed_t            bed_feature = BL_BED_INIT;
+    hit_list_t          hits = HIT_LIST_INIT;
+    size_t              chrom = 0, iso_chrom = 0;
+    int64_t             start, end;
+    unsigned            class_id;
+    FILE                *outfile;
+    int                 status;
+
+    if ( isoform_index_load(&iso, augmented_filename, priority_list)
+	    != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+
+    fputs("#Chr\tP-start\tP-end\tP-name\tClass\tTranscripts\n", outfile);
+    bl_bed_skip_header(peak_stream);
+    while ( (status = peak_read(&bed_feature, peak_stream, midpoints_only,
+				&start, &end)) == BL_READ_OK )
+    {
+	chrom = feature_index_find_chrom(&fi, BL_BED_CHROM(&bed_feature), chrom);
+	iso_chrom = feature_index_find_chrom(&iso.segments,
+				BL_BED_CHROM(&bed_feature), iso_chrom);
+	class_id = feature_index_classify(&fi, chrom, start, end, params,
+					  &hits, NULL);
+	fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\t%s\t%s",
+		BL_BED_CHROM(&bed_feature), start, end,
+		BL_BED_FIELDS(&bed_feature) > 3 ? BL_BED_NAME(&bed_feature) : ".",
+		feature_index_class_name(&fi, class_id));
+	isoform_assign(&iso, iso_chrom, start, end, &hits, &query, outfile);
+	putc('\n', outfile);
+    }
+    close_output(outfile);
+    isoform_query_free(&query);
+    hit_list_free(&hits);
+    isoform_index_free(&iso);
+    feature_index_free(&fi);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --atac-qc: Stream alignments once, accumulating the fraction of
+ *      Tn5 insertions in peaks, the aggregate insertion profile around
+ *      gene TSSs, and the fragment length distribution, and write them
+ *      as a JSON report.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     atac_qc_mode(FILE *peak_stream, const char *augmented_filename,
+		     const char *priority_list, const char *alignments_filename,
+		     unsigned min_mapq, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    atac_qc_t           qc;
+    FILE                *sam_stream,
+			*header_stream,
+			*outfile;
+    int                 status;
+
+    // Gene records are only in the augmented BED
+    if ( (status = load_feature_index(&fi, augmented_filename, priority_list,
+				      NULL, true)) != EX_OK )
+	return status;
+    if ( atac_qc_load(&qc, peak_stream, &fi) != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    if ( (sam_stream = bl_sam_fopen(alignments_filename, "r", NULL)) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		alignments_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+
+    fprintf(stderr, "Scanning alignments against %zu peaks and %zu TSSs...\n",
+	    qc.peaks.count, qc.tss_count);
+    if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	fclose(header_stream);
+    status = atac_qc_scan(&qc, sam_stream, &fi, min_mapq);
+    bl_sam_fclose(sam_stream);
+    atac_qc_write(&qc, alignments_filename, outfile);
+    close_output(outfile);
+    atac_qc_free(&qc);
+    feature_index_free(&fi);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --bedgraph: Write bedGraph coverage of sorted alignments, in
+ *      counts per million if cpm is true.  Indexed BAM and CRAM files
+ *      are processed one chromosome per thread with --threads.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     bedgraph_mode(const char *alignments_filename, unsigned min_mapq,
+		      bool cpm, unsigned threads, const char *output_filename)
+
+{
+    char        index_filename[PATH_MAX + 1],
+		**chroms = NULL;
+    struct stat file_info;
+    size_t      chrom_count = 0, c;
+    uint64_t    reads = 0;
+    FILE        *sam_stream,
+		*header_stream,
+		*runs,
+		*outfile;
+    int         status;
+
+    if ( (threads > 1) && (xt_valid_extension(alignments_filename, ".bam") ||
+			   xt_valid_extension(alignments_filename, ".cram")) )
+    {
+	snprintf(index_filename, PATH_MAX, "%s.%s", alignments_filename,
+		 xt_valid_extension(alignments_filename, ".bam") ? "bai" : "crai");
+	if ( stat(index_filename, &file_info) == 0 )
+	    chrom_count = coverage_chroms(alignments_filename, &chroms);
+	else
+	    fprintf(stderr, "No %s, using one thread.\n", index_filename);
+    }
+
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+    if ( chrom_count > 0 )
+    {
+	fprintf(stderr, "Computing coverage of %zu sequences on %u threads...\n",
+		chrom_count, threads);
+	status = coverage_parallel(alignments_filename, chroms, chrom_count,
+				   min_mapq, cpm, threads, outfile);
+	for (c = 0; c < chrom_count; ++c)
+	    free(chroms[c]);
+	free(chroms);
+    }
+    else
+    {
+	if ( (sam_stream = bl_sam_fopen(alignments_filename, "r", NULL)) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		    alignments_filename, strerror(errno));
+	    close_output(outfile);
+	    return EX_NOINPUT;
+	}
+	if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	    fclose(header_stream);
+	fputs("Computing coverage...\n", stderr);
+	// CPM needs the total, so hold runs in a temp file until the end
+	if ( !cpm )
+	    status = coverage_scan(sam_stream, min_mapq, outfile, &reads);
+	else if ( (runs = tmpfile()) == NULL )
+	    status = BL_READ_UNKNOWN_FORMAT;
+	else
+	{
+	    if ( (status = coverage_scan(sam_stream, min_mapq, runs, &reads))
+		    == BL_READ_EOF )
+		coverage_write_runs(runs, true,
+				    reads == 0 ? 0.0 : 1.0e6 / reads, outfile);
+	    fclose(runs);
+	}
+	bl_sam_fclose(sam_stream);
+    }
+    close_output(outfile);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --count-matrix: Count reads overlapping each peak in every
+ *      alignment file listed in list_filename, reading all files
+ *      concurrently, and write a peak x sample matrix.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     count_matrix_mode(FILE *peak_stream, const char *list_filename,
+			  unsigned min_mapq, const char *output_filename)
+
+{
+    feature_index_t     chroms;
+    sample_list_t       samples = SAMPLE_LIST_INIT;
+    peak_set_t          peaks = PEAK_SET_INIT;
+    count_sample_t      *stats;
+    uint64_t            *counts;
+    size_t              *chrom_first, s;
+    FILE                *outfile;
+    int                 status;
+
+    if ( sample_list_read(&samples, list_filename) != FEATURE_INDEX_OK )
+	return EX_NOINPUT;
+
+    // Only used to number chromosomes for the peak sweep
+    feature_index_init(&chroms);
+    if ( peak_set_read(&peaks, peak_stream, &chroms, false)
+	    != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    chrom_first = xt_malloc(chroms.chrom_count + 1, sizeof(*chrom_first));
+    counts = xt_malloc(samples.count * peaks.count + 1, sizeof(*counts));
+    stats = xt_malloc(samples.count, sizeof(*stats));
+    if ( (chrom_first == NULL) || (counts == NULL) || (stats == NULL) )
+    {
+	fputs("count_matrix_mode(): Could not allocate matrix.\n", stderr);
+	return EX_UNAVAILABLE;
+    }
+    interval_set_sort(&peaks, chroms.chrom_count, chrom_first);
+
+    fprintf(stderr, "Counting reads in %zu peaks from %zu files...\n",
+	    peaks.count, samples.count);
+    status = count_matrix(&samples, &chroms, &peaks, chrom_first, min_mapq,
+			  counts, stats);
+    for (s = 0; s < samples.count; ++s)
+	fprintf(stderr, "%s: %" PRIu64 " alignments, %" PRIu64 " unmapped, %"
+		PRIu64 " below MAPQ %u, %" PRIu64 " used\n",
+		samples.names[s], stats[s].alignments, stats[s].unmapped,
+		stats[s].low_mapq, min_mapq, stats[s].used);
+    if ( status == EX_OK )
+    {
+	if ( (outfile = open_output(output_filename)) == NULL )
+	    status = EX_CANTCREAT;
 	else
-	    usage(argv);
+	{
+	    count_matrix_write(&samples, &chroms, &peaks, counts, outfile);
+	    close_output(outfile);
+	}
     }
+    free(stats);
+    free(counts);
+    free(chrom_first);
+    peak_set_free(&peaks);
+    feature_index_free(&chroms);
+    sample_list_free(&samples);
+    return status;
+}
 
-    if ( strcmp(argv[c], "-") == 0 )
-	peak_stream = stdin;
+
+/***************************************************************************
+ *  Description:
+ *      --classify-reads: Classify each alignment by the features its
+ *      CIGAR blocks overlap, so that spliced reads are assigned to the
+ *      exons they cover rather than the introns they skip.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     classify_reads_mode(const char *alignments_filename,
+			    const char *sorted_filename,
+			    const char *priority_list, overlap_params_t *params,
+			    unsigned min_mapq, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    bl_sam_t            alignment;
+    sam_blocks_t        blocks = SAM_BLOCKS_INIT;
+    hit_list_t          hits = HIT_LIST_INIT;
+    size_t              chrom = 0;
+    unsigned            class_id;
+    FILE                *sam_stream,
+			*header_stream,
+			*outfile;
+    int                 status;
+
+    // BL_SAM_INIT omits the qual sizes and bl_sam_init() the cigar sizes
+    memset(&alignment, 0, sizeof(alignment));
+
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( (sam_stream = bl_sam_fopen(alignments_filename, "r", NULL)) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		alignments_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+
+    fputs("Classifying alignments...\n", stderr);
+    if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	fclose(header_stream);
+    fputs("#Read\tChr\tA-start\tA-end\tBlocks\tAligned\tClass\n", outfile);
+    while ( (status = bl_sam_read(&alignment, sam_stream,
+				  BL_SAM_FIELD_QNAME | BL_SAM_FIELD_FLAG |
+				  BL_SAM_FIELD_RNAME | BL_SAM_FIELD_POS |
+				  BL_SAM_FIELD_MAPQ | BL_SAM_FIELD_CIGAR))
+	    == BL_READ_OK )
+    {
+	if ( (BL_SAM_FLAG(&alignment) & BL_SAM_FLAG_UNMAP) ||
+	     (BL_SAM_MAPQ(&alignment) < min_mapq) )
+	    continue;
+	sam_blocks_parse(&blocks, BL_SAM_POS(&alignment) - 1,
+			 BL_SAM_CIGAR(&alignment));
+	if ( blocks.count == 0 )
+	    continue;
+	chrom = feature_index_find_chrom(&fi, BL_SAM_RNAME(&alignment), chrom);
+	class_id = sam_blocks_classify(&fi, chrom, &blocks, params, &hits,
+				       NULL);
+	fprintf(outfile, "%s\t%s\t%" PRId64 "\t%" PRId64 "\t%zu\t%" PRId64
+		"\t%s\n", BL_SAM_QNAME(&alignment), BL_SAM_RNAME(&alignment),
+		blocks.start[0], blocks.end[blocks.count - 1], blocks.count,
+		blocks.aligned_len, feature_index_class_name(&fi, class_id));
+    }
+    bl_sam_fclose(sam_stream);
+    close_output(outfile);
+    sam_blocks_free(&blocks);
+    hit_list_free(&hits);
+    bl_sam_free(&alignment);
+    feature_index_free(&fi);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --junctions: Count splice junctions in alignments and mark each
+ *      as a known or novel intron of the annotation.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     junctions_mode(const char *alignments_filename,
+		       const char *sorted_filename, unsigned min_mapq,
+		       const char *output_filename)
+
+{
+    junction_set_t  introns, junctions;
+    uint64_t        spliced_reads = 0;
+    size_t          known, novel;
+    FILE            *sam_stream,
+		    *header_stream,
+		    *outfile;
+    int             status;
+
+    junction_set_init(&introns);
+    junction_set_init(&junctions);
+    fputs("Loading introns...\n", stderr);
+    if ( junction_introns_load(&introns, sorted_filename) != FEATURE_INDEX_OK )
+	return EX_DATAERR;
+    if ( (sam_stream = bl_sam_fopen(alignments_filename, "r", NULL)) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		alignments_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+
+    fputs("Counting junctions...\n", stderr);
+    if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	fclose(header_stream);
+    status = junction_scan(&junctions, sam_stream, min_mapq, &spliced_reads);
+    bl_sam_fclose(sam_stream);
+    if ( status == BL_READ_EOF )
+    {
+	junction_write(&junctions, &introns, outfile, &known, &novel);
+	fprintf(stderr, "%" PRIu64 " spliced reads, %zu known and %zu novel junctions.\n",
+		spliced_reads, known, novel);
+    }
+    close_output(outfile);
+    junction_set_free(&junctions);
+    junction_set_free(&introns);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --mark-duplicates: Write sorted alignments as SAM with duplicates
+ *      flagged 0x400.  Indexed BAM and CRAM files are processed one
+ *      chromosome per thread with --threads.  Partial output is removed
+ *      if the alignments are not sorted.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ *  2026-10-19  agent       Remove partial output on failure
+ ***************************************************************************/
+
+int     mark_duplicates_mode(const char *alignments_filename, unsigned threads,
+			     const char *output_filename)
+
+{
+    char        index_filename[PATH_MAX + 1],
+		**chroms = NULL;
+    struct stat file_info;
+    size_t      chrom_count = 0, c;
+    dup_mark_t  dm;
+    FILE        *sam_stream,
+		*header_stream,
+		*outfile;
+    int         status;
+
+    if ( (threads > 1) && (xt_valid_extension(alignments_filename, ".bam") ||
+			   xt_valid_extension(alignments_filename, ".cram")) )
+    {
+	snprintf(index_filename, PATH_MAX, "%s.%s", alignments_filename,
+		 xt_valid_extension(alignments_filename, ".bam") ? "bai" : "crai");
+	if ( stat(index_filename, &file_info) == 0 )
+	    chrom_count = coverage_chroms(alignments_filename, &chroms);
+	else
+	    fprintf(stderr, "No %s, using one thread.\n", index_filename);
+    }
+
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+    dup_mark_init(&dm, outfile);
+    if ( chrom_count > 0 )
+    {
+	// Unplaced unmapped reads follow all chromosomes
+	chroms = xt_realloc(chroms, chrom_count + 1, sizeof(*chroms));
+	if ( chroms == NULL )
+	{
+	    fputs("mark_duplicates_mode(): Could not allocate chroms.\n", stderr);
+	    return EX_UNAVAILABLE;
+	}
+	chroms[chrom_count++] = strdup("*");
+	fprintf(stderr, "Marking duplicates in %zu sequences on %u threads...\n",
+		chrom_count - 1, threads);
+	status = dup_mark_parallel(alignments_filename, chroms, chrom_count,
+				   threads, outfile, &dm);
+	for (c = 0; c < chrom_count; ++c)
+	    free(chroms[c]);
+	free(chroms);
+    }
     else
     {
-	assert(xt_valid_extension(argv[c], ".bed"));
-	if ( (peak_stream = xt_fopen(argv[c], "r")) == NULL )
+	if ( (sam_stream = bl_sam_fopen(alignments_filename, "r", NULL)) == NULL )
 	{
-	    fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[c],
-		    strerror(errno));
-	    exit(EX_NOINPUT);
+	    fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		    alignments_filename, strerror(errno));
+	    close_output(outfile);
+	    return EX_NOINPUT;
 	}
+	fputs("Marking duplicates...\n", stderr);
+	if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	    sam_tmpfile_append(header_stream, outfile);
+	status = dup_mark_scan(&dm, sam_stream);
+	bl_sam_fclose(sam_stream);
     }
-    
-    if ( strcmp(argv[++c], "-") == 0 )
+    close_output(outfile);
+    fprintf(stderr, "%" PRIu64 " records, %" PRIu64 " examined, %" PRIu64
+	    " duplicates.\n", dm.records, dm.keyed, dm.duplicates);
+    dup_mark_free(&dm);
+    if ( status != BL_READ_EOF )
     {
-	gff_stream = stdin;
-	gff_stem = "unknown-stdin-gff";
+	if ( *output_filename != '\0' )
+	{
+	    fprintf(stderr, "Marking failed.  Removing %s...\n",
+		    output_filename);
+	    unlink(output_filename);
+	}
+	return EX_DATAERR;
     }
-    else
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --filter-alignments: Write sorted alignments as SAM without those
+ *      overlapping the exclusion regions, or those outside the inclusion
+ *      regions, and report how many were dropped for each reason.
+ *      Partial output is removed if the alignments are not sorted.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ *  2026-10-19  agent       Remove partial output on failure
+ ***************************************************************************/
+
+int     filter_alignments_mode(const char *alignments_filename,
+			       const char *regions_filename, bool include,
+			       unsigned min_mapq, unsigned threads,
+			       const char *output_filename)
+
+{
+    region_filter_t rf;
+    FILE            *sam_stream,
+		    *header_stream,
+		    *outfile;
+    int             status;
+
+    fputs("Loading regions...\n", stderr);
+    if ( (status = region_filter_load(&rf, regions_filename, include,
+				      min_mapq, threads)) != EX_OK )
+	return status;
+    if ( (sam_stream = bl_sam_fopen(alignments_filename, "r", NULL)) == NULL )
     {
-	assert(xt_valid_extension(argv[c], ".gff3"));
-	if ( (gff_stream = xt_fopen(argv[c], "r")) == NULL )
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		alignments_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+
+    fprintf(stderr, "Filtering alignments against %zu merged regions...\n",
+	    rf.regions.count);
+    if ( (header_stream = bl_sam_skip_header(sam_stream)) != NULL )
+	sam_tmpfile_append(header_stream, outfile);
+    status = region_filter_scan(&rf, sam_stream, outfile);
+    bl_sam_fclose(sam_stream);
+    close_output(outfile);
+    fprintf(stderr, "%" PRIu64 " records, %" PRIu64 " unmapped, %" PRIu64
+	    " below MAPQ %u, %" PRIu64 " %s, %" PRIu64 " passed.\n",
+	    rf.records, rf.unmapped, rf.low_mapq, min_mapq,
+	    include ? rf.outside : rf.excluded,
+	    include ? "outside regions" : "in excluded regions", rf.passed);
+    region_filter_free(&rf);
+    if ( status != BL_READ_EOF )
+    {
+	if ( *output_filename != '\0' )
 	{
-	    fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[c],
-		    strerror(errno));
-	    exit(EX_NOINPUT);
+	    fprintf(stderr, "Filtering failed.  Removing %s...\n",
+		    output_filename);
+	    unlink(output_filename);
 	}
-	gff_stem = argv[c];
+	return EX_DATAERR;
     }
-    
-    if ( strcmp(argv[++c], "-") == 0 )
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --great: Write each peak with its class and the genes whose GREAT
+ *      regulatory domains contain it.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     great_mode(FILE *peak_stream, const char *sorted_filename,
+		   const char *augmented_filename, const char *great_filename,
+		   const char *priority_list, overlap_params_t *params,
+		   bool midpoints_only, int64_t max_extension,
+		   const char *output_filename)
+
+{
+    feature_index_t     fi, domains;
+    bl_bed_t            bed_feature = BL_BED_INIT;
+    hit_list_t          hits = HIT_LIST_INIT;
+    size_t              chrom = 0, domain_chrom = 0;
+    int64_t             start, end;
+    unsigned            class_id;
+    FILE                *outfile;
+    int                 status;
+
+    if ( (status = great_domains_get(&domains, augmented_filename,
+				     great_filename, max_extension)) != EX_OK )
+	return status;
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( (outfile = open_output(output_filename)) == NULL )
+	return EX_CANTCREAT;
+
+    fputs("#Chr\tP-start\tP-end\tP-name\tClass\tGenes\n", outfile);
+    bl_bed_skip_header(peak_stream);
+    while ( (status = peak_read(&bed_feature, peak_stream, midpoints_only,
+				&start, &end)) == BL_READ_OK )
     {
-	overlaps_filename = "";
-	redirect_overwrite = "";
-	redirect_append = "";
+	chrom = feature_index_find_chrom(&fi, BL_BED_CHROM(&bed_feature), chrom);
+	domain_chrom = feature_index_find_chrom(&domains,
+				BL_BED_CHROM(&bed_feature), domain_chrom);
+	class_id = feature_index_classify(&fi, chrom, start, end, params,
+					  &hits, NULL);
+	fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\t%s\t%s",
+		BL_BED_CHROM(&bed_feature), start, end,
+		BL_BED_FIELDS(&bed_feature) > 3 ? BL_BED_NAME(&bed_feature) : ".",
+		feature_index_class_name(&fi, class_id));
+	great_assign(&domains, domain_chrom, start, end, params, &hits, outfile);
+	putc('\n', outfile);
     }
+    close_output(outfile);
+    hit_list_free(&hits);
+    feature_index_free(&domains);
+    feature_index_free(&fi);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --tiles: Classify every tile of the genome without reading peaks.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     tiles_mode(const char *sorted_filename, const char *priority_list,
+		   const char *chrom_sizes, overlap_params_t *params,
+		   int64_t tile_size, int64_t tile_step,
+		   const char *output_filename)
+
+{
+    feature_index_t     fi;
+    FILE                *outfile;
+    int                 status;
+
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      chrom_sizes, false)) != EX_OK )
+	return status;
+    if ( chrom_sizes == NULL )
+	fputs("peak-classifier: Warning: No --chrom-sizes, using feature extents.\n",
+	      stderr);
+    if ( (outfile = open_output(output_filename)) == NULL )
+	status = EX_CANTCREAT;
     else
     {
-	overlaps_filename = argv[c];
-	assert(xt_valid_extension(overlaps_filename, ".tsv"));
-	redirect_overwrite = " > ";
-	redirect_append = " >> ";
+	fputs("Classifying tiles...\n", stderr);
+	tile_classify(&fi, tile_size, tile_step, params, outfile);
+	close_output(outfile);
     }
+    feature_index_free(&fi);
+    return status;
+}
 
-    // Already verified .gff3[.*z] extension above
-    *strstr(gff_stem, ".gff3") = '\0';
-    snprintf(augmented_filename, PATH_MAX, "%s-augmented.bed", gff_stem);
-    if ( stat(augmented_filename, &file_info) == 0 )
-	fprintf(stderr, "Using existing %s...\n", augmented_filename);
-    else if ( gff_augment(gff_stream, upstream_boundaries, augmented_filename) != EX_OK )
+
+/***************************************************************************
+ *  Description:
+ *      --stitch: Stitch sorted peaks within distance of each other,
+ *      excluding peaks in exclude_class ("none" to keep all), and write
+ *      the stitched regions ranked by summed signal.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     stitch_mode(FILE *peak_stream, const char *sorted_filename,
+		    const char *priority_list, overlap_params_t *params,
+		    int64_t distance, const char *exclude_class,
+		    const char *output_filename)
+
+{
+    feature_index_t     fi;
+    stitch_list_t       list = STITCH_LIST_INIT;
+    unsigned            exclude_id = FEATURE_CLASS_NONE;
+    double              cutoff;
+    FILE                *outfile;
+    int                 status;
+
+    if ( (status = load_feature_index(&fi, sorted_filename, priority_list,
+				      NULL, false)) != EX_OK )
+	return status;
+    if ( (strcmp(exclude_class, "none") != 0) &&
+	 ((exclude_id = feature_index_class_id(&fi, exclude_class))
+	    == FEATURE_CLASS_NONE) )
+	fprintf(stderr, "peak-classifier: Warning: %s is not in the priority list, "
+		"no peaks excluded.\n", exclude_class);
+
+    fputs("Stitching peaks...\n", stderr);
+    if ( stitch_peaks(&fi, peak_stream, params, distance, exclude_id, &list)
+	    != FEATURE_INDEX_OK )
+	status = EX_DATAERR;
+    else if ( (outfile = open_output(output_filename)) == NULL )
+	status = EX_CANTCREAT;
+    else
     {
-	fprintf(stderr, "gff_augment() failed.  Removing %s...\n",
-		augmented_filename);
-	unlink(augmented_filename);
-	exit(EX_DATAERR);
+	cutoff = stitch_rank(&list);
+	fprintf(stderr, "%zu peaks excluded, %zu stitched regions, "
+		"super-enhancer cutoff %g.\n", list.excluded, list.count, cutoff);
+	stitch_write(&list, cutoff, &fi, params, outfile);
+	close_output(outfile);
     }
-    
-    snprintf(sorted_filename, PATH_MAX, "%s-augmented+sorted.bed", gff_stem);
-    if ( stat(sorted_filename, &file_info) == 0 )
-	fprintf(stderr, "Using existing %s...\n", sorted_filename);
-    else
+    stitch_list_free(&list);
+    feature_index_free(&fi);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      --batch --gene-rollup: Write a gene x sample matrix of the peaks
+ *      overlapping each gene in any prioritized class, for each peak
+ *      file listed in batch_filename.  Genes come from the unsorted
+ *      augmented BED, which groups each gene's features together.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     gene_rollup_mode(const char *batch_filename,
+			 const char *augmented_filename,
+			 const char *priority_list, overlap_params_t *params,
+			 bool midpoints_only, const char *output_filename)
+
+{
+    feature_index_t     fi;
+    sample_list_t       samples = SAMPLE_LIST_INIT;
+    gene_rollup_t       gr;
+    size_t              s;
+    FILE                *peak_stream,
+			*outfile;
+    int                 status = EX_OK;
+
+    if ( sample_list_read(&samples, batch_filename) != FEATURE_INDEX_OK )
+	return EX_NOINPUT;
+    if ( (status = load_feature_index(&fi, augmented_filename, priority_list,
+				      NULL, true)) != EX_OK )
+	return status;
+    fprintf(stderr, "Loaded %zu genes.\n", fi.gene_count);
+
+    gene_rollup_init(&gr, &fi, samples.count);
+    for (s = 0; (s < samples.count) && (status == EX_OK); ++s)
     {
-	// LC_ALL=C makes sort assume 1 byte/char, which improves speed
-	// gsort is faster than other implementations, so use it if
-	// available
-	if ( system("which gsort") == 0 )
-	    sort = "gsort";
+	fprintf(stderr, "Counting %s...\n", samples.filenames[s]);
+	if ( (peak_stream = xt_fopen(samples.filenames[s], "r")) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		    samples.filenames[s], strerror(errno));
+	    status = EX_NOINPUT;
+	}
 	else
-	    sort = "sort";
-	snprintf(cmd, PEAK_CMD_MAX, "env LC_ALL=C grep -v '^#' %s | "
-		"%s -n -k 1 -k 2 -k 3 > %s\n",
-		augmented_filename, sort, sorted_filename);
-	fputs("Sorting...\n", stderr);
-	if ( (status = system(cmd)) != 0 )
 	{
-	    fprintf(stderr, "Sort failed.  Removing %s...\n", sorted_filename);
-	    unlink(sorted_filename);
-	    exit(EX_DATAERR);
+	    status = gene_rollup_stream(&gr, &fi, peak_stream, params,
+					midpoints_only, s);
+	    xt_fclose(peak_stream);
 	}
     }
-    
-    fputs("Finding intersects...\n", stderr);
-    snprintf(cmd, PEAK_CMD_MAX,
-	    "printf '#Chr\tP-start\tP-end\tF-start\tF-end\tF-name\tStrand\tOverlap\n'%s%s",
-	    redirect_overwrite, overlaps_filename);
-    if ( (status = system(cmd)) == 0 )
-    {
-	/*
-	 *  Peaks not overlapping anything else are labeled
-	 *  upstream-beyond.  The entire peak length must overlap the
-	 *  beyond region since none of it overlaps anything else.
-	 */
-	 
-	// Insert "set -x; " for debugging
-	snprintf(cmd, PEAK_CMD_MAX,
-		 "%s intersect -a - -b %s -f %g -F %g %s -wao"
-		 "| awk 'BEGIN { OFS=IFS; } { if ( $8 == -1 ) "
-		    "$9 = \"upstream-beyond\"; $12 = $3 - $2; "
-		    "printf(\"%%s\\t%%d\\t%%d\\t%%d\\t%%d\\t"
-		    "%%s\\t%%s\\t%%s\\n\", "
-		    "$1, $2, $3, $7, $8, $9, $11, $12); }' %s%s\n",
-		bedtools, sorted_filename, min_peak_overlap, min_gff_overlap,
-		min_overlap_flags, redirect_append, overlaps_filename);
 
-	if ( (intersect_pipe = popen(cmd, "w")) == NULL )
-	{
-	    fprintf(stderr, "%s: Cannot pipe data to bedtools intersect.\n",
-		    argv[0]);
-	    return EX_CANTCREAT;
-	}
-	while ( bl_bed_read(&bed_feature, peak_stream, BL_BED_FIELD_ALL) != EOF )
+    if ( status == EX_OK )
+    {
+	if ( (outfile = open_output(output_filename)) == NULL )
+	    status = EX_CANTCREAT;
+	else
 	{
-	    if ( midpoints_only )
-	    {
-		// Replace peak start/end with midpoint coordinates
-		bl_bed_set_chrom_start(&bed_feature,
-		    (BL_BED_CHROM_START(&bed_feature) + BL_BED_CHROM_END(&bed_feature))
-		    / 2);
-		bl_bed_set_chrom_end(&bed_feature, BL_BED_CHROM_START(&bed_feature) + 1);
-	    }
-	    bl_bed_write(&bed_feature, intersect_pipe, BL_BED_FIELD_ALL);
+	    gene_rollup_write(&gr, &fi, samples.names, outfile);
+	    close_output(outfile);
 	}
-	pclose(intersect_pipe);
     }
-    xt_fclose(peak_stream);
+    gene_rollup_free(&gr);
+    sample_list_free(&samples);
+    feature_index_free(&fi);
     return status;
 }
 
+
+/***************************************************************************
+ *  Description:
+ *      Classify the peaks in one stream and add them to a gene rollup.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     gene_rollup_stream(gene_rollup_t *gr, feature_index_t *fi,
+			   FILE *peak_stream, overlap_params_t *params,
+			   bool midpoints_only, size_t sample)
+
+{
+    bl_bed_t    bed_feature = BL_BED_INIT;
+    hit_list_t  hits = HIT_LIST_INIT;
+    size_t      chrom = 0;
+    int64_t     start, end;
+    int         status;
+
+    bl_bed_skip_header(peak_stream);
+    while ( (status = peak_read(&bed_feature, peak_stream, midpoints_only,
+				&start, &end)) == BL_READ_OK )
+    {
+	chrom = feature_index_find_chrom(fi, BL_BED_CHROM(&bed_feature), chrom);
+	feature_index_classify(fi, chrom, start, end, params, &hits, NULL);
+	gene_rollup_add(gr, fi, &hits, sample);
+    }
+    hit_list_free(&hits);
+    return status == BL_READ_EOF ? EX_OK : EX_DATAERR;
+}
+
+
 /***************************************************************************
  *  Library:
  *      #include <biolibc/gff.h>
@@ -261,7 +2265,8 @@ void    bl_gff_to_bed2(bl_gff_t *gff_feature, bl_bed_t *bed_feature)
      *  GFF is the same
      */
     bl_bed_set_chrom_end(bed_feature, BL_GFF_END(gff_feature));
-    snprintf(name, BL_BED_NAME_MAX_CHARS + 1, "%s;%s;%s", BL_GFF_TYPE(gff_feature), BL_GFF_FEATURE_NAME(gff_feature), BL_GFF_FEATURE_ID(gff_feature));
+    if ( snprintf(name, BL_BED_NAME_MAX_CHARS + 1, "%s;%s;%s", BL_GFF_TYPE(gff_feature), BL_GFF_FEATURE_NAME(gff_feature), BL_GFF_FEATURE_ID(gff_feature)) > BL_BED_NAME_MAX_CHARS )
+	fprintf(stderr, "bl_gff_to_bed2(): Name truncated: %s\n", name);
     bl_bed_set_name_cpy(bed_feature, name, BL_BED_NAME_MAX_CHARS + 1);
     bl_bed_set_score(bed_feature, 0);  // FIXME: Take as arg?
     if ( bl_bed_set_strand(bed_feature, strand) != BL_BED_DATA_OK )
@@ -390,10 +2395,7 @@ void    gff_process_subfeatures(FILE *gff_stream, FILE *bed_stream,
 	exon = (strcmp(feature, "exon") == 0);
 
 	// mRNA or lnc_RNA mark the start of a new set of exons
-	if ( (strstr(BL_GFF_TYPE(&subfeature), "RNA") != NULL) ||
-	     (strstr(BL_GFF_TYPE(&subfeature), "transcript") != NULL) ||
-	     (strstr(BL_GFF_TYPE(&subfeature), "gene_segment") != NULL) ||
-	     (strstr(BL_GFF_TYPE(&subfeature), "_overlapping_ncrna") != NULL) )
+	if ( gff_is_transcript(feature) )
 	    first_exon = true;
 	
 	// Generate introns between exons
@@ -454,9 +2456,10 @@ void    generate_upstream_features(FILE *feature_stream,
     
     strand = BL_GFF_STRAND(gff_feature);
 
-    for (c = 0; c < BL_POS_LIST_COUNT(pos_list) - 1; ++c)
+    for (c = 0; c < (int)BL_POS_LIST_COUNT(pos_list) - 1; ++c)
     {
 	bl_bed_set_fields(&bed_feature[c], 6);
+	bl_bed_set_score(&bed_feature[c], 0);
 	bl_bed_set_strand(&bed_feature[c], strand);
 	bl_bed_set_chrom_cpy(&bed_feature[c], BL_GFF_SEQID(gff_feature),
 			     BL_CHROM_MAX_CHARS + 1);
@@ -484,15 +2487,15 @@ void    generate_upstream_features(FILE *feature_stream,
 			    BL_GFF_END(gff_feature) + 
 			    BL_POS_LIST_POSITIONS_AE(pos_list, c + 1));
 	}
-    snprintf(name, BL_BED_NAME_MAX_CHARS + 1, "%s;%s;%s", BL_GFF_TYPE(gff_feature), BL_GFF_FEATURE_NAME(gff_feature), BL_GFF_FEATURE_ID(gff_feature));
-	
-	snprintf(name, BL_BED_NAME_MAX_CHARS, "upstream%li;%s;%s;%s", BL_POS_LIST_POSITIONS_AE(pos_list, c + 1), BL_GFF_TYPE(gff_feature), BL_GFF_FEATURE_NAME(gff_feature), BL_GFF_FEATURE_ID(gff_feature));
+	if ( snprintf(name, BL_BED_NAME_MAX_CHARS, "upstream%li;%s;%s;%s", BL_POS_LIST_POSITIONS_AE(pos_list, c + 1), BL_GFF_TYPE(gff_feature), BL_GFF_FEATURE_NAME(gff_feature), BL_GFF_FEATURE_ID(gff_feature)) >= BL_BED_NAME_MAX_CHARS )
+	    fprintf(stderr, "generate_upstream_features(): Name truncated: %s\n",
+		    name);
 	bl_bed_set_name_cpy(&bed_feature[c], name, BL_BED_NAME_MAX_CHARS + 1);
     }
     
     if ( strand == '-' )
     {
-	for (c = 0; c < BL_POS_LIST_COUNT(pos_list) - 1; ++c)
+	for (c = 0; c < (int)BL_POS_LIST_COUNT(pos_list) - 1; ++c)
 	    bl_bed_write(&bed_feature[c], feature_stream, BL_BED_FIELD_ALL);
     }
     else
@@ -509,7 +2512,36 @@ void    usage(char *argv[])
     fprintf(stderr,
 	    "\nUsage: %s [--upstream-boundaries pos[,pos ...]] "
 	    "[--min-peak-overlap x.y] [--min-gff-overlap x.y] [--midpoints] "
-	    "peaks.bed features.gff3 overlaps.tsv\n\n", argv[0]);
+	    "[--priority class[,class ...]] [--chrom-sizes file] [--class-coverage] "
+	    "[--liftover file.chain [--min-match x.y]] "
+	    "[--slop N] [--flank N] [--merge distance] [--intersect regions.bed] "
+	    "[--subtract regions.bed] [--complement] "
+	    "[--composition file.tsv] [--gene-rollup file.tsv [--batch]] "
+	    "[--feature-counts file.tsv] "
+	    "[--batch --consensus min-support] [--batch --jaccard] "
+	    "[--stitch distance [--stitch-exclude class]] [--tiles size[:step]] "
+	    "[--great [--great-extension max]] "
+	    "[--motifs file --genome genome.fa [--motif-threshold x.y] [--threads N]] "
+	    "[--kmers k --genome genome.fa [--threads N]] "
+	    "[--bigwig file.bw [--bigwig-exact] [--bigwig-summary]] "
+	    "[--loops [--loop-genes]] [--isoforms] "
+	    "[--atac-qc alignments.bam [--min-mapq N]] "
+	    "[--bedgraph alignments.bam [--cpm] [--min-mapq N] [--threads N]] "
+	    "[--call-peaks alignments.bam [--cut-sites] [--peak-pvalue x.y] "
+	    "[--min-mapq N]] "
+	    "[--count-matrix alignments-list.txt [--min-mapq N]] "
+	    "[--classify-reads alignments.bam [--min-mapq N]] "
+	    "[--junctions alignments.bam [--min-mapq N]] "
+	    "[--mark-duplicates alignments.bam [--threads N]] "
+	    "[--filter-alignments alignments.bam "
+	    "--exclude-regions|--include-regions regions.bed [--min-mapq N]] "
+	    "[--enrichment N [--exclude regions.bed] [--threads N] [--seed N]] "
+	    "peaks.bed features.gff3 overlaps.tsv\n\n"
+	    "       %s --batch --jaccard [--threads N] peak-files.txt overlaps.tsv\n\n"
+	    "       %s --count-matrix alignments-list.txt ... peaks.bed overlaps.tsv\n\n"
+	    "       %s --bedgraph|--mark-duplicates|--filter-alignments ... "
+	    "overlaps.bedGraph|overlaps.sam\n\n", argv[0], argv[0], argv[0],
+	    argv[0]);
     fputs("Upstream boundaries are distances upstream from TSS, for which we want\n"
 	  "overlaps reported.  The default is 1000,10000,100000, which means features\n"
 	  "are generated for 1 to 1000, 1001 to 10000, and 10001 to 100000 bases\n"
@@ -527,6 +2559,112 @@ void    usage(char *argv[])
 	  "the midpoint of each peak.  This is the same as --min-peak-overlap 0.5\n"
 	  "in cases where half the peak is contained in a feature, but can also report\n"
 	  "overlaps with features too small to contain this much overlap.\n\n"
-	  "--bedtools location of bedtools binairy (used for intersect) [default:bedtools]\n\n", stderr);
+	  "--bedtools location of bedtools binairy (used for intersect) [default:bedtools]\n\n"
+	  "--priority class[,class ...] orders feature classes for in-memory modes,\n"
+	  "highest priority first, as with filter-overlaps.  The default is the UTRs,\n"
+	  "intron, exon, each upstream region, and upstream-beyond.\n\n"
+	  "--chrom-sizes file gives chromosome lengths (.fai or chrom.sizes).\n\n"
+	  "--liftover file.chain maps peaks to the annotation assembly as they are\n"
+	  "read, for any mode.  Peaks with less than --min-match (default 0.95) of\n"
+	  "their bases aligned by a chain are dropped, and peaks aligned by several\n"
+	  "chains are split, one interval per chain.\n\n"
+	  "--slop N, --flank N, --merge distance, --intersect regions.bed,\n"
+	  "--subtract regions.bed, and --complement transform peaks in memory before\n"
+	  "any mode, in that order, as with the bedtools commands of the same names.\n"
+	  "--complement requires --chrom-sizes.  Use --threads N to process\n"
+	  "chromosomes in parallel.\n\n"
+	  "--enrichment N writes observed/expected counts and empirical p-values per\n"
+	  "class from N within-chromosome random placements of the peaks, instead\n"
+	  "of overlaps.  Placements avoid regions in --exclude regions.bed.  Use\n"
+	  "--threads N to run permutations in parallel and --seed N for a\n"
+	  "different random sequence.\n\n"
+	  "--class-coverage writes the base pairs of the genome in each class, for any\n"
+	  "overlap and after priority resolution, instead of overlaps.  The table is\n"
+	  "cached in features-class-coverage.tsv for use by --enrichment.\n\n"
+	  "--composition file.tsv writes the base pairs of each peak in each class,\n"
+	  "after priority resolution.  Each row sums to the peak length.\n\n"
+	  "--gene-rollup file.tsv writes the number of peaks per gene per class,\n"
+	  "counting each peak once per gene under that gene's highest priority\n"
+	  "class.  With --batch, the peaks argument is a file listing peak BED\n"
+	  "files, one per line, and file.tsv receives a gene x sample matrix.\n\n"
+	  "--feature-counts file.tsv writes the number of peaks overlapping each\n"
+	  "feature and the bases they cover, one line per feature.\n\n"
+	  "--composition, --gene-rollup, and --feature-counts are written in\n"
+	  "addition to overlaps, from the same pass over the peaks.\n\n"
+	  "--batch --consensus min-support merges the sorted peak files listed in the\n"
+	  "peaks argument, writing merged peaks found in at least min-support samples\n"
+	  "with the number of samples, a presence string, and the peak class.\n\n"
+	  "--batch --jaccard writes pairwise Jaccard and intersection length matrices\n"
+	  "for the peak files listed in the peaks argument, using --threads N.  The\n"
+	  "features argument is not read and may be omitted.\n\n"
+	  "--stitch distance stitches sorted peaks within distance (12500 for ROSE),\n"
+	  "after excluding peaks overlapping --stitch-exclude class (default\n"
+	  "upstream1000, \"none\" to keep all).  Regions are ranked by summed BED\n"
+	  "score, and those above the inflection point are flagged as super.\n\n"
+	  "--tiles size[:step] classifies genome tiles of size bases every step bases\n"
+	  "(default size) from --chrom-sizes instead of peaks.  The peaks argument is\n"
+	  "not read and may be -.\n\n"
+	  "--great writes each peak with its class and the genes whose GREAT basal\n"
+	  "plus extension regulatory domains contain it.  Domains extend at most\n"
+	  "--great-extension bases (default 1000000) from the TSS and are cached in\n"
+	  "features-great-domains.bed.\n\n"
+	  "--motifs file --genome genome.fa scans each peak on both strands for each\n"
+	  "MEME or JASPAR motif in file, writing the best hit per peak and motif with\n"
+	  "the peak class if its score relative to the motif's range is at least\n"
+	  "--motif-threshold (default 0.8).  Use --threads N to scan peaks in parallel.\n\n"
+	  "--kmers k --genome genome.fa writes the frequency of each canonical k-mer\n"
+	  "(k <= 12) in the peaks of each class, with its frequency in all peaks and\n"
+	  "log2 enrichment, using --threads N.\n\n"
+	  "--bigwig file.bw writes the size, covered bases, summed signal, mean over\n"
+	  "the peak, mean over covered bases, and maximum signal of each peak with its\n"
+	  "class.  Large peaks use bigWig zoom levels unless --bigwig-exact is given.\n"
+	  "--bigwig-summary writes the same statistics per class instead of per peak.\n\n"
+	  "--loops reads BEDPE loops (peaks.bedpe) and writes each loop with the\n"
+	  "classes of both anchors, classified in one pass.  --loop-genes adds the\n"
+	  "gene with the TSS nearest each anchor and its distance.\n\n"
+	  "--isoforms writes each peak with its class and every transcript it\n"
+	  "overlaps with that transcript's highest priority class, such as exon in\n"
+	  "one isoform and intron in another.\n\n"
+	  "--atac-qc alignments.bam streams SAM, BAM, or CRAM alignments once and\n"
+	  "writes a JSON report (overlaps.json) with the fraction of Tn5 insertions\n"
+	  "in peaks, the insertion profile and enrichment at gene TSSs +/- 2 kb, and\n"
+	  "fragment length statistics.  Alignments below --min-mapq N are skipped.\n\n"
+	  "--bedgraph alignments.bam writes coverage of sorted alignments as\n"
+	  "bedGraph (overlaps.bedGraph), in counts per million with --cpm.  The\n"
+	  "peaks and features arguments are not read and may be omitted.  Indexed\n"
+	  "BAM and CRAM files are processed one chromosome per thread with\n"
+	  "--threads N.\n\n"
+	  "--call-peaks alignments.bam calls peaks from sorted alignments and\n"
+	  "classifies them in the same run, with any mode.  The peaks argument\n"
+	  "receives the called peaks as narrowPeak (peaks.narrowPeak), or - to\n"
+	  "discard them.  The pileup uses whole fragments, or +/- 75 bases around Tn5\n"
+	  "cut sites with --cut-sites.  Peaks are significant at --peak-pvalue\n"
+	  "(default 1e-5) against the larger of the depth within 5 kb and the\n"
+	  "genome-wide depth.\n\n"
+	  "--count-matrix alignments-list.txt counts reads overlapping each peak\n"
+	  "in every sorted SAM, BAM, or CRAM file listed, one per line, reading all\n"
+	  "files concurrently.  The output has one row per peak in sorted order and\n"
+	  "one column per file.  Unmapped reads and those below --min-mapq are\n"
+	  "not counted.  Peaks are not classified, so features.gff3 may be omitted.\n\n"
+	  "--classify-reads alignments.bam classifies each mapped alignment by the\n"
+	  "features its CIGAR blocks overlap, splitting blocks at N so that spliced\n"
+	  "reads are not assigned to the introns they skip.  The peaks argument is\n"
+	  "not read and may be -.\n\n"
+	  "--junctions alignments.bam counts splice junctions (CIGAR N gaps) by\n"
+	  "strand, taken from the XS or ts tag, and marks each as a known or novel\n"
+	  "intron of the annotation.  The peaks argument is not read and may be -.\n\n"
+	  "--mark-duplicates alignments.bam writes sorted alignments as SAM to\n"
+	  "overlaps.sam with 0x400 set on both mates of all but the pair with the\n"
+	  "best base qualities among those sharing the unclipped 5' positions and\n"
+	  "strands of both ends, the mate's from its MC tag.  With --threads N,\n"
+	  "indexed BAM and CRAM files are processed one chromosome per thread.  The\n"
+	  "peaks and features arguments are not read and may be omitted.\n\n"
+	  "--filter-alignments alignments.bam writes sorted alignments as SAM to\n"
+	  "overlaps.sam, dropping unmapped reads, those below --min-mapq, and those\n"
+	  "whose CIGAR blocks overlap a region of --exclude-regions regions.bed or\n"
+	  "no region of --include-regions regions.bed.  Counts per reason are\n"
+	  "reported.  The peaks and features arguments are not read and may be\n"
+	  "omitted.\n\n",
+	  stderr);
     exit(EX_USAGE);
 }
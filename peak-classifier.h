@@ -1,5 +1,1045 @@
-
 #define MAX_UPSTREAM_BOUNDARIES 64
 #define PEAK_CMD_MAX            PATH_MAX * 2 + 256
 
+/*
+ *  Feature classes are the feature types listed in priority order, as
+ *  with filter-overlaps.  A class ID is the 0-based position in the list,
+ *  so the lowest ID among overlapping features is the priority-resolved
+ *  class.  Limited to 64 so a set of classes fits in a class_mask_t.
+ */
+#define FEATURE_CLASS_MAX       64
+#define FEATURE_CLASS_NONE      0xff
+#define FEATURE_CLASS_BEYOND    "upstream-beyond"
+#define FEATURE_CLASS_NONE_NAME "unclassified"
+
+#define FEATURE_INDEX_OK        0
+#define FEATURE_INDEX_NOINPUT   -1
+#define FEATURE_INDEX_BAD_DATA  -2
+
+#define FEATURE_GENE_NONE       ((size_t)-1)
+
+#define FEATURE_INDEX_START_SIZE    65536
+#define PEAK_SET_START_SIZE         4096
+
+// Attempts to place a shuffled peak outside excluded regions
+#define ENRICH_MAX_TRIES        1000
+#define PC_MAX_THREADS          256
+
+typedef uint64_t    class_mask_t;
+
+typedef struct
+{
+    double      min_peak_overlap,
+		min_gff_overlap;
+    bool        either;
+}   overlap_params_t;
+
+#define OVERLAP_PARAMS_INIT { 1.0e-9, 1.0e-9, false }
+
+/*
+ *  A gene record from the augmented BED, which groups each gene's
+ *  subfeatures and upstream regions into one block following the gene.
+ */
+typedef struct
+{
+    char        *id,
+		*name;
+    size_t      chrom;
+    int64_t     start,
+		end;
+    char        strand;
+}   fi_gene_t;
+
+/*
+ *  One entry per chromosome.  Features for a chromosome occupy
+ *  [first, first + count) in the feature_index_t arrays, sorted by start,
+ *  and are augmented with max_end to form an implicit interval tree.
+ */
+typedef struct
+{
+    char        *name;
+    size_t      first,
+		count;
+    int64_t     size;       // From --chrom-sizes, else last feature end
+    int         root_level;
+}   fi_chrom_t;
+
+typedef struct
+{
+    size_t          count,
+		    array_size;
+    int64_t         *start,
+		    *end,
+		    *max_end;
+    unsigned char   *class_id;
+    char            *strand;
+    char            **name;
+    size_t          *gene;      // Index into genes, or FEATURE_GENE_NONE
+
+    size_t          chrom_count,
+		    chrom_array_size;
+    fi_chrom_t      *chroms;
+
+    size_t          class_count;
+    char            *class_names[FEATURE_CLASS_MAX];
+    unsigned char   beyond_class;
+
+    size_t          gene_count,
+		    gene_array_size;
+    fi_gene_t       *genes;
+}   feature_index_t;
+
+#define FEATURE_INDEX_INIT  { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, \
+			      0, 0, NULL, 0, { NULL }, FEATURE_CLASS_NONE, \
+			      0, 0, NULL }
+
+typedef struct
+{
+    size_t      count,
+		array_size;
+    size_t      *index;
+}   hit_list_t;
+
+#define HIT_LIST_INIT   { 0, 0, NULL }
+
+typedef struct
+{
+    size_t      count,
+		array_size;
+    size_t      *chrom;     // Index into feature_index_t chroms
+    int64_t     *start,
+		*end;
+    char        **name;
+}   peak_set_t;
+
+#define PEAK_SET_INIT   { 0, 0, NULL, NULL, NULL, NULL }
+
+typedef struct
+{
+    int64_t         pos;
+    int             delta;      // +1 at feature start, -1 at end
+    unsigned char   class_id;
+}   boundary_event_t;
+
+/*
+ *  Base pairs per class, with slot class_count for bases covered only
+ *  by unclassified features.
+ */
+typedef struct
+{
+    size_t      class_count;
+    int64_t     genome_size,
+		any_bp[FEATURE_CLASS_MAX + 1],
+		priority_bp[FEATURE_CLASS_MAX + 1];
+}   class_coverage_t;
+
+typedef struct
+{
+    size_t      count,
+		array_size;
+    char        **filenames,
+		**names;    // Filename without directory or extension
+}   sample_list_t;
+
+#define SAMPLE_LIST_INIT    { 0, 0, NULL, NULL }
+
+/*
+ *  Peak counts per gene, with one column per class or per sample in
+ *  a dense gene-major array.
+ */
+typedef struct
+{
+    size_t          gene_count,
+		    columns,
+		    touched_count;
+    bool            by_class;
+    int64_t         *counts;
+    unsigned char   *best;      // Per-peak scratch: best class per gene
+    size_t          *touched;   // Genes with best set for this peak
+}   gene_rollup_t;
+
+/*
+ *  Per-feature peak counters, parallel to the feature_index_t arrays.
+ */
+typedef struct
+{
+    size_t      count;
+    int64_t     *peaks,
+		*bp;
+}   feature_counts_t;
+
+/*
+ *  Optional outputs collected during classification, sharing one
+ *  feature index and one overlap query per peak.  A NULL filename
+ *  disables an output.
+ */
+typedef struct
+{
+    const char          *composition_filename,
+			*gene_rollup_filename,
+			*feature_counts_filename;
+    FILE                *composition_stream;
+    overlap_params_t    *params;
+    feature_index_t     fi;
+    gene_rollup_t       gr;
+    feature_counts_t    fc;
+    hit_list_t          hits;
+    boundary_event_t    *events;
+    size_t              events_size,
+			chrom;
+    int64_t             bp[FEATURE_CLASS_MAX + 1];
+}   peak_extras_t;
+
+/*
+ *  One input of a k-way merge of sorted peak files.  The heap holds
+ *  sample indexes ordered by the current peak of each.
+ */
+typedef struct
+{
+    FILE        *stream;
+    bl_bed_t    peak;
+    size_t      chrom_rank; // Index of peak's chrom in chrom_order_t
+    bool        eof;
+}   merge_input_t;
+
+/*
+ *  Chromosome order shared by all inputs of a merge.  Each input
+ *  contributes edges between consecutive chromosomes, and names[] is
+ *  then sorted so that every input's chromosomes appear in increasing
+ *  index order.  Ties go to the chromosome seen first.
+ */
+typedef struct
+{
+    char        **names;
+    size_t      *last_input,    // Last input containing each chrom
+		*edge_from,
+		*edge_to,
+		count,
+		array_size,
+		edge_count,
+		edge_array_size;
+}   chrom_order_t;
+
+#define CHROM_ORDER_INIT    { NULL, NULL, NULL, NULL, 0, 0, 0, 0 }
+
+typedef struct
+{
+    char        chrom[BL_CHROM_MAX_CHARS + 1];
+    int64_t     start,
+		end;
+    size_t      support;
+    uint64_t    *presence;  // Bitset of contributing samples
+}   consensus_peak_t;
+
+typedef struct
+{
+    int64_t     pos;
+    int         delta;      // +1 at peak start, -1 at end
+    unsigned    sample;
+}   sample_event_t;
+
+/*
+ *  Shared state for the per-chromosome sweep threads of
+ *  jaccard_matrix().  Events are bucketed by chromosome.
+ */
+typedef struct
+{
+    size_t          samples,
+		    chrom_count,
+		    first_chrom,
+		    chrom_step;
+    size_t          *chrom_first;   // Events for chrom c start here
+    sample_event_t  *events;
+    int64_t         *intersect;     // samples x samples, per thread
+}   jaccard_thread_t;
+
+#define STITCH_DEFAULT_DISTANCE 12500
+#define STITCH_DEFAULT_EXCLUDE  "upstream1000"
+
+typedef struct
+{
+    size_t      chrom;      // Index into feature_index_t chroms
+    int64_t     start,
+		end;
+    size_t      constituents;
+    double      signal;
+}   stitched_region_t;
+
+typedef struct
+{
+    size_t              count,
+			array_size,
+			excluded;
+    stitched_region_t   *regions;
+}   stitch_list_t;
+
+#define STITCH_LIST_INIT    { 0, 0, 0, NULL }
+
+/*
+ *  GREAT basal plus extension regulatory domains: each gene gets a basal
+ *  domain from 5 kb upstream to 1 kb downstream of its TSS, extended in
+ *  both directions to the nearest neighboring basal domains, up to a
+ *  maximum distance from the TSS.
+ */
+#define GREAT_BASAL_UPSTREAM    5000
+#define GREAT_BASAL_DOWNSTREAM  1000
+#define GREAT_MAX_EXTENSION     1000000
+
+typedef struct
+{
+    size_t      chrom;
+    int64_t     tss,
+		basal_start,
+		basal_end;
+    fi_gene_t   *gene;
+}   great_gene_t;
+
+/*
+ *  Bases are encoded 0-3 for ACGT, so the complement of b is 3 - b.
+ *  Anything else, such as N, is BASE_OTHER.
+ */
+#define BASE_OTHER      4
+#define BASE_CODES      5
+
+/*
+ *  Called by peak_seq_sweep() once per FASTA record with peaks, with the
+ *  encoded chromosome and the indexes of the peaks on it.
+ */
+typedef int (*peak_seq_func_t)(void *arg, size_t chrom, const uint8_t *codes,
+			       int64_t len, const size_t *peak_indexes,
+			       size_t peak_count);
+
+/*
+ *  Integer log-odds position weight matrix in column-major order,
+ *  score[j * BASE_CODES + b] for base code b at position j, so each
+ *  column is a small lookup table for the sliding-window sums.  Row
+ *  BASE_OTHER holds the lowest score of each column, so N never
+ *  contributes to a hit.  rc_score is the reverse complement matrix,
+ *  which scans the minus strand without reverse complementing peaks.
+ */
+#define MOTIF_SCALE         100
+#define MOTIF_PSEUDOCOUNT   0.01
+#define MOTIF_MAX_WIDTH     64
+#define MOTIF_DEFAULT_THRESHOLD 0.8
+#define MOTIF_CHUNK_PEAKS   4096
+
+typedef struct
+{
+    char        *id,
+		*name;
+    size_t      width;
+    int32_t     *score,
+		*rc_score,
+		min_score,
+		max_score;
+}   motif_t;
+
+typedef struct
+{
+    size_t      count,
+		array_size;
+    motif_t     *motifs;
+}   motif_set_t;
+
+#define MOTIF_SET_INIT  { 0, 0, NULL }
+
+typedef struct
+{
+    int32_t     score;
+    int32_t     offset;     // From peak start, of the motif's first base
+    char        strand;
+}   motif_hit_t;
+
+/*
+ *  Shared state for scanning one chunk of a chromosome's peaks.  Each
+ *  thread takes every threads'th peak of the chunk and writes the best
+ *  hit for each motif to results[peak * motif count + motif].
+ */
+typedef struct
+{
+    motif_set_t     *motifs;
+    feature_index_t *fi;
+    peak_set_t      *peaks;
+    overlap_params_t *params;
+    size_t          chrom;
+    const uint8_t   *codes;
+    int64_t         len;
+    const size_t    *peak_indexes;
+    size_t          peak_count,
+		    first_peak,
+		    peak_step;
+    motif_hit_t     *results;
+    unsigned char   *class_ids;
+}   motif_thread_t;
+
+typedef struct
+{
+    motif_set_t     *motifs;
+    feature_index_t *fi;
+    peak_set_t      *peaks;
+    overlap_params_t *params;
+    double          threshold;
+    unsigned        threads;
+    FILE            *outfile;
+}   motif_scan_t;
+
+/*
+ *  Canonical k-mer counts per class.  Slots 0 to class_count - 1 are
+ *  classes, slot class_count is unclassified peaks, and the last slot is
+ *  all peaks, used as the background.  Small k uses a dense array indexed
+ *  by slot and k-mer; larger k uses an open-addressing hash table keyed
+ *  by k-mer and slot.
+ */
+#define KMER_MAX_K          12
+#define KMER_DENSE_MAX_K    8
+#define KMER_HASH_START_SIZE    (1 << 16)
+#define KMER_HASH_EMPTY     UINT64_MAX
+#define KMER_SLOT_BITS      7
+
+typedef struct
+{
+    unsigned    k;
+    size_t      slots;
+    bool        dense;
+    int64_t     *counts;    // Dense: [slot][k-mer], hash: parallel to keys
+    uint64_t    *keys;      // k-mer << KMER_SLOT_BITS | slot
+    size_t      table_size,
+		used;
+    int64_t     *totals;    // K-mers counted per slot
+}   kmer_counts_t;
+
+typedef struct
+{
+    feature_index_t *fi;
+    peak_set_t      *peaks;
+    overlap_params_t *params;
+    size_t          chrom;
+    const uint8_t   *codes;
+    int64_t         len;
+    const size_t    *peak_indexes;
+    size_t          peak_count,
+		    first_peak,
+		    peak_step;
+    kmer_counts_t   counts;     // Per thread, merged when all are done
+}   kmer_thread_t;
+
+typedef struct
+{
+    feature_index_t *fi;
+    peak_set_t      *peaks;
+    overlap_params_t *params;
+    unsigned        threads;
+    kmer_thread_t   *thread_args;
+}   kmer_scan_t;
+
+/*
+ *  bigWig file, read through its chromosome B+ tree and R-tree indexes.
+ *  Index leaves are loaded into sorted arrays on open (zoom levels on
+ *  first use), and the last decompressed data block is cached, so
+ *  sorted peaks walk the data blocks sequentially.
+ */
+#define BIGWIG_MAGIC            0x888FFC26
+#define BIGWIG_CHROM_TREE_MAGIC 0x78CA8C91
+#define BIGWIG_RTREE_MAGIC      0x2468ACE0
+#define BIGWIG_OK               0
+#define BIGWIG_NOINPUT          -1
+#define BIGWIG_BAD_DATA         -2
+// Use a zoom level only if it has at least this many records per peak
+#define BIGWIG_ZOOM_MIN_RECORDS 16
+
+typedef struct
+{
+    uint32_t    start_chrom,
+		start_base,
+		end_chrom,
+		end_base;
+    uint64_t    offset,
+		size;
+}   bw_block_t;
+
+typedef struct
+{
+    uint32_t    reduction;
+    uint64_t    index_offset;
+    size_t      block_count;
+    bw_block_t  *blocks;        // NULL until first used
+}   bw_zoom_t;
+
+typedef struct
+{
+    char        *name;
+    uint32_t    id,
+		size;
+}   bw_chrom_t;
+
+/*
+ *  The last decompressed block.  Full resolution and zoom data have
+ *  separate caches, since zoom queries also read full resolution edges.
+ */
+typedef struct
+{
+    uint64_t        offset;     // File offset of the block in data
+    unsigned char   *data;
+    size_t          len,
+		    size;
+}   bw_cache_t;
+
+#define BW_CACHE_INIT   { UINT64_MAX, NULL, 0, 0 }
+
+typedef struct
+{
+    FILE            *stream;
+    uint32_t        uncompress_buf_size;
+    size_t          zoom_count;
+    bw_zoom_t       *zooms;
+    size_t          chrom_count;
+    bw_chrom_t      *chroms;
+    size_t          block_count;
+    bw_block_t      *blocks;
+    bw_cache_t      full_cache,
+		    zoom_cache;
+    unsigned char   *raw;
+    size_t          raw_size;
+}   bigwig_t;
+
+#define BIGWIG_INIT { NULL, 0, 0, NULL, 0, NULL, 0, NULL, \
+		      BW_CACHE_INIT, BW_CACHE_INIT, NULL, 0 }
+
+typedef struct
+{
+    int64_t     covered;
+    double      sum,
+		max;
+}   bw_stats_t;
+
+/*
+ *  Chain file liftover.  Aligned blocks are indexed as features on the
+ *  source (target) chromosomes, named "chain-id<TAB>new-chrom<TAB>origin"
+ *  with the chain's query strand, where origin is the new coordinate of
+ *  the block start on the + strand, or of the block end on the - strand.
+ */
+#define LIFTOVER_DEFAULT_MIN_MATCH  0.95
+#define LIFTOVER_LINE_MAX           1024
+
+typedef struct
+{
+    size_t      id;
+    char        chrom[BL_CHROM_MAX_CHARS + 1];
+    char        strand;
+    int64_t     matched,
+		start,
+		end;
+}   liftover_hit_t;
+
+typedef struct
+{
+    feature_index_t *chains;
+    FILE            *in,
+		    *out;
+    double          min_match;
+}   liftover_thread_t;
+
+/*
+ *  BEDPE loops.  The anchors of loop l are peaks 2l and 2l + 1 of one
+ *  peak set, so they can be classified in a single sorted pass and the
+ *  results scattered back by index.  The loop name is kept with the
+ *  first anchor.
+ */
+#define LOOP_LINE_MAX       4096
+
+typedef struct
+{
+    peak_set_t      anchors;
+    size_t          *order;     // Anchor indexes sorted by chrom, start
+    unsigned char   *class_id;
+    fi_gene_t       **gene;     // Nearest TSS, or NULL
+    int64_t         *distance;  // From the TSS to the anchor midpoint
+}   loop_set_t;
+
+#define LOOP_SET_INIT   { PEAK_SET_INIT, NULL, NULL, NULL, NULL }
+
+/*
+ *  Interval set algebra on peak sets, as with bedtools merge, intersect,
+ *  subtract, complement, slop, and flank.  Sweeps run on sets sorted by
+ *  chromosome and start, with whole chromosomes assigned to threads as
+ *  in jaccard_matrix(), each writing a separate output set.
+ */
+#define INTERVAL_MERGE          0
+#define INTERVAL_INTERSECT      1
+#define INTERVAL_SUBTRACT       2
+#define INTERVAL_COMPLEMENT     3
+
+typedef struct
+{
+    int64_t         start,
+		    end;
+    size_t          index;
+}   interval_key_t;
+
+typedef struct
+{
+    int             op;
+    peak_set_t      *a,
+		    *b,
+		    *out;           // One set per chromosome
+    size_t          *a_first,       // Intervals of chrom c start here
+		    *b_first,
+		    chrom_count,
+		    first_chrom,
+		    chrom_step;
+    feature_index_t *chroms;
+    int64_t         distance;
+}   interval_thread_t;
+
+/*
+ *  Preprocessing of peaks before any mode, applied in the order slop,
+ *  flank, merge, intersect, subtract, complement.
+ */
+typedef struct
+{
+    int64_t         slop,           // 0 for none
+		    flank,          // 0 for none
+		    merge_distance; // -1 for none
+    char            *intersect_filename,
+		    *subtract_filename,
+		    *chrom_sizes;
+    bool            complement;
+    unsigned        threads;
+}   interval_ops_t;
+
+#define INTERVAL_OPS_INIT   { 0, 0, -1, NULL, NULL, NULL, false, 1 }
+
+/*
+ *  Isoform-resolved classification.  Each gene is cut into segments at
+ *  every boundary of its transcripts' subfeatures, and each segment
+ *  carries one bitset of the gene's transcripts per transcript-level
+ *  class (the prioritized classes other than upstream regions), in
+ *  priority order.  OR-ing the bitsets of the segments a peak touches
+ *  gives the classes of every transcript at once.
+ */
+#define ISOFORM_MAX_CLASSES     16
+#define ISOFORM_WORD_BITS       64
+
+typedef struct
+{
+    char        *name,
+		*id;
+    size_t      first_tx,
+		tx_count,
+		words;          // Bitset words per class
+}   isoform_gene_t;
+
+typedef struct
+{
+    size_t      gene,
+		bits;           // Offset of the segment's bitsets in bits
+}   isoform_segment_t;
+
+typedef struct
+{
+    feature_index_t     segments;   // gene[] holds the segment number
+    size_t              class_count;
+    unsigned char       class_id[ISOFORM_MAX_CLASSES];  // In segments
+    size_t              gene_count,
+			gene_array_size,
+			tx_count,
+			tx_array_size,
+			segment_count,
+			segment_array_size,
+			bit_count,
+			bit_array_size;
+    isoform_gene_t      *genes;
+    char                **tx_names;
+    isoform_segment_t   *segs;
+    uint64_t            *bits;
+}   isoform_index_t;
+
+/*
+ *  Subfeatures of the gene being loaded, with tx relative to the gene's
+ *  first transcript
+ */
+typedef struct
+{
+    int64_t     start,
+		end;
+    size_t      tx;
+    unsigned    slot;
+}   isoform_feature_t;
+
+typedef struct
+{
+    size_t              count,
+			array_size;
+    isoform_feature_t   *features;
+}   isoform_feature_list_t;
+
+#define ISOFORM_FEATURE_LIST_INIT   { 0, 0, NULL }
+
+// Per-query scratch: OR-ed bitsets of each gene a peak touches
+typedef struct
+{
+    size_t      count,
+		array_size,
+		*gene,
+		*offset,        // Into bits
+		bit_count,
+		bit_array_size;
+    uint64_t    *bits;
+}   isoform_query_t;
+
+#define ISOFORM_QUERY_INIT  { 0, 0, NULL, NULL, 0, 0, NULL }
+
+typedef struct
+{
+    peak_set_t      set;
+    feature_index_t chroms;
+    FILE            *out;
+}   interval_pipe_t;
+
+/*
+ *  One-pass ATAC-seq QC.  Each filtered alignment contributes one Tn5
+ *  insertion, shifted +4 on the plus strand and -5 on the minus strand,
+ *  which is looked up in the merged peaks and the deduplicated gene
+ *  TSSs, both sorted and bucketed by chromosome.
+ */
+#define ATAC_TSS_FLANK          2000    // Profile covers TSS +/- this
+#define ATAC_TSS_CENTER         50      // Enrichment center is TSS +/- this
+#define ATAC_TSS_EDGE           100     // Background from each profile end
+#define ATAC_MAX_FRAGMENT       1000    // Histogram size
+#define ATAC_NFR_MAX            146     // Nucleosome-free fragments
+#define ATAC_MONO_MAX           294     // Mono-nucleosome fragments
+#define ATAC_DI_MAX             441     // Di-nucleosome fragments
+
+typedef struct
+{
+    size_t          chrom;
+    int64_t         tss;
+    char            strand;
+}   atac_tss_t;
+
+typedef struct
+{
+    peak_set_t      peaks;          // Merged and sorted
+    size_t          peak_count,     // Before merging
+		    chrom_count,
+		    *peak_first,    // Peaks of chrom c start here
+		    *tss_first,
+		    tss_count;
+    atac_tss_t      *tss;
+    uint64_t        alignments,
+		    unmapped,
+		    secondary,
+		    qc_fail,
+		    duplicate,
+		    low_mapq,
+		    insertions,
+		    in_peaks,
+		    near_tss,
+		    profile[2 * ATAC_TSS_FLANK + 1],
+		    fragments,
+		    fragment_hist[ATAC_MAX_FRAGMENT + 1],
+		    long_fragments;
+    double          fragment_sum;
+}   atac_qc_t;
+
+/*
+ *  Streaming coverage from sorted alignments.  Aligned blocks are added
+ *  to a circular difference array starting at the first position not
+ *  yet written, which only grows to fit the longest alignment span.
+ *  Positions before the current alignment are final and are written as
+ *  runs of equal depth.
+ */
+#define COVERAGE_WINDOW_START   65536   // Must be a power of 2
+
+typedef struct
+{
+    char            *chrom;
+    int32_t         *diff;
+    size_t          size,
+		    mask;
+    int64_t         base,           // First position not yet written
+		    last_event,     // Last position with a pending change
+		    depth,
+		    run_start,
+		    run_depth;
+    // Called with arg for each run, coverage_write_run() by default
+    void            (*emit)(void *arg, const char *chrom, int64_t start,
+			    int64_t end, int64_t depth);
+    void            *arg;
+}   coverage_t;
+
+typedef struct
+{
+    const char      *alignments_filename;
+    char            **chroms;
+    FILE            **runs;         // One temp file per chromosome
+    uint64_t        *reads;
+    size_t          chrom_count,
+		    first_chrom,
+		    chrom_step;
+    unsigned        min_mapq;
+    int             status;
+}   coverage_thread_t;
+
+/*
+ *  Built-in peak calling.  Fragment or cut-site pileup runs from the
+ *  coverage engine are buffered only as far as the local background
+ *  window, and each run is tested against a Poisson distribution with
+ *  the local mean depth as lambda.  Significant runs are joined into
+ *  candidate peaks, which are tested again at the end against the
+ *  genome-wide mean depth.
+ */
+#define PEAK_CALL_FRAGMENT      200     // Single-end fragment length
+#define PEAK_CALL_CUT_EXTEND    75      // Cut-site pileup is +/- this
+#define PEAK_CALL_LOCAL         5000    // Local lambda from +/- this
+#define PEAK_CALL_MAX_GAP       50      // Join significant runs this close
+#define PEAK_CALL_MIN_LENGTH    100
+#define PEAK_CALL_DEFAULT_PVALUE    1.0e-5
+
+typedef struct
+{
+    int64_t         start,
+		    end,
+		    depth;
+    double          area;           // Pileup before this run
+}   peak_run_t;
+
+typedef struct
+{
+    char            *chrom;
+    int64_t         start,
+		    end,
+		    summit,
+		    depth;          // At the summit
+    double          lambda;         // Local lambda at the summit
+}   called_peak_t;
+
+typedef struct
+{
+    const char      *alignments_filename,
+		    *narrow_peak_filename;
+    FILE            *narrow_peak,   // NULL if not saved
+		    *out;           // BED peaks for classification
+    bool            cut_sites;
+    unsigned        min_mapq;
+    double          min_log10p;     // -log10 of the p-value cutoff
+    coverage_t      cov;
+    peak_run_t      *runs;
+    size_t          run_count,
+		    run_array_size,
+		    next_run,       // First run not yet tested
+		    low_run,        // First run ending after window start
+		    high_run;       // First run ending after window end
+    double          area,           // Pileup on this chromosome
+		    total_area;
+    int64_t         genome_size,    // From @SQ LN, 0 if unknown
+		    extent_sum;     // Sum of pileup extents per chromosome
+    bool            region_open;
+    called_peak_t   region,
+		    *peaks;
+    size_t          peak_count,
+		    peak_array_size;
+    int             status;         // EX_ status of the calling thread
+}   peak_call_t;
+
+/*
+ *  One alignment file of a peak x sample count matrix.  Each reader
+ *  thread sweeps its file against the shared sorted peaks and counts
+ *  into its own column.
+ */
+typedef struct
+{
+    const char      *filename;
+    feature_index_t *chroms;
+    peak_set_t      *peaks;         // Sorted by interval_set_sort()
+    size_t          *chrom_first;   // Peaks for chrom c start here
+    unsigned        min_mapq;
+    uint64_t        *counts,        // One per peak
+		    alignments,
+		    unmapped,
+		    low_mapq,
+		    used;
+    int             status;
+}   count_sample_t;
+
+/*
+ *  Reference blocks of one alignment from its CIGAR, split at N.  Kept
+ *  beside the bl_sam_t and reparsed in place for each record.
+ */
+#define SAM_BLOCKS_START_SIZE   16
+
+typedef struct
+{
+    size_t      count,
+		array_size;
+    int64_t     *start,
+		*end,
+		aligned_len;    // Sum of block lengths
+}   sam_blocks_t;
+
+#define SAM_BLOCKS_INIT { 0, 0, NULL, NULL, 0 }
+
+/*
+ *  Splice junctions, one open addressing hash table per chromosome.
+ *  Junctions are intron coordinates, the gap between two CIGAR blocks.
+ *  The same tables hold annotated introns for exact lookup.
+ */
+#define JUNCTION_HASH_START_SIZE    1024
+
+typedef struct
+{
+    int64_t     start,      // First intron base, 0-based
+		end;        // One past the last intron base
+    uint64_t    count;      // Reads or annotations, 0 if slot is empty
+    char        strand,
+		*name;      // First annotated intron, NULL for reads
+}   junction_t;
+
+typedef struct
+{
+    junction_t  *table;
+    size_t      table_size,
+		used;
+}   junction_shard_t;
+
+typedef struct
+{
+    feature_index_t     chroms;     // Names only, numbering the shards
+    junction_shard_t    *shards;
+    size_t              shard_array_size;
+}   junction_set_t;
+
+/*
+ *  Raw SAM record for modes that write alignments.  The mandatory
+ *  fields are NUL terminated in place and the optional tags follow as
+ *  one string at field[SAM_RECORD_FIELDS].
+ */
+#define SAM_RECORD_FIELDS   11
+#define SAM_RECORD_QNAME    0
+#define SAM_RECORD_FLAG     1
+#define SAM_RECORD_RNAME    2
+#define SAM_RECORD_POS      3
+#define SAM_RECORD_MAPQ     4
+#define SAM_RECORD_CIGAR    5
+#define SAM_RECORD_RNEXT    6
+#define SAM_RECORD_PNEXT    7
+#define SAM_RECORD_TLEN     8
+#define SAM_RECORD_SEQ      9
+#define SAM_RECORD_QUAL     10
+
+#define SAM_RECORD_FIELD(r, f)  ((r)->line + (r)->field[f])
+#define SAM_RECORD_INIT         { NULL, 0, { 0 }, 0, 0, 0, 0 }
+
+typedef struct
+{
+    char        *line;
+    size_t      line_size,      // getline() buffer size
+		field[SAM_RECORD_FIELDS + 1];   // Offsets into line
+    unsigned    flag,
+		mapq;
+    int64_t     pos,            // 1-based, as in the file
+		pnext;
+}   sam_record_t;
+
+/*
+ *  Streaming duplicate marking.  Groups of reads or pairs sharing a key
+ *  live in an open addressing table that is rebuilt without closed
+ *  groups whenever it fills.  Records wait in a ring in input order
+ *  until their group closes.  The first mate of a pair also waits in a
+ *  table by QNAME, rebuilt the same way, until its mate arrives.
+ *  Pairs with mates further apart than DUP_MARK_MAX_INSERT are not
+ *  held for their mates.
+ */
+#define DUP_MARK_WINDOW             1000
+#define DUP_MARK_MAX_INSERT         100000
+#define DUP_MARK_HASH_START_SIZE    1024
+#define DUP_MARK_QUEUE_START_SIZE   4096
+
+typedef struct
+{
+    int64_t     pos5,           // Unclipped 5' position, lower end of pairs
+		mate_pos,       // Unclipped 5' position of the other end
+		mate_chrom;     // 0 same, -1 no mapped mate, else index + 1
+    char        strand,
+		mate_strand;
+}   dup_key_t;
+
+typedef struct
+{
+    dup_key_t   key;
+    uint64_t    best_seq,       // Queue sequence number of best read/pair
+		best_score;     // Sum of its base qualities
+    size_t      pending,        // Records not yet written
+		open;           // Pairs waiting for a mate
+    bool        used,
+		scored;         // best_seq is set
+}   dup_group_t;
+
+typedef struct
+{
+    sam_record_t    rec;
+    dup_key_t       key;
+    uint64_t        seq,
+		    pair_seq,   // seq of the first mate, or seq
+		    score;      // Sum of base qualities
+    bool            keyed,      // False for records passed through
+		    open;       // First mate waiting for its mate
+}   dup_entry_t;
+
+typedef struct
+{
+    FILE            *out;
+    char            *chrom;
+    feature_index_t mate_chroms;    // Names only, numbering rnext
+    dup_entry_t     *queue;
+    size_t          queue_size,
+		    head,
+		    count;
+    dup_group_t     *table;
+    size_t          table_size,
+		    used;           // Including closed groups
+    uint64_t        *mates;         // seq + 1 of first mates, 0 if empty
+    size_t          mates_size,
+		    mates_used;     // Including mates already found
+    int64_t         last_pos;
+    uint64_t        next_seq,
+		    records,
+		    keyed,
+		    duplicates;
+}   dup_mark_t;
+
+typedef struct
+{
+    const char      *alignments_filename;
+    char            **chroms;
+    FILE            **outputs;      // One temp file per chromosome
+    size_t          chrom_count,
+		    first_chrom,
+		    chrom_step;
+    uint64_t        records,
+		    keyed,
+		    duplicates;
+    int             status;
+}   dup_mark_thread_t;
+
+/*
+ *  Region filter for alignments.  Regions are merged and sorted so that
+ *  each chromosome's intervals are ordered by both start and end, and
+ *  one pointer per sweep skips those ending before the current read.
+ */
+typedef struct
+{
+    feature_index_t chroms;         // Names only, numbering the regions
+    peak_set_t      regions;
+    size_t          *chrom_first;
+    bool            include;        // Keep overlapping reads, not drop
+    unsigned        min_mapq;
+    uint64_t        records,
+		    unmapped,
+		    low_mapq,
+		    excluded,       // Overlap an exclusion region
+		    outside,        // Overlap no inclusion region
+		    passed;
+}   region_filter_t;
+
 #include "protos.h"
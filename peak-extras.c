@@ -0,0 +1,170 @@
+/***************************************************************************
+ *  Description:
+ *      Optional outputs collected while peaks are classified: per-peak
+ *      class composition, peaks per gene, and peaks per feature.  These
+ *      share one in-memory feature index and one overlap query per peak,
+ *      and are written alongside the normal overlaps output.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Set up the outputs whose filenames are not NULL.  Genes come from
+ *      the unsorted augmented BED, which groups each gene's features
+ *      together, so it is loaded instead of the sorted BED when a gene
+ *      rollup is requested.  The composition header is written here and
+ *      its rows as peaks are added.
+ *
+ *  Returns:
+ *      EX_OK, or the status of load_feature_index() or EX_CANTCREAT
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+int     peak_extras_open(peak_extras_t *px, const char *composition_filename,
+			 const char *gene_rollup_filename,
+			 const char *feature_counts_filename,
+			 const char *sorted_filename,
+			 const char *augmented_filename,
+			 const char *priority_list, overlap_params_t *params)
+
+{
+    size_t  c;
+    int     status;
+
+    memset(px, 0, sizeof(*px));
+    px->composition_filename = composition_filename;
+    px->gene_rollup_filename = gene_rollup_filename;
+    px->feature_counts_filename = feature_counts_filename;
+    px->params = params;
+    px->hits = (hit_list_t)HIT_LIST_INIT;
+    if ( (status = load_feature_index(&px->fi,
+		gene_rollup_filename != NULL ? augmented_filename :
+		sorted_filename, priority_list, NULL,
+		gene_rollup_filename != NULL)) != EX_OK )
+	return status;
+    if ( gene_rollup_filename != NULL )
+    {
+	fprintf(stderr, "Loaded %zu genes.\n", px->fi.gene_count);
+	gene_rollup_init(&px->gr, &px->fi, 0);
+    }
+    if ( feature_counts_filename != NULL )
+	feature_counts_init(&px->fc, &px->fi);
+    if ( composition_filename != NULL )
+    {
+	if ( (px->composition_stream = open_output(composition_filename))
+		== NULL )
+	    return EX_CANTCREAT;
+	fputs("#Chr\tP-start\tP-end\tP-name", px->composition_stream);
+	for (c = 0; c <= px->fi.class_count; ++c)
+	    fprintf(px->composition_stream, "\t%s",
+		    feature_index_class_name(&px->fi,
+		    c == px->fi.class_count ? FEATURE_CLASS_NONE : c));
+	putc('\n', px->composition_stream);
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add the peak [start, end) to each output.  Peaks on chromosomes
+ *      with no features overlap nothing, so they are all upstream-beyond
+ *      in the composition and count toward no gene or feature.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+void    peak_extras_add(peak_extras_t *px, const char *chrom_name,
+			int64_t start, int64_t end, const char *peak_name)
+
+{
+    size_t  c;
+
+    px->chrom = feature_index_find_chrom(&px->fi, chrom_name, px->chrom);
+    if ( px->composition_stream != NULL )
+    {
+	// Leaves the qualifying hits in px->hits for the other outputs
+	peak_composition(&px->fi, px->chrom, start, end, px->params,
+			 &px->hits, &px->events, &px->events_size, px->bp);
+	fprintf(px->composition_stream, "%s\t%" PRId64 "\t%" PRId64 "\t%s",
+		chrom_name, start, end, peak_name);
+	for (c = 0; c <= px->fi.class_count; ++c)
+	    fprintf(px->composition_stream, "\t%" PRId64, px->bp[c]);
+	putc('\n', px->composition_stream);
+    }
+    else
+	feature_index_classify(&px->fi, px->chrom, start, end, px->params,
+			       &px->hits, NULL);
+    if ( px->gene_rollup_filename != NULL )
+	gene_rollup_add(&px->gr, &px->fi, &px->hits, 0);
+    if ( px->feature_counts_filename != NULL )
+	feature_counts_add(&px->fc, &px->fi, &px->hits, start, end);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the gene rollup and feature counts, close the composition,
+ *      and free everything.
+ *
+ *  Returns:
+ *      EX_OK or EX_CANTCREAT
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+int     peak_extras_close(peak_extras_t *px)
+
+{
+    FILE    *outfile;
+    int     status = EX_OK;
+
+    if ( px->composition_stream != NULL )
+	close_output(px->composition_stream);
+    if ( px->gene_rollup_filename != NULL )
+    {
+	if ( (outfile = open_output(px->gene_rollup_filename)) == NULL )
+	    status = EX_CANTCREAT;
+	else
+	{
+	    gene_rollup_write(&px->gr, &px->fi, NULL, outfile);
+	    close_output(outfile);
+	}
+	gene_rollup_free(&px->gr);
+    }
+    if ( px->feature_counts_filename != NULL )
+    {
+	if ( (outfile = open_output(px->feature_counts_filename)) == NULL )
+	    status = EX_CANTCREAT;
+	else
+	{
+	    feature_counts_write(&px->fc, &px->fi, outfile);
+	    close_output(outfile);
+	}
+	feature_counts_free(&px->fc);
+    }
+    free(px->events);
+    hit_list_free(&px->hits);
+    feature_index_free(&px->fi);
+    return status;
+}
@@ -0,0 +1,142 @@
+/***************************************************************************
+ *  Description:
+ *      Access to peak sequences from a genome FASTA.  The FASTA is read
+ *      one record at a time and each chromosome is encoded 0-3 for ACGT,
+ *      so only one chromosome is in memory at once.  Peaks are visited
+ *      per chromosome in FASTA order, in their original order within
+ *      each chromosome.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Encode len bases of seq as 0-3 for ACGT (either case), BASE_OTHER
+ *      for anything else.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    seq_encode(const char *seq, size_t len, uint8_t *codes)
+
+{
+    static uint8_t  table[256];
+    static bool     initialized = false;
+    size_t          c;
+
+    if ( !initialized )
+    {
+	memset(table, BASE_OTHER, sizeof(table));
+	table['A'] = table['a'] = 0;
+	table['C'] = table['c'] = 1;
+	table['G'] = table['g'] = 2;
+	table['T'] = table['t'] = 3;
+	initialized = true;
+    }
+    for (c = 0; c < len; ++c)
+	codes[c] = table[(unsigned char)seq[c]];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Stream the genome FASTA and call func for each record with peaks.
+ *      Peak chromosome indexes refer to fi, as from peak_set_read().
+ *      Peaks are clipped to the chromosome by the caller if needed.
+ *
+ *  Returns:
+ *      EX_OK, an error from func, or an error reading the FASTA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     peak_seq_sweep(const char *fasta_filename, feature_index_t *fi,
+		       peak_set_t *peaks, peak_seq_func_t func, void *arg)
+
+{
+    FILE        *fasta_stream;
+    bl_fasta_t  record = BL_FASTA_INIT;
+    uint8_t     *codes = NULL;
+    size_t      *chrom_first, *order, *next, c, chrom, codes_size = 0;
+    char        *name;
+    int         status = EX_OK, read_status;
+
+    if ( (fasta_stream = xt_fopen(fasta_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		fasta_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+
+    // Bucket peak indexes by chromosome, preserving order
+    chrom_first = xt_malloc(fi->chrom_count + 1, sizeof(*chrom_first));
+    next = xt_malloc(fi->chrom_count + 1, sizeof(*next));
+    order = xt_malloc(peaks->count + 1, sizeof(*order));
+    if ( (chrom_first == NULL) || (next == NULL) || (order == NULL) )
+    {
+	fputs("peak_seq_sweep(): Could not allocate peak buckets.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    memset(chrom_first, 0, (fi->chrom_count + 1) * sizeof(*chrom_first));
+    for (c = 0; c < peaks->count; ++c)
+	++chrom_first[peaks->chrom[c] + 1];
+    for (c = 0; c < fi->chrom_count; ++c)
+	chrom_first[c + 1] += chrom_first[c];
+    memcpy(next, chrom_first, fi->chrom_count * sizeof(*next));
+    for (c = 0; c < peaks->count; ++c)
+	order[next[peaks->chrom[c]]++] = c;
+
+    while ( (status == EX_OK) &&
+	    ((read_status = bl_fasta_read(&record, fasta_stream)) == BL_READ_OK) )
+    {
+	// Chromosome name is the first word of the description
+	name = BL_FASTA_DESC(&record) + 1;
+	name[strcspn(name, " \t")] = '\0';
+	chrom = feature_index_find_chrom(fi, name, 0);
+	if ( (chrom == fi->chrom_count) ||
+	     (chrom_first[chrom] == chrom_first[chrom + 1]) )
+	    continue;
+	if ( BL_FASTA_SEQ_LEN(&record) > codes_size )
+	{
+	    codes_size = BL_FASTA_SEQ_LEN(&record);
+	    free(codes);
+	    if ( (codes = xt_malloc(codes_size, sizeof(*codes))) == NULL )
+	    {
+		fputs("peak_seq_sweep(): Could not allocate sequence.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	fprintf(stderr, "Scanning %s...\n", name);
+	seq_encode(BL_FASTA_SEQ(&record), BL_FASTA_SEQ_LEN(&record), codes);
+	status = func(arg, chrom, codes, BL_FASTA_SEQ_LEN(&record),
+		      order + chrom_first[chrom],
+		      chrom_first[chrom + 1] - chrom_first[chrom]);
+    }
+    if ( (status == EX_OK) && (read_status != BL_READ_EOF) )
+	status = EX_DATAERR;
+
+    xt_fclose(fasta_stream);
+    bl_fasta_free(&record);
+    free(codes);
+    free(chrom_first);
+    free(next);
+    free(order);
+    return status;
+}
@@ -1,6 +1,300 @@
 /* peak-classifier.c */
 int main(int argc, char *argv[]);
+int close_peaks(FILE *peak_stream, int status, const char *output_filename);
+int load_feature_index(feature_index_t *fi, const char *sorted_filename, const char *priority_list, const char *chrom_sizes, _Bool track_genes);
+FILE *open_output(const char *filename);
+void close_output(FILE *outfile);
+int class_coverage_mode(const char *sorted_filename, const char *priority_list, const char *chrom_sizes, const char *coverage_filename, const char *output_filename);
+int jaccard_mode(const char *batch_filename, unsigned threads, const char *output_filename);
+int consensus_mode(const char *batch_filename, const char *sorted_filename, const char *priority_list, overlap_params_t *params, size_t min_support, const char *output_filename);
+int motif_mode(FILE *peak_stream, const char *sorted_filename, const char *priority_list, overlap_params_t *params, _Bool midpoints_only, const char *motif_filename, const char *genome_filename, double threshold, unsigned threads, const char *output_filename);
+int bigwig_mode(FILE *peak_stream, const char *sorted_filename, const char *priority_list, overlap_params_t *params, _Bool midpoints_only, const char *bigwig_filename, _Bool use_zoom, _Bool summary, const char *output_filename);
+int kmer_mode(FILE *peak_stream, const char *sorted_filename, const char *priority_list, overlap_params_t *params, _Bool midpoints_only, unsigned k, const char *genome_filename, unsigned threads, const char *output_filename);
+int loops_mode(FILE *loop_stream, const char *sorted_filename, const char *augmented_filename, const char *priority_list, overlap_params_t *params, _Bool midpoints_only, _Bool nearest_genes, const char *output_filename);
+int isoform_mode(FILE *peak_stream, const char *sorted_filename, const char *augmented_filename, const char *priority_list, overlap_params_t *params, _Bool midpoints_only, const char *output_filename);
+int atac_qc_mode(FILE *peak_stream, const char *augmented_filename, const char *priority_list, const char *alignments_filename, unsigned min_mapq, const char *output_filename);
+int count_matrix_mode(FILE *peak_stream, const char *list_filename, unsigned min_mapq, const char *output_filename);
+int classify_reads_mode(const char *alignments_filename, const char *sorted_filename, const char *priority_list, overlap_params_t *params, unsigned min_mapq, const char *output_filename);
+int junctions_mode(const char *alignments_filename, const char *sorted_filename, unsigned min_mapq, const char *output_filename);
+int mark_duplicates_mode(const char *alignments_filename, unsigned threads, const char *output_filename);
+int filter_alignments_mode(const char *alignments_filename, const char *regions_filename, _Bool include, unsigned min_mapq, unsigned threads, const char *output_filename);
+int bedgraph_mode(const char *alignments_filename, unsigned min_mapq, _Bool cpm, unsigned threads, const char *output_filename);
+int great_mode(FILE *peak_stream, const char *sorted_filename, const char *augmented_filename, const char *great_filename, const char *priority_list, overlap_params_t *params, _Bool midpoints_only, int64_t max_extension, const char *output_filename);
+int tiles_mode(const char *sorted_filename, const char *priority_list, const char *chrom_sizes, overlap_params_t *params, int64_t tile_size, int64_t tile_step, const char *output_filename);
+int stitch_mode(FILE *peak_stream, const char *sorted_filename, const char *priority_list, overlap_params_t *params, int64_t distance, const char *exclude_class, const char *output_filename);
+int gene_rollup_mode(const char *batch_filename, const char *augmented_filename, const char *priority_list, overlap_params_t *params, _Bool midpoints_only, const char *output_filename);
+int gene_rollup_stream(gene_rollup_t *gr, feature_index_t *fi, FILE *peak_stream, overlap_params_t *params, _Bool midpoints_only, size_t sample);
+int enrichment_mode(FILE *peak_stream, const char *sorted_filename, const char *priority_list, const char *chrom_sizes, const char *coverage_filename, const char *exclude_filename, overlap_params_t *params, _Bool midpoints_only, size_t permutations, unsigned threads, uint64_t seed, const char *output_filename);
 int gff_augment(FILE *gff_stream, const char *upstream_boundaries, const char *augmented_filename);
 void gff_process_subfeatures(FILE *gff_stream, FILE *bed_stream, bl_gff_t *gene_feature);
 void generate_upstream_features(FILE *feature_stream, bl_gff_t *gff_feature, bl_pos_list_t *pos_list);
 void usage(char *argv[]);
+/* feature-index.c */
+void feature_index_init(feature_index_t *fi);
+int feature_index_set_classes(feature_index_t *fi, const char *priority_list);
+void default_priority_list(char *list, size_t list_size, const char *upstream_boundaries);
+unsigned char feature_index_class_id(feature_index_t *fi, const char *name);
+const char *feature_index_class_name(feature_index_t *fi, unsigned class_id);
+size_t feature_index_find_chrom(feature_index_t *fi, const char *chrom, size_t hint);
+size_t feature_index_add_chrom(feature_index_t *fi, const char *chrom, size_t hint);
+void feature_index_add(feature_index_t *fi, size_t chrom, int64_t start, int64_t end, const char *name, char strand);
+size_t feature_index_add_gene(feature_index_t *fi, size_t chrom);
+int feature_index_load(feature_index_t *fi, const char *bed_filename, _Bool track_genes);
+int feature_index_load_sizes(feature_index_t *fi, const char *sizes_filename);
+void feature_index_build(feature_index_t *fi);
+int feature_cmp(const size_t *i1, const size_t *i2);
+void feature_index_sort_chrom(feature_index_t *fi, fi_chrom_t *ch);
+void hit_list_add(hit_list_t *hits, size_t index);
+void hit_list_free(hit_list_t *hits);
+size_t feature_index_overlaps(feature_index_t *fi, size_t chrom, int64_t start, int64_t end, hit_list_t *hits);
+_Bool overlap_ok(overlap_params_t *params, int64_t peak_len, int64_t feature_len, int64_t overlap_len);
+unsigned feature_index_classify(feature_index_t *fi, size_t chrom, int64_t start, int64_t end, overlap_params_t *params, hit_list_t *hits, class_mask_t *classes);
+unsigned feature_index_resolve(feature_index_t *fi, int64_t start, int64_t end, overlap_params_t *params, hit_list_t *hits, class_mask_t *classes);
+void feature_index_free(feature_index_t *fi);
+int peak_set_read(peak_set_t *peaks, FILE *peak_stream, feature_index_t *fi, _Bool midpoints_only);
+int peak_read(bl_bed_t *bed_feature, FILE *peak_stream, _Bool midpoints_only, int64_t *start, int64_t *end);
+void peak_set_add(peak_set_t *peaks, size_t chrom, int64_t start, int64_t end, const char *name);
+void peak_set_free(peak_set_t *peaks);
+/* enrichment.c */
+uint64_t pc_random(uint64_t *state);
+int64_t random_placement(feature_index_t *fi, feature_index_t *exclude, size_t chrom, size_t exclude_chrom, int64_t start, int64_t width, uint64_t *rng, hit_list_t *hits);
+void *enrich_thread(void *arg);
+int enrichment_test(feature_index_t *fi, feature_index_t *exclude, peak_set_t *peaks, class_coverage_t *cov, overlap_params_t *params, size_t permutations, unsigned threads, uint64_t seed, FILE *outfile);
+/* class-coverage.c */
+int boundary_event_cmp(const boundary_event_t *e1, const boundary_event_t *e2);
+void boundary_events(feature_index_t *fi, size_t first, size_t count, const size_t *index, boundary_event_t *events);
+void class_coverage_add(feature_index_t *fi, int64_t *any_bp, int64_t *priority_bp, int64_t len, class_mask_t active_mask, size_t active_other);
+void boundary_sweep(feature_index_t *fi, boundary_event_t *events, size_t n, int64_t start, int64_t end, int64_t *any_bp, int64_t *priority_bp);
+void class_coverage_compute(feature_index_t *fi, class_coverage_t *cov);
+void peak_composition(feature_index_t *fi, size_t chrom, int64_t start, int64_t end, overlap_params_t *params, hit_list_t *hits, boundary_event_t **events, size_t *events_size, int64_t *bp);
+void class_coverage_write(feature_index_t *fi, class_coverage_t *cov, const char *priority_list, FILE *stream);
+double class_coverage_fraction(class_coverage_t *cov, int64_t bp);
+int class_coverage_read(feature_index_t *fi, class_coverage_t *cov, const char *priority_list, int64_t genome_size, const char *filename);
+int class_coverage_get(feature_index_t *fi, class_coverage_t *cov, const char *priority_list, const char *cache_filename);
+/* gene-rollup.c */
+void gene_rollup_init(gene_rollup_t *gr, feature_index_t *fi, size_t samples);
+void gene_rollup_add(gene_rollup_t *gr, feature_index_t *fi, hit_list_t *hits, size_t sample);
+void gene_rollup_write(gene_rollup_t *gr, feature_index_t *fi, char **sample_names, FILE *outfile);
+void gene_rollup_free(gene_rollup_t *gr);
+/* sample-list.c */
+int sample_list_read(sample_list_t *samples, const char *list_filename);
+void sample_list_free(sample_list_t *samples);
+/* feature-counts.c */
+void feature_counts_init(feature_counts_t *fc, feature_index_t *fi);
+void feature_counts_add(feature_counts_t *fc, feature_index_t *fi, hit_list_t *hits, int64_t start, int64_t end);
+void feature_counts_write(feature_counts_t *fc, feature_index_t *fi, FILE *outfile);
+void feature_counts_free(feature_counts_t *fc);
+/* consensus.c */
+size_t chrom_order_find(chrom_order_t *order, const char *chrom, size_t hint);
+size_t chrom_order_add(chrom_order_t *order, const char *chrom, size_t prev, size_t input);
+int chrom_order_sort(chrom_order_t *order);
+int chrom_order_scan(chrom_order_t *order, sample_list_t *samples);
+void chrom_order_free(chrom_order_t *order);
+int merge_input_cmp(merge_input_t *inputs, size_t i1, size_t i2);
+void merge_heap_down(merge_input_t *inputs, size_t *heap, size_t count, size_t root);
+int merge_input_next(merge_input_t *input, chrom_order_t *order, const char *filename);
+void consensus_peak_write(consensus_peak_t *cp, size_t samples, size_t min_support, size_t *serial, feature_index_t *fi, overlap_params_t *params, hit_list_t *hits, FILE *outfile);
+int consensus_merge(sample_list_t *samples, size_t min_support, feature_index_t *fi, overlap_params_t *params, FILE *outfile);
+/* jaccard.c */
+int sample_event_cmp(const sample_event_t *e1, const sample_event_t *e2);
+void *jaccard_thread(void *arg);
+int jaccard_matrix(feature_index_t *fi, peak_set_t *sets, size_t samples, unsigned threads, int64_t *intersect);
+void jaccard_write(sample_list_t *samples, int64_t *intersect, FILE *outfile);
+/* stitch.c */
+void stitch_list_add(stitch_list_t *list, size_t chrom, int64_t start, int64_t end, double signal);
+int stitch_peaks(feature_index_t *fi, FILE *peak_stream, overlap_params_t *params, int64_t distance, unsigned exclude_class, stitch_list_t *list);
+int stitched_region_cmp(const stitched_region_t *r1, const stitched_region_t *r2);
+double stitch_rank(stitch_list_t *list);
+void stitch_write(stitch_list_t *list, double cutoff, feature_index_t *fi, overlap_params_t *params, FILE *outfile);
+void stitch_list_free(stitch_list_t *list);
+/* tiles.c */
+void tile_classify_chrom(feature_index_t *fi, size_t chrom, int64_t size, int64_t step, overlap_params_t *params, FILE *outfile);
+void tile_classify(feature_index_t *fi, int64_t size, int64_t step, overlap_params_t *params, FILE *outfile);
+/* great.c */
+int great_gene_cmp(const great_gene_t *g1, const great_gene_t *g2);
+void great_domains_write(feature_index_t *fi, int64_t max_extension, FILE *outfile);
+_Bool great_cache_ok(const char *cache_filename, int64_t max_extension);
+int great_domains_get(feature_index_t *domains, const char *augmented_filename, const char *cache_filename, int64_t max_extension);
+void great_assign(feature_index_t *domains, size_t chrom, int64_t start, int64_t end, overlap_params_t *params, hit_list_t *hits, FILE *outfile);
+/* peak-seq.c */
+void seq_encode(const char *seq, size_t len, uint8_t *codes);
+int peak_seq_sweep(const char *fasta_filename, feature_index_t *fi, peak_set_t *peaks, peak_seq_func_t func, void *arg);
+/* motif.c */
+int motif_add(motif_set_t *set, const char *id, const char *name, size_t width, double freq[4][64]);
+size_t motif_parse_row(char *line, double *values, char *base);
+void motif_split_header(char *line, char **id, char **name);
+int motif_set_read(motif_set_t *set, const char *filename);
+void motif_set_free(motif_set_t *set);
+void motif_score_windows(const int32_t *restrict score, size_t width, const uint8_t *restrict codes, size_t windows, int32_t *restrict acc);
+_Bool motif_best_hit(const motif_t *motif, const uint8_t *codes, size_t len, int32_t *acc, motif_hit_t *hit);
+void *motif_thread(void *arg);
+int motif_scan_chrom(void *arg, size_t chrom, const uint8_t *codes, int64_t len, const size_t *peak_indexes, size_t peak_count);
+int motif_scan(motif_set_t *motifs, const char *genome_filename, feature_index_t *fi, peak_set_t *peaks, overlap_params_t *params, double threshold, unsigned threads, FILE *outfile);
+/* kmer.c */
+void kmer_counts_init(kmer_counts_t *kc, unsigned k, size_t slots);
+void kmer_counts_free(kmer_counts_t *kc);
+size_t kmer_hash_find(kmer_counts_t *kc, uint64_t key);
+void kmer_hash_grow(kmer_counts_t *kc);
+void kmer_counts_add(kmer_counts_t *kc, size_t slot, uint64_t kmer, int64_t count);
+int64_t kmer_counts_get(kmer_counts_t *kc, size_t slot, uint64_t kmer);
+void kmer_counts_merge(kmer_counts_t *dest, kmer_counts_t *src);
+void kmer_count_seq(kmer_counts_t *kc, size_t slot, const uint8_t *codes, size_t len);
+void *kmer_thread(void *arg);
+int kmer_count_chrom(void *arg, size_t chrom, const uint8_t *codes, int64_t len, const size_t *peak_indexes, size_t peak_count);
+void kmer_decode(uint64_t kmer, unsigned k, char *str);
+void kmer_write_row(kmer_counts_t *kc, feature_index_t *fi, size_t slot, uint64_t kmer, int64_t count, FILE *outfile);
+int kmer_key_cmp(const uint64_t *key1, const uint64_t *key2);
+void kmer_write(kmer_counts_t *kc, feature_index_t *fi, FILE *outfile);
+int kmer_scan(unsigned k, const char *genome_filename, feature_index_t *fi, peak_set_t *peaks, overlap_params_t *params, unsigned threads, FILE *outfile);
+/* bigwig.c */
+int bw_read_at(bigwig_t *bw, uint64_t offset, void *buf, size_t len);
+int bw_read_chrom_node(bigwig_t *bw, uint64_t offset, uint32_t key_size, size_t *array_size);
+int bw_read_rtree_node(bigwig_t *bw, uint64_t offset, bw_block_t **blocks, size_t *count, size_t *array_size);
+int bw_read_rtree(bigwig_t *bw, uint64_t offset, bw_block_t **blocks, size_t *count);
+int bigwig_open(bigwig_t *bw, const char *filename);
+void bigwig_close(bigwig_t *bw);
+int64_t bigwig_chrom_id(bigwig_t *bw, const char *chrom, size_t *hint);
+int bw_load_block(bigwig_t *bw, const bw_block_t *block, bw_cache_t *cache);
+size_t bw_first_block(const bw_block_t *blocks, size_t count, uint32_t chrom, uint32_t start);
+int bw_stats_full(bigwig_t *bw, uint32_t chrom, int64_t start, int64_t end, bw_stats_t *stats);
+int bw_stats_zoom(bigwig_t *bw, bw_zoom_t *zoom, uint32_t chrom, int64_t start, int64_t end, bw_stats_t *stats, int64_t *inner_start, int64_t *inner_end);
+int bigwig_stats(bigwig_t *bw, int64_t chrom_id, int64_t start, int64_t end, _Bool use_zoom, bw_stats_t *stats);
+void bw_stats_write(bw_stats_t *stats, int64_t size, FILE *outfile);
+/* liftover.c */
+int liftover_load(feature_index_t *chains, const char *chain_filename);
+size_t liftover_region(feature_index_t *chains, const char *chrom, int64_t start, int64_t end, double min_match, hit_list_t *hits, liftover_hit_t **lifted, size_t *lifted_size);
+void liftover_stream(feature_index_t *chains, FILE *in, FILE *out, double min_match);
+void *liftover_thread(void *arg);
+FILE *liftover_pipe(feature_index_t *chains, FILE *peak_stream, double min_match);
+/* loops.c */
+int loop_set_read(loop_set_t *loops, FILE *stream, feature_index_t *fi, _Bool midpoints_only, size_t *skipped);
+int loop_anchor_cmp(const size_t *a1, const size_t *a2);
+void loop_classify(loop_set_t *loops, feature_index_t *fi, overlap_params_t *params);
+void loop_nearest_genes(loop_set_t *loops, feature_index_t *fi);
+void loop_write(loop_set_t *loops, feature_index_t *fi, FILE *outfile);
+void loop_set_free(loop_set_t *loops);
+/* interval-set.c */
+int interval_key_cmp(const interval_key_t *k1, const interval_key_t *k2);
+void interval_set_chrom_first(peak_set_t *set, size_t chrom_count, size_t *chrom_first);
+void interval_set_sort(peak_set_t *set, size_t chrom_count, size_t *chrom_first);
+void interval_set_concat(peak_set_t *sets, size_t count, peak_set_t *result);
+void interval_sweep_chrom(interval_thread_t *it, size_t c);
+void *interval_thread(void *arg);
+int interval_set_apply(int op, peak_set_t *a, peak_set_t *b, feature_index_t *chroms, int64_t distance, unsigned threads);
+void interval_set_slop(peak_set_t *set, feature_index_t *chroms, int64_t bases);
+void interval_set_flank(peak_set_t *set, feature_index_t *chroms, int64_t bases);
+int interval_set_load(peak_set_t *set, const char *filename, feature_index_t *chroms);
+int interval_set_apply_file(int op, peak_set_t *set, const char *filename, feature_index_t *chroms, unsigned threads);
+_Bool interval_ops_active(interval_ops_t *ops);
+void *interval_pipe_thread(void *arg);
+FILE *interval_preprocess(FILE *peak_stream, interval_ops_t *ops);
+/* isoform.c */
+_Bool gff_is_transcript(const char *type);
+int isoform_index_init(isoform_index_t *iso, const char *priority_list);
+unsigned isoform_slot(isoform_index_t *iso, const char *name);
+void isoform_add_gene(isoform_index_t *iso, const char *feature_name);
+void isoform_add_tx(isoform_index_t *iso, const char *name, size_t len);
+void isoform_feature_add(isoform_feature_list_t *list, int64_t start, int64_t end, size_t tx, unsigned slot);
+int position_cmp(const int64_t *p1, const int64_t *p2);
+size_t isoform_bound_index(const int64_t *bounds, size_t n, int64_t pos);
+void isoform_segment_gene(isoform_index_t *iso, size_t chrom, char strand, isoform_feature_list_t *list);
+int isoform_index_load(isoform_index_t *iso, const char *augmented_filename, const char *priority_list);
+void isoform_assign(isoform_index_t *iso, size_t chrom, int64_t start, int64_t end, hit_list_t *hits, isoform_query_t *q, FILE *outfile);
+void isoform_query_free(isoform_query_t *q);
+void isoform_index_free(isoform_index_t *iso);
+/* atac-qc.c */
+int atac_tss_cmp(const atac_tss_t *t1, const atac_tss_t *t2);
+int atac_qc_load(atac_qc_t *qc, FILE *peak_stream, feature_index_t *fi);
+int64_t cigar_ref_len(const char *cigar);
+int64_t atac_insertion(unsigned flag, int64_t start, const char *cigar);
+void atac_qc_insertion(atac_qc_t *qc, size_t chrom, int64_t pos);
+int atac_qc_scan(atac_qc_t *qc, FILE *sam_stream, feature_index_t *fi, unsigned min_mapq);
+void atac_qc_write(atac_qc_t *qc, const char *alignments_filename, FILE *outfile);
+void atac_qc_free(atac_qc_t *qc);
+/* coverage.c */
+void coverage_init(coverage_t *cov, FILE *out);
+void coverage_write_run(void *out, const char *chrom, int64_t start, int64_t end, int64_t depth);
+void coverage_grow(coverage_t *cov, int64_t end);
+void coverage_add(coverage_t *cov, int64_t start, int64_t end);
+void coverage_flush(coverage_t *cov, int64_t pos);
+void coverage_set_chrom(coverage_t *cov, const char *chrom);
+void coverage_free(coverage_t *cov);
+void coverage_add_alignment(coverage_t *cov, int64_t start, const char *cigar);
+int coverage_scan(FILE *sam_stream, unsigned min_mapq, FILE *out, uint64_t *reads);
+void coverage_write_runs(FILE *runs, _Bool cpm, double scale, FILE *out);
+size_t coverage_chroms(const char *alignments_filename, char ***chroms);
+void *coverage_thread(void *arg);
+int coverage_parallel(const char *alignments_filename, char **chroms, size_t chrom_count, unsigned min_mapq, _Bool cpm, unsigned threads, FILE *out);
+/* peak-call.c */
+double peak_call_log10p(int64_t k, double lambda);
+void peak_call_run(void *arg, const char *chrom, int64_t start, int64_t end, int64_t depth);
+double peak_call_area(peak_call_t *pc, int64_t x, size_t *run);
+void peak_call_close_region(peak_call_t *pc);
+void peak_call_test(peak_call_t *pc, int64_t horizon);
+void peak_call_chrom_end(peak_call_t *pc);
+int peak_call_scan(peak_call_t *pc, FILE *sam_stream);
+void peak_call_write(peak_call_t *pc);
+int64_t peak_call_genome_size(FILE *header_stream);
+void *peak_call_thread(void *arg);
+FILE *peak_call_pipe(const char *alignments_filename, const char *narrow_peak_filename, _Bool cut_sites, unsigned min_mapq, double pvalue);
+int peak_call_finish(void);
+/* count-matrix.c */
+int count_matrix_scan(count_sample_t *sample, FILE *sam_stream);
+void *count_matrix_thread(void *arg);
+int count_matrix(sample_list_t *samples, feature_index_t *chroms, peak_set_t *peaks, size_t *chrom_first, unsigned min_mapq, uint64_t *counts, count_sample_t *stats);
+void count_matrix_write(sample_list_t *samples, feature_index_t *chroms, peak_set_t *peaks, uint64_t *counts, FILE *outfile);
+/* sam-blocks.c */
+void sam_blocks_parse(sam_blocks_t *blocks, int64_t start, const char *cigar);
+void sam_blocks_add(sam_blocks_t *blocks, int64_t start, int64_t end);
+int64_t sam_blocks_overlap(const sam_blocks_t *blocks, int64_t start, int64_t end);
+unsigned sam_blocks_classify(feature_index_t *fi, size_t chrom, sam_blocks_t *blocks, overlap_params_t *params, hit_list_t *hits, class_mask_t *classes);
+void sam_blocks_free(sam_blocks_t *blocks);
+/* junction.c */
+void junction_set_init(junction_set_t *set);
+junction_shard_t *junction_shard(junction_set_t *set, const char *chrom, size_t *hint);
+size_t junction_find(junction_shard_t *shard, int64_t start, int64_t end, char strand);
+void junction_grow(junction_shard_t *shard);
+junction_t *junction_add(junction_shard_t *shard, int64_t start, int64_t end, char strand, const char *name, uint64_t count);
+junction_t *junction_lookup(junction_set_t *set, const char *chrom, size_t *hint, int64_t start, int64_t end, char strand);
+int junction_introns_load(junction_set_t *introns, const char *bed_filename);
+char junction_strand(sam_record_t *rec);
+int junction_scan(junction_set_t *junctions, FILE *sam_stream, unsigned min_mapq, uint64_t *spliced_reads);
+int junction_cmp(const junction_t *j1, const junction_t *j2);
+void junction_write(junction_set_t *junctions, junction_set_t *introns, FILE *outfile, size_t *known, size_t *novel);
+void junction_set_free(junction_set_t *set);
+/* sam-record.c */
+int sam_record_read(sam_record_t *rec, FILE *sam_stream);
+void sam_record_write(sam_record_t *rec, FILE *sam_stream);
+const char *sam_record_tag(sam_record_t *rec, const char *tag);
+void sam_record_free(sam_record_t *rec);
+int sam_header_copy(const char *alignments_filename, FILE *out);
+void sam_tmpfile_append(FILE *tmp, FILE *out);
+/* dup-mark.c */
+void dup_mark_init(dup_mark_t *dm, FILE *out);
+int64_t dup_unclipped_5prime(unsigned flag, int64_t pos, const char *cigar);
+uint64_t dup_qname_hash(const char *qname);
+size_t dup_group_find(dup_mark_t *dm, dup_key_t *key);
+void dup_group_rebuild(dup_mark_t *dm);
+dup_group_t *dup_group_get(dup_mark_t *dm, dup_key_t *key);
+void dup_group_score(dup_group_t *g, uint64_t seq, uint64_t score);
+dup_entry_t *dup_queue_tail(dup_mark_t *dm);
+dup_entry_t *dup_queue_entry(dup_mark_t *dm, uint64_t seq);
+size_t dup_mate_find(dup_mark_t *dm, const char *qname);
+void dup_mate_rebuild(dup_mark_t *dm);
+void dup_mate_close(dup_mark_t *dm, dup_entry_t *first, uint64_t score);
+void dup_mark_orphans(dup_mark_t *dm, int64_t pos);
+void dup_mark_flush(dup_mark_t *dm, int64_t limit);
+void dup_pair_key(dup_key_t *key, sam_record_t *rec);
+void dup_mark_add(dup_mark_t *dm, dup_entry_t *e);
+int dup_mark_scan(dup_mark_t *dm, FILE *sam_stream);
+void dup_mark_free(dup_mark_t *dm);
+void *dup_mark_thread(void *arg);
+int dup_mark_parallel(const char *alignments_filename, char **chroms, size_t chrom_count, unsigned threads, FILE *out, dup_mark_t *totals);
+/* region-filter.c */
+int region_filter_load(region_filter_t *rf, const char *bed_filename, _Bool include, unsigned min_mapq, unsigned threads);
+int region_filter_scan(region_filter_t *rf, FILE *sam_stream, FILE *out);
+void region_filter_free(region_filter_t *rf);
+/* peak-extras.c */
+int peak_extras_open(peak_extras_t *px, const char *composition_filename, const char *gene_rollup_filename, const char *feature_counts_filename, const char *sorted_filename, const char *augmented_filename, const char *priority_list, overlap_params_t *params);
+void peak_extras_add(peak_extras_t *px, const char *chrom_name, int64_t start, int64_t end, const char *peak_name);
+int peak_extras_close(peak_extras_t *px);
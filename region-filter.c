@@ -0,0 +1,173 @@
+/***************************************************************************
+ *  Description:
+ *      Region filter for sorted alignments, replacing samtools view -L
+ *      and bedtools intersect -v with one pass.  An exclusion or
+ *      inclusion BED is merged into a sorted per-chromosome interval
+ *      index, and each alignment's CIGAR blocks are tested against it
+ *      with a pointer that only moves forward.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Load the regions in bed_filename into rf.  Overlapping and
+ *      adjacent regions are merged, so that the regions of each
+ *      chromosome are sorted by end as well as start.  If include is
+ *      true, alignments overlapping no region are filtered out,
+ *      otherwise those overlapping any region are.
+ *
+ *  Returns:
+ *      EX_OK, EX_NOINPUT, EX_DATAERR, or EX_OSERR
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     region_filter_load(region_filter_t *rf, const char *bed_filename,
+			   bool include, unsigned min_mapq, unsigned threads)
+
+{
+    int     status;
+
+    memset(rf, 0, sizeof(*rf));
+    rf->regions = (peak_set_t)PEAK_SET_INIT;
+    rf->include = include;
+    rf->min_mapq = min_mapq;
+    // Only used to number chromosomes for the sweep
+    feature_index_init(&rf->chroms);
+    if ( (status = interval_set_load(&rf->regions, bed_filename, &rf->chroms))
+	    != FEATURE_INDEX_OK )
+	return status == FEATURE_INDEX_NOINPUT ? EX_NOINPUT : EX_DATAERR;
+    if ( interval_set_apply(INTERVAL_MERGE, &rf->regions, NULL, &rf->chroms,
+			    0, threads) != EX_OK )
+	return EX_OSERR;
+    rf->chrom_first = xt_malloc(rf->chroms.chrom_count + 1,
+				sizeof(*rf->chrom_first));
+    if ( rf->chrom_first == NULL )
+    {
+	fputs("region_filter_load(): Could not allocate chromosomes.\n", stderr);
+	exit(EX_UNAVAILABLE);
+    }
+    interval_set_chrom_first(&rf->regions, rf->chroms.chrom_count,
+			     rf->chrom_first);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Copy a sorted SAM stream positioned after the header to out,
+ *      dropping unmapped alignments, those below rf->min_mapq, and those
+ *      rejected by the regions.  An alignment overlaps a region if one
+ *      of its CIGAR blocks does, so spliced reads do not overlap regions
+ *      within their introns.  Passing records are written unchanged,
+ *      with their optional tags.
+ *
+ *      Alignments on a chromosome without regions overlap nothing, so
+ *      with an inclusion BED, off-target contigs are dropped.
+ *
+ *  Returns:
+ *      BL_READ_EOF on success, BL_READ_BAD_DATA if alignments are not
+ *      sorted, or another read status
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     region_filter_scan(region_filter_t *rf, FILE *sam_stream, FILE *out)
+
+{
+    sam_record_t    rec = SAM_RECORD_INIT;
+    sam_blocks_t    blocks = SAM_BLOCKS_INIT;
+    peak_set_t      *regions = &rf->regions;
+    char            *rname = NULL;
+    size_t          chrom = 0, first = 0, last = 0, r;
+    int64_t         start, end, previous_start = 0;
+    bool            overlap;
+    int             status;
+
+    while ( (status = sam_record_read(&rec, sam_stream)) == BL_READ_OK )
+    {
+	++rf->records;
+	if ( rec.flag & BL_SAM_FLAG_UNMAP )
+	{
+	    ++rf->unmapped;
+	    continue;
+	}
+	if ( rec.mapq < rf->min_mapq )
+	{
+	    ++rf->low_mapq;
+	    continue;
+	}
+	start = rec.pos - 1;
+	if ( (rname == NULL) ||
+	     (strcmp(rname, SAM_RECORD_FIELD(&rec, SAM_RECORD_RNAME)) != 0) )
+	{
+	    free(rname);
+	    rname = strdup(SAM_RECORD_FIELD(&rec, SAM_RECORD_RNAME));
+	    chrom = feature_index_find_chrom(&rf->chroms, rname, chrom);
+	    if ( chrom < rf->chroms.chrom_count )
+	    {
+		first = rf->chrom_first[chrom];
+		last = rf->chrom_first[chrom + 1];
+	    }
+	    else
+		first = last = 0;
+	}
+	else if ( start < previous_start )
+	{
+	    fprintf(stderr, "region_filter_scan(): Alignments are not sorted: "
+		    "%s %" PRId64 "\n", rname, start + 1);
+	    status = BL_READ_BAD_DATA;
+	    break;
+	}
+	previous_start = start;
+
+	sam_blocks_parse(&blocks, start,
+			 SAM_RECORD_FIELD(&rec, SAM_RECORD_CIGAR));
+	end = blocks.count > 0 ? blocks.end[blocks.count - 1] : start;
+	while ( (first < last) && (regions->end[first] <= start) )
+	    ++first;
+	overlap = false;
+	for (r = first; !overlap && (r < last) && (regions->start[r] < end); ++r)
+	    overlap = sam_blocks_overlap(&blocks, regions->start[r],
+					 regions->end[r]) > 0;
+	if ( overlap && !rf->include )
+	    ++rf->excluded;
+	else if ( !overlap && rf->include )
+	    ++rf->outside;
+	else
+	{
+	    ++rf->passed;
+	    sam_record_write(&rec, out);
+	}
+    }
+    sam_blocks_free(&blocks);
+    sam_record_free(&rec);
+    free(rname);
+    return status;
+}
+
+
+void    region_filter_free(region_filter_t *rf)
+
+{
+    free(rf->chrom_first);
+    peak_set_free(&rf->regions);
+    feature_index_free(&rf->chroms);
+}
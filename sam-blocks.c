@@ -0,0 +1,185 @@
+/***************************************************************************
+ *  Description:
+ *      Reference blocks of an alignment.  The CIGAR is parsed once per
+ *      alignment into the reference intervals it actually covers, so
+ *      that spliced reads do not overlap the introns they skip, and
+ *      every overlap test against the alignment is a loop over the
+ *      cached blocks.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Parse the CIGAR of an alignment starting at 0-based start into
+ *      reference blocks, reusing the arrays already in blocks.  M, =,
+ *      X, and D extend the current block and N (skipped reference, e.g.
+ *      an intron) ends it.  An alignment with no reference-consuming
+ *      operations, such as CIGAR "*", has no blocks.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    sam_blocks_parse(sam_blocks_t *blocks, int64_t start, const char *cigar)
+
+{
+    const char  *p;
+    char        *end;
+    int64_t     pos = start, block_start = start, len;
+
+    blocks->count = 0;
+    blocks->aligned_len = 0;
+    for (p = cigar; isdigit((unsigned char)*p); p = end + 1)
+    {
+	len = strtoll(p, &end, 10);
+	if ( *end == '\0' )
+	    break;
+	switch(*end)
+	{
+	    case    'M':
+	    case    '=':
+	    case    'X':
+	    case    'D':
+		pos += len;
+		break;
+	    case    'N':
+		sam_blocks_add(blocks, block_start, pos);
+		pos += len;
+		block_start = pos;
+		break;
+	    default:
+		break;
+	}
+    }
+    sam_blocks_add(blocks, block_start, pos);
+}
+
+
+void    sam_blocks_add(sam_blocks_t *blocks, int64_t start, int64_t end)
+
+{
+    if ( end <= start )
+	return;
+    if ( blocks->count == blocks->array_size )
+    {
+	blocks->array_size = blocks->array_size == 0 ? SAM_BLOCKS_START_SIZE :
+			     blocks->array_size * 2;
+	blocks->start = xt_realloc(blocks->start, blocks->array_size,
+				   sizeof(*blocks->start));
+	blocks->end = xt_realloc(blocks->end, blocks->array_size,
+				 sizeof(*blocks->end));
+	if ( (blocks->start == NULL) || (blocks->end == NULL) )
+	{
+	    fputs("sam_blocks_add(): Could not allocate blocks.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    blocks->start[blocks->count] = start;
+    blocks->end[blocks->count++] = end;
+    blocks->aligned_len += end - start;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the number of bases of [start, end) covered by the blocks.
+ *      The loop has no branches or early exits so that the compiler can
+ *      vectorize it over the block arrays.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int64_t sam_blocks_overlap(const sam_blocks_t *blocks, int64_t start,
+			   int64_t end)
+
+{
+    const int64_t   *bstart = blocks->start, *bend = blocks->end;
+    int64_t         len, sum = 0;
+    size_t          b;
+
+    for (b = 0; b < blocks->count; ++b)
+    {
+	len = XT_MIN(end, bend[b]) - XT_MAX(start, bstart[b]);
+	sum += len > 0 ? len : 0;
+    }
+    return sum;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify an alignment by its blocks, as feature_index_classify()
+ *      does for a peak.  Candidates come from the span of the blocks and
+ *      are kept only if the blocks themselves overlap them enough, with
+ *      the aligned length in place of the peak length.
+ *
+ *  Returns:
+ *      The highest priority class overlapped, or beyond_class
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+unsigned    sam_blocks_classify(feature_index_t *fi, size_t chrom,
+				sam_blocks_t *blocks, overlap_params_t *params,
+				hit_list_t *hits, class_mask_t *classes)
+
+{
+    size_t          c, kept, f;
+    unsigned        best = FEATURE_CLASS_NONE;
+    class_mask_t    mask = 0;
+
+    if ( blocks->count == 0 )
+	hits->count = 0;
+    else
+	feature_index_overlaps(fi, chrom, blocks->start[0],
+			       blocks->end[blocks->count - 1], hits);
+    for (c = kept = 0; c < hits->count; ++c)
+    {
+	f = hits->index[c];
+	if ( overlap_ok(params, blocks->aligned_len, fi->end[f] - fi->start[f],
+			sam_blocks_overlap(blocks, fi->start[f], fi->end[f])) )
+	{
+	    hits->index[kept++] = f;
+	    if ( fi->class_id[f] != FEATURE_CLASS_NONE )
+	    {
+		mask |= (class_mask_t)1 << fi->class_id[f];
+		if ( fi->class_id[f] < best )
+		    best = fi->class_id[f];
+	    }
+	}
+    }
+    hits->count = kept;
+    if ( kept == 0 )
+	best = fi->beyond_class;
+    if ( classes != NULL )
+	*classes = mask;
+    return best;
+}
+
+
+void    sam_blocks_free(sam_blocks_t *blocks)
+
+{
+    free(blocks->start);
+    free(blocks->end);
+    blocks->count = blocks->array_size = 0;
+    blocks->start = blocks->end = NULL;
+}
@@ -0,0 +1,196 @@
+/***************************************************************************
+ *  Description:
+ *      Raw SAM records for filters that write alignments back out.
+ *      bl_sam_read() discards optional tags, so records are kept as
+ *      the original line with the mandatory fields split in place and
+ *      the tags untouched, and only the flag is rewritten on output.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <inttypes.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Read one alignment line into rec, reusing its buffer.  The 11
+ *      mandatory fields are NUL terminated in place and the optional
+ *      tags, if any, are left as one string.  The header must already
+ *      have been skipped.
+ *
+ *  Returns:
+ *      BL_READ_OK, BL_READ_EOF, or BL_READ_TRUNCATED
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     sam_record_read(sam_record_t *rec, FILE *sam_stream)
+
+{
+    ssize_t len;
+    char    *p, *tab;
+    int     f;
+
+    if ( (len = getline(&rec->line, &rec->line_size, sam_stream)) == -1 )
+	return BL_READ_EOF;
+    if ( (len > 0) && (rec->line[len - 1] == '\n') )
+	rec->line[--len] = '\0';
+    for (f = 0, p = rec->line; f < SAM_RECORD_FIELDS; ++f)
+    {
+	rec->field[f] = p - rec->line;
+	if ( (tab = strchr(p, '\t')) != NULL )
+	{
+	    *tab = '\0';
+	    p = tab + 1;
+	}
+	else if ( f < SAM_RECORD_FIELDS - 1 )
+	{
+	    fprintf(stderr, "sam_record_read(): Truncated record: %s\n",
+		    rec->line);
+	    return BL_READ_TRUNCATED;
+	}
+	else
+	    p = rec->line + len;
+    }
+    rec->field[SAM_RECORD_FIELDS] = p - rec->line;
+    rec->flag = strtoul(SAM_RECORD_FIELD(rec, SAM_RECORD_FLAG), NULL, 10);
+    rec->pos = strtoll(SAM_RECORD_FIELD(rec, SAM_RECORD_POS), NULL, 10);
+    rec->mapq = strtoul(SAM_RECORD_FIELD(rec, SAM_RECORD_MAPQ), NULL, 10);
+    rec->pnext = strtoll(SAM_RECORD_FIELD(rec, SAM_RECORD_PNEXT), NULL, 10);
+    return BL_READ_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write rec as a SAM line with its current flag.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    sam_record_write(sam_record_t *rec, FILE *sam_stream)
+
+{
+    int     f;
+
+    fprintf(sam_stream, "%s\t%u", SAM_RECORD_FIELD(rec, SAM_RECORD_QNAME),
+	    rec->flag);
+    for (f = SAM_RECORD_RNAME; f < SAM_RECORD_FIELDS; ++f)
+    {
+	putc('\t', sam_stream);
+	fputs(SAM_RECORD_FIELD(rec, f), sam_stream);
+    }
+    if ( *SAM_RECORD_FIELD(rec, SAM_RECORD_FIELDS) != '\0' )
+    {
+	putc('\t', sam_stream);
+	fputs(SAM_RECORD_FIELD(rec, SAM_RECORD_FIELDS), sam_stream);
+    }
+    putc('\n', sam_stream);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Find the optional tag named tag (e.g. "XS") in rec.  The tags are
+ *      not split, so the value runs to the next tab or the end of the
+ *      line.
+ *
+ *  Returns:
+ *      Pointer to the value following "XX:T:", or NULL if absent
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-19  agent       Begin
+ ***************************************************************************/
+
+const char  *sam_record_tag(sam_record_t *rec, const char *tag)
+
+{
+    const char  *p;
+
+    for (p = SAM_RECORD_FIELD(rec, SAM_RECORD_FIELDS); *p != '\0'; )
+    {
+	if ( (p[0] == tag[0]) && (p[1] == tag[1]) && (p[2] == ':') &&
+	     (p[3] != '\0') && (p[4] == ':') )
+	    return p + 5;
+	if ( (p = strchr(p, '\t')) == NULL )
+	    break;
+	++p;
+    }
+    return NULL;
+}
+
+
+void    sam_record_free(sam_record_t *rec)
+
+{
+    free(rec->line);
+    rec->line = NULL;
+    rec->line_size = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Copy the SAM header of alignments_filename to out, for modes that
+ *      read chromosomes with separate samtools queries.
+ *
+ *  Returns:
+ *      EX_OK or EX_NOINPUT
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     sam_header_copy(const char *alignments_filename, FILE *out)
+
+{
+    char    cmd[PEAK_CMD_MAX + 1];
+    FILE    *header;
+    int     ch;
+
+    snprintf(cmd, PEAK_CMD_MAX, "samtools view -H %s", alignments_filename);
+    if ( (header = popen(cmd, "r")) == NULL )
+	return EX_NOINPUT;
+    while ( (ch = getc(header)) != EOF )
+	putc(ch, out);
+    pclose(header);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append the contents of a temp file to out and close it.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    sam_tmpfile_append(FILE *tmp, FILE *out)
+
+{
+    char    buff[65536];
+    size_t  count;
+
+    rewind(tmp);
+    while ( (count = fread(buff, 1, sizeof(buff), tmp)) > 0 )
+	fwrite(buff, 1, count, out);
+    fclose(tmp);
+}
@@ -0,0 +1,107 @@
+/***************************************************************************
+ *  Description:
+ *      Lists of sample files for --batch modes, which process many peak
+ *      files against one resident feature index.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Read a list of sample files, one per line.  Blank lines and lines
+ *      beginning with '#' are ignored.  Each sample is named for its
+ *      file, without the directory or extension.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK, FEATURE_INDEX_NOINPUT, or FEATURE_INDEX_BAD_DATA
+ *      if the list is empty
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     sample_list_read(sample_list_t *samples, const char *list_filename)
+
+{
+    FILE    *list_stream;
+    char    filename[PATH_MAX + 1],
+	    *name, *p;
+    size_t  len;
+    int     delim;
+
+    if ( (list_stream = fopen(list_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "sample_list_read(): Cannot open %s: %s\n",
+		list_filename, strerror(errno));
+	return FEATURE_INDEX_NOINPUT;
+    }
+    while ( (delim = tsv_read_field(list_stream, filename, PATH_MAX, &len))
+	    != EOF )
+    {
+	if ( delim != '\n' )
+	    tsv_skip_rest_of_line(list_stream);
+	if ( (*filename == '\0') || (*filename == '#') )
+	    continue;
+	if ( samples->count == samples->array_size )
+	{
+	    samples->array_size = samples->array_size == 0 ? 64 :
+				  samples->array_size * 2;
+	    samples->filenames = xt_realloc(samples->filenames,
+			samples->array_size, sizeof(*samples->filenames));
+	    samples->names = xt_realloc(samples->names,
+			samples->array_size, sizeof(*samples->names));
+	    if ( (samples->filenames == NULL) || (samples->names == NULL) )
+	    {
+		fputs("sample_list_read(): Could not allocate list.\n", stderr);
+		exit(EX_UNAVAILABLE);
+	    }
+	}
+	samples->filenames[samples->count] = strdup(filename);
+	if ( (name = strrchr(filename, '/')) == NULL )
+	    name = filename;
+	else
+	    ++name;
+	if ( ((p = strstr(name, ".bed")) != NULL) ||
+	     ((p = strrchr(name, '.')) != NULL) )
+	    *p = '\0';
+	samples->names[samples->count++] = strdup(name);
+    }
+    fclose(list_stream);
+    if ( samples->count == 0 )
+    {
+	fprintf(stderr, "sample_list_read(): No samples in %s.\n", list_filename);
+	return FEATURE_INDEX_BAD_DATA;
+    }
+    return FEATURE_INDEX_OK;
+}
+
+
+void    sample_list_free(sample_list_t *samples)
+
+{
+    size_t  c;
+
+    for (c = 0; c < samples->count; ++c)
+    {
+	free(samples->filenames[c]);
+	free(samples->names[c]);
+    }
+    free(samples->filenames);
+    free(samples->names);
+    samples->count = samples->array_size = 0;
+    samples->filenames = samples->names = NULL;
+}
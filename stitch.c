@@ -0,0 +1,222 @@
+/***************************************************************************
+ *  Description:
+ *      Super-enhancer style stitching, as in ROSE.  Sorted peaks within
+ *      a given distance of each other are stitched into regions, after
+ *      dropping peaks in a promoter class, and regions are ranked by
+ *      summed signal.  Regions above the inflection point of the
+ *      ranked signal curve are called super-enhancers.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Start a new stitched region with a single peak.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    stitch_list_add(stitch_list_t *list, size_t chrom, int64_t start,
+			int64_t end, double signal)
+
+{
+    stitched_region_t   *region;
+
+    if ( list->count == list->array_size )
+    {
+	list->array_size = list->array_size == 0 ? PEAK_SET_START_SIZE :
+			   list->array_size * 2;
+	list->regions = xt_realloc(list->regions, list->array_size,
+				   sizeof(*list->regions));
+	if ( list->regions == NULL )
+	{
+	    fputs("stitch_list_add(): Could not allocate regions.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+    }
+    region = &list->regions[list->count++];
+    region->chrom = chrom;
+    region->start = start;
+    region->end = end;
+    region->constituents = 1;
+    region->signal = signal;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Stitch the peaks in a sorted BED stream in one pass.  Peaks whose
+ *      classes include exclude_class are dropped first, unless it is
+ *      FEATURE_CLASS_NONE.  Signal is the BED score, or 1 per peak if
+ *      the BED has no score column.
+ *
+ *  Returns:
+ *      FEATURE_INDEX_OK or FEATURE_INDEX_BAD_DATA
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+int     stitch_peaks(feature_index_t *fi, FILE *peak_stream,
+		     overlap_params_t *params, int64_t distance,
+		     unsigned exclude_class, stitch_list_t *list)
+
+{
+    bl_bed_t            bed_feature = BL_BED_INIT;
+    hit_list_t          hits = HIT_LIST_INIT;
+    stitched_region_t   *last;
+    class_mask_t        classes;
+    size_t              chrom = 0;
+    int64_t             start, end;
+    double              signal;
+    int                 status;
+
+    bl_bed_skip_header(peak_stream);
+    while ( (status = peak_read(&bed_feature, peak_stream, false,
+				&start, &end)) == BL_READ_OK )
+    {
+	chrom = feature_index_add_chrom(fi, BL_BED_CHROM(&bed_feature), chrom);
+	if ( exclude_class != FEATURE_CLASS_NONE )
+	{
+	    feature_index_classify(fi, chrom, start, end, params, &hits,
+				   &classes);
+	    if ( classes & ((class_mask_t)1 << exclude_class) )
+	    {
+		++list->excluded;
+		continue;
+	    }
+	}
+	signal = BL_BED_FIELDS(&bed_feature) > 4 ?
+		 BL_BED_SCORE(&bed_feature) : 1.0;
+	last = list->count == 0 ? NULL : &list->regions[list->count - 1];
+	if ( (last != NULL) && (last->chrom == chrom) &&
+	     (start < last->start) )
+	{
+	    fprintf(stderr, "stitch_peaks(): Peaks are not sorted at %s %" PRId64 ".\n",
+		    BL_BED_CHROM(&bed_feature), start);
+	    hit_list_free(&hits);
+	    return FEATURE_INDEX_BAD_DATA;
+	}
+	if ( (last != NULL) && (last->chrom == chrom) &&
+	     (start - last->end <= distance) )
+	{
+	    last->end = XT_MAX(last->end, end);
+	    ++last->constituents;
+	    last->signal += signal;
+	}
+	else
+	    stitch_list_add(list, chrom, start, end, signal);
+    }
+    hit_list_free(&hits);
+    return status == BL_READ_EOF ? FEATURE_INDEX_OK : FEATURE_INDEX_BAD_DATA;
+}
+
+
+/*
+ *  Descending signal, then genomic order for reproducible ranks
+ */
+
+int     stitched_region_cmp(const stitched_region_t *r1,
+			    const stitched_region_t *r2)
+
+{
+    if ( r1->signal != r2->signal )
+	return r1->signal > r2->signal ? -1 : 1;
+    if ( r1->chrom != r2->chrom )
+	return r1->chrom < r2->chrom ? -1 : 1;
+    return r1->start < r2->start ? -1 : r1->start > r2->start;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sort regions by descending signal and return the ROSE cutoff:
+ *      the signal at the point where a line with the slope of the whole
+ *      ascending signal curve, (max - min) / n, is tangent to it.
+ *      Regions with signal above the cutoff are super-enhancers.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+double  stitch_rank(stitch_list_t *list)
+
+{
+    size_t  c, n = list->count, best = 0;
+    double  slope, y, min_y = 0.0, signal;
+
+    if ( n == 0 )
+	return 0.0;
+    qsort(list->regions, n, sizeof(*list->regions),
+	  (int (*)(const void *, const void *))stitched_region_cmp);
+    slope = (list->regions[0].signal - list->regions[n - 1].signal) / n;
+    // Ascending position c + 1 is region n - 1 - c
+    for (c = 0; c < n; ++c)
+    {
+	signal = list->regions[n - 1 - c].signal;
+	y = signal - slope * (c + 1);
+	if ( (c == 0) || (y < min_y) )
+	{
+	    min_y = y;
+	    best = c;
+	}
+    }
+    return list->regions[n - 1 - best].signal;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write ranked stitched regions with their priority-resolved class.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    stitch_write(stitch_list_t *list, double cutoff, feature_index_t *fi,
+		     overlap_params_t *params, FILE *outfile)
+
+{
+    stitched_region_t   *region;
+    hit_list_t          hits = HIT_LIST_INIT;
+    size_t              c;
+
+    fprintf(outfile, "#Chr\tStart\tEnd\tName\tConstituents\tSignal\tRank\tSuper\tClass\n");
+    for (c = 0; c < list->count; ++c)
+    {
+	region = &list->regions[c];
+	fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\tstitched%zu\t%zu\t%g\t%zu\t%d\t%s\n",
+		fi->chroms[region->chrom].name, region->start, region->end,
+		c + 1, region->constituents, region->signal, c + 1,
+		region->signal > cutoff,
+		feature_index_class_name(fi, feature_index_classify(fi,
+			region->chrom, region->start, region->end, params,
+			&hits, NULL)));
+    }
+    hit_list_free(&hits);
+}
+
+
+void    stitch_list_free(stitch_list_t *list)
+
+{
+    free(list->regions);
+    list->regions = NULL;
+    list->count = list->array_size = list->excluded = 0;
+}
@@ -0,0 +1,88 @@
+/***************************************************************************
+ *  Description:
+ *      Classification of fixed-size genome tiles, enumerated on the fly
+ *      from chromosome sizes.  Tiles advance monotonically, so they are
+ *      classified by a synchronized sweep over each chromosome's sorted
+ *      features rather than an index query per tile, and no tile BED is
+ *      ever written or sorted.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "libxtend.h"
+#include "biolibc.h"
+#include "peak-classifier.h"
+
+/***************************************************************************
+ *  Description:
+ *      Classify tiles [start, start + size) for start = 0, step, ...
+ *      up to the size of one chromosome.  The last tile is truncated at
+ *      the chromosome end.  Each line has the priority-resolved class
+ *      and the set of all classes overlapped as a hexadecimal bit mask,
+ *      bit N for class N in the priority list.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-18  agent       Begin
+ ***************************************************************************/
+
+void    tile_classify_chrom(feature_index_t *fi, size_t chrom, int64_t size,
+			    int64_t step, overlap_params_t *params,
+			    FILE *outfile)
+
+{
+    fi_chrom_t      *ch = &fi->chroms[chrom];
+    hit_list_t      active = HIT_LIST_INIT,
+		    hits = HIT_LIST_INIT;
+    size_t          next = ch->first, last = ch->first + ch->count, c, kept;
+    int64_t         start, end;
+    class_mask_t    classes;
+    unsigned        class_id;
+
+    for (start = 0; start < ch->size; start += step)
+    {
+	end = XT_MIN(start + size, ch->size);
+
+	// Retire features ending before this tile, add those starting in it
+	for (c = kept = 0; c < active.count; ++c)
+	    if ( fi->end[active.index[c]] > start )
+		active.index[kept++] = active.index[c];
+	active.count = kept;
+	while ( (next < last) && (fi->start[next] < end) )
+	{
+	    if ( fi->end[next] > start )
+		hit_list_add(&active, next);
+	    ++next;
+	}
+
+	hits.count = 0;
+	for (c = 0; c < active.count; ++c)
+	    hit_list_add(&hits, active.index[c]);
+	class_id = feature_index_resolve(fi, start, end, params, &hits,
+					 &classes);
+	fprintf(outfile, "%s\t%" PRId64 "\t%" PRId64 "\t%s\t%" PRIx64 "\n",
+		ch->name, start, end, feature_index_class_name(fi, class_id),
+		classes);
+    }
+    hit_list_free(&active);
+    hit_list_free(&hits);
+}
+
+
+void    tile_classify(feature_index_t *fi, int64_t size, int64_t step,
+		      overlap_params_t *params, FILE *outfile)
+
+{
+    size_t  c;
+
+    fputs("#Chr\tStart\tEnd\tClass\tClasses\n", outfile);
+    for (c = 0; c < fi->chrom_count; ++c)
+	tile_classify_chrom(fi, c, size, step, params, outfile);
+}